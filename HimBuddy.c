@@ -10,10 +10,21 @@
  * - Magic "alert" command
  * - Google Maps Intent Link
  * - Buzzer Test Button
+ * - Sensor History & Trend Graphs (/api/history, /trend)
+ * - Multi-Client Web Server (own task, keep-alive, bounded pool)
+ * - WebSocket Control (/ws) for instant buttons & live state
+ * - OLED redrawn only on change, no blocking sensor screens (/api/perf)
+ * - No String / heap use in loop() and web pages, heap telemetry (/api/heap)
+ * - Earthquake = FFT classifier on MPU6050 FIFO data, not any shake (/api/quake)
+ * - Alert rules as text in flash, changed from the website (/api/rules)
+ * - Alerts broadcast to the hotspot over UDP (port 47267), no polling
+ * - Pins + features from a compile-time board profile (src/board_config.h, /api/board)
+ * - Unplugged sensors skipped, re-probed with backoff (src/sensor_health.h, /api/health)
+ * - Black box: 6 s before + 3 s after every alert, MPU6050 at 100 Hz (/api/blackbox)
  ****************************************************************/
 
 #include <WiFi.h>
-#include <WebServer.h>
+#include <esp_http_server.h>
 #include <Wire.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
@@ -21,13 +32,43 @@
 #include <Adafruit_Sensor.h>
 #include <DHT.h>
 #include <TinyGPS++.h>
+#include <Preferences.h>
+#include <array>
+#include <utility>
+
+// Board profile: pins + features (src/board_config.h). Another one:
+// build with -DHIMBUDDY_PROFILE=PROFILE_...
+#ifndef HIMBUDDY_PROFILE
+#define HIMBUDDY_PROFILE PROFILE_WEB
+#endif
+#include "src/board_config.h"
+static_assert(BOARD.features.web && !BOARD.features.bt && !BOARD.features.sd && !BOARD.features.modem &&
+              !BOARD.features.bme280 && !BOARD.features.mesh && !BOARD.features.powerSave,
+              "HimBuddy.c is the web unit: only the web feature is written here");
+
+#include "src/history.h"
+#include "src/heap_stats.h"
+#include "src/quake_fft.h"
+#include "src/rules.h"
+#include "src/bench.h"
+#include "src/log_format.h"
+#include "src/oled_message.h"
+#include "src/alert_beacon.h"
+#include "src/sensor_health.h"
+#include "src/blackbox.h"
 
 // ==============================================================
 //                    WIFI CONFIGURATION
 // ==============================================================
 const char* ssid = "Himbuddy by akshitvip"; // Hotspot Name
 const char* pass = "akshitvip";             // Password
-WebServer server(80);                       // Server Port
+httpd_handle_t server = NULL;               // HTTP server (runs in its own task, port 80)
+
+// Max phones on the hotspot (ESP32 SoftAP allows up to 10)
+#define WIFI_MAX_STATIONS 10
+// Open HTTP sockets at once (keep-alive). When full, the longest
+// idle one is closed so a new phone always gets in.
+#define WEB_MAX_SOCKETS 12
 
 // ==============================================================
 //                    OLED DISPLAY SETTINGS
@@ -39,22 +80,15 @@ Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1);
 // ==============================================================
 //                    PIN DEFINITIONS (STABLE PINS)
 // ==============================================================
-// Soil Sensor connected to Pin 32 (ADC1)
-#define SOIL_PIN 32          
-
-// Gas Sensor connected to Pin 33 (ADC1)
-#define MQ2_PIN 33           
-
-// Buzzer connected to Pin 25
-#define BUZZER_PIN 25        
-
-// DHT Sensor connected to Pin 4
-#define DHTPIN 4
+// From the board profile (PROFILE_WEB: soil 32 + gas 33 on ADC1,
+// buzzer 25, DHT 4, GPS on Serial2 RX=16 TX=17, I2C 21/22)
+constexpr int SOIL_PIN = BOARD.pins.soil;
+constexpr int MQ2_PIN = BOARD.pins.mq2;
+constexpr int BUZZER_PIN = BOARD.pins.buzzer;
+constexpr int DHTPIN = BOARD.pins.dht;
 #define DHTTYPE DHT22
-
-// GPS Module connected to Serial2 (RX=16, TX=17)
-#define GPS_RX 16
-#define GPS_TX 17
+constexpr int GPS_RX = BOARD.pins.gpsRx;
+constexpr int GPS_TX = BOARD.pins.gpsTx;
 
 // ==============================================================
 //                    SAFETY THRESHOLDS (LIMITS)
@@ -65,8 +99,11 @@ Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1);
 // Isse zyada value aayi to Aag hai
 #define GAS_LIMIT 2500       
 
-// Isse tez hila to Bhukamp hai
-#define QUAKE_LIMIT 3.5      
+// Isse tez hila to Bhukamp hai (PGA in mg, sirf jab FFT "SEISMIC" bole)
+#define QUAKE_PGA_MG 30
+
+// (The alerts themselves are rules, see ALERT RULES. These limits are
+// the factory rules and what the sensor screens beep at.)
 
 // ==============================================================
 //                    SENSOR OBJECTS
@@ -79,32 +116,80 @@ HardwareSerial gpsSerial(1);
 // ==============================================================
 //                    GLOBAL VARIABLES
 // ==============================================================
-int menuIndex = 0; 
-bool inMenu = true; 
-
-// Menu Items Array
-String menuItems[] = {
-  "SOIL SENSOR", 
-  "MQ2 GAS", 
-  "DHT TEMP", 
-  "MPU QUAKE", 
-  "GPS LOC", 
-  "DEV INFO"
-};
+volatile int menuIndex = 0; 
+volatile bool inMenu = true; 
+// (menu entries: SENSORS[] in the SENSOR REGISTRY below)
 
 // Variables for Logic
-String currentAlert = ""; // Stores current danger message
+// Stores current danger message. Always points to a fixed text (or a
+// rule name in alertNames, never changed once added), so the web task
+// can read it while loop() changes it.
+const char* volatile currentAlert = "";
+
+// currentAlert broadcast to the hotspot (see src/alert_beacon.h);
+// loop() only
+UdpBeaconSocket beaconSocket;
+AlertBeacon beacon;
 
 // --- Variables for New Features (Text Box & Web) ---
-String lastWebMessage = "";
-bool showMessageMode = false;
-unsigned long messageTimer = 0;
+// The web task queues messages, loop() takes the next one when the
+// shown one is done and copies it to lastWebMessage (for the phones).
+// Both guarded by webMux.
+#define WEB_MESSAGE_LEN 64
+#define WEB_MESSAGE_QUEUE 8          // waiting messages kept
+#define WEB_MESSAGE_TTL_MS 60000     // not on the OLED by then: dropped
+#define WEB_MESSAGE_PRIO_ALARM 9     // magic "alert" (/msg p= goes up to 8)
+MessageQueue<WEB_MESSAGE_QUEUE, WEB_MESSAGE_LEN> webMessages;
+char lastWebMessage[WEB_MESSAGE_LEN] = "";
+volatile uint32_t webMessageId = 0;  // +1 per message put on the OLED
+portMUX_TYPE webMux = portMUX_INITIALIZER_UNLOCKED;
+volatile bool showMessageMode = false;
+
+// Slow actions asked for by the web task, done by loop()
+volatile bool webAlarmPending = false;
+volatile bool buzzTestPending = false;
+
+// Last DHT reading (from recordHistory), so web pages never touch the sensor
+volatile float lastTemp = NAN;
+volatile float lastHum = NAN;
 
-// --- MPU Logic Variables ---
-unsigned long moveStartTime = 0;
-bool earthquake = false;
-float lastX = 0;
-float lastY = 0;
+// --- Sensor health (ok / degraded / absent) ---
+// A sensor that stops answering is not read on every pass any more,
+// only probed with backoff until it is back. health[] is loop() only;
+// pollHealth() copies it for the web task once a second (healthMux).
+enum HealthDevice : uint8_t { DEV_SOIL, DEV_GAS, DEV_DHT, DEV_MPU, DEV_COUNT };
+#define SOIL_MIN_RAW 10    // lower: input floating (not wired)
+#define GAS_MIN_RAW 100
+SensorHealth health[DEV_COUNT];
+char healthJson[DEV_COUNT * 192] = "[]";
+HealthState healthShown[DEV_COUNT] = {};
+portMUX_TYPE healthMux = portMUX_INITIALIZER_UNLOCKED;
+
+// --- WebSocket (/ws) ---
+TaskHandle_t loopTask = NULL;      // woken early when a button is pressed
+volatile uint32_t uiInputUs = 0;   // micros() of a press not yet on the OLED (0 = none)
+volatile bool wsFullSync = false;  // new client: next push sends every field
+uint32_t wsStateSig = 0;           // loop(): last state it asked to push
+
+// --- Sensor History (10 min @ 1s, 24 h @ 1min, 30 days @ 1h) ---
+// Channels: 0 = soil raw, 1 = gas raw, 2 = temp x10, 3 = humidity x10
+#define HIST_CHANNELS 4
+SensorHistory<HIST_CHANNELS> history;
+unsigned long lastHistoryMs = 0;
+
+// --- Black box (src/blackbox.h): samples around every alert ---
+// fast = MPU6050 x/y/z in mg (FIFO, 100 Hz), slow = the history sample
+// (1 s). Recorder is loop() only; a frozen event is copied to bbFile
+// for the web task (bbMux) and the recorder released right away.
+#define BB_PRE_MS 6000
+#define BB_POST_MS 3000
+typedef Blackbox<3, 640, 960, HIST_CHANNELS, 16> BlackboxRec;
+BlackboxRec blackbox;
+uint8_t bbFile[BlackboxRec::MAX_BYTES];
+size_t bbFileLen = 0;    // 0 = no event (yet, or being copied)
+uint32_t bbFileId = 0;
+char bbJson[192] = "{}";
+portMUX_TYPE bbMux = portMUX_INITIALIZER_UNLOCKED;
 
 // ==============================================================
 //                 BUZZER FUNCTION (MANUAL TONE)
@@ -119,444 +204,316 @@ void playTone() {
 }
 
 // ==============================================================
-//             SAFETY CHECK LOGIC (PRIORITY 1)
+//            QUAKE CLASSIFIER (MPU6050 FIFO + FFT)
 // ==============================================================
-bool checkSafetyPriority() {
-  currentAlert = ""; // Reset alert string
-  
-  // ---------------- CHECK 1: FLOOD ----------------
-  int soil = analogRead(SOIL_PIN);
-  if (soil < FLOOD_LIMIT && soil > 10) { 
-    currentAlert = "FLOOD DETECTED!"; 
-    
-    // OLED Alert
-    display.clearDisplay(); 
-    display.setTextColor(WHITE);
-    display.setTextSize(3); 
-    display.setCursor(10, 10); 
-    display.println("FLOOD!");
-    display.display();
-    
-    // Siren Logic
-    for(int k=0; k<5; k++) { 
-      playTone(); 
-      delay(50); 
-    }
-    return true; // Khatra hai!
-  }
+// The MPU6050 samples itself at 100 Hz into its 1 KB FIFO (accel
+// only, 6 bytes each = 170 samples = 1.7 s) and loop() empties it on
+// every pass, so no sample is lost to a slow screen or web request.
+// Every 1.28 s the last 2.56 s go through src/quake_fft.h, which
+// tells ground motion from footsteps, slams and machines.
+#define MPU_ADDR 0x68
+#define MPU_REG_SMPLRT_DIV 0x19
+#define MPU_REG_FIFO_EN 0x23
+#define MPU_REG_INT_STATUS 0x3A
+#define MPU_REG_USER_CTRL 0x6A
+#define MPU_REG_FIFO_COUNT 0x72
+#define MPU_REG_FIFO_RW 0x74
+#define MPU_LSB_PER_G 8192      // MPU6050_RANGE_4_G
+#define QUAKE_BUDGET_US 2000    // analysis allowed per window (loop() waits that long)
 
-  // ---------------- CHECK 2: FIRE ----------------
-  int gas = analogRead(MQ2_PIN);
-  if (gas > GAS_LIMIT) { 
-    currentAlert = "FIRE ALERT!"; 
-    
-    // OLED Alert
-    display.clearDisplay(); 
-    display.setTextColor(WHITE);
-    display.setTextSize(3); 
-    display.setCursor(10, 10); 
-    display.println("FIRE!");
-    display.display();
-    
-    // Siren Logic
-    for(int k=0; k<5; k++) { 
-      playTone(); 
-      delay(50); 
-    }
-    return true; // Khatra hai!
-  }
+QuakeDetector quake;
+QuakeFeatures quakeLast = {};   // last window (written by loop())
+unsigned long quakeLastMs = 0;
 
-  // ---------------- CHECK 3: EARTHQUAKE ----------------
-  sensors_event_t a, g, t;
-  mpu.getEvent(&a, &g, &t);
-  
-  float dx = abs(a.acceleration.x - lastX);
-  float dy = abs(a.acceleration.y - lastY);
-  lastX = a.acceleration.x; 
-  lastY = a.acceleration.y;
+// For /api/quake: guarded by quakeMux
+struct QuakeStats {
+  QuakeFeatures last;
+  uint32_t windows, usLast, usMax, overBudget, overflows;
+};
+QuakeStats quakeStats = {};
+portMUX_TYPE quakeMux = portMUX_INITIALIZER_UNLOCKED;
 
-  if (dx > QUAKE_LIMIT || dy > QUAKE_LIMIT) { 
-    currentAlert = "EARTHQUAKE!"; 
-    
-    // OLED Alert with WARNING SIGN
-    display.clearDisplay(); 
-    display.setTextColor(WHITE);
-    
-    // Draw Exclamation Mark (Alert Sign)
-    display.setTextSize(4);
-    display.setCursor(55, 0);
-    display.println("!"); 
-    
-    display.setTextSize(2); 
-    display.setCursor(5, 40); 
-    display.println("EARTHQUAKE");
-    display.display();
-    
-    // Siren Logic
-    for(int k=0; k<5; k++) { 
-      playTone(); 
-      delay(50); 
-    }
-    return true; // Khatra hai!
-  }
+void mpuWrite(uint8_t reg, uint8_t value) {
+  Wire.beginTransmission(MPU_ADDR);
+  Wire.write(reg);
+  Wire.write(value);
+  Wire.endTransmission();
+}
 
-  return false; // Sab Safe hai
+uint8_t mpuRead(uint8_t reg, uint8_t* buf, uint8_t len) {
+  Wire.beginTransmission(MPU_ADDR);
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0) return 0;
+  uint8_t n = Wire.requestFrom((uint8_t)MPU_ADDR, len);
+  for (uint8_t i = 0; i < n; i++) buf[i] = Wire.read();
+  return n;
 }
 
-// ==============================================================
-//                    WEB SERVER HANDLER
-// ==============================================================
-void handleRoot() {
-  String html = "<html><head><meta name='viewport' content='width=device-width, initial-scale=1'>";
-  
-  // Auto Refresh for Realtime Alerts
-  // HTML refresh se page reload hoga taaki alert dikhe
-  html += "<meta http-equiv='refresh' content='2'>"; 
-  
-  // --- JAVASCRIPT FOR NOTIFICATIONS & VIBRATION ---
-  html += "<script>";
-  html += "function reqPerm() { Notification.requestPermission(); }";
-  
-  if (currentAlert != "") {
-     // Browser Notification
-     html += "if(Notification.permission === 'granted') {";
-     html += "  new Notification('HIMBUDDY DANGER!', { body: '" + currentAlert + "' });";
-     html += "}";
-     // Phone Vibration (200ms vibrate, 100ms stop, 200ms vibrate)
-     html += "if (navigator.vibrate) { navigator.vibrate([500, 200, 500]); }";
-  }
-  html += "</script>";
+// After mpu.begin() + settings (DLPF on -> 1 kHz internal rate)
+void quakeBegin() {
+  quake.begin();
+  mpuWrite(MPU_REG_SMPLRT_DIV, 1000 / QUAKE_FS - 1);
+  mpuWrite(MPU_REG_USER_CTRL, 0x04);  // FIFO reset
+  mpuWrite(MPU_REG_FIFO_EN, 0x08);    // accel X/Y/Z only
+  mpuWrite(MPU_REG_USER_CTRL, 0x40);  // FIFO on
+}
 
-  // --- CSS STYLING ---
-  html += "<style>";
-  html += "body { font-family: sans-serif; text-align: center; background: #222; color: white; margin: 0; padding: 10px; }";
-  
-  // --- DANGER BLINKING LOGIC ---
-  if (currentAlert != "") {
-    // Agar Alert hai to RED BLINK karega
-    html += "body { animation: blinkRed 0.5s infinite; }";
-    html += "@keyframes blinkRed { 0% {background-color: red;} 50% {background-color: black;} 100% {background-color: red;} }";
-    html += ".alert-box { border: 5px solid yellow; background: darkred; padding: 20px; border-radius: 10px; }";
-    html += "h1 { font-size: 40px; }";
-  }
-
-  html += "button { width: 90%; padding: 15px; margin: 8px; font-size: 18px; border-radius: 10px; border: none; cursor: pointer; }";
-  html += ".nav { background: #007bff; color: white; }"; 
-  html += ".act { background: #28a745; color: white; }"; 
-  html += ".ext { background: #dc3545; color: white; }"; 
-  html += ".info { background: #ffc107; color: black; }";
-  html += ".purple { background: #8e44ad; color: white; }"; 
-  html += ".orange { background: #e67e22; color: white; }"; 
-  
-  // Input Box Styling
-  html += "input[type=text] { width: 65%; padding: 12px; border-radius: 5px; border: none; margin-bottom: 10px; }";
-  html += "input[type=submit] { width: 25%; padding: 12px; background: #27ae60; color: white; border: none; border-radius: 5px; font-weight: bold; }";
-  
-  html += "</style></head><body>";
+// mpu.begin() + settings + FIFO: at boot, and when a probe finds the
+// MPU6050 again (it lost its settings with the plug)
+bool mpuBegin() {
+  if (!mpu.begin()) return false;
+  mpu.setAccelerometerRange(MPU6050_RANGE_4_G);
+  mpu.setGyroRange(MPU6050_RANGE_500_DEG);
+  mpu.setFilterBandwidth(MPU6050_BAND_21_HZ); // also the anti-alias filter for 100 Hz
+  quakeBegin();
+  return true;
+}
 
-  // --- HTML BODY ---
-  if (currentAlert != "") {
-    // DANGER MODE
-    html += "<div class='alert-box'>";
-    html += "<h1>⚠️ DANGER ⚠️</h1>";
-    html += "<h2>" + currentAlert + "</h2>";
-    html += "<h3>GET TO SAFETY!</h3>";
-    html += "</div><br>";
-  }
+void quakeWindowDone(uint32_t us) {
+  quakeLast = quake.last();
+  quakeLastMs = millis();
+  portENTER_CRITICAL(&quakeMux);
+  quakeStats.last = quakeLast;
+  quakeStats.windows++;
+  quakeStats.usLast = us;
+  if (us > quakeStats.usMax) quakeStats.usMax = us;
+  if (us > QUAKE_BUDGET_US) quakeStats.overBudget++;
+  portEXIT_CRITICAL(&quakeMux);
+}
 
-  html += "<h1>HIMBUDDY CONTROL</h1>";
-  html += "<h3>Mode: " + (inMenu ? "MENU" : menuItems[menuIndex]) + "</h3>";
-  
-  // --- TEXT BOX FEATURE ---
-  html += "<div style='background:#333; padding:15px; border-radius:10px;'>";
-  html += "<form action='/msg' method='GET'>";
-  html += "<label><b>SEND TO OLED:</b></label><br>";
-  html += "<input type='text' name='t' placeholder='Type Msg (or alert)'> ";
-  html += "<input type='submit' value='SEND'>";
-  html += "</form></div>";
+int16_t mpuToMg(const uint8_t* p) {
+  return (int16_t)((int32_t)(int16_t)(p[0] << 8 | p[1]) * 1000 / MPU_LSB_PER_G);
+}
 
-  // Notification Button
-  html += "<br><button onclick='reqPerm()' style='background:#6610f2;color:white;'>🔔 ALLOW ALERTS</button>";
-  
-  html += "<hr>";
-  
-  // Control Buttons
-  html += "<a href='/up'><button class='nav'>UP</button></a>";
-  html += "<a href='/down'><button class='nav'>DOWN</button></a>";
-  html += "<a href='/select'><button class='act'>SELECT</button></a>";
-  html += "<a href='/exit'><button class='ext'>EXIT</button></a>";
-  
-  html += "<hr>";
-  
-  // --- MAPS & BUZZER ---
-  
-  // Logic to create Google Maps Link
-  String mapLink = "https://www.google.com/maps/search/?api=1&query=";
-  if (gps.location.isValid()) {
-     // Real Location Link
-     mapLink += String(gps.location.lat(), 6) + "," + String(gps.location.lng(), 6);
-  } else {
-     // Default Jeori Location Link
-     mapLink += "31.4982,77.8054";
+// Empties the FIFO into the detector (loop(), every pass). Without an
+// MPU6050 only a probe now and then (sensor health)
+void pollQuake() {
+  uint32_t now = millis();
+  if (!health[DEV_MPU].due(now)) return;
+  uint8_t buf[120]; // 20 samples per I2C read (Wire buffer is 128)
+  bool answered = mpuRead(MPU_REG_INT_STATUS, buf, 1) == 1;
+  if (health[DEV_MPU].report(answered ? READ_OK : READ_MISSING, now)) {
+    mpuBegin(); // plugged back in
+    return;
   }
-  
-  html += "<a href='" + mapLink + "' target='_blank'><button class='purple'>📍 OPEN MAPS (GPS)</button></a>";
-  html += "<a href='/test_buzz'><button class='orange'>🔊 TEST ALARM</button></a>";
+  if (!answered) return;
+  if (buf[0] & 0x10) {
+    // FIFO overflowed (loop() stuck > 1.7 s): gap in the data, start clean
+    mpuWrite(MPU_REG_USER_CTRL, 0x44);
+    quake.reset();
+    portENTER_CRITICAL(&quakeMux);
+    quakeStats.overflows++;
+    portEXIT_CRITICAL(&quakeMux);
+    return;
+  }
+  if (mpuRead(MPU_REG_FIFO_COUNT, buf, 2) != 2) return;
+  uint16_t count = (uint16_t)(buf[0] << 8 | buf[1]) / 6 * 6;
+  uint16_t left = count / 6; // samples still in the FIFO: the newest is 'now'
+  while (count) {
+    uint8_t len = count > sizeof(buf) ? sizeof(buf) : count;
+    if (mpuRead(MPU_REG_FIFO_RW, buf, len) != len) return;
+    count -= len;
+    for (uint8_t i = 0; i < len; i += 6) {
+      int16_t mg[3] = { mpuToMg(buf + i), mpuToMg(buf + i + 2), mpuToMg(buf + i + 4) };
+      blackbox.pushFast(now - --left * (1000 / QUAKE_FS), mg);
+      uint32_t t0 = micros();
+      if (quake.push(mg[0], mg[1], mg[2])) {
+        quakeWindowDone(micros() - t0);
+      }
+    }
+  }
+}
 
-  html += "<hr>";
-  
-  // Extra Features
-  html += "<a href='/dev'><button class='info'>SHOW DEV INFO</button></a>";
-  html += "<a href='/view_temp'><button class='info'>CHECK TEMP</button></a>";
-  
-  html += "</body></html>";
-  server.send(200, "text/html", html);
+// Last window is still fresh (two hops)
+bool quakeFresh() {
+  return millis() - quakeLastMs < 2000UL * QUAKE_HOP / QUAKE_FS;
+}
+
+// Last window was ground motion, strong enough, and is still fresh
+bool quakeAlarm() {
+  return quakeFresh() && quakeLast.cls == QUAKE_SEISMIC && quakeLast.pgaMg >= QUAKE_PGA_MG;
 }
 
 // ==============================================================
-//           NEW ROUTE HANDLERS (MESSAGE & TEST)
+//                    SENSOR HEALTH
 // ==============================================================
+// Every read of soil, MQ-2 and DHT goes through these (screens, rules,
+// history), the MPU6050 through pollQuake(). An ABSENT sensor reads as
+// "not connected" (0 / NAN) without touching the pin or the bus.
 
-// Handler for Text Message from Website
-void handleMessage() {
-  if (server.hasArg("t")) {
-    String msg = server.arg("t");
-    
-    // Check for Magic Word "alert"
-    if (msg.equalsIgnoreCase("alert")) {
-       // Trigger Alarm Logic
-       display.clearDisplay();
-       display.setTextSize(3); 
-       display.setTextColor(WHITE);
-       display.setCursor(10,20); 
-       display.println("ALERT!");
-       display.display();
-       
-       // Beep for 3 seconds approx
-       for(int k=0; k<30; k++) { 
-         playTone(); 
-         delay(50);
-       }
-       lastWebMessage = "USER SENT ALERT!";
-    } else {
-       // Normal Message
-       lastWebMessage = msg;
-    }
-    
-    // Switch Mode to show message
-    showMessageMode = true;
-    messageTimer = millis();
-    inMenu = false; 
-  }
-  server.sendHeader("Location", "/"); 
-  server.send(303);
+// Soil / MQ-2 raw value; 0 while the input is ABSENT
+int readAnalog(HealthDevice dev, int pin, int minRaw) {
+  uint32_t now = millis();
+  if (!health[dev].due(now)) return 0;
+  int v = analogRead(pin);
+  health[dev].report(v >= minRaw ? READ_OK : READ_MISSING, now);
+  return v;
 }
 
-// Handler for Buzzer Test
-void handleBuzzerTest() {
-  // Beep 3 times (Total ~3 seconds)
-  for(int i=0; i<3; i++) {
-    digitalWrite(BUZZER_PIN, HIGH); 
-    delay(500);
-    digitalWrite(BUZZER_PIN, LOW); 
-    delay(500);
+int readSoil() { return readAnalog(DEV_SOIL, SOIL_PIN, SOIL_MIN_RAW); }
+int readGas() { return readAnalog(DEV_GAS, MQ2_PIN, GAS_MIN_RAW); }
+
+// DHT22 into lastTemp / lastHum (NAN while ABSENT or failing)
+void readDHT(uint32_t now) {
+  float t = NAN, h = NAN;
+  if (health[DEV_DHT].due(now)) {
+    t = dht.readTemperature(); // DHT library caches for 2s
+    h = dht.readHumidity();
+    health[DEV_DHT].report(isnan(t) || isnan(h) ? READ_MISSING : READ_OK, now);
   }
-  server.sendHeader("Location", "/"); 
-  server.send(303);
+  lastTemp = t;
+  lastHum = h;
 }
 
-// Function for Temperature Page
-void handleWebTemp() {
-  float h = dht.readHumidity();
-  float t = dht.readTemperature();
-  String html = "<html><head><meta name='viewport' content='width=device-width, initial-scale=1'><meta http-equiv='refresh' content='5'>";
-  html += "<style>body{font-family:sans-serif;text-align:center;background:#eee;padding:20px;}.box{background:white;padding:20px;border-radius:10px;}</style></head><body>";
-  html += "<div class='box'><h1>LIVE WEATHER</h1>";
-  if (isnan(h)) html += "<h2>Sensor Error!</h2>";
-  else { html += "<h2>Temp: " + String(t, 1) + " C</h2><h2>Hum: " + String(h, 0) + " %</h2>"; }
-  html += "<br><a href='/'><button style='padding:10px;background:#333;color:white;'>BACK</button></a></div></body></html>";
-  server.send(200, "text/html", html);
+// Copy for the web task (/api/health, home page), once a second
+void pollHealth(uint32_t now) {
+  static uint32_t last = 0;
+  if (now - last < 1000) return;
+  last = now;
+  char json[sizeof(healthJson)];
+  healthListJson(health, DEV_COUNT, now, json, sizeof(json));
+  portENTER_CRITICAL(&healthMux);
+  memcpy(healthJson, json, sizeof(healthJson));
+  for (uint8_t i = 0; i < DEV_COUNT; i++) healthShown[i] = health[i].state();
+  portEXIT_CRITICAL(&healthMux);
 }
 
-// ==============================================================
-//                    SETUP WIFI & ROUTES
-// ==============================================================
-void setupWifi() {
-  WiFi.softAP(ssid, pass);
-  
-  server.on("/", handleRoot);
-  
-  // Register New Pages
-  server.on("/msg", handleMessage);        
-  server.on("/test_buzz", handleBuzzerTest); 
-  
-  server.on("/up", [](){ 
-    if(inMenu) { menuIndex--; if(menuIndex < 0) menuIndex = 5; } 
-    server.sendHeader("Location", "/"); server.send(303); 
-  });
-  
-  server.on("/down", [](){ 
-    if(inMenu) { menuIndex++; if(menuIndex > 5) menuIndex = 0; } 
-    server.sendHeader("Location", "/"); server.send(303); 
-  });
-  
-  server.on("/select", [](){ 
-    inMenu = false; 
-    server.sendHeader("Location", "/"); server.send(303); 
-  });
-  
-  server.on("/exit", [](){ 
-    inMenu = true; 
-    showMessageMode = false; // Turn off message mode
-    server.sendHeader("Location", "/"); server.send(303); 
-  });
-  
-  server.on("/dev", [](){ 
-    menuIndex = 5; inMenu = false; 
-    server.sendHeader("Location", "/"); server.send(303); 
-  });
-  
-  server.on("/view_temp", handleWebTemp);
-  
-  server.begin();
+// healthShown[], 2 bits per device (web state / signature)
+static_assert(DEV_COUNT <= 4, "health bits are one byte");
+uint8_t healthBits() {
+  uint8_t bits = 0;
+  portENTER_CRITICAL(&healthMux);
+  for (uint8_t i = 0; i < DEV_COUNT; i++) bits |= healthShown[i] << (2 * i);
+  portEXIT_CRITICAL(&healthMux);
+  return bits;
 }
 
-// ==============================================================
-//                    DEV INFO DISPLAY
-// ==============================================================
-void runDevInfo() {
-  display.clearDisplay(); 
-  display.setTextColor(SSD1306_WHITE);
-  display.setTextSize(1); 
-  display.setCursor(0, 0); 
-  display.println(F(">> DEVELOPER INFO <<"));
-  display.drawLine(0, 10, 128, 10, WHITE);
-  
-  display.setCursor(0, 15); display.println(F("Dev: Akshit Negi"));
-  display.setCursor(0, 27); display.println(F("Class: 10th"));
-  display.setCursor(0, 39); display.println(F("Roll No: 06"));
-  display.setCursor(0, 51); display.println(F("ID: akshitvip"));
-  
-  display.display(); 
-  delay(1000); 
+// "soil ok, gas absent, .." for the home page
+void healthLine(uint8_t bits, char* out, size_t len) {
+  size_t n = 0;
+  out[0] = 0;
+  for (uint8_t i = 0; i < DEV_COUNT && n < len; i++) {
+    n += snprintf(out + n, len - n, "%s%s %s", i ? ", " : "", health[i].deviceName(),
+                  healthStateName((bits >> (2 * i)) & 3));
+  }
 }
 
 // ==============================================================
-//               NEW FUNCTION: SHOW WEB MESSAGE
+//                    SENSOR REGISTRY
 // ==============================================================
-void runWebMessage() {
-  display.clearDisplay();
-  display.setTextColor(SSD1306_WHITE);
-  display.setTextSize(1); 
-  display.setCursor(0,0); 
-  display.println("MESSAGE FROM WEB:");
-  display.drawLine(0, 10, 128, 10, WHITE);
-  
-  display.setTextSize(2); 
-  display.setCursor(0, 25);
-  display.println(lastWebMessage);
-  
-  display.display();
-  delay(100);
-}
+// One entry per menu screen. The menu, its wrap-around, the web /
+// ws mode label and the screen dispatch are all made from SENSORS[]:
+// a new sensor is its functions + one table line (+ RULE_SIGNALS[]
+// if alert rules should see it).
+//
+// sample() reads what the screen shows (and does its buzzer work) and
+// returns a signature of it; draw() paints the last sample. The UI
+// redraws only when the signature changes (no I2C transfer otherwise).
+struct UiViewDef {
+  uint16_t refreshMs;   // re-sample this often (0 = every tick, values are just variables)
+  uint32_t (*sample)();
+  void (*draw)();
+};
 
-// ==============================================================
-//                    SENSOR LOGIC FUNCTIONS
-// ==============================================================
+// Alert texts (fixed, so the web task can compare / read them)
+const char ALERT_FLOOD[] = "FLOOD DETECTED!";
+const char ALERT_FIRE[]  = "FIRE ALERT!";
+const char ALERT_QUAKE[] = "EARTHQUAKE!";
+
+// Values read by the last sample() (loop() only)
+int viewSoil = 0;
+int viewGas = 0;
+float viewTemp = NAN, viewHum = NAN;
+float viewX = 0, viewY = 0;
+QuakeFeatures viewQuake = {};
+bool viewEarthquake = false;
+bool viewMpuOk = false;
+bool viewGpsValid = false;
+double viewLat = 0, viewLng = 0;
+
+// Short tone used by the sensor views while a limit is crossed
+void viewBeep() {
+  for(int i=0; i<50; i++) { 
+    digitalWrite(BUZZER_PIN, HIGH); 
+    delayMicroseconds(200); 
+    digitalWrite(BUZZER_PIN, LOW); 
+    delayMicroseconds(200); 
+  }
+}
 
 // --- SOIL SENSOR ---
-void runSoil() {
-  int soil = analogRead(SOIL_PIN); 
-  Serial.print("RAW VALUE: "); Serial.println(soil);
-  
+uint32_t sampleSoil() {
+  viewSoil = readSoil(); 
+  Serial.print("RAW VALUE: "); Serial.println(viewSoil);
+  if (viewSoil >= SOIL_MIN_RAW && viewSoil < FLOOD_LIMIT) viewBeep();
+  else digitalWrite(BUZZER_PIN, LOW);
+  return (uint32_t)viewSoil;
+}
+
+void drawSoil() {
   display.clearDisplay(); 
   display.setTextColor(SSD1306_WHITE);
   display.setTextSize(1); 
   display.setCursor(80, 0); 
   display.print("V:"); 
-  display.print(soil); 
+  display.print(viewSoil); 
 
-  if (soil < 10) { 
+  if (viewSoil < SOIL_MIN_RAW) { 
     display.setTextSize(2); 
     display.setCursor(0, 20); 
     display.println("CHECK"); 
     display.println("WIRING");
-    digitalWrite(BUZZER_PIN, LOW);
   } else {
-    if (soil < FLOOD_LIMIT) {  
-      display.setTextSize(2); 
-      display.setCursor(0, 0); 
-      display.println("CONNECTED");
-      display.setCursor(0, 30); 
-      display.println("WET - FLOOD");
-      
-      // Tone Loop
-      for(int i=0; i<50; i++) { 
-        digitalWrite(BUZZER_PIN, HIGH); 
-        delayMicroseconds(200); 
-        digitalWrite(BUZZER_PIN, LOW); 
-        delayMicroseconds(200); 
-      }
-    } else {
-      display.setTextSize(2); 
-      display.setCursor(0, 0); 
-      display.println("CONNECTED");
-      display.setCursor(0, 30); 
-      display.println("DRY - SAFE");
-      digitalWrite(BUZZER_PIN, LOW); 
-    }
+    display.setTextSize(2); 
+    display.setCursor(0, 0); 
+    display.println("CONNECTED");
+    display.setCursor(0, 30); 
+    if (viewSoil < FLOOD_LIMIT) display.println("WET - FLOOD");
+    else display.println("DRY - SAFE");
   }
-  display.display(); 
-  delay(100);
 }
 
 // --- GAS SENSOR ---
-void runMQ2() {
-  int mq = analogRead(MQ2_PIN);
-  
+uint32_t sampleGas() {
+  viewGas = readGas();
+  if (viewGas >= GAS_MIN_RAW && viewGas > GAS_LIMIT) viewBeep();
+  else digitalWrite(BUZZER_PIN, LOW);
+  // screen only shows the state, not the number
+  return viewGas < GAS_MIN_RAW ? 0 : (viewGas > GAS_LIMIT ? 2 : 1);
+}
+
+void drawGas() {
   display.clearDisplay(); 
   display.setTextColor(SSD1306_WHITE);
   
-  if (mq < 100) { 
+  if (viewGas < GAS_MIN_RAW) { 
     display.setTextSize(2); 
     display.setCursor(0, 20); 
     display.println("NOT"); 
     display.println("CONNECTED");
-    digitalWrite(BUZZER_PIN, LOW);
   } else {
     display.setTextSize(2); 
     display.setCursor(0, 0); 
     display.println("CONNECTED");
-    if (mq > GAS_LIMIT) { 
-      display.setCursor(0, 30); 
-      display.println("GAS !");
-      
-      // Tone Loop
-      for(int i=0; i<50; i++) { 
-        digitalWrite(BUZZER_PIN, HIGH); 
-        delayMicroseconds(200); 
-        digitalWrite(BUZZER_PIN, LOW); 
-        delayMicroseconds(200); 
-      }
-    } else {
-      display.setCursor(0, 30); 
-      display.println("SAFE");
-      digitalWrite(BUZZER_PIN, LOW);
-    }
+    display.setCursor(0, 30); 
+    if (viewGas > GAS_LIMIT) display.println("GAS !");
+    else display.println("SAFE");
   }
-  display.display(); 
-  delay(100);
 }
 
-// --- DHT SENSOR ---
-void runDHT() {
-  float h = dht.readHumidity();
-  float t = dht.readTemperature();
-  
+// --- DHT SENSOR --- (cached by recordHistory, never waits for the sensor)
+uint32_t sampleDHT() {
+  viewTemp = lastTemp;
+  viewHum = lastHum;
+  if (isnan(viewTemp) || isnan(viewHum)) return 0xFFFFFFFF;
+  return ((uint32_t)lroundf(viewTemp * 10) << 16) ^ (uint32_t)lroundf(viewHum);
+}
+
+void drawDHT() {
   display.clearDisplay(); 
   display.setTextColor(SSD1306_WHITE);
   
-  if (isnan(h) || isnan(t)) {
+  if (isnan(viewHum) || isnan(viewTemp)) {
     display.setTextSize(2); 
     display.setCursor(0, 20); 
     display.println("NOT"); 
@@ -568,84 +525,79 @@ void runDHT() {
     
     display.setTextSize(2); 
     display.setCursor(0, 20);
-    display.print(t, 1); 
+    display.print(viewTemp, 1); 
     display.println(" C");
     
     display.setCursor(0, 45);
-    display.print(h, 0); 
+    display.print(viewHum, 0); 
     display.println(" %");
   }
-  display.display(); 
-  delay(2000);
 }
 
-// --- EARTHQUAKE SENSOR ---
-void runMPU() {
-  sensors_event_t a, g, temp;
-  mpu.getEvent(&a, &g, &temp);
-  
-  float x = a.acceleration.x; 
-  float y = a.acceleration.y;
-  float dx = abs(x - lastX); 
-  float dy = abs(y - lastY);
-  
-  // CHANGE 1: Sensitivity 1.5 se badha kar 2.5 kar di.
-  // Ab chote-mote touch se trigger nahi hoga, zor se hilane par hi "moving" mana jayega.
-  bool moving = (dx > 2.5 || dy > 2.5); 
-  
-  unsigned long now = millis();
-
-  if (moving) { 
-    if (moveStartTime == 0) moveStartTime = now; 
-    
-    // CHANGE 2: Time 2000 (2 sec) se kam karke 1200 (1.2 sec) kar diya
-    if ((now - moveStartTime) >= 1200) earthquake = true; 
-  } else { 
-    moveStartTime = 0; 
-    earthquake = false; 
-  }
-  lastX = x; 
-  lastY = y; 
-
-  if (earthquake) { 
-    for(int i=0; i<50; i++) { 
-      digitalWrite(BUZZER_PIN, HIGH); 
-      delayMicroseconds(200); 
-      digitalWrite(BUZZER_PIN, LOW); 
-      delayMicroseconds(200); 
-    } 
-  } else { 
-    digitalWrite(BUZZER_PIN, LOW); 
+// --- EARTHQUAKE SENSOR --- (the FIFO is read by pollQuake())
+uint32_t sampleMPU() {
+  viewMpuOk = !health[DEV_MPU].absent(); // probing is pollQuake()'s job
+  viewX = viewY = 0;
+  if (viewMpuOk) {
+    sensors_event_t a, g, temp;
+    mpu.getEvent(&a, &g, &temp);
+    viewX = a.acceleration.x;
+    viewY = a.acceleration.y;
   }
+  viewQuake = quakeLast;
+  viewEarthquake = quakeAlarm();
+
+  if (viewEarthquake) viewBeep();
+  else digitalWrite(BUZZER_PIN, LOW); 
 
+  // screen shows 2 decimals, class, Hz and PGA
+  return ((uint32_t)lroundf(viewX * 100) << 16) ^ (uint32_t)(lroundf(viewY * 100) & 0xFFFF) ^
+         ((uint32_t)viewEarthquake << 31) ^ ((uint32_t)viewQuake.cls << 28) ^
+         ((uint32_t)viewQuake.domHzX10 << 12) ^ viewQuake.pgaMg ^ ((uint32_t)viewMpuOk << 27);
+}
+
+void drawMPU() {
   display.clearDisplay(); 
   display.setTextColor(SSD1306_WHITE);
+  if (!viewMpuOk) {
+    display.setTextSize(2); 
+    display.setCursor(0, 20); 
+    display.println("NOT"); 
+    display.println("CONNECTED");
+    return;
+  }
   display.setTextSize(1); 
   display.setCursor(0, 0); 
   display.print("X: "); 
-  display.println(x, 2);
+  display.println(viewX, 2);
   display.setCursor(0, 10); 
   display.print("Y: "); 
-  display.println(y, 2);
+  display.println(viewY, 2);
+  display.setCursor(0, 20);
+  display.printf("%s %u.%uHz %umg", quakeClassName(viewQuake.cls), viewQuake.domHzX10 / 10,
+                 viewQuake.domHzX10 % 10, viewQuake.pgaMg);
   
   display.setTextSize(2); 
   display.setCursor(0, 40);
-  if (earthquake) display.println("EARTHQUAKE");
+  if (viewEarthquake) display.println("EARTHQUAKE");
   else display.println("STABLE");
-  
-  display.display(); 
-  delay(200);
 }
-// --- GPS SENSOR ---
-void runGPS() {
-  // GPS data background mein read karta rahega
-  while (gpsSerial.available()) gps.encode(gpsSerial.read());
-  
+
+// --- GPS SENSOR --- (gps.encode runs every loop pass)
+uint32_t sampleGPS() {
+  viewGpsValid = gps.location.isValid();
+  if (!viewGpsValid) return 0;
+  viewLat = gps.location.lat();
+  viewLng = gps.location.lng();
+  return (uint32_t)llround(viewLat * 1e6) ^ ((uint32_t)llround(viewLng * 1e6) << 1) ^ 1u;
+}
+
+void drawGPS() {
   display.clearDisplay(); 
   display.setTextColor(SSD1306_WHITE);
   
   // Agar GPS signal VALID nahi hai (abhi search kar raha hai)
-  if (!gps.location.isValid()) {
+  if (!viewGpsValid) {
     // Yahan hum "WAIT" ki jagah Default Location dikhayenge
     display.setTextSize(1); 
     display.setCursor(0, 0); 
@@ -670,99 +622,1644 @@ void runGPS() {
     
     display.setCursor(0, 20); 
     display.print("LAT: "); 
-    display.println(gps.location.lat(), 6); // Real Latitude
+    display.println(viewLat, 6); // Real Latitude
     
     display.setCursor(0, 35); 
     display.print("LON: "); 
-    display.println(gps.location.lng(), 6); // Real Longitude
+    display.println(viewLng, 6); // Real Longitude
   }
-  
-  display.display(); 
-  delay(800);
 }
-// ==============================================================
-//                    MAIN SETUP FUNCTION
-// ==============================================================
-void setup() {
-  Serial.begin(115200);
-  Wire.begin(21, 22);
-  if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) { for(;;); }
-  
-  setupWifi();
-  pinMode(BUZZER_PIN, OUTPUT);
-  
-  dht.begin();
-  mpu.begin();
-  
-  // MPU6050 Sensitivity Settings
-  mpu.setAccelerometerRange(MPU6050_RANGE_4_G);
-  mpu.setGyroRange(MPU6050_RANGE_500_DEG);
-  mpu.setFilterBandwidth(MPU6050_BAND_21_HZ);
-  
-  gpsSerial.begin(9600, SERIAL_8N1, GPS_RX, GPS_TX);
 
-  // Intro Screen
+// --- DEV INFO ---
+uint32_t sampleDev() { return 0; }
+
+void drawDev() {
   display.clearDisplay(); 
-  display.setTextSize(2); 
   display.setTextColor(SSD1306_WHITE);
-  display.setCursor(10, 20); 
-  display.println("SYSTEM OK");
-  display.display(); 
-  delay(1000);
+  display.setTextSize(1); 
+  display.setCursor(0, 0); 
+  display.println(F(">> DEVELOPER INFO <<"));
+  display.drawLine(0, 10, 128, 10, WHITE);
+  
+  display.setCursor(0, 15); display.println(F("Dev: Akshit Negi"));
+  display.setCursor(0, 27); display.println(F("Class: 10th"));
+  display.setCursor(0, 39); display.println(F("Roll No: 06"));
+  display.setCursor(0, 51); display.println(F("ID: akshitvip"));
+}
+
+struct SensorDef {
+  const char* name;       // menu + web label
+  int8_t pin;             // data pin (-1 = on the I2C bus)
+  UiViewDef view;         // screen: refresh, sample, draw
+};
+
+constexpr SensorDef SENSORS[] = {
+  { "SOIL SENSOR", SOIL_PIN, { 100,  sampleSoil, drawSoil } },
+  { "MQ2 GAS",     MQ2_PIN,  { 100,  sampleGas,  drawGas } },
+  { "DHT TEMP",    DHTPIN,   { 1000, sampleDHT,  drawDHT } },
+  { "MPU QUAKE",   -1,       { 200,  sampleMPU,  drawMPU } },
+  { "GPS LOC",     GPS_RX,   { 800,  sampleGPS,  drawGPS } },
+  { "DEV INFO",    -1,       { 0,    sampleDev,  drawDev } },
+};
+constexpr uint8_t SENSOR_COUNT = sizeof(SENSORS) / sizeof(SENSORS[0]);
+
+constexpr bool sameText(const char* a, const char* b) {
+  while (*a && *a == *b) { a++; b++; }
+  return *a == *b;
+}
+
+constexpr uint8_t sensorIndex(const char* name) {
+  for (uint8_t i = 0; i < SENSOR_COUNT; i++) if (sameText(SENSORS[i].name, name)) return i;
+  return SENSOR_COUNT;
 }
 
+// "DEV INFO" button on the website
+constexpr uint8_t SENSOR_DEV_INFO = sensorIndex("DEV INFO");
+static_assert(SENSOR_DEV_INFO < SENSOR_COUNT, "DEV INFO missing from SENSORS");
+
 // ==============================================================
-//                    MAIN LOOP FUNCTION
+//             ALERT RULES (PRIORITY 1, /api/rules)
 // ==============================================================
-void loop() {
-  server.handleClient(); 
+// The safety checks are text rules (syntax: src/rules.h), kept in
+// flash (NVS) and compiled to bytecode, so a new limit or a new alert
+// needs no reflash. Every SAFETY_PERIOD_MS loop() reads the signals
+// below and evaluates all rules at once.
+//   GET  /api/rules          -> the rules text
+//   GET  /api/rules?fmt=json -> per-rule state + evaluation time
+//   POST /api/rules (text)   -> compile, and if it compiles save + use it
+// A rule named FLOOD / FIRE / EARTHQUAKE shows the usual alert
+// screen; any other name is shown as it is.
+#define RULES_TEXT_MAX 2048
 
-  // --- SAFETY CHECK (Must run first for notifications) ---
-  if (checkSafetyPriority()) {
-    return; // Stop here if Alert
-  }
-  
-  // --- NEW: CHECK WEB MESSAGE ---
-  // Agar web se message aaya hai, to yahan se show karega
-  if (showMessageMode) {
-    runWebMessage();
-    
-    // 5 second baad wapis main menu
-    if (millis() - messageTimer > 5000) {
-      showMessageMode = false;
-      inMenu = true;
+#define RULE_NUM_(x) #x
+#define RULE_NUM(x) RULE_NUM_(x)
+const char DEFAULT_RULES[] =
+  "soil < " RULE_NUM(FLOOD_LIMIT) " and soil > 10 -> FLOOD priority 1\n"
+  "gas > " RULE_NUM(GAS_LIMIT) " -> FIRE priority 2\n"
+  "# footsteps, slams, pumps do not count\n"
+  "seismic == 1 and pga >= " RULE_NUM(QUAKE_PGA_MG) " -> EARTHQUAKE priority 3\n";
+
+// Signals the rules can use (values[] order = this order)
+struct RuleSignal {
+  const char* name;
+  float (*read)();
+};
+
+const RuleSignal RULE_SIGNALS[] = {
+  { "soil",    []() -> float { return readSoil(); } },             // raw, low = wet (0 = not connected)
+  { "gas",     []() -> float { return readGas(); } },              // raw MQ2
+  { "temp",    []() -> float { return lastTemp; } },               // C (NAN = no data)
+  { "hum",     []() -> float { return lastHum; } },                // %
+  { "seismic", []() -> float { return quakeFresh() && quakeLast.cls == QUAKE_SEISMIC; } },
+  { "pga",     []() -> float { return quakeFresh() ? quakeLast.pgaMg : 0; } },  // mg
+};
+constexpr uint8_t RULE_SIGNAL_COUNT = sizeof(RULE_SIGNALS) / sizeof(RULE_SIGNALS[0]);
+const char* ruleSignalNames[RULE_SIGNAL_COUNT];
+
+RuleEngine rules;             // loop() changes it under rulesLock
+Preferences rulesPrefs;
+// Held by loop() while it compiles / evaluates, and by /api/rules while
+// it reads a rule (a mutex: rule JSON is formatted with it held)
+SemaphoreHandle_t rulesLock;
+uint32_t rulesGen = 0;        // +1 per swap, under rulesLock
+
+// Source of the running rules + last result, read by the web task:
+// guarded by rulesMux
+char rulesText[RULES_TEXT_MAX] = "";
+char rulesError[64] = "";
+uint32_t rulesEvalUs = 0, rulesEvalUsMax = 0;
+portMUX_TYPE rulesMux = portMUX_INITIALIZER_UNLOCKED;
+
+// POSTed text waiting for loop() to compile it
+enum RulesJob : uint8_t { RULES_IDLE, RULES_RECEIVING, RULES_PENDING, RULES_COMPILING, RULES_DONE };
+char rulesNew[RULES_TEXT_MAX];
+volatile RulesJob rulesJob = RULES_IDLE;
+volatile bool rulesJobOk = false;
+
+// Compiles text, and if it compiles makes it the running rules
+bool loadRules(const char* text, bool save) {
+  char err[sizeof(rulesError)];
+  xSemaphoreTake(rulesLock, portMAX_DELAY);
+  bool ok = rules.compile(text, ruleSignalNames, RULE_SIGNAL_COUNT, err, sizeof(err));
+  if (ok) rulesGen++;
+  xSemaphoreGive(rulesLock);
+  if (ok && save) {
+    rulesPrefs.putString("rules", text);
+  }
+  portENTER_CRITICAL(&rulesMux);
+  if (ok) {
+    strncpy(rulesText, text, sizeof(rulesText) - 1);
+    rulesText[sizeof(rulesText) - 1] = 0;
+    rulesEvalUsMax = 0;
+  }
+  memcpy(rulesError, err, sizeof(rulesError));
+  portEXIT_CRITICAL(&rulesMux);
+  if (!ok) Serial.printf("rules: %s\n", err);
+  return ok;
+}
+
+// setup(): saved rules, or the factory ones if there are none / they
+// do not compile any more (e.g. a signal was renamed)
+void rulesBegin() {
+  for (uint8_t i = 0; i < RULE_SIGNAL_COUNT; i++) ruleSignalNames[i] = RULE_SIGNALS[i].name;
+  rulesPrefs.begin("himbuddy", false);
+  static char saved[RULES_TEXT_MAX];
+  size_t n = rulesPrefs.getString("rules", saved, sizeof(saved));
+  if (n == 0 || !loadRules(saved, false)) loadRules(DEFAULT_RULES, false);
+  Serial.printf("rules: %u loaded, %u bytes of bytecode\n", rules.count(), rules.codeBytes());
+}
+
+// loop(): compiles what /api/rules POSTed
+void pollRules() {
+  if (rulesJob != RULES_PENDING) return;
+  // claimed under rulesMux: a POST that timed out may withdraw it
+  portENTER_CRITICAL(&rulesMux);
+  bool claimed = rulesJob == RULES_PENDING;
+  if (claimed) rulesJob = RULES_COMPILING;
+  portEXIT_CRITICAL(&rulesMux);
+  if (!claimed) return;
+  rulesJobOk = loadRules(rulesNew, true);
+  rulesJob = RULES_DONE;
+}
+
+// Rule names that became alerts. The engine rewrites its own names on
+// the next compile, while currentAlert / viewAlert (held ALERT_HOLD_MS,
+// read by the web task) may still point at one: so they point here,
+// where a name is added once and never changed (loop() only).
+#define ALERT_NAMES 32
+char alertNames[ALERT_NAMES][RULES_NAME_MAX];
+uint8_t alertNameCount = 0;
+const char ALERT_RULE[] = "RULE ALERT";  // the table is full
+
+// Rule name -> alert text (the fixed ones keep their screens)
+const char* ruleAlert(uint8_t i) {
+  const char* name = rules.name(i);
+  if (strcmp(name, "FLOOD") == 0) return ALERT_FLOOD;
+  if (strcmp(name, "FIRE") == 0) return ALERT_FIRE;
+  if (strcmp(name, "EARTHQUAKE") == 0) return ALERT_QUAKE;
+  for (uint8_t k = 0; k < alertNameCount; k++) {
+    if (strcmp(alertNames[k], name) == 0) return alertNames[k];
+  }
+  if (alertNameCount == ALERT_NAMES) return ALERT_RULE;
+  char* slot = alertNames[alertNameCount];
+  strncpy(slot, name, RULES_NAME_MAX - 1);
+  alertNameCount++;
+  return slot;
+}
+
+// Evaluates every rule and sets currentAlert to the most urgent one
+// that holds ("" = safe). The alert screen and siren are done by the UI.
+bool checkSafetyPriority() {
+  float values[RULE_SIGNAL_COUNT];
+  for (uint8_t i = 0; i < RULE_SIGNAL_COUNT; i++) values[i] = RULE_SIGNALS[i].read();
+
+  uint32_t now = millis();
+  uint32_t t0 = micros();
+  uint8_t fired[8];
+  xSemaphoreTake(rulesLock, portMAX_DELAY);
+  uint8_t n = rules.evaluate(now, values, fired, sizeof(fired));
+  int16_t top = rules.topHeld();
+  xSemaphoreGive(rulesLock);
+  uint32_t us = micros() - t0;
+  portENTER_CRITICAL(&rulesMux);
+  rulesEvalUs = us;
+  if (us > rulesEvalUsMax) rulesEvalUsMax = us;
+  portEXIT_CRITICAL(&rulesMux);
+
+  for (uint8_t i = 0; i < n; i++) Serial.printf("rule fired: %s (line %u)\n", rules.name(fired[i]), rules.rule(fired[i]).line);
+  if (n) blackbox.trigger(now, ruleAlert(fired[0])); // later ones join the open event
+  if (top >= 0) {
+    currentAlert = ruleAlert(top);
+    return true; // Khatra hai!
+  }
+  currentAlert = "";
+  return false; // Sab Safe hai
+}
+
+// ==============================================================
+//                    WEB SERVER HANDLER
+// ==============================================================
+// Small output buffer, so big replies go out in chunks (no heap)
+// (req NULL = count the bytes only, for the on-boot benchmark)
+struct ChunkOut {
+  httpd_req_t* req;
+  char buf[512];
+  size_t len = 0;
+  size_t sent = 0;
+
+  explicit ChunkOut(httpd_req_t* r) : req(r) {}
+
+  void put(const char* s, size_t n) {
+    while (n > 0) {
+      size_t room = sizeof(buf) - len;
+      size_t k = (n < room) ? n : room;
+      memcpy(buf + len, s, k);
+      len += k; s += k; n -= k;
+      if (len == sizeof(buf)) flush();
+    }
+  }
+  void put(const char* s) { put(s, strlen(s)); }
+  void putf(const char* fmt, ...) {
+    char tmp[96];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    if (n > 0) put(tmp, (size_t)n < sizeof(tmp) ? (size_t)n : sizeof(tmp) - 1);
+  }
+  void flush() {
+    if (len > 0 && req) httpd_resp_send_chunk(req, buf, len);
+    sent += len;
+    len = 0;
+  }
+};
+
+// Main page HTML
+void renderRoot(ChunkOut& out) {
+  const char* alert = currentAlert; // one snapshot for the whole page
+  out.put("<html><head><meta name='viewport' content='width=device-width, initial-scale=1'>");
+  
+  // Auto Refresh for Realtime Alerts
+  // HTML refresh se page reload hoga taaki alert dikhe
+  // (with WebSocket open the page only reloads when the alert changes)
+  out.put("<noscript><meta http-equiv='refresh' content='2'></noscript>"); 
+  
+  // --- JAVASCRIPT FOR NOTIFICATIONS & VIBRATION ---
+  out.put("<script>");
+  out.put("function reqPerm() { Notification.requestPermission(); }");
+  
+  // --- WEBSOCKET CONTROL (falls back to normal links if not open) ---
+  out.putf("var ws=null, alertNow='%s';", alert);
+  out.put("var rt=setTimeout(function(){location.reload();},2000);");
+  out.put("function cmd(c){ if(ws&&ws.readyState==1){ws.send(c);return false;} return true; }");
+  out.put("function sendMsg(f){ if(cmd('M'+f.t.value)) return true; f.t.value=''; return false; }");
+  out.put("try{ ws=new WebSocket('ws://'+location.host+'/ws');");
+  out.put(" ws.onopen=function(){clearTimeout(rt);};");
+  out.put(" ws.onmessage=function(e){var s=JSON.parse(e.data);");
+  out.put("  if(s.mode!==undefined) document.getElementById('mode').innerText='Mode: '+s.mode;");
+  out.put("  if(s.health!==undefined) document.getElementById('health').innerText='Sensors: '+s.health;");
+  out.put("  if(s.alert!==undefined && s.alert!==alertNow) location.reload(); };");
+  out.put(" ws.onclose=function(){ clearTimeout(rt); rt=setTimeout(function(){location.reload();},2000); };");
+  out.put("}catch(e){}");
+  
+  if (alert[0]) {
+     // Browser Notification
+     out.put("if(Notification.permission === 'granted') {");
+     out.putf("  new Notification('HIMBUDDY DANGER!', { body: '%s' });", alert);
+     out.put("}");
+     // Phone Vibration (200ms vibrate, 100ms stop, 200ms vibrate)
+     out.put("if (navigator.vibrate) { navigator.vibrate([500, 200, 500]); }");
+  }
+  out.put("</script>");
+
+  // --- CSS STYLING ---
+  out.put("<style>");
+  out.put("body { font-family: sans-serif; text-align: center; background: #222; color: white; margin: 0; padding: 10px; }");
+  
+  // --- DANGER BLINKING LOGIC ---
+  if (alert[0]) {
+    // Agar Alert hai to RED BLINK karega
+    out.put("body { animation: blinkRed 0.5s infinite; }");
+    out.put("@keyframes blinkRed { 0% {background-color: red;} 50% {background-color: black;} 100% {background-color: red;} }");
+    out.put(".alert-box { border: 5px solid yellow; background: darkred; padding: 20px; border-radius: 10px; }");
+    out.put("h1 { font-size: 40px; }");
+  }
+
+  out.put("button { width: 90%; padding: 15px; margin: 8px; font-size: 18px; border-radius: 10px; border: none; cursor: pointer; }");
+  out.put(".nav { background: #007bff; color: white; }"); 
+  out.put(".act { background: #28a745; color: white; }"); 
+  out.put(".ext { background: #dc3545; color: white; }"); 
+  out.put(".info { background: #ffc107; color: black; }");
+  out.put(".purple { background: #8e44ad; color: white; }"); 
+  out.put(".orange { background: #e67e22; color: white; }"); 
+  
+  // Input Box Styling
+  out.put("input[type=text] { width: 65%; padding: 12px; border-radius: 5px; border: none; margin-bottom: 10px; }");
+  out.put("input[type=submit] { width: 25%; padding: 12px; background: #27ae60; color: white; border: none; border-radius: 5px; font-weight: bold; }");
+  
+  out.put("</style></head><body>");
+
+  // --- HTML BODY ---
+  if (alert[0]) {
+    // DANGER MODE
+    out.put("<div class='alert-box'>");
+    out.put("<h1>⚠️ DANGER ⚠️</h1>");
+    out.putf("<h2>%s</h2>", alert);
+    out.put("<h3>GET TO SAFETY!</h3>");
+    out.put("</div><br>");
+  }
+
+  out.put("<h1>HIMBUDDY CONTROL</h1>");
+  out.putf("<h3 id='mode'>Mode: %s</h3>", inMenu ? "MENU" : SENSORS[menuIndex].name);
+  char sensors[64];
+  healthLine(healthBits(), sensors, sizeof(sensors));
+  out.putf("<p id='health'>Sensors: %s</p>", sensors);
+  
+  // --- TEXT BOX FEATURE ---
+  out.put("<div style='background:#333; padding:15px; border-radius:10px;'>");
+  out.put("<form action='/msg' method='GET' onsubmit='return sendMsg(this)'>");
+  out.put("<label><b>SEND TO OLED:</b></label><br>");
+  out.put("<input type='text' name='t' placeholder='Type Msg (or alert)'> ");
+  out.put("<input type='submit' value='SEND'>");
+  out.put("</form></div>");
+
+  // Notification Button
+  out.put("<br><button onclick='reqPerm()' style='background:#6610f2;color:white;'>🔔 ALLOW ALERTS</button>");
+  
+  out.put("<hr>");
+  
+  // Control Buttons
+  out.put("<a href='/up' onclick='return cmd(\"U\")'><button class='nav'>UP</button></a>");
+  out.put("<a href='/down' onclick='return cmd(\"D\")'><button class='nav'>DOWN</button></a>");
+  out.put("<a href='/select' onclick='return cmd(\"S\")'><button class='act'>SELECT</button></a>");
+  out.put("<a href='/exit' onclick='return cmd(\"X\")'><button class='ext'>EXIT</button></a>");
+  
+  out.put("<hr>");
+  
+  // --- MAPS & BUZZER ---
+  
+  // Logic to create Google Maps Link
+  out.put("<a href='https://www.google.com/maps/search/?api=1&query=");
+  if (gps.location.isValid()) {
+     // Real Location Link
+     char ll[2 * FIELDS_NUM_LEN];
+     FieldWriter w(ll, sizeof(ll));
+     w.putFixed(gps.location.lat(), 6);
+     w.put(',');
+     w.putFixed(gps.location.lng(), 6);
+     w.finish();
+     out.put(ll);
+  } else {
+     // Default Jeori Location Link
+     out.put("31.4982,77.8054");
+  }
+  out.put("' target='_blank'><button class='purple'>📍 OPEN MAPS (GPS)</button></a>");
+  out.put("<a href='/test_buzz' onclick='return cmd(\"B\")'><button class='orange'>🔊 TEST ALARM</button></a>");
+
+  out.put("<hr>");
+  
+  // Extra Features
+  out.put("<a href='/dev' onclick='return cmd(\"V\")'><button class='info'>SHOW DEV INFO</button></a>");
+  out.put("<a href='/view_temp'><button class='info'>CHECK TEMP</button></a>");
+  out.put("<a href='/trend'><button class='info'>SHOW TRENDS</button></a>");
+  
+  out.put("</body></html>");
+  out.flush();
+}
+
+esp_err_t handleRoot(httpd_req_t* req) {
+  ChunkOut out(req);
+  httpd_resp_set_type(req, "text/html");
+  renderRoot(out);
+  return httpd_resp_send_chunk(req, NULL, 0); // end of chunked reply
+}
+
+// ==============================================================
+//           NEW ROUTE HANDLERS (MESSAGE & TEST)
+// ==============================================================
+
+// Every control route answers with "303 -> /" (same as before)
+esp_err_t redirectHome(httpd_req_t* req) {
+  httpd_resp_set_status(req, "303 See Other");
+  httpd_resp_set_hdr(req, "Location", "/");
+  return httpd_resp_send(req, NULL, 0);
+}
+
+// Form values arrive URL-encoded ("hello+world%21")
+void urlDecode(const char* in, char* out, size_t len) {
+  size_t o = 0;
+  while (*in && o + 1 < len) {
+    if (*in == '+') { out[o++] = ' '; in++; }
+    else if (*in == '%' && isxdigit((unsigned char)in[1]) && isxdigit((unsigned char)in[2])) {
+      char hex[3] = { in[1], in[2], 0 };
+      out[o++] = (char)strtol(hex, NULL, 16);
+      in += 3;
+    }
+    else out[o++] = *in++;
+  }
+  out[o] = 0;
+}
+
+// Reads one query argument (decoded). Returns false if it is missing.
+bool getArg(httpd_req_t* req, const char* key, char* out, size_t len) {
+  char query[256];
+  char raw[192];
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK) return false;
+  if (httpd_query_key_value(query, key, raw, sizeof(raw)) != ESP_OK) return false;
+  urlDecode(raw, out, len);
+  return true;
+}
+
+// false: the queue is full of more important messages
+bool queueWebMessage(const char* msg, uint8_t priority, uint32_t ttlMs) {
+  uint32_t now = millis();
+  portENTER_CRITICAL(&webMux);
+  bool ok = webMessages.push(msg, priority, now, ttlMs);
+  portEXIT_CRITICAL(&webMux);
+  return ok;
+}
+
+// Wakes loop() so the OLED shows a button press right away
+void uiWake() {
+  if (uiInputUs == 0) uiInputUs = micros() | 1; // for the input latency figure
+  if (loopTask) xTaskNotifyGive(loopTask);
+}
+
+// loop() waits here instead of delay(), a button press ends the wait
+void uiWait(uint32_t ms) {
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms));
+}
+
+// --- Control actions (shared by the GET routes and /ws) ---
+void navUp() {
+  if(inMenu) { int i = menuIndex - 1; if(i < 0) i = SENSOR_COUNT - 1; menuIndex = i; }
+  uiWake();
+}
+
+void navDown() {
+  if(inMenu) { int i = menuIndex + 1; if(i >= SENSOR_COUNT) i = 0; menuIndex = i; }
+  uiWake();
+}
+
+void navSelect() {
+  inMenu = false;
+  uiWake();
+}
+
+void navExit() {
+  inMenu = true; 
+  showMessageMode = false; // Turn off message mode
+  portENTER_CRITICAL(&webMux);
+  webMessages.clear();     // and drop the ones still waiting
+  portEXIT_CRITICAL(&webMux);
+  uiWake();
+}
+
+void navDev() {
+  menuIndex = SENSOR_DEV_INFO; inMenu = false;
+  uiWake();
+}
+
+void postWebMessage(const char* msg, uint8_t priority = 0, uint32_t ttlMs = WEB_MESSAGE_TTL_MS) {
+  bool queued;
+  // Check for Magic Word "alert"
+  if (strcasecmp(msg, "alert") == 0) {
+     // Alarm (OLED + 3 sec beep) is done by loop(), web task must not block
+     webAlarmPending = true;
+     queued = queueWebMessage("USER SENT ALERT!", WEB_MESSAGE_PRIO_ALARM, ttlMs);
+  } else {
+     // Normal Message
+     queued = queueWebMessage(msg, priority, ttlMs);
+  }
+  if (!queued) return;
+  
+  // Switch Mode to show message (loop() shows the queue in order)
+  showMessageMode = true;
+  inMenu = false; 
+  uiWake();
+}
+
+void testBuzzer() {
+  buzzTestPending = true; // beeping is done by loop()
+  uiWake();
+}
+
+// Handler for Text Message from Website
+// /msg?t=text[&p=0..8 priority][&ttl=seconds it may wait]
+esp_err_t handleMessage(httpd_req_t* req) {
+  char msg[sizeof(lastWebMessage)];
+  char arg[8];
+  uint8_t priority = 0;
+  uint32_t ttlMs = WEB_MESSAGE_TTL_MS;
+  if (getArg(req, "p", arg, sizeof(arg))) priority = (uint8_t)constrain(atol(arg), 0L, WEB_MESSAGE_PRIO_ALARM - 1L);
+  if (getArg(req, "ttl", arg, sizeof(arg))) ttlMs = (uint32_t)constrain(atol(arg), 1L, 3600L) * 1000;
+  if (getArg(req, "t", msg, sizeof(msg))) postWebMessage(msg, priority, ttlMs);
+  return redirectHome(req);
+}
+
+// Handler for Buzzer Test
+esp_err_t handleBuzzerTest(httpd_req_t* req) {
+  testBuzzer();
+  return redirectHome(req);
+}
+
+// Function for Temperature Page
+esp_err_t handleWebTemp(httpd_req_t* req) {
+  float h = lastHum;
+  float t = lastTemp;
+  char reading[64];
+  if (isnan(h)) strcpy(reading, "<h2>Sensor Error!</h2>");
+  else {
+    FieldWriter w(reading, sizeof(reading));
+    w.put("<h2>Temp: ");
+    w.putFixed(t, 1);
+    w.put(" C</h2><h2>Hum: ");
+    w.putFixed(h, 0);
+    w.put(" %</h2>");
+    w.finish();
+  }
+  char html[640];
+  int n = snprintf(html, sizeof(html),
+    "<html><head><meta name='viewport' content='width=device-width, initial-scale=1'><meta http-equiv='refresh' content='5'>"
+    "<style>body{font-family:sans-serif;text-align:center;background:#eee;padding:20px;}.box{background:white;padding:20px;border-radius:10px;}</style></head><body>"
+    "<div class='box'><h1>LIVE WEATHER</h1>%s"
+    "<br><a href='/'><button style='padding:10px;background:#333;color:white;'>BACK</button></a></div></body></html>",
+    reading);
+  httpd_resp_set_type(req, "text/html");
+  return httpd_resp_send(req, html, n);
+}
+
+// ==============================================================
+//             SENSOR HISTORY (RECORD + /api/history)
+// ==============================================================
+
+// Uptime seconds for the history (millis() / 1000 wraps after 49.7 days)
+uint32_t uptimeSec() {
+  return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+// Called every loop pass, takes one sample per second
+void recordHistory() {
+  unsigned long now = millis();
+  if (now - lastHistoryMs < 1000) return;
+  lastHistoryMs = now;
+
+  HistoryPoint<HIST_CHANNELS> p;
+  p.v[0] = readSoil();
+  p.v[1] = readGas();
+  if (health[DEV_SOIL].absent()) p.v[0] = HISTORY_NO_DATA;
+  if (health[DEV_GAS].absent()) p.v[1] = HISTORY_NO_DATA;
+  readDHT(now);
+  float t = lastTemp;
+  float h = lastHum;
+  p.v[2] = isnan(t) ? HISTORY_NO_DATA : (int16_t)lroundf(t * 10);
+  p.v[3] = isnan(h) ? HISTORY_NO_DATA : (int16_t)lroundf(h * 10);
+
+  history.record(uptimeSec(), p);
+  blackbox.pushSlow(now, p.v);
+}
+
+// Sends the newest 'want' points of one ring.
+// JSON: {"res":"m","step":60,"now":..,"last":..,"per":3,"ch":[..],"scale":[..],"data":[[..],..]}
+//   per = values per channel (1 = plain value, 3 = lo[],hi[],avg[])
+//   last = uptime second where the newest point ends, null = no data
+// BIN : "HBH1", res, channels, per, 0, u32 step, u32 now, u32 last, u16 count,
+//       then count * channels * per int16 (little endian, same order as JSON)
+// (Rings are read while loop() keeps adding; worst case one point is torn.)
+template <typename Ring>
+esp_err_t sendHistory(httpd_req_t* req, const Ring& ring, char res, uint32_t step, uint8_t per, uint32_t last,
+                 uint16_t want, bool bin) {
+  uint16_t count = ring.size();
+  if (want < count) count = want;
+  uint16_t first = ring.size() - count;
+  uint32_t now = uptimeSec();
+  const uint8_t values = HIST_CHANNELS * per;
+
+  httpd_resp_set_type(req, bin ? "application/octet-stream" : "application/json");
+  ChunkOut out(req);
+
+  if (bin) {
+    uint8_t head[20] = { 'H', 'B', 'H', '1', (uint8_t)res, HIST_CHANNELS, per, 0 };
+    memcpy(head + 8, &step, 4);
+    memcpy(head + 12, &now, 4);
+    memcpy(head + 16, &last, 4);
+    out.put((const char*)head, sizeof(head));
+    out.put((const char*)&count, 2);
+    for (uint16_t i = 0; i < count; i++) {
+      out.put((const char*)&ring.at(first + i), values * sizeof(int16_t));
+    }
+  } else {
+    char num[16];
+    snprintf(num, sizeof(num), "%c", res);
+    out.put("{\"res\":\""); out.put(num);
+    snprintf(num, sizeof(num), "%lu", (unsigned long)step);
+    out.put("\",\"step\":"); out.put(num);
+    snprintf(num, sizeof(num), "%lu", (unsigned long)now);
+    out.put(",\"now\":"); out.put(num);
+    snprintf(num, sizeof(num), "%lu", (unsigned long)last);
+    out.put(",\"last\":"); out.put(num);
+    snprintf(num, sizeof(num), "%u", per);
+    out.put(",\"per\":"); out.put(num);
+    out.put(",\"ch\":[\"soil\",\"gas\",\"temp\",\"hum\"],\"scale\":[1,1,10,10],\"data\":[");
+    for (uint16_t i = 0; i < count; i++) {
+      const int16_t* v = (const int16_t*)&ring.at(first + i);
+      out.put(i ? ",[" : "[");
+      for (uint8_t k = 0; k < values; k++) {
+        if (v[k] == HISTORY_NO_DATA) snprintf(num, sizeof(num), "%snull", k ? "," : "");
+        else snprintf(num, sizeof(num), "%s%d", k ? "," : "", v[k]);
+        out.put(num);
+      }
+      out.put("]");
+    }
+    out.put("]}");
+  }
+  out.flush();
+  return httpd_resp_send_chunk(req, NULL, 0); // end of chunked reply
+}
+
+// /api/history?res=s|m|h&n=<points>&fmt=json|bin
+esp_err_t handleHistory(httpd_req_t* req) {
+  char arg[16];
+  char res = getArg(req, "res", arg, sizeof(arg)) ? arg[0] : 'm';
+  bool bin = getArg(req, "fmt", arg, sizeof(arg)) && strcmp(arg, "bin") == 0;
+  uint16_t want = 0xFFFF;
+  if (getArg(req, "n", arg, sizeof(arg))) want = (uint16_t)constrain(atol(arg), 0L, 0xFFFFL);
+
+  uint32_t sec = history.lastSecond() + 1; // end of the newest 1 s sample
+  if (res == 's') {
+    return sendHistory(req, history.seconds, 's', 1, 1, sec, want, bin);
+  } else if (res == 'h') {
+    return sendHistory(req, history.hours, 'h', 3600, 3, sec - history.openHourSecs(), want, bin);
+  }
+  return sendHistory(req, history.minutes, 'm', 60, 3, sec - history.openMinuteSecs(), want, bin);
+}
+
+// Trend page: draws /api/history on a canvas (min/max band + mean)
+const char TREND_PAGE[] PROGMEM = R"rawliteral(<html><head><meta name='viewport' content='width=device-width, initial-scale=1'>
+<style>body{font-family:sans-serif;text-align:center;background:#222;color:white;margin:0;padding:10px;}
+button{padding:10px;margin:4px;border-radius:8px;border:none;background:#007bff;color:white;}
+canvas{background:#111;width:100%;height:220px;border-radius:10px;}</style></head><body>
+<h2>HIMBUDDY TRENDS</h2>
+<div><button onclick="r='s';load()">10 MIN</button><button onclick="r='m';load()">24 HRS</button><button onclick="r='h';load()">30 DAYS</button></div>
+<div><button onclick="c=0;load()">SOIL</button><button onclick="c=1;load()">GAS</button><button onclick="c=2;load()">TEMP</button><button onclick="c=3;load()">HUM</button></div>
+<h3 id='t'>Loading...</h3><canvas id='g' width='600' height='220'></canvas>
+<br><a href='/'><button style='background:#333;'>BACK</button></a>
+<script>
+var r='m',c=2,names=['SOIL','GAS','TEMP C','HUM %'];
+function load(){fetch('/api/history?res='+r).then(x=>x.json()).then(draw);}
+function draw(j){
+ var g=document.getElementById('g').getContext('2d'),W=600,H=220,d=j.data,n=d.length,N=j.ch.length;
+ var lo=[],hi=[],av=[];
+ for(var i=0;i<n;i++){ if(j.per==1){lo[i]=hi[i]=av[i]=d[i][c];} else {lo[i]=d[i][c];hi[i]=d[i][N+c];av[i]=d[i][2*N+c];} }
+ var v=lo.concat(hi).filter(x=>x!==null);
+ g.clearRect(0,0,W,H);
+ if(!v.length){document.getElementById('t').innerText=names[c]+': NO DATA';return;}
+ var mn=Math.min.apply(null,v),mx=Math.max.apply(null,v); if(mx==mn)mx=mn+1;
+ function y(x){return H-5-(x-mn)/(mx-mn)*(H-10);}
+ function line(a,col){g.strokeStyle=col;g.beginPath();var s=0;for(var i=0;i<n;i++){if(a[i]===null){s=0;continue;}var x=i*W/Math.max(n-1,1);if(s)g.lineTo(x,y(a[i]));else g.moveTo(x,y(a[i]));s=1;}g.stroke();}
+ line(hi,'#dc3545');line(lo,'#007bff');line(av,'#28a745');
+ document.getElementById('t').innerText=names[c]+'  MIN '+(mn/j.scale[c])+'  MAX '+(mx/j.scale[c]);
+}
+load();setInterval(load,10000);
+</script></body></html>)rawliteral";
+
+esp_err_t handleTrend(httpd_req_t* req) {
+  httpd_resp_set_type(req, "text/html");
+  return httpd_resp_send(req, TREND_PAGE, HTTPD_RESP_USE_STRLEN);
+}
+
+// ==============================================================
+//             BLACK BOX (EVENT CAPTURE + /api/blackbox)
+// ==============================================================
+// No SD card on this unit: the last event stays in RAM (bbFile) until
+// the next one, for the phone to download and
+// tools/blackbox_decode.cpp to turn into CSV.
+
+// Every loop pass: freezes the open event after BB_POST_MS and copies
+// it out. bbFileLen is 0 while the copy runs, so a download that is
+// going on stops instead of mixing two events.
+void pollBlackbox(uint32_t now) {
+  static uint32_t lastJson = 0;
+  bool frozen = blackbox.poll(now);
+  if (frozen) {
+    portENTER_CRITICAL(&bbMux);
+    bbFileLen = 0;
+    portEXIT_CRITICAL(&bbMux);
+    size_t len = blackbox.readEvent(0, bbFile, sizeof(bbFile));
+    portENTER_CRITICAL(&bbMux);
+    bbFileLen = len;
+    bbFileId = blackbox.header().id;
+    portEXIT_CRITICAL(&bbMux);
+    blackbox.release();
+    Serial.printf("black box: event %lu, %u bytes\n", (unsigned long)bbFileId, (unsigned)len);
+  }
+  if (!frozen && now - lastJson < 1000) return;
+  lastJson = now;
+  char json[sizeof(bbJson)];
+  blackbox.json(json, sizeof(json));
+  portENTER_CRITICAL(&bbMux);
+  memcpy(bbJson, json, sizeof(bbJson));
+  portEXIT_CRITICAL(&bbMux);
+}
+
+// /api/blackbox          -> {"state","events","merged","dropped","id","cause","bytes","fast","slow"}
+// /api/blackbox?fmt=bin  -> the last event file (format: src/blackbox.h)
+esp_err_t handleBlackbox(httpd_req_t* req) {
+  char arg[8];
+  if (!getArg(req, "fmt", arg, sizeof(arg)) || strcmp(arg, "bin") != 0) {
+    char out[sizeof(bbJson)];
+    portENTER_CRITICAL(&bbMux);
+    memcpy(out, bbJson, sizeof(out));
+    portEXIT_CRITICAL(&bbMux);
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, out, HTTPD_RESP_USE_STRLEN);
+  }
+
+  portENTER_CRITICAL(&bbMux);
+  uint32_t id = bbFileId;
+  size_t len = bbFileLen;
+  portEXIT_CRITICAL(&bbMux);
+  if (len == 0) {
+    httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "no event yet");
+    return ESP_FAIL;
+  }
+  char name[48];
+  snprintf(name, sizeof(name), "attachment; filename=\"%08lX.hbb\"", (unsigned long)id);
+  httpd_resp_set_type(req, "application/octet-stream");
+  httpd_resp_set_hdr(req, "Content-Disposition", name);
+  char chunk[512];
+  for (size_t at = 0; at < len; at += sizeof(chunk)) {
+    size_t n = len - at < sizeof(chunk) ? len - at : sizeof(chunk);
+    portENTER_CRITICAL(&bbMux);
+    bool same = bbFileId == id && bbFileLen == len;
+    if (same) memcpy(chunk, bbFile + at, n);
+    portEXIT_CRITICAL(&bbMux);
+    if (!same || httpd_resp_send_chunk(req, chunk, n) != ESP_OK) {
+      return ESP_FAIL; // a newer event came in: cut off (the decoder refuses it)
+    }
+  }
+  return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// ==============================================================
+//            WEBSOCKET CONTROL CHANNEL (/ws)
+// ==============================================================
+// Phone -> device: one text frame per action
+//   "U" up, "D" down, "S" select, "X" exit, "V" dev info,
+//   "B" test buzzer, "M<text>" message to OLED ("Malert" = alarm)
+// Device -> phone: JSON with only the fields that changed, eg.
+//   {"mode":"DHT TEMP","in":0,"i":2}   {"alert":"FIRE ALERT!"}
+// A new client gets every field once.
+
+// What the phones see (compared field by field for deltas)
+struct WebState {
+  bool in;
+  int idx;
+  bool msgOn;
+  uint32_t msgId;
+  const char* alert;
+  uint8_t health;   // healthBits()
+};
+
+WebState currentWebState() {
+  WebState st;
+  st.in = inMenu;
+  st.idx = menuIndex;
+  st.msgOn = showMessageMode;
+  st.msgId = webMessageId;
+  st.alert = currentAlert;
+  st.health = healthBits();
+  return st;
+}
+
+// Copies text into a JSON string body (quotes, backslash, control chars)
+size_t jsonEscape(char* out, size_t len, const char* in) {
+  size_t o = 0;
+  for (; *in && o + 7 < len; in++) {
+    unsigned char c = (unsigned char)*in;
+    if (c == '"' || c == '\\') { out[o++] = '\\'; out[o++] = c; }
+    else if (c < 0x20) o += snprintf(out + o, len - o, "\\u%04x", c);
+    else out[o++] = c;
+  }
+  out[o] = 0;
+  return o;
+}
+
+// Sends the state delta to every WebSocket client.
+// Only ever runs in the HTTP server task (handler or queued work).
+void wsPushState() {
+  static WebState sent;
+  static bool haveSent = false;
+  WebState st = currentWebState();
+  bool full = !haveSent || wsFullSync;
+  wsFullSync = false;
+
+  char out[264];
+  size_t n = 0;
+  out[n++] = '{';
+  if (full || st.in != sent.in || st.idx != sent.idx) {
+    n += snprintf(out + n, sizeof(out) - n, "\"mode\":\"%s\",\"in\":%d,\"i\":%d,",
+                  st.in ? "MENU" : SENSORS[st.idx].name, st.in, st.idx);
+  }
+  if (full || st.alert != sent.alert) {
+    n += snprintf(out + n, sizeof(out) - n, "\"alert\":\"%s\",", st.alert);
+  }
+  if (full || st.msgOn != sent.msgOn || st.msgId != sent.msgId) {
+    char msg[sizeof(lastWebMessage)];
+    portENTER_CRITICAL(&webMux);
+    memcpy(msg, lastWebMessage, sizeof(msg));
+    portEXIT_CRITICAL(&webMux);
+    char esc[100];
+    jsonEscape(esc, sizeof(esc), st.msgOn ? msg : "");
+    n += snprintf(out + n, sizeof(out) - n, "\"msg\":\"%s\",", esc);
+  }
+  if (full || st.health != sent.health) {
+    char line[64];
+    healthLine(st.health, line, sizeof(line));
+    n += snprintf(out + n, sizeof(out) - n, "\"health\":\"%s\",", line);
+  }
+  sent = st;
+  haveSent = true;
+  if (n == 1) return; // nothing changed
+  out[n - 1] = '}';   // replace last comma
+
+  httpd_ws_frame_t frame = {};
+  frame.type = HTTPD_WS_TYPE_TEXT;
+  frame.payload = (uint8_t*)out;
+  frame.len = n;
+
+  int fds[WEB_MAX_SOCKETS];
+  size_t count = WEB_MAX_SOCKETS;
+  if (httpd_get_client_list(server, &count, fds) != ESP_OK) return;
+  for (size_t i = 0; i < count; i++) {
+    if (httpd_ws_get_fd_info(server, fds[i]) == HTTPD_WS_CLIENT_WEBSOCKET) {
+      httpd_ws_send_frame_async(server, fds[i], &frame);
+    }
+  }
+}
+
+// Called every loop pass: if something loop() changed (alert, message
+// timeout) is not pushed yet, let the server task send the delta.
+void wsWatchState() {
+  WebState st = currentWebState();
+  uint32_t sig = (uint32_t)(uintptr_t)st.alert ^ ((uint32_t)st.idx << 2) ^ ((uint32_t)st.in << 1) ^ (uint32_t)st.msgOn ^
+                 (st.msgId << 8) ^
+                 ((uint32_t)st.health << 24);
+  if (sig == wsStateSig || server == NULL) return;
+  wsStateSig = sig;
+  httpd_queue_work(server, [](void*) { wsPushState(); }, NULL);
+}
+
+esp_err_t handleWs(httpd_req_t* req) {
+  if (req->method == HTTP_GET) {
+    // handshake done: send this client the full state
+    wsFullSync = true;
+    httpd_queue_work(server, [](void*) { wsPushState(); }, NULL);
+    return ESP_OK;
+  }
+
+  uint8_t buf[sizeof(lastWebMessage) + 8];
+  httpd_ws_frame_t frame = {};
+  if (httpd_ws_recv_frame(req, &frame, 0) != ESP_OK) return ESP_FAIL; // gets length
+  if (frame.len >= sizeof(buf)) return ESP_FAIL;                       // too big: drop client
+  frame.payload = buf;
+  if (frame.len > 0 && httpd_ws_recv_frame(req, &frame, frame.len) != ESP_OK) return ESP_FAIL;
+  if (frame.type != HTTPD_WS_TYPE_TEXT || frame.len == 0) return ESP_OK;
+  buf[frame.len] = 0;
+
+  switch (buf[0]) {
+    case 'U': navUp(); break;
+    case 'D': navDown(); break;
+    case 'S': navSelect(); break;
+    case 'X': navExit(); break;
+    case 'V': navDev(); break;
+    case 'B': testBuzzer(); break;
+    case 'M': if (buf[1]) postWebMessage((const char*)buf + 1); break;
+    default: return ESP_OK;
+  }
+  wsPushState(); // echo the new state to every phone at once
+  return ESP_OK;
+}
+
+// ==============================================================
+//                UI PERFORMANCE (/api/perf)
+// ==============================================================
+// Filled by loop(), read by the web task: guarded by perfMux.
+//   tick  = CPU time of one UI tick (sample + draw + I2C transfer)
+//   input = button press (web or /ws) until the OLED shows the result
+//   loop  = one loop() pass without the idle wait
+struct UiPerf {
+  uint32_t ticks, tickUsSum, tickUsMax;
+  uint32_t redraws;
+  uint32_t inputs, inputUsSum, inputUsMax;
+  uint32_t loops, loopUsSum, loopUsMax;
+};
+UiPerf uiPerf = {};
+portMUX_TYPE perfMux = portMUX_INITIALIZER_UNLOCKED;
+
+void uiPerfTick(uint32_t tickUs, bool redrawn, uint32_t inputUs) {
+  portENTER_CRITICAL(&perfMux);
+  uiPerf.ticks++;
+  uiPerf.tickUsSum += tickUs;
+  if (tickUs > uiPerf.tickUsMax) uiPerf.tickUsMax = tickUs;
+  if (redrawn) uiPerf.redraws++;
+  if (inputUs) {
+    uiPerf.inputs++;
+    uiPerf.inputUsSum += inputUs;
+    if (inputUs > uiPerf.inputUsMax) uiPerf.inputUsMax = inputUs;
+  }
+  portEXIT_CRITICAL(&perfMux);
+}
+
+void uiPerfLoop(uint32_t loopUs) {
+  portENTER_CRITICAL(&perfMux);
+  uiPerf.loops++;
+  uiPerf.loopUsSum += loopUs;
+  if (loopUs > uiPerf.loopUsMax) uiPerf.loopUsMax = loopUs;
+  portEXIT_CRITICAL(&perfMux);
+}
+
+// /api/perf          -> counters since boot or the last reset
+// /api/perf?reset=1  -> same, then start counting again
+esp_err_t handlePerf(httpd_req_t* req) {
+  char arg[4];
+  bool reset = getArg(req, "reset", arg, sizeof(arg)) && arg[0] == '1';
+  portENTER_CRITICAL(&perfMux);
+  UiPerf p = uiPerf;
+  if (reset) memset(&uiPerf, 0, sizeof(uiPerf));
+  portEXIT_CRITICAL(&perfMux);
+
+  char out[320];
+  int n = snprintf(out, sizeof(out),
+    "{\"ticks\":%lu,\"tickAvgUs\":%lu,\"tickMaxUs\":%lu,\"redraws\":%lu,"
+    "\"inputs\":%lu,\"inputAvgUs\":%lu,\"inputMaxUs\":%lu,\"loops\":%lu,\"loopAvgUs\":%lu,\"loopMaxUs\":%lu}",
+    (unsigned long)p.ticks, (unsigned long)(p.ticks ? p.tickUsSum / p.ticks : 0), (unsigned long)p.tickUsMax,
+    (unsigned long)p.redraws, (unsigned long)p.inputs,
+    (unsigned long)(p.inputs ? p.inputUsSum / p.inputs : 0), (unsigned long)p.inputUsMax,
+    (unsigned long)p.loops, (unsigned long)(p.loops ? p.loopUsSum / p.loops : 0), (unsigned long)p.loopUsMax);
+  httpd_resp_set_type(req, "application/json");
+  return httpd_resp_send(req, out, n);
+}
+
+// --- Heap (fragmentation) telemetry, sampled by loop() ---
+HeapWatch heapWatch;
+char heapJson[192] = "{}";   // last sample as JSON, guarded by perfMux
+
+void pollHeap() {
+  if (!heapWatch.poll(millis())) return;
+  char line[sizeof(heapJson)];
+  heapWatch.json(line, sizeof(line));
+  portENTER_CRITICAL(&perfMux);
+  memcpy(heapJson, line, sizeof(heapJson));
+  portEXIT_CRITICAL(&perfMux);
+}
+
+// /api/heap -> {"free","minFree","largest","frag","blocks","blockDelta","failed"}
+esp_err_t handleHeap(httpd_req_t* req) {
+  char out[sizeof(heapJson)];
+  portENTER_CRITICAL(&perfMux);
+  memcpy(out, heapJson, sizeof(out));
+  portEXIT_CRITICAL(&perfMux);
+  httpd_resp_set_type(req, "application/json");
+  return httpd_resp_send(req, out, HTTPD_RESP_USE_STRLEN);
+}
+
+// Board profile + boot time and memory, written once at the end of
+// setup(), guarded by perfMux
+char bootReport[224] = "{}";
+
+// /api/board -> {"profile","features","bootMs","sketchBytes","freeHeap","minFreeHeap"}
+esp_err_t handleBoard(httpd_req_t* req) {
+  char out[sizeof(bootReport)];
+  portENTER_CRITICAL(&perfMux);
+  memcpy(out, bootReport, sizeof(out));
+  portEXIT_CRITICAL(&perfMux);
+  httpd_resp_set_type(req, "application/json");
+  return httpd_resp_send(req, out, HTTPD_RESP_USE_STRLEN);
+}
+
+// /api/health -> [{"name","state","reads","errors","missing","probes","skips","changes","probeInMs"},..]
+esp_err_t handleHealth(httpd_req_t* req) {
+  char out[sizeof(healthJson)];
+  portENTER_CRITICAL(&healthMux);
+  memcpy(out, healthJson, sizeof(out));
+  portEXIT_CRITICAL(&healthMux);
+  httpd_resp_set_type(req, "application/json");
+  return httpd_resp_send(req, out, HTTPD_RESP_USE_STRLEN);
+}
+
+// /api/quake -> last window of the classifier + time per window
+esp_err_t handleQuake(httpd_req_t* req) {
+  portENTER_CRITICAL(&quakeMux);
+  QuakeStats q = quakeStats;
+  portEXIT_CRITICAL(&quakeMux);
+  const QuakeFeatures& f = q.last;
+
+  char out[384];
+  int n = snprintf(out, sizeof(out),
+    "{\"class\":\"%s\",\"pgaMg\":%u,\"rmsMg\":%u,\"domHz\":%u.%u,\"peaky\":%u.%u,\"busyBlocks\":%u,"
+    "\"tonalPct\":%u,\"lowPct\":%u,\"bands\":[%lu,%lu,%lu,%lu,%lu],\"alarm\":%s,"
+    "\"windows\":%lu,\"usLast\":%lu,\"usMax\":%lu,\"budgetUs\":%u,\"overBudget\":%lu,\"fifoOverflows\":%lu}",
+    quakeClassName(f.cls), f.pgaMg, f.rmsMg, f.domHzX10 / 10, f.domHzX10 % 10, f.peakyX10 / 10, f.peakyX10 % 10,
+    f.busyBlocks, f.tonalPct, f.lowPct, (unsigned long)f.band[0], (unsigned long)f.band[1],
+    (unsigned long)f.band[2], (unsigned long)f.band[3], (unsigned long)f.band[4],
+    currentAlert == ALERT_QUAKE ? "true" : "false",
+    (unsigned long)q.windows, (unsigned long)q.usLast, (unsigned long)q.usMax, QUAKE_BUDGET_US,
+    (unsigned long)q.overBudget, (unsigned long)q.overflows);
+  httpd_resp_set_type(req, "application/json");
+  return httpd_resp_send(req, out, n);
+}
+
+// /api/rules          -> the running rules (text/plain)
+// /api/rules?fmt=json -> {"rules":[{..},..],"codeBytes","evalUs","evalMaxUs","error"}
+// Each rule is read under rulesLock (never half evaluated); if loop()
+// swaps in new rules meanwhile the list stops and "error" says so.
+esp_err_t handleRules(httpd_req_t* req) {
+  char arg[8];
+  ChunkOut out(req);
+  if (!getArg(req, "fmt", arg, sizeof(arg)) || strcmp(arg, "json") != 0) {
+    httpd_resp_set_type(req, "text/plain");
+    char text[256];
+    for (size_t at = 0;; at += sizeof(text) - 1) {
+      portENTER_CRITICAL(&rulesMux);
+      size_t left = strlen(rulesText) > at ? strlen(rulesText) - at : 0;
+      size_t n = left < sizeof(text) - 1 ? left : sizeof(text) - 1;
+      memcpy(text, rulesText + at, n);
+      portEXIT_CRITICAL(&rulesMux);
+      if (n == 0) break;
+      out.put(text, n);
     }
-    return; // Stop here, don't show menu
+    out.flush();
+    return httpd_resp_send_chunk(req, NULL, 0);
   }
 
-  // --- MENU LOGIC ---
-  if (inMenu) {
+  httpd_resp_set_type(req, "application/json");
+  out.put("{\"rules\":[");
+  // the lock is not held while sending: a slow client never stalls loop()
+  xSemaphoreTake(rulesLock, portMAX_DELAY);
+  uint32_t gen = rulesGen;
+  uint16_t codeBytes = rules.codeBytes();
+  xSemaphoreGive(rulesLock);
+  bool swapped = false;
+  for (uint8_t i = 0;; i++) {
+    char line[192];
+    xSemaphoreTake(rulesLock, portMAX_DELAY);
+    swapped = rulesGen != gen;
+    bool more = !swapped && i < rules.count();
+    if (more) rules.json(i, line, sizeof(line));
+    xSemaphoreGive(rulesLock);
+    if (!more) break;
+    if (i) out.put(",");
+    out.put(line);
+  }
+  char err[sizeof(rulesError)];
+  portENTER_CRITICAL(&rulesMux);
+  uint32_t us = rulesEvalUs, usMax = rulesEvalUsMax;
+  memcpy(err, rulesError, sizeof(err));
+  portEXIT_CRITICAL(&rulesMux);
+  if (swapped) snprintf(err, sizeof(err), "rules changed while listing, reload");
+  out.putf("],\"codeBytes\":%u,\"evalUs\":%lu,\"evalMaxUs\":%lu,\"error\":\"", codeBytes,
+           (unsigned long)us, (unsigned long)usMax);
+  out.put(err);
+  out.put("\"}");
+  out.flush();
+  return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// POST /api/rules, body = new rules text. loop() compiles it; the
+// reply says "ok" or which line is wrong (the old rules stay then).
+esp_err_t handleRulesPost(httpd_req_t* req) {
+  if (req->content_len >= RULES_TEXT_MAX) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "rules too long");
+    return ESP_FAIL;
+  }
+  // one upload at a time (a finished or timed out one is free again)
+  portENTER_CRITICAL(&rulesMux);
+  bool busy = rulesJob == RULES_RECEIVING || rulesJob == RULES_PENDING || rulesJob == RULES_COMPILING;
+  if (!busy) rulesJob = RULES_RECEIVING;
+  portEXIT_CRITICAL(&rulesMux);
+  if (busy) {
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "busy, try again");
+    return ESP_FAIL;
+  }
+
+  size_t got = 0;
+  while (got < req->content_len) {
+    int r = httpd_req_recv(req, rulesNew + got, req->content_len - got);
+    if (r == HTTPD_SOCK_ERR_TIMEOUT) continue;
+    if (r <= 0) { rulesJob = RULES_IDLE; return ESP_FAIL; }
+    got += r;
+  }
+  rulesNew[got] = 0;
+  rulesJob = RULES_PENDING;
+  if (loopTask) xTaskNotifyGive(loopTask);
+
+  for (int i = 0; i < 100 && rulesJob == RULES_PENDING; i++) vTaskDelay(pdMS_TO_TICKS(10));
+  // loop() did not take it within 1 s: withdraw it, so "timeout" means
+  // the old rules stay; one already compiling is short, wait for it
+  portENTER_CRITICAL(&rulesMux);
+  bool cancelled = rulesJob == RULES_PENDING;
+  if (cancelled) rulesJob = RULES_IDLE;
+  portEXIT_CRITICAL(&rulesMux);
+  while (!cancelled && rulesJob != RULES_DONE) vTaskDelay(pdMS_TO_TICKS(10));
+  char reply[sizeof(rulesError) + 32];
+  if (cancelled) snprintf(reply, sizeof(reply), "{\"ok\":false,\"error\":\"timeout\"}");
+  else {
+    portENTER_CRITICAL(&rulesMux);
+    snprintf(reply, sizeof(reply), "{\"ok\":%s,\"error\":\"%s\"}", rulesJobOk ? "true" : "false", rulesError);
+    portEXIT_CRITICAL(&rulesMux);
+    rulesJob = RULES_IDLE;
+  }
+  httpd_resp_set_type(req, "application/json");
+  return httpd_resp_send(req, reply, HTTPD_RESP_USE_STRLEN);
+}
+
+// ==============================================================
+//                    SETUP WIFI & ROUTES
+// ==============================================================
+void addRoute(const char* uri, esp_err_t (*handler)(httpd_req_t*), httpd_method_t method = HTTP_GET) {
+  httpd_uri_t route = {};
+  route.uri = uri;
+  route.method = method;
+  route.handler = handler;
+  httpd_register_uri_handler(server, &route);
+}
+
+void setupWifi() {
+  WiFi.softAP(ssid, pass, 1, 0, WIFI_MAX_STATIONS);
+
+  // alert datagrams to every phone on the hotspot (192.168.4.255)
+  if (beaconSocket.open(WiFi.softAPBroadcastIP().toString().c_str())) {
+    beacon.begin(beaconSocket, (uint32_t)ESP.getEfuseMac(), esp_random());
+  } else {
+    Serial.println("Alert beacon socket failed");
+  }
+  
+  // esp_http_server: own task on core 0 (loop() is on core 1),
+  // HTTP/1.1 keep-alive, fixed number of sockets
+  httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+  config.max_open_sockets = WEB_MAX_SOCKETS;
+  config.lru_purge_enable = true;
+  config.max_uri_handlers = 24;
+  config.stack_size = 8192;
+  config.core_id = 0;
+  if (httpd_start(&server, &config) != ESP_OK) {
+    Serial.println("HTTP server start failed");
+    return;
+  }
+  
+  addRoute("/", handleRoot);
+  
+  // Register New Pages
+  addRoute("/msg", handleMessage);        
+  addRoute("/test_buzz", handleBuzzerTest); 
+  
+  // Old style buttons (GET + redirect), kept as fallback for /ws
+  addRoute("/up", [](httpd_req_t* req) { navUp(); return redirectHome(req); });
+  addRoute("/down", [](httpd_req_t* req) { navDown(); return redirectHome(req); });
+  addRoute("/select", [](httpd_req_t* req) { navSelect(); return redirectHome(req); });
+  addRoute("/exit", [](httpd_req_t* req) { navExit(); return redirectHome(req); });
+  addRoute("/dev", [](httpd_req_t* req) { navDev(); return redirectHome(req); });
+  
+  addRoute("/view_temp", handleWebTemp);
+  addRoute("/trend", handleTrend);
+  addRoute("/api/history", handleHistory);
+  addRoute("/api/perf", handlePerf);
+  addRoute("/api/heap", handleHeap);
+  addRoute("/api/board", handleBoard);
+  addRoute("/api/health", handleHealth);
+  addRoute("/api/quake", handleQuake);
+  addRoute("/api/blackbox", handleBlackbox);
+  addRoute("/api/rules", handleRules);
+  addRoute("/api/rules", handleRulesPost, HTTP_POST);
+
+  httpd_uri_t ws = {};
+  ws.uri = "/ws";
+  ws.method = HTTP_GET;
+  ws.handler = handleWs;
+  ws.is_websocket = true;
+  httpd_register_uri_handler(server, &ws);
+}
+
+// ==============================================================
+//                    UI VIEWS (SAMPLE + DRAW)
+// ==============================================================
+// Views 0 .. SENSOR_COUNT-1 are the screens of SENSORS[] (same
+// index as menuIndex), then the screens that are not in the menu.
+enum UiView : uint8_t {
+  VIEW_MENU = SENSOR_COUNT, VIEW_MESSAGE, VIEW_WEB_ALARM, VIEW_ALERT, VIEW_COUNT
+};
+UiView uiShown = VIEW_COUNT;   // view on the OLED now (nothing drawn yet)
+
+// Values read by the last sample() (loop() only)
+const char* viewAlert = "";
+
+// --- MAIN MENU ---
+uint32_t sampleMenu() { return (uint32_t)menuIndex; }
+
+void drawMenu() {
+  display.clearDisplay();
+  display.setTextColor(SSD1306_WHITE);
+  display.setTextSize(2); 
+  display.setCursor(0, 0); 
+  display.println("MAIN MENU");
+  display.drawLine(0, 16, 128, 16, WHITE);
+  
+  display.setTextSize(1); 
+  display.setCursor(0, 25); 
+  display.println("Select Sensor:");
+  
+  display.setTextSize(2); 
+  display.setCursor(10, 40); 
+  display.print("> "); 
+  display.println(SENSORS[menuIndex].name);
+  digitalWrite(BUZZER_PIN, LOW); 
+}
+
+// --- MESSAGE FROM WEB ---
+// runWebMessages() draws the text once into msgStrip (text size 2, one
+// line); a frame only copies the 128 columns in view into the display
+// buffer, so long messages scroll at the cost of short ones.
+#define MESSAGE_PAGE 3         // strip rows 24..39 (display buffer pages 3 + 4)
+#define MESSAGE_FRAME_MS 50    // scroll frame period (a full I2C transfer is ~25 ms)
+TextStrip msgStrip;
+GFXcanvas1 glyphCanvas(6, 8);  // one character of the GFX font, read back by column
+bool msgShown = false;
+unsigned long msgStart = 0;    // scroll clock (starts after a web alarm's siren)
+uint32_t msgShowMs = 0;        // one scroll pass, at least MESSAGE_SHOW_MS
+size_t msgWaiting = 0;         // still queued, shown as "+N"
+uint16_t msgScrollX = 0;
+uint32_t msgDrawnId = 0;
+size_t msgDrawnWaiting = 0;
+
+void oledGlyph(char c, uint8_t cols[5]) {
+  glyphCanvas.fillScreen(0);
+  glyphCanvas.drawChar(0, 0, c, 1, 0, 1);
+  for (int x = 0; x < 5; x++) {
+    uint8_t b = 0;
+    for (int y = 0; y < 8; y++) if (glyphCanvas.getPixel(x, y)) b |= 1 << y;
+    cols[x] = b;
+  }
+}
+
+uint32_t sampleMessage() {
+  long ms = (long)(millis() - msgStart);
+  msgScrollX = msgStrip.scrollX(ms > 0 ? (uint32_t)ms : 0, SCREEN_WIDTH);
+  return (webMessageId * 2654435761u) ^ msgScrollX ^ ((uint32_t)msgWaiting << 16);
+}
+
+void drawMessage() {
+  if (uiShown != VIEW_MESSAGE || msgDrawnId != webMessageId || msgDrawnWaiting != msgWaiting) {
+    // header: GFX text, once per message
     display.clearDisplay();
-    display.setTextSize(2); 
-    display.setCursor(0, 0); 
-    display.println("MAIN MENU");
-    display.drawLine(0, 16, 128, 16, WHITE);
-    
+    display.setTextColor(SSD1306_WHITE);
     display.setTextSize(1); 
-    display.setCursor(0, 25); 
-    display.println("Select Sensor:");
+    display.setCursor(0,0); 
+    display.println("MESSAGE FROM WEB:");
+    if (msgWaiting) {
+      display.setCursor(110, 0);
+      display.print('+');
+      display.print((unsigned)msgWaiting);
+    }
+    display.drawLine(0, 10, 128, 10, WHITE);
+    msgDrawnId = webMessageId;
+    msgDrawnWaiting = msgWaiting;
+  }
+  // every frame: the text in view, straight into the display buffer
+  msgStrip.blit(display.getBuffer(), SCREEN_WIDTH, MESSAGE_PAGE, msgScrollX, SCREEN_WIDTH);
+}
+
+// --- MAGIC "alert" MESSAGE (siren runs while shown) ---
+uint32_t sampleWebAlarm() { return 0; }
+
+void drawWebAlarm() {
+  display.clearDisplay();
+  display.setTextSize(3); 
+  display.setTextColor(WHITE);
+  display.setCursor(10,20); 
+  display.println("ALERT!");
+}
+
+// --- SAFETY ALERT (siren runs while shown) ---
+uint32_t sampleAlert() { return (uint32_t)(uintptr_t)viewAlert; }
+
+void drawAlert() {
+  display.clearDisplay(); 
+  display.setTextColor(WHITE);
+  if (viewAlert == ALERT_QUAKE) {
+    // Draw Exclamation Mark (Alert Sign)
+    display.setTextSize(4);
+    display.setCursor(55, 0);
+    display.println("!"); 
     
     display.setTextSize(2); 
-    display.setCursor(10, 40); 
-    display.print("> "); 
-    display.println(menuItems[menuIndex]);
-    
-    display.display();
-    digitalWrite(BUZZER_PIN, LOW); 
-    delay(100); 
-  } 
-  else {
-    // Run the selected function
-    if (menuIndex == 0) runSoil();
-    else if (menuIndex == 1) runMQ2();
-    else if (menuIndex == 2) runDHT();
-    else if (menuIndex == 3) runMPU();
-    else if (menuIndex == 4) runGPS();
-    else if (menuIndex == 5) runDevInfo();
+    display.setCursor(5, 40); 
+    display.println("EARTHQUAKE");
+  } else if (viewAlert == ALERT_FLOOD || viewAlert == ALERT_FIRE) {
+    display.setTextSize(3); 
+    display.setCursor(10, 10); 
+    display.println(viewAlert == ALERT_FLOOD ? "FLOOD!" : "FIRE!");
+  } else {
+    // alert from a user rule: its name
+    display.setTextSize(2);
+    display.setCursor(0, 10);
+    display.println(viewAlert);
+  }
+}
+
+// Sensor screens, then the others: built at compile time from SENSORS[]
+template <size_t... I>
+constexpr std::array<UiViewDef, VIEW_COUNT> makeViews(std::index_sequence<I...>) {
+  return {{ SENSORS[I].view...,
+            { 0, sampleMenu,     drawMenu },       // VIEW_MENU
+            { 0, sampleMessage,  drawMessage },    // VIEW_MESSAGE
+            { 0, sampleWebAlarm, drawWebAlarm },   // VIEW_WEB_ALARM
+            { 0, sampleAlert,    drawAlert } }};   // VIEW_ALERT
+}
+constexpr std::array<UiViewDef, VIEW_COUNT> UI_VIEWS = makeViews(std::make_index_sequence<SENSOR_COUNT>());
+
+// ==============================================================
+//                    UI STATE MACHINE
+// ==============================================================
+#define SAFETY_PERIOD_MS 100   // safety check + UI tick at least this often
+#define ALERT_HOLD_MS 400      // alert screen + siren stay at least this long
+#define WEB_ALARM_MS 2100      // magic "alert": siren time before the message
+#define MESSAGE_SHOW_MS 5000   // web message at least this long (long ones: one scroll pass)
+#define SIREN_GAP_MS 50        // pause between siren tones
+
+uint32_t uiSig = 0;
+unsigned long uiSampledAt = 0;
+unsigned long alertUntil = 0;    // alert screen kept until here
+unsigned long webAlarmUntil = 0; // magic "alert" siren until here
+unsigned long sirenAt = 0;
+unsigned long buzzTestStart = 0;
+bool buzzTestOn = false;
+
+// Which view the state asks for (alert > message > menu > sensor)
+UiView uiSelectView(unsigned long now) {
+  if (viewAlert[0] && (long)(alertUntil - now) > 0) return VIEW_ALERT;
+  if (showMessageMode) return (long)(webAlarmUntil - now) > 0 ? VIEW_WEB_ALARM : VIEW_MESSAGE;
+  if (inMenu) return VIEW_MENU;
+  return (UiView)menuIndex;
+}
+
+void uiTick() {
+  uint32_t t0 = micros();
+  unsigned long now = millis();
+  uint32_t input = uiInputUs; // button press waiting to be shown (0 = none)
+
+  UiView v = uiSelectView(now);
+  const UiViewDef& def = UI_VIEWS[v];
+  bool entered = (v != uiShown);
+  bool redrawn = false;
+  if (entered || def.refreshMs == 0 || now - uiSampledAt >= def.refreshMs) {
+    uiSampledAt = now;
+    uint32_t sig = def.sample();
+    if (entered || sig != uiSig) {
+      def.draw();
+      display.display();
+      uiShown = v;
+      uiSig = sig;
+      redrawn = true;
+    }
+  }
+
+  uint32_t t1 = micros();
+  // a press that changed nothing on screen is done as well
+  if (input) uiInputUs = 0;
+  uiPerfTick(t1 - t0, redrawn, input ? t1 - input : 0);
+}
+
+// How long loop() may sleep before the next tick is needed
+uint32_t uiNextWaitMs() {
+  uint32_t wait = SAFETY_PERIOD_MS;
+  uint16_t refresh = (uiShown < VIEW_COUNT) ? UI_VIEWS[uiShown].refreshMs : 0;
+  if (refresh) {
+    unsigned long gone = millis() - uiSampledAt;
+    uint32_t left = gone >= refresh ? 0 : refresh - gone;
+    if (left < wait) wait = left;
+  }
+  if (uiShown == VIEW_MESSAGE && msgStrip.width() > SCREEN_WIDTH && wait > MESSAGE_FRAME_MS) wait = MESSAGE_FRAME_MS;
+  if (uiShown == VIEW_ALERT || uiShown == VIEW_WEB_ALARM || buzzTestOn) wait = 10;
+  uint32_t beaconDue = beacon.nextDueMs(millis());  // repeats of a burst
+  if (beaconDue < wait) wait = beaconDue;
+  return wait;
+}
+
+// Siren while an alert screen is up: 20 ms tone, SIREN_GAP_MS pause
+void runSiren() {
+  if (uiShown != VIEW_ALERT && uiShown != VIEW_WEB_ALARM) return;
+  if (millis() - sirenAt < SIREN_GAP_MS) return;
+  playTone();
+  sirenAt = millis();
+}
+
+// Shown message done (or EXIT pressed): the next one from the queue,
+// drawn into msgStrip once; none left: back to the main menu
+void runWebMessages(unsigned long now) {
+  if (msgShown && (!showMessageMode || (long)(now - msgStart) >= (long)msgShowMs)) msgShown = false;
+  if (msgShown) return;
+
+  MessageQueue<WEB_MESSAGE_QUEUE, WEB_MESSAGE_LEN>::Message m;
+  portENTER_CRITICAL(&webMux);
+  bool got = webMessages.pop(now, m);
+  if (got) {
+    memcpy(lastWebMessage, m.text, sizeof(lastWebMessage));
+    webMessageId++;
+  }
+  msgWaiting = webMessages.size();
+  portEXIT_CRITICAL(&webMux);
+
+  if (!got) {
+    // wapis main menu
+    if (showMessageMode) {
+      showMessageMode = false;
+      inMenu = true;
+    }
+    return;
+  }
+  msgStrip.render(m.text, 2, oledGlyph);
+  msgStart = (long)(webAlarmUntil - now) > 0 ? webAlarmUntil : now; // after the siren
+  msgShowMs = msgStrip.passMs(SCREEN_WIDTH);
+  if (msgShowMs < MESSAGE_SHOW_MS) msgShowMs = MESSAGE_SHOW_MS;
+  msgShown = true;
+  showMessageMode = true;
+  inMenu = false;
+}
+
+// Buzzer Test: Beep 3 times (500 ms on / 500 ms off), without blocking
+void runBuzzerTest() {
+  unsigned long phase = (millis() - buzzTestStart) / 500;
+  if (phase >= 6) {
+    digitalWrite(BUZZER_PIN, LOW);
+    buzzTestOn = false;
+    return;
+  }
+  digitalWrite(BUZZER_PIN, (phase % 2 == 0) ? HIGH : LOW);
+}
+
+// ==============================================================
+//             ON-BOOT BENCHMARK (BENCH_ON_BOOT 1)
+// ==============================================================
+// Times the hot paths in CPU cycles with src/bench.h and prints one
+// JSON array over Serial, same fields as tools/microbench.cpp (which
+// runs the PC side). Only for bench builds: takes a few seconds at
+// boot and leaves the quake classifier reset.
+#ifndef BENCH_ON_BOOT
+#define BENCH_ON_BOOT 0
+#endif
+
+#if BENCH_ON_BOOT
+// 64-bit cycle counter (the CPU one wraps every ~18 s at 240 MHz)
+uint64_t benchCycles() {
+  static uint32_t last = 0, high = 0;
+  uint32_t c = ESP.getCycleCount();
+  if (c < last) high++;
+  last = c;
+  return ((uint64_t)high << 32) | c;
+}
+
+void benchPrint(const BenchResult& r, bool last) {
+  char line[256];
+  Bench::json(r, line, sizeof(line));
+  Serial.printf("  %s%s\n", line, last ? "" : ",");
+}
+
+void runBootBench() {
+  BenchClock clock = { benchCycles, "cycles", (uint64_t)ESP.getCpuFreqMHz() * 2000 }; // 2 ms batches
+  Bench bench(clock, 15);
+  Serial.printf("bench: %lu MHz\n[\n", (unsigned long)ESP.getCpuFreqMHz());
+
+  benchPrint(bench.run("safety_rules", []() { benchKeep(checkSafetyPriority()); }), false);
+
+  benchPrint(bench.run("render_root", []() {
+    ChunkOut out(NULL);
+    renderRoot(out);
+    benchKeep(out.sent);
+  }), false);
+
+  static const char NMEA[] =
+    "$GPGGA,123519,3018.989,N,07801.931,E,1,08,0.9,545.4,M,46.9,M,,*5C\r\n"
+    "$GPRMC,123519,A,3018.989,N,07801.931,E,000.5,054.7,140725,003.1,W*6B\r\n";
+  static TinyGPSPlus benchGps;
+  benchPrint(bench.run("gps_feed", []() {
+    for (const char* c = NMEA; *c; c++) benchGps.encode(*c);
+    benchKeep(benchGps);
+  }), false);
+
+  uint32_t i = 0;
+  benchPrint(bench.run("quake_sample", [&]() {
+    benchKeep(quake.push((int16_t)(i * 7 % 41) - 20, (int16_t)(i * 13 % 41) - 20, 1000));
+    i++;
+  }), false);
+  quake.reset();
+
+  char ts[ISO_TIME_LEN];
+  formatIsoTime(ts, 2025, 7, 14, 13, 5, 0);
+  static char out[512];
+  benchPrint(bench.run("iso_time", [&]() { formatIsoTime(ts, 2025, 7, 14, 13, 5, (int)(i++ % 60)); benchKeep(ts); }),
+             false);
+  benchPrint(bench.run("alert_json", [&]() {
+    benchKeep(formatAlertJson(out, sizeof(out), "MQ2", "Smoke/Gas detected", ts, "t:24.5,h:61.0,mq:412,soil:1830",
+                              24.5f, 61.0f, 24.1f, 58.2f, 812.4f, 412, 1830, 30.316494, 78.032188));
+  }), false);
+  benchPrint(bench.run("snapshot_csv", [&]() {
+    benchKeep(formatSnapshotCsv(out, sizeof(out), ts, 24.5f, 61.0f, 24.1f, 58.2f, 812.4f, 412, 1830, 30.316494,
+                                78.032188));
+  }), true);
+  Serial.println("]");
+}
+#endif
+
+// ==============================================================
+//                    MAIN SETUP FUNCTION
+// ==============================================================
+void setup() {
+  Serial.begin(115200);
+  loopTask = xTaskGetCurrentTaskHandle(); // setup() and loop() share this task
+  rulesLock = xSemaphoreCreateMutex();     // before the web server can read rules
+  Wire.begin(BOARD.pins.i2cSda, BOARD.pins.i2cScl);
+  if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) { for(;;); }
+  
+  setupWifi();
+  pinMode(BUZZER_PIN, OUTPUT);
+  
+  dht.begin();
+  // MPU6050 Sensitivity Settings + FIFO (not found: ABSENT, probed later)
+  bool mpuFound = mpuBegin();
+
+  uint32_t bootMs = millis();
+  health[DEV_SOIL].begin("soil", HEALTH_ANALOG, true, bootMs);
+  health[DEV_GAS].begin("gas", HEALTH_ANALOG, true, bootMs);
+  health[DEV_DHT].begin("dht", HEALTH_BUS, true, bootMs);
+  health[DEV_MPU].begin("mpu", HEALTH_BUS, mpuFound, bootMs);
+  blackbox.begin(BB_PRE_MS, BB_POST_MS, "ax,ay,az;soil,gas,temp,hum");
+  rulesBegin();
+  
+  gpsSerial.begin(9600, SERIAL_8N1, GPS_RX, GPS_TX);
+
+  for (const SensorDef& sensor : SENSORS) Serial.printf("%-12s pin %d\n", sensor.name, sensor.pin);
+
+  // Intro Screen
+  display.clearDisplay(); 
+  display.setTextSize(2); 
+  display.setTextColor(SSD1306_WHITE);
+  display.setCursor(10, 20); 
+  display.println("SYSTEM OK");
+  display.display(); 
+  delay(1000);
+
+  heapWatch.begin(millis());
+
+  // boot time = until here (the intro screen included): the unit is ready
+  char report[sizeof(bootReport)];
+  bootReportJson(BOARD, millis(), ESP.getSketchSize(), ESP.getFreeHeap(), ESP.getMinFreeHeap(), report, sizeof(report));
+  portENTER_CRITICAL(&perfMux);
+  memcpy(bootReport, report, sizeof(bootReport));
+  portEXIT_CRITICAL(&perfMux);
+  Serial.println(report);
+#if BENCH_ON_BOOT
+  runBootBench();
+#endif
+}
+
+// ==============================================================
+//                    MAIN LOOP FUNCTION
+// ==============================================================
+void loop() {
+  // (Web requests are served by the HTTP server task)
+  uint32_t loopStart = micros();
+  unsigned long now = millis();
+
+  // --- SENSOR HISTORY (1 sample per second) ---
+  recordHistory();
+
+  // GPS data background mein read karta rahega
+  while (gpsSerial.available()) gps.encode(gpsSerial.read());
+
+  // --- ACTIONS REQUESTED FROM WEBSITE ---
+  if (webAlarmPending) {
+    webAlarmPending = false;
+    webAlarmUntil = now + WEB_ALARM_MS;
+    if (msgShown) msgStart = webAlarmUntil; // the shown message starts over after the siren
   }
+  if (buzzTestPending) { buzzTestPending = false; buzzTestStart = now; buzzTestOn = true; }
+  if (buzzTestOn) runBuzzerTest();
+
+  // --- MPU6050 FIFO -> quake classifier ---
+  pollQuake();
+
+  // --- NEW ALERT RULES FROM WEBSITE ---
+  pollRules();
+
+  // --- SAFETY CHECK (Must run first for notifications) ---
+  static unsigned long lastSafety = 0;
+  if (now - lastSafety >= SAFETY_PERIOD_MS) {
+    lastSafety = now;
+    if (checkSafetyPriority()) {
+      viewAlert = currentAlert;
+      alertUntil = now + ALERT_HOLD_MS;
+    }
+  }
+
+  // --- BLACK BOX (event done -> copy for /api/blackbox) ---
+  pollBlackbox(now);
+
+  // --- ALERT BEACON (start / change / clear -> UDP broadcast) ---
+  beacon.update(now, currentAlert);
+
+  // --- WEB MESSAGES (next one when the shown one is done) ---
+  runWebMessages(now);
+
+  // --- PUSH STATE CHANGES TO /ws CLIENTS ---
+  wsWatchState();
+
+  // --- SCREEN (only redrawn when something on it changed) ---
+  uiTick();
+  runSiren();
+
+  uiPerfLoop(micros() - loopStart);
+  pollHeap();
+  pollHealth(now);
+  uiWait(uiNextWaitMs()); // a button press from web ends the wait
 }
@@ -12,19 +12,36 @@
 #include "SD.h"
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
+#include <esp_system.h>
+#include <esp_task_wdt.h>
+// Board profile: pins + features (src/board_config.h). A unit without
+// the modem, the speech or the SD card: build with
+// -DHIMBUDDY_PROFILE=<a profile with them off>; their code is left out.
+#ifndef HIMBUDDY_PROFILE
+#define HIMBUDDY_PROFILE PROFILE_BT_CALL
+#endif
+#include "src/board_config.h"
+static_assert(BOARD.features.bt && !BOARD.features.web && !BOARD.features.bme280 && !BOARD.features.mesh &&
+              !BOARD.features.powerSave, "esp32.c is the BT unit: sd, modem and tts are optional, the rest is not here");
+#include "src/deadline.h"
+#include "src/heap_stats.h"
+#include "src/landslide.h"
+#include "src/rules.h"
+#include "src/log_format.h"
+#include "src/sensor_health.h"
 
-#define DHT_PIN               4
-#define SOIL_MOISTURE_PIN     34
-#define TILT_SENSOR_PIN       35
-#define MQ2_PIN               32
-#define BUZZER_PIN            14
-#define LED_PIN               26
-#define AUDIO_OUT_PIN         25 
+constexpr int DHT_PIN           = BOARD.pins.dht;
+constexpr int SOIL_MOISTURE_PIN = BOARD.pins.soil;
+constexpr int TILT_SENSOR_PIN   = BOARD.pins.tilt;
+constexpr int MQ2_PIN           = BOARD.pins.mq2;
+constexpr int BUZZER_PIN        = BOARD.pins.buzzer;
+constexpr int LED_PIN           = BOARD.pins.led;
+constexpr int AUDIO_OUT_PIN     = BOARD.pins.audioOut;
 
-#define SD_CS_PIN             5
+constexpr int SD_CS_PIN         = BOARD.pins.sdCs;
 
-#define GPS_RX_PIN            12
-#define GPS_TX_PIN            13
+constexpr int GPS_RX_PIN        = BOARD.pins.gpsRx;
+constexpr int GPS_TX_PIN        = BOARD.pins.gpsTx;
 
 SoftwareSerial gpsSerial(GPS_RX_PIN, GPS_TX_PIN);
 
@@ -32,7 +49,7 @@ BluetoothSerial SerialBT;
 TinyGPSPlus gps;
 RTC_DS3231 rtc;
 Adafruit_MPU6050 mpu;
-ESP8266SAM sam;
+Feature<BOARD.features.tts, ESP8266SAM> sam;
 
 #define DHT_TYPE DHT22
 DHT dht(DHT_PIN, DHT_TYPE);
@@ -42,21 +59,100 @@ DHT dht(DHT_PIN, DHT_TYPE);
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1);
 
 unsigned long lastSensorReadMillis = 0;
-String currentGpsLocation = "Location not available";
-String emergencyNumber = "YOUR_EMERGENCY_NUMBER"; 
+const char* emergencyNumber = "YOUR_EMERGENCY_NUMBER"; 
+HeapWatch heapWatch;
+
+// Landslide risk from soil trend, inclination drift and tilt switch activity
+LandslideDetector landslideRisk;
+int lastTiltLevel = LOW;
+uint16_t tiltEdges = 0;     // switch closures since the last sensor read
+
+// Alert rules: /rules.txt on the SD card (syntax in src/rules.h), written
+// with these defaults when missing. RULES_RELOAD over Bluetooth re-reads it.
+#define RULES_FILE "/rules.txt"
+#define RULES_TEXT_MAX 2048
+const char DEFAULT_RULES[] =
+    "gas > 1500 -> Fire priority 1 cooldown 2s\n"
+    "vibration > 20 -> Earthquake priority 2 cooldown 2s\n"
+    "# slide: 0 Safe, 1 Watch, 2 Warning, 3 Danger\n"
+    "slide >= 2 -> Landslide priority 3\n"
+    "slide >= 3 -> Landslide priority 3\n";
+
+enum RuleSignalIndex { SIG_TEMP, SIG_HUM, SIG_SOIL, SIG_GAS, SIG_VIBRATION, SIG_SLIDE, SIG_TILT, SIG_COUNT };
+const char* const RULE_SIGNAL_NAMES[SIG_COUNT] = { "temp", "hum", "soil", "gas", "vibration", "slide", "tilt" };
+RuleEngine alertRules;
+char rulesError[64] = "";   // why RULES_FILE did not compile ("" = it did)
+
+// Sensor health (src/sensor_health.h): a sensor that does not answer is
+// skipped and probed with backoff, not read every pass (BT "STATUS" / "HEALTH")
+enum HealthDevice : uint8_t { DEV_SOIL, DEV_GAS, DEV_DHT, DEV_MPU, DEV_COUNT };
+#define SOIL_MIN_RAW 10    // lower: input floating (not wired)
+#define GAS_MIN_RAW 100
+#define MPU_ADDR 0x68
+SensorHealth health[DEV_COUNT];
+// last pass, for BT "STATUS" (NAN / -1 = no data)
+float lastTemp = NAN, lastHum = NAN;
+int lastSoilRaw = -1, lastGasRaw = -1;
+
+// Loop stages and their time budgets (src/deadline.h). A stage over
+// budget goes into the stall trace; one that never ends starves the
+// task watchdog, and the next boot records where the unit was.
+// Trace: BT "STALLS", and /stalls.log on the SD card.
+enum LoopStage : uint8_t {
+    STAGE_INPUT, STAGE_SENSORS, STAGE_OLED, STAGE_BT_SEND, STAGE_ALERT, STAGE_SD_LOG,
+    STAGE_CALL_DIAL, STAGE_CALL_SPEAK, STAGE_CALL_LISTEN, STAGE_GPS, STAGE_BT_CMD, STAGE_HOUSEKEEPING,
+    STAGE_COUNT
+};
+const DeadlineStage LOOP_STAGES[STAGE_COUNT] = {
+    { "input", 5 },
+    { "sensors", 300 },          // DHT22 + MPU6050 + rules
+    { "oled", 150 },             // 1 KB over I2C at 100 kHz
+    { "bt_send", 100 },
+    { "alert", 2500 },           // buzzer + LED held 2 s
+    { "sd_log", 250 },
+    { "call_dial", 16000 },      // ATD, then 15 s for the call to connect
+    { "call_speak", 15000 },     // SAM speaks the location
+    { "call_listen", 10500 },    // 10 s on the line, then ATH
+    { "gps", 20 },
+    { "bt_cmd", 3000 },          // one command (GET_ANALYTICS: one chunk)
+    { "housekeeping", 250 },     // heap poll, stall log to SD
+};
+#define WDT_TIMEOUT_S 20        // above the longest budget (call_dial)
+#define STALLS_FILE "/stalls.log"
+#define STALLS_LOG_MS 10000
+RTC_NOINIT_ATTR StallTrace stallTrace;
+char bootReport[224] = "{}";
+LoopDeadline deadline;
+
+// Status texts (fixed strings, nothing is allocated per reading)
+const char* const STATUS_DETECTED = "Detected";
+const char* const STATUS_NORMAL = "Normal";
+const char* const STATUS_HIGH = "High";
+const char* const STATUS_LOW = "Low";
 
 void readAndProcessSensors();
-void sendDataToBluetooth(float temp, float hum, int soil, String fire, String landslide, String vib);
-void triggerHardAlert(String alertType);
+void sendDataToBluetooth(float temp, float hum, int soil, const char* fire, const char* landslide, const char* vib);
+void triggerHardAlert(const char* alertType);
 void handleBluetoothCommand();
-void logToSDCard(String event);
-void updateOLED(float temp, float hum, String fire, String landslide);
-void makeEmergencyCall(String alertType);
+void logToSDCard(const char* event);
+void updateOLED(float temp, float hum, const char* fire, const char* landslide);
+void makeEmergencyCall(const char* alertType);
 void updateGpsLocation();
+void formatGpsLocation(char* out, size_t len);
+void loadRules();
+bool ruleHeld(const char* name);
+void stallMark(uint8_t stage);
+void stallEnd();
+void logStalls();
+bool mpuBegin();
 
 void setup() {
+    // before anything that could hang: a stage left open is recorded now
+    stallTrace.start(esp_reset_reason() == ESP_RST_POWERON, esp_reset_reason(), STAGE_COUNT);
+    deadline.begin(stallTrace, LOOP_STAGES, STAGE_COUNT);
+
     Serial.begin(115200);
-    Wire.begin();
+    Wire.begin(BOARD.pins.i2cSda, BOARD.pins.i2cScl);
     SerialBT.begin("himbuddy_esp32");
     
     pinMode(TILT_SENSOR_PIN, INPUT);
@@ -75,13 +171,19 @@ void setup() {
     }
 
     dht.begin();
-    if (!mpu.begin()) {
-        Serial.println("MPU6050 not found");
-        while (1);
-    }
+    // not found: ABSENT, probed again with backoff (sensor health)
+    bool mpuFound = mpuBegin();
+    if (!mpuFound) Serial.println("MPU6050 not found");
+    uint32_t bootMs = millis();
+    health[DEV_SOIL].begin("soil", HEALTH_ANALOG, true, bootMs);
+    health[DEV_GAS].begin("gas", HEALTH_ANALOG, true, bootMs);
+    health[DEV_DHT].begin("dht", HEALTH_BUS, true, bootMs);
+    health[DEV_MPU].begin("mpu", HEALTH_BUS, mpuFound, bootMs);
     
     gpsSerial.begin(9600);
-    Serial2.begin(9600, SERIAL_8N1, 16, 17); // SIM800L on RX2/TX2
+    if constexpr (BOARD.features.modem) {
+        Serial2.begin(9600, SERIAL_8N1, BOARD.pins.modemRx, BOARD.pins.modemTx); // SIM800L on RX2/TX2
+    }
 
     if (!rtc.begin()) {
         Serial.println("Couldn't find RTC");
@@ -90,96 +192,361 @@ void setup() {
         rtc.adjust(DateTime(F(__DATE__), F(__TIME__)));
     }
 
-    if(!SD.begin(SD_CS_PIN)){
-        Serial.println("SD Card Mount Failed");
+    if constexpr (BOARD.features.sd) {
+        if(!SD.begin(SD_CS_PIN)){
+            Serial.println("SD Card Mount Failed");
+        }
     }
+
+    heapWatch.begin(millis());
+    landslideRisk.begin(LANDSLIDE_CONFIG_DEFAULT, millis());
+    loadRules();
+    logStalls();   // what the last boot(s) left in the trace
+
+    // fed by stallMark() only, never on a timer; the idle tasks stay
+    // watched as the core configured them
+    esp_task_wdt_config_t wdt = {};
+    wdt.timeout_ms = WDT_TIMEOUT_S * 1000;
+    wdt.trigger_panic = true;
+#if CONFIG_ESP_TASK_WDT_CHECK_IDLE_TASK_CPU0
+    wdt.idle_core_mask |= 1 << 0;
+#endif
+#if CONFIG_ESP_TASK_WDT_CHECK_IDLE_TASK_CPU1
+    wdt.idle_core_mask |= 1 << 1;
+#endif
+    esp_task_wdt_reconfigure(&wdt);
+    esp_task_wdt_add(NULL);
+
+    // profile, boot time and memory (BT "BOARD")
+    bootReportJson(BOARD, millis(), ESP.getSketchSize(), ESP.getFreeHeap(), ESP.getMinFreeHeap(),
+                   bootReport, sizeof(bootReport));
+    Serial.println(bootReport);
 }
 
 void loop() {
+    stallMark(STAGE_INPUT);
+    // count every tilt switch closure, not only the ones seen every 2 s
+    int tilt = digitalRead(TILT_SENSOR_PIN);
+    if (tilt == HIGH && lastTiltLevel == LOW) tiltEdges++;
+    lastTiltLevel = tilt;
+
     if (millis() - lastSensorReadMillis > 2000) {
         lastSensorReadMillis = millis();
         readAndProcessSensors();
     }
+    stallMark(STAGE_GPS);
     updateGpsLocation();
     if (SerialBT.available()) {
+        stallMark(STAGE_BT_CMD);
         handleBluetoothCommand();
     }
+    stallMark(STAGE_HOUSEKEEPING);
+    heapWatch.poll(millis());
+    logStalls();
+    stallEnd();
 }
 
-void readAndProcessSensors() {
-    float temp = dht.readTemperature();
-    float humidity = dht.readHumidity();
-    int soilValue = analogRead(SOIL_MOISTURE_PIN);
-    int soilPercent = map(soilValue, 0, 4095, 100, 0);
-    int gasValue = analogRead(MQ2_PIN);
-    String fireStatus = (gasValue > 1500) ? "Detected" : "Normal";
-    String landslideStatus = (digitalRead(TILT_SENSOR_PIN) == HIGH) ? "Detected" : "Safe";
-    
+// Next loop stage; the one before it finished, so feed the watchdog
+void stallMark(uint8_t stage) {
+    if (deadline.mark(stage, micros(), millis())) esp_task_wdt_reset();
+}
+
+void stallEnd() {
+    if (deadline.end(micros())) esp_task_wdt_reset();
+}
+
+// Stall records not yet on the SD card go to STALLS_FILE: at boot, then
+// at most every STALLS_LOG_MS (a slow card would otherwise overrun the
+// housekeeping stage, log that, overrun again ...)
+void logStalls() {
+    if constexpr (!BOARD.features.sd) return;
+    static unsigned long lastTry = 0;
+    if (stallTrace.logged == stallTrace.next) return;
+    if (lastTry && millis() - lastTry < STALLS_LOG_MS) return;
+    lastTry = millis() | 1;
+    File f = SD.open(STALLS_FILE, FILE_APPEND);
+    if (!f) return;
+    char line[160];
+    uint32_t s = stallTrace.logged;
+    for (; s != stallTrace.next; s++) {
+        stallJson(stallTrace.at(s), LOOP_STAGES, line, sizeof(line));
+        f.println(line);
+    }
+    f.close();
+    stallTrace.setLogged(s);
+}
+
+// An I2C device answers its address (missing: one NACKed byte)
+bool i2cPresent(uint8_t addr) {
+    Wire.beginTransmission(addr);
+    return Wire.endTransmission() == 0;
+}
+
+// At boot, and when a probe finds the MPU6050 again
+bool mpuBegin() {
+    return mpu.begin(MPU_ADDR);
+}
+
+// Soil / MQ-2 raw value; -1 while the input is ABSENT (not read)
+int readAnalog(HealthDevice dev, int pin, int minRaw) {
+    uint32_t now = millis();
+    if (!health[dev].due(now)) return -1;
+    int v = analogRead(pin);
+    health[dev].report(v >= minRaw ? READ_OK : READ_MISSING, now);
+    return health[dev].absent() ? -1 : v;
+}
+
+// DHT22; NAN without a reply (the library waits for it on every call,
+// so an ABSENT sensor is only probed)
+void readDht(float& t, float& h) {
+    t = h = NAN;
+    uint32_t now = millis();
+    if (!health[DEV_DHT].due(now)) return;
+    t = dht.readTemperature();
+    h = dht.readHumidity();
+    health[DEV_DHT].report(isnan(t) || isnan(h) ? READ_MISSING : READ_OK, now);
+}
+
+// Accelerometer (m/s^2); false while the MPU6050 is ABSENT
+bool readAccel(float& ax, float& ay, float& az) {
+    uint32_t now = millis();
+    if (!health[DEV_MPU].due(now)) return false;
+    bool wasAbsent = health[DEV_MPU].absent();
+    if (!i2cPresent(MPU_ADDR)) {
+        health[DEV_MPU].report(READ_MISSING, now);
+        return false;
+    }
+    if (wasAbsent && !mpuBegin()) {
+        health[DEV_MPU].report(READ_BAD, now);  // something answers, not an MPU6050
+        return false;
+    }
+    health[DEV_MPU].report(READ_OK, now);
     sensors_event_t a, g, t;
     mpu.getEvent(&a, &g, &t);
-    float totalVibration = sqrt(pow(a.acceleration.x, 2) + pow(a.acceleration.y, 2) + pow(a.acceleration.z, 2));
-    String vibrationStatus = (totalVibration > 20) ? "High" : "Low";
+    ax = a.acceleration.x;
+    ay = a.acceleration.y;
+    az = a.acceleration.z;
+    return true;
+}
+
+void readAndProcessSensors() {
+    stallMark(STAGE_SENSORS);
+    float temp, humidity;
+    readDht(temp, humidity);
+    int soilValue = readAnalog(DEV_SOIL, SOIL_MOISTURE_PIN, SOIL_MIN_RAW);
+    int soilPercent = soilValue < 0 ? -1 : map(soilValue, 0, 4095, 100, 0);
+    int gasValue = readAnalog(DEV_GAS, MQ2_PIN, GAS_MIN_RAW);
+    lastTemp = temp;
+    lastHum = humidity;
+    lastSoilRaw = soilValue;
+    lastGasRaw = gasValue;
+
+    // an ABSENT sensor is NAN: no rule on it fires
+    float ax, ay, az;
+    float totalVibration = NAN;
+    if (readAccel(ax, ay, az)) {
+        totalVibration = sqrt(ax * ax + ay * ay + az * az);
+        // landslide: not without soil data
+        if (soilPercent >= 0) landslideRisk.update(millis(), soilPercent, ax, ay, az, tiltEdges);
+    }
+
+    float values[SIG_COUNT];
+    values[SIG_TEMP] = temp;
+    values[SIG_HUM] = humidity;
+    values[SIG_SOIL] = soilPercent < 0 ? NAN : soilPercent;
+    values[SIG_GAS] = gasValue < 0 ? NAN : gasValue;
+    values[SIG_VIBRATION] = totalVibration;
+    values[SIG_SLIDE] = landslideRisk.level();
+    values[SIG_TILT] = tiltEdges;
+    tiltEdges = 0;
+    uint8_t fired[8];
+    uint8_t firedCount = alertRules.evaluate(millis(), values, fired, sizeof(fired));
+
+    const char* fireStatus = ruleHeld("Fire") ? STATUS_DETECTED : STATUS_NORMAL;
+    const char* landslideStatus = landslideRiskName(landslideRisk.level());
+    const char* vibrationStatus = ruleHeld("Earthquake") ? STATUS_HIGH : STATUS_LOW;
 
+    stallMark(STAGE_OLED);
     updateOLED(temp, humidity, fireStatus, landslideStatus);
+    stallMark(STAGE_BT_SEND);
     sendDataToBluetooth(temp, humidity, soilPercent, fireStatus, landslideStatus, vibrationStatus);
 
-    if (fireStatus == "Detected") {
-        triggerHardAlert("Fire");
+    // most urgent first, each alert once (e.g. Landslide Warning -> Danger at once)
+    for (uint8_t i = 0; i < firedCount; i++) {
+        const char* name = alertRules.name(fired[i]);
+        bool done = false;
+        for (uint8_t j = 0; j < i; j++) done |= strcmp(alertRules.name(fired[j]), name) == 0;
+        if (!done) triggerHardAlert(name);
     }
-    if (vibrationStatus == "High") {
-        triggerHardAlert("Earthquake");
+}
+
+// Reads RULES_FILE (writes the defaults first if it is missing) and
+// compiles it. A file that does not compile keeps the old rules, or
+// the defaults at boot.
+void loadRules() {
+    static char text[RULES_TEXT_MAX];
+    size_t n = 0;
+    if constexpr (!BOARD.features.sd) {
+        snprintf(rulesError, sizeof(rulesError), "no SD card in profile %s", BOARD.name);
+        alertRules.compile(DEFAULT_RULES, RULE_SIGNAL_NAMES, SIG_COUNT, NULL, 0);
+        return;
+    }
+    if (!SD.exists(RULES_FILE)) {
+        File f = SD.open(RULES_FILE, FILE_WRITE);
+        if (f) {
+            f.print(DEFAULT_RULES);
+            f.close();
+        }
     }
+    File f = SD.open(RULES_FILE);
+    if (f) {
+        n = f.read((uint8_t*)text, sizeof(text) - 1);
+        f.close();
+    }
+    text[n] = 0;
+
+    if (n == 0) snprintf(rulesError, sizeof(rulesError), "%s missing or empty", RULES_FILE);
+    if (n > 0 && alertRules.compile(text, RULE_SIGNAL_NAMES, SIG_COUNT, rulesError, sizeof(rulesError))) {
+        Serial.printf("%u rules from %s\n", alertRules.count(), RULES_FILE);
+        return;
+    }
+    Serial.printf("%s: %s\n", RULES_FILE, rulesError);
+    if (alertRules.count() == 0) alertRules.compile(DEFAULT_RULES, RULE_SIGNAL_NAMES, SIG_COUNT, NULL, 0);
 }
 
-void sendDataToBluetooth(float temp, float hum, int soil, String fire, String landslide, String vib) {
+// Some rule with this name holds right now
+bool ruleHeld(const char* name) {
+    for (uint8_t i = 0; i < alertRules.count(); i++) {
+        if (alertRules.status(i).held && strcmp(alertRules.name(i), name) == 0) return true;
+    }
+    return false;
+}
+
+void sendDataToBluetooth(float temp, float hum, int soil, const char* fire, const char* landslide, const char* vib) {
     if (SerialBT.connected()) {
         SerialBT.printf("{\"temp\":%.1f}\n", temp);
         SerialBT.printf("{\"humidity\":%.1f}\n", hum);
-        SerialBT.printf("{\"soil\":%d}\n", soil);
-        SerialBT.printf("{\"fire\":\"%s\"}\n", fire.c_str());
-        SerialBT.printf("{\"landslide\":\"%s\"}\n", landslide.c_str());
-        SerialBT.printf("{\"vibration\":\"%s\"}\n", vib.c_str());
+        if (soil < 0) SerialBT.println("{\"soil\":null}");
+        else SerialBT.printf("{\"soil\":%d}\n", soil);
+        SerialBT.printf("{\"fire\":\"%s\"}\n", fire);
+        SerialBT.printf("{\"landslide\":\"%s\"}\n", landslide);
+        SerialBT.printf("{\"vibration\":\"%s\"}\n", vib);
         SerialBT.printf("{\"lat\":%.4f, \"lon\":%.4f}\n", gps.location.lat(), gps.location.lng());
     }
 }
 
-void triggerHardAlert(String alertType) {
-    String alertMessage = alertType + " Detected!";
+void triggerHardAlert(const char* alertType) {
+    char alertMessage[48];
+    snprintf(alertMessage, sizeof(alertMessage), "%s Detected!", alertType);
+    stallMark(STAGE_ALERT);
     digitalWrite(BUZZER_PIN, HIGH);
     digitalWrite(LED_PIN, HIGH);
     
     if (SerialBT.connected()) {
-        SerialBT.printf("{\"alert\":\"%s\"}\n", alertMessage.c_str());
+        SerialBT.printf("{\"alert\":\"%s\"}\n", alertMessage);
     }
+    stallMark(STAGE_SD_LOG);
     logToSDCard(alertMessage);
     makeEmergencyCall(alertType);
+    stallMark(STAGE_ALERT);
     delay(2000);
     digitalWrite(BUZZER_PIN, LOW);
     digitalWrite(LED_PIN, LOW);
 }
 
-void makeEmergencyCall(String alertType) {
-    Serial.println("Making emergency call...");
-    Serial2.println("ATD" + emergencyNumber + ";");
-    delay(15000); 
+// Without the modem there is no call; without TTS the line stays
+// silent for the listen time
+void makeEmergencyCall(const char* alertType) {
+    if constexpr (BOARD.features.modem) {
+        stallMark(STAGE_CALL_DIAL);
+        Serial.println("Making emergency call...");
+        Serial2.printf("ATD%s;\r\n", emergencyNumber);
+        delay(15000); 
 
-    String messageToSpeak = "Attention. " + alertType + " detected at my location. " + currentGpsLocation;
-    sam.say(AUDIO_OUT_PIN, messageToSpeak.c_str());
-    delay(10000); 
+        if constexpr (BOARD.features.tts) {
+            stallMark(STAGE_CALL_SPEAK);
+            char location[80];
+            formatGpsLocation(location, sizeof(location));
+            char messageToSpeak[160];
+            snprintf(messageToSpeak, sizeof(messageToSpeak), "Attention. %s detected at my location. %s", alertType, location);
+            sam->say(AUDIO_OUT_PIN, messageToSpeak);
+        }
+        stallMark(STAGE_CALL_LISTEN);
+        delay(10000); 
 
-    Serial2.println("ATH"); 
-    Serial.println("Call ended.");
+        Serial2.println("ATH"); 
+        Serial.println("Call ended.");
+    }
 }
 
 void handleBluetoothCommand() {
-    String command = SerialBT.readStringUntil('\n');
-    command.trim();
-    if (command.equals("GET_ANALYTICS")) {
+    char command[32];
+    size_t n = SerialBT.readBytesUntil('\n', command, sizeof(command) - 1);
+    while (n > 0 && isspace((unsigned char)command[n - 1])) n--;
+    command[n] = 0;
+    if (strcmp(command, "HEAP") == 0) {
+        char out[192];
+        heapWatch.json(out, sizeof(out));
+        SerialBT.println(out);
+    } else if (strcmp(command, "SLIDE") == 0) {
+        char out[192];
+        landslideRisk.json(out, sizeof(out));
+        SerialBT.println(out);
+    } else if (strcmp(command, "SLIDE_ZERO") == 0) {
+        // unit re-mounted: take its current inclination as the new reference
+        landslideRisk.rebaseline(millis());
+        SerialBT.println("{\"slide\":\"rebaseline\"}");
+    } else if (strcmp(command, "STALLS") == 0) {
+        // stages over budget (this boot and the ones before), then per stage
+        char out[160];
+        for (uint32_t s = stallTrace.first(); s != stallTrace.next; s++) {
+            stallJson(stallTrace.at(s), LOOP_STAGES, out, sizeof(out));
+            SerialBT.println(out);
+        }
+        for (uint8_t i = 0; i < deadline.count(); i++) {
+            deadline.json(i, out, sizeof(out));
+            SerialBT.println(out);
+        }
+    } else if (strcmp(command, "RULES") == 0) {
+        char out[192];
+        for (uint8_t i = 0; i < alertRules.count(); i++) {
+            alertRules.json(i, out, sizeof(out));
+            SerialBT.println(out);
+        }
+    } else if (strcmp(command, "RULES_RELOAD") == 0) {
+        // after editing /rules.txt: compile it, or say which line is wrong
+        loadRules();
+        SerialBT.printf("{\"rules\":%u,\"error\":\"%s\"}\n", alertRules.count(), rulesError);
+    } else if (strcmp(command, "STATUS") == 0) {
+        // last readings + sensor states ("health" says which are ABSENT)
+        char states[96];
+        healthSummaryJson(health, DEV_COUNT, states, sizeof(states));
+        char out[256];
+        formatStatusJson(out, sizeof(out), lastTemp, lastHum, lastGasRaw, lastSoilRaw, states);
+        SerialBT.println(out);
+    } else if (strcmp(command, "HEALTH") == 0) {
+        // one line per sensor: state, counters, next probe
+        char out[192];
+        for (uint8_t i = 0; i < DEV_COUNT; i++) {
+            health[i].json(out, sizeof(out), millis());
+            SerialBT.println(out);
+        }
+    } else if (strcmp(command, "BOARD") == 0) {
+        SerialBT.println(bootReport);
+    } else if (strcmp(command, "GET_ANALYTICS") == 0) {
+        if constexpr (!BOARD.features.sd) {
+            SerialBT.println("No SD card in this build.");
+            return;
+        }
         File dataFile = SD.open("/analytics.log");
         if (dataFile) {
             SerialBT.println("\n--- Analytics from SD Card ---");
-            while (dataFile.available()) {
-                SerialBT.write(dataFile.read());
+            // a chunk per stage: a long log is progress, not a stall
+            uint8_t buf[512];
+            size_t n;
+            while ((n = dataFile.read(buf, sizeof(buf))) > 0) {
+                SerialBT.write(buf, n);
+                stallMark(STAGE_BT_CMD);
             }
             dataFile.close();
             SerialBT.println("\n--- End of Analytics ---\n");
@@ -189,19 +556,18 @@ void handleBluetoothCommand() {
     }
 }
 
-void logToSDCard(String event) {
+void logToSDCard(const char* event) {
+    if constexpr (!BOARD.features.sd) return;
     File dataFile = SD.open("/analytics.log", FILE_APPEND);
     if (dataFile) {
         DateTime now = rtc.now();
-        String logEntry = String(now.year()) + "/" + String(now.month()) + "/" + String(now.day()) + " ";
-        logEntry += String(now.hour()) + ":" + String(now.minute()) + ":" + String(now.second()) + " - ";
-        logEntry += event;
-        dataFile.println(logEntry);
+        dataFile.printf("%d/%d/%d %d:%d:%d - %s\r\n", now.year(), now.month(), now.day(),
+                        now.hour(), now.minute(), now.second(), event);
         dataFile.close();
     }
 }
 
-void updateOLED(float temp, float hum, String fire, String landslide) {
+void updateOLED(float temp, float hum, const char* fire, const char* landslide) {
     display.clearDisplay();
     display.setCursor(0,0);
     display.setTextSize(1);
@@ -216,10 +582,15 @@ void updateOLED(float temp, float hum, String fire, String landslide) {
 
 void updateGpsLocation(){
     while (gpsSerial.available() > 0) {
-        if (gps.encode(gpsSerial.read())) {
-            if (gps.location.isUpdated()) {
-                currentGpsLocation = "Latitude is " + String(gps.location.lat(), 6) + " and Longitude is " + String(gps.location.lng(), 6);
-            }
-        }
+        gps.encode(gpsSerial.read());
+    }
+}
+
+// Spoken location, built only when a call is made
+void formatGpsLocation(char* out, size_t len) {
+    if (gps.location.isValid()) {
+        snprintf(out, len, "Latitude is %.6f and Longitude is %.6f", gps.location.lat(), gps.location.lng());
+    } else {
+        snprintf(out, len, "Location not available");
     }
 }
@@ -2,11 +2,33 @@
   ESP32 Multi-Sensor Monitoring with Immediate OLED Alerts + Bluetooth + SD logging
   - OLED alert overlay (big inverted banner) on any alert
   - Sends alert JSON to BluetoothSerial (SPP) immediately
-  - Logs alerts to /alerts.log (JSON lines) and periodic sensor snapshots to /senslog.csv
+  - Logs alerts (JSON lines) and raw 5 s sensor rows (CSV) to ring journals /alerts.jnl and
+    /raw.jnl: fixed size files, checksummed blocks, a power cut loses at most the last block
+    (src/journal.h, tools/journal_sim.cpp); BT "GET_ALERTS" / "GET_RAW" read them back
+  - Raw rows are rolled up into /min/YYYYMMDD.csv and /hour/YYYYMM.csv (min/max/mean/count per channel)
+  - Alerts are relayed to/from other units over ESP-NOW (src/alert_mesh.h)
+  - Power save: light sleep between samples, wakes on MPU6050 motion / tilt,
+    BT + OLED only on while needed (src/power.h, tools/power_sim.cpp)
   - Sensors included: DHT22, MQ-2, Soil (Analog), Tilt (digital), BME280, MPU6050, GPS(Neo-6M), DS3231 RTC
+  - DHT22 is read by the RMT peripheral in the background (no interrupts-off bit-banging) and
+    cached for its 2 s period (src/dht22.h, tools/dht_check.cpp); BT "DHT" / "DHT_RAW" report it
+  - Landslide risk (Safe/Watch/Warning/Danger) from soil trend, MPU6050 inclination drift and
+    tilt switch activity (src/landslide.h, tools/landslide_replay.cpp); BT "SLIDE" reports it
+  - No String / heap use in the loop; BT "HEAP" reports heap + fragmentation (src/heap_stats.h)
+  - Alert conditions are text rules in /rules.txt on the SD card (src/rules.h); BT "RULES" lists
+    them, "RULES_RELOAD" re-reads the file after an edit
+  - An unplugged sensor is skipped and re-probed with backoff instead of read every pass
+    (src/sensor_health.h, tools/health_sim.cpp); BT "STATUS" / "HEALTH" report it
+  - Black box: MQ-2 / soil every pass for 10 s before and 5 s after each alert, saved to
+    /bb/<time>.hbb (src/blackbox.h); BT "EVENTS" lists them, "GET_EVENT name" sends one
+    (tools/blackbox_decode.cpp)
   - Use Arduino IDE with ESP32 core
 
-  Adjust PINs, thresholds, and ENABLE_SIM800L flag for your wiring.
+  - Pins and the optional parts (SIM800L, BME280, mesh, power save) come from the board profile
+    PROFILE_BT_SD (src/board_config.h); BT "BOARD" reports it with the boot time and memory
+
+  Adjust thresholds here; pins and features in src/board_config.h (or build with
+  -DHIMBUDDY_PROFILE=... for another wiring).
 */
 
 #include <Wire.h>
@@ -15,52 +37,98 @@
 #include "BluetoothSerial.h"
 #include <Adafruit_SSD1306.h>
 #include <Adafruit_BME280.h>
-#include <DHT.h>
 #include <RTClib.h>
 #include <TinyGPSPlus.h>
 #include <Adafruit_MPU6050.h>
 #include <Adafruit_Sensor.h>
+#include <WiFi.h>
+#include <esp_now.h>
+#include <esp_wifi.h>
+#include <esp_sleep.h>
+#include <Preferences.h>
+#include <driver/gpio.h>
+
+// Board profile: pins + features (src/board_config.h)
+#ifndef HIMBUDDY_PROFILE
+#define HIMBUDDY_PROFILE PROFILE_BT_SD
+#endif
+#include "src/board_config.h"
+static_assert(BOARD.features.bt && BOARD.features.sd && !BOARD.features.web && !BOARD.features.tts,
+              "esp32fullcode.c is the BT + SD unit: modem, bme280, mesh and powerSave are optional");
+#include "src/history.h"
+#include "src/alert_mesh.h"
+#include "src/power.h"
+#include "src/heap_stats.h"
+#include "src/landslide.h"
+#include "src/rules.h"
+#include "src/unit_rules.h"
+#include "src/log_format.h"
+#include "src/journal.h"
+#include "src/dht22.h"
+#include "src/sensor_health.h"
+#include "src/blackbox.h"
 
 // ---------- CONFIG ----------
-#define ENABLE_SIM800L false
+// SIM800L, mesh (ESP-NOW alert relay), power save (light sleep between
+// samples, battery / solar units), BME280: BOARD.features
+#define MESH_CHANNEL 1               // all units must use the same Wi-Fi channel
 #define OLED_RESET -1
 #define SCREEN_WIDTH 128
 #define SCREEN_HEIGHT 64
 
-// Pins (tune as per your wiring)
-const int PIN_DHT = 15;
-const int PIN_MQ2 = 34;
-const int PIN_SOIL = 35;
-const int PIN_TILT = 14;
-const int PIN_BUZZER = 27;
-const int SD_CS = 5;
+// Pins (from the board profile)
+constexpr int PIN_DHT = BOARD.pins.dht;
+constexpr int PIN_MQ2 = BOARD.pins.mq2;
+constexpr int PIN_SOIL = BOARD.pins.soil;
+constexpr int PIN_TILT = BOARD.pins.tilt;
+constexpr int PIN_MPU_INT = BOARD.pins.mpuInt;  // MPU6050 INT (motion wake)
+constexpr int PIN_BUZZER = BOARD.pins.buzzer;
+constexpr int SD_CS = BOARD.pins.sdCs;
 
 // UART pins
-#define SIM800_TX_PIN 25
-#define SIM800_RX_PIN 26
-#define GPS_RX_PIN 16
-#define GPS_TX_PIN 17
+constexpr int SIM800_TX_PIN = BOARD.pins.modemTx;
+constexpr int SIM800_RX_PIN = BOARD.pins.modemRx;
+constexpr int GPS_RX_PIN = BOARD.pins.gpsRx;
+constexpr int GPS_TX_PIN = BOARD.pins.gpsTx;
 
-// Sensor types and timing
-#define DHTTYPE DHT22
-#define DHT_READ_INTERVAL_MS 5000
-#define SENSOR_REPORT_INTERVAL_MS 5000
+// Sensor timing
+#define SENSOR_REPORT_INTERVAL_MS 5000   // scheduled sample: DHT check + CSV snapshot
 
 // Alert behavior
 #define ALERT_DISPLAY_MS 6000        // how long overlay stays (ms)
-#define ALERT_MIN_INTERVAL_MS 5000   // minimum gap between same alerts
 
-// Thresholds (tune/calibrate)
-const int MQ2_SMOKE_THRESHOLD = 300;     // raw ADC threshold (0-4095) - tune
-const int SOIL_DRY_THRESHOLD = 2000;     // raw ADC (0-4095)
-const float DHT_TEMP_HIGH = 45.0;
-const float DHT_HUM_HIGH = 85.0;
+// SD journals (512 byte blocks, made once at this size; change the size = start over)
+#define ALERT_JOURNAL "/alerts.jnl"
+#define ALERT_JOURNAL_BLOCKS 4096    // 2 MB, ~4000 alerts
+#define RAW_JOURNAL "/raw.jnl"
+#define RAW_JOURNAL_BLOCKS 8192      // 4 MB, ~55 h of raw 5 s rows
+
+// SD retention (aggregates of the raw rows: per-minute -> per-hour)
+#define MIN_RETENTION_DAYS 30        // per-minute aggregates kept this long
+#define HOUR_RETENTION_MONTHS 24     // per-hour aggregates kept this long
+
+// Black box (see src/blackbox.h): samples around every alert, one file per alert
+#define BB_PRE_MS 10000              // before the alert ...
+#define BB_POST_MS 5000              // ... and after it
+#define BB_DIR "/bb"
+#define BB_RETENTION_DAYS 90         // event files kept this long
+
+// Power save (see src/power.h)
+#define MOTION_HOLD_MS 10000         // awake after a motion / tilt wake
+#define ALERT_HOLD_MS 60000          // BT + OLED on, no sleep, after the last alert
+#define BOOT_LINK_MS 120000          // BT up after power-on
+#define LINK_PERIOD_MS 300000        // BT up every 5 min ...
+#define LINK_WINDOW_MS 20000         // ... for 20 s so the app can connect
+
+// Alert rules (tune/calibrate in /rules.txt, syntax in src/rules.h). Written with
+// DEFAULT_RULES (src/unit_rules.h, with the signals) when the file is missing.
+#define RULES_FILE "/rules.txt"
+#define RULES_TEXT_MAX 2048
 
 // ---------- LIBS / OBJECTS ----------
 BluetoothSerial SerialBT;
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
-Adafruit_BME280 bme;
-DHT dht(PIN_DHT, DHTTYPE);
+Feature<BOARD.features.bme280, Adafruit_BME280> bme;
 RTC_DS3231 rtc;
 TinyGPSPlus gps;
 Adafruit_MPU6050 mpu;
@@ -68,14 +136,48 @@ HardwareSerial SerialSIM(1);
 HardwareSerial SerialGPS(2);
 
 // ---------- STATE ----------
-unsigned long lastDHTread = 0;
-unsigned long lastSensorReport = 0;
-unsigned long lastMQ2Alert = 0;
-unsigned long lastSoilAlert = 0;
-unsigned long lastTiltAlert = 0;
-unsigned long lastDhtAlert = 0;
+RuleEngine alertRules;
+char rulesError[64] = "";    // why RULES_FILE did not compile ("" = it did)
+float lastDhtT = NAN;        // DHT22 (cached) as the rules saw it this loop
+float lastDhtH = NAN;
+
+// Sensor health: ok / degraded / absent per device (BME280 only with the feature)
+enum HealthDevice : uint8_t { DEV_DHT, DEV_GAS, DEV_SOIL, DEV_MPU, DEV_BME };
+constexpr uint8_t DEV_COUNT = BOARD.features.bme280 ? DEV_BME + 1 : DEV_BME;
+#define SOIL_MIN_RAW 10    // lower: input floating (not wired)
+#define GAS_MIN_RAW 100
+#define MPU_ADDR 0x68
+SensorHealth health[DEV_BME + 1];
+uint8_t bmeAddr = 0x76;
+
+// Alert type -> message (types from the default rules, others: "Rule alert")
+struct AlertText { const char* type; const char* msg; };
+const AlertText ALERT_TEXTS[] = {
+  { "DHT", "Temperature/Humidity high" },
+  { "MQ2", "Smoke/Gas detected" },
+  { "SOIL", "Soil dry" },
+  { "SLIDE", "Landslide risk" },
+};
+
+// Landslide: tilt closures are counted every loop, judged every sample
+LandslideDetector landslide;
+int lastTiltLevel = HIGH;     // INPUT_PULLUP: LOW = switch closed
+uint16_t tiltEdges = 0;
 
 bool sdAvailable = false;
+bool rtcAvailable = false;
+char bootReport[224] = "{}";  // profile, boot time, memory (BT "BOARD")
+
+// Retention / rollup state
+// Channels (fixed point): dhtT x100, dhtH x100, bmeT x100, bmeH x100, bmeP x10, mq, soil
+#define AGG_CHANNELS 7
+const char* const AGG_NAMES[AGG_CHANNELS] = { "dhtT", "dhtH", "bmeT", "bmeH", "bmeP", "mq", "soil" };
+const int16_t AGG_SCALE[AGG_CHANNELS] = { 100, 100, 100, 100, 10, 1, 1 };
+HistoryAccum<AGG_CHANNELS> minuteAgg;
+HistoryAccum<AGG_CHANNELS> hourAgg;
+uint32_t minuteKey = 0;  // unixtime/60 of the open minute (0 = none yet)
+uint32_t hourKey = 0;    // unixtime/3600 of the open hour
+uint32_t sweptHour = 0;  // unixtime/3600 of the last retention sweep
 
 // Alert overlay info
 bool alertActive = false;
@@ -84,88 +186,754 @@ char alertType[32] = "";
 char alertMsg[128] = "";
 char alertExtra[128] = "";
 
+// Mesh: every unit must be flashed with the same key
+const uint8_t MESH_KEY[16] = { 'H','i','m','B','u','d','d','y','-','m','e','s','h','-','k','1' };
+
 // buffers
 char jsonBuf[512];
 char csvBuf[512];
+HeapWatch heapWatch;
+
+// ---------- DHT22 (RMT) ----------
+// The DHT library reads the 5 ms reply with interrupts off, on every
+// call. Here a read is started and left to the RMT receiver:
+//   start    pull the line low for DHT_START_US
+//   receive  arm RMT, let go; the sensor answers with ~84 pulses,
+//            RMT records them and stops after DHT_IDLE_US of idle line
+//   decode   once RMT is done (src/dht22.h), into DhtCache
+// poll() only looks at the clock and the RMT flag, so loop(), GPS UART
+// and BT keep running. At most one read per DHT_MIN_PERIOD_MS; every
+// caller gets the cached reading.
+#define DHT_RMT_SYMBOLS 64            // one RMT memory block, the reply needs ~43
+#define DHT_REPLY_TIMEOUT_US 20000    // no capture by then: no sensor
+
+class DhtRmt {
+public:
+  void begin(int p) {
+    pin = p;
+    ready = rmtInit(pin, RMT_RX_MODE, RMT_MEM_NUM_BLOCKS_1, 1000000);  // 1 us ticks
+    if (!ready) {
+      Serial.println("DHT22: RMT init failed");
+      return;
+    }
+    rmtSetRxMinThreshold(pin, 3);             // spikes < 3 us are not edges
+    rmtSetRxMaxThreshold(pin, DHT_IDLE_US);   // idle this long: reply over
+    // open drain output on top of the RMT input: the start pulse needs
+    // no pin re-config (the DHT22 module has its own pull-up)
+    gpio_set_direction((gpio_num_t)pin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_level((gpio_num_t)pin, 1);
+  }
+
+  // from loop(), never blocks
+  void poll() {
+    uint32_t ms = millis();
+    uint32_t us = micros();
+    switch (state) {
+      case IDLE:
+        if (!ready || !cache.due(ms)) return;
+        gpio_set_level((gpio_num_t)pin, 0);
+        cache.started(ms);
+        mark = us;
+        state = START;
+        return;
+      case START:
+        if (us - mark < DHT_START_US) return;
+        symbols = DHT_RMT_SYMBOLS;
+        if (!rmtReadAsync(pin, rx, &symbols)) {
+          gpio_set_level((gpio_num_t)pin, 1);
+          finish(ms, nullptr, 0);
+          return;
+        }
+        gpio_set_level((gpio_num_t)pin, 1);  // let go: the sensor answers within 40 us
+        mark = us;
+        state = RECEIVE;
+        return;
+      case RECEIVE:
+        if (rmtReceiveCompleted(pin)) {
+          uint32_t words[DHT_RMT_SYMBOLS];
+          size_t n = symbols < DHT_RMT_SYMBOLS ? symbols : DHT_RMT_SYMBOLS;
+          for (size_t i = 0; i < n; i++) words[i] = rx[i].val;
+          finish(ms, words, n);
+        } else if (us - mark > DHT_REPLY_TIMEOUT_US) {
+          // no edge ever came: the pending receive only goes with the channel
+          rmtDeinit(pin);
+          begin(pin);
+          finish(ms, nullptr, 0);
+        }
+        return;
+    }
+  }
+
+  bool busy() const { return state != IDLE; }
+  float temperature() const { return cache.temperature(millis()); }
+  float humidity() const { return cache.humidity(millis()); }
+
+  // last capture, one line as tools/dht_check.cpp --captures reads it
+  void printRaw(Print& out) const {
+    if (last.status == DHT_OK) out.printf("%s %.1f %.1f", dhtStatusName(last.status), last.temperature, last.humidity);
+    else out.printf("%s - -", dhtStatusName(last.status));
+    for (size_t i = 0; i < pulseCount; i++) out.printf(" %u:%u", (unsigned)pulses[i].level, (unsigned)pulses[i].us);
+    out.println();
+  }
+
+  DhtCache cache;
+
+private:
+  void finish(uint32_t ms, const uint32_t* words, size_t n) {
+    pulseCount = words ? dhtPulsesFromSymbols(words, n, pulses, DHT_RMT_SYMBOLS * 2) : 0;
+    last = dhtDecode(pulses, pulseCount);
+    cache.update(ms, last);
+    state = IDLE;
+  }
+
+  enum { IDLE, START, RECEIVE } state = IDLE;
+  int pin = -1;
+  bool ready = false;
+  uint32_t mark = 0;
+  rmt_data_t rx[DHT_RMT_SYMBOLS];
+  size_t symbols = 0;
+  DhtPulse pulses[DHT_RMT_SYMBOLS * 2];
+  size_t pulseCount = 0;
+  DhtReading last = { DHT_NO_REPLY, NAN, NAN, { 0, 0, 0, 0, 0 } };
+};
+
+DhtRmt dht;
 
 // ---------- HELPERS ----------
-String isoNow() {
-  if (!rtc.begin()) {
+// Writes the current time into out (ISO_TIME_LEN bytes) and returns it
+const char* isoNow(char* out) {
+  if (!rtcAvailable) {
     // fallback: millis-based approximate (not preferred)
-    unsigned long s = millis() / 1000;
-    unsigned long h = (s/3600)%24;
-    unsigned long m = (s/60)%60;
-    unsigned long sec = s%60;
-    char t[32];
-    snprintf(t, sizeof(t), "1970-01-01T%02lu:%02lu:%02lu", h, m, sec);
-    return String(t);
+    formatUptimeIso(out, millis());
+    return out;
   }
   DateTime now = rtc.now();
-  char buf[32];
-  snprintf(buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d:%02d",
-           now.year(), now.month(), now.day(), now.hour(), now.minute(), now.second());
-  return String(buf);
+  formatIsoTime(out, now.year(), now.month(), now.day(), now.hour(), now.minute(), now.second());
+  return out;
+}
+
+// ---------- SD JOURNALS ----------
+// The journal file is made once at full size (zeros); after that it is
+// only rewritten in place, block by block: no cluster allocation, no
+// FAT update, the same cost for every append (src/journal.h).
+class SdJournalStore : public JournalStore {
+public:
+  bool open(const char* path, uint32_t blocks) {
+    uint32_t bytes = blocks * JOURNAL_BLOCK_SIZE;
+    File f = SD.open(path, FILE_READ);
+    bool ready = f && f.size() == bytes;
+    if (f) f.close();
+    if (!ready) {
+      Serial.printf("%s: making %lu KB (once)\n", path, (unsigned long)(bytes / 1024));
+      f = SD.open(path, FILE_WRITE);
+      if (!f) return false;
+      static const uint8_t zeros[JOURNAL_BLOCK_SIZE] = {};
+      for (uint32_t i = 0; i < blocks; i++) {
+        if (f.write(zeros, sizeof(zeros)) != sizeof(zeros)) { f.close(); return false; }
+      }
+      f.close();
+    }
+    file = SD.open(path, "r+");
+    return file;
+  }
+  bool read(uint32_t offset, uint8_t* buf, size_t len) override {
+    return file.seek(offset) && file.read(buf, len) == len;
+  }
+  bool write(uint32_t offset, const uint8_t* buf, size_t len) override {
+    return file.seek(offset) && file.write(buf, len) == len;
+  }
+  bool sync() override {
+    file.flush();
+    return true;
+  }
+private:
+  File file;
+};
+
+enum { JOURNAL_ALERT = 1, JOURNAL_SNAPSHOT = 2 };  // record kinds
+SdJournalStore alertStore, rawStore;
+Journal alertJournal, rawJournal;
+bool journalsOpen = false;
+JournalBlock journalScratch;  // for reading a journal back (BT GET_*)
+
+void openJournals() {
+  journalsOpen = alertStore.open(ALERT_JOURNAL, ALERT_JOURNAL_BLOCKS) &&
+                 rawStore.open(RAW_JOURNAL, RAW_JOURNAL_BLOCKS) &&
+                 alertJournal.begin(alertStore, ALERT_JOURNAL_BLOCKS) &&
+                 rawJournal.begin(rawStore, RAW_JOURNAL_BLOCKS);
+  if (!journalsOpen) {
+    Serial.println("SD journals failed");
+    return;
+  }
+  Serial.printf("journals: %lu alerts, %lu rows (%lu + %lu block reads)\n",
+                (unsigned long)alertJournal.nextSeq(), (unsigned long)rawJournal.nextSeq(),
+                (unsigned long)alertJournal.recoveryReads(), (unsigned long)rawJournal.recoveryReads());
 }
 
 void sdLogAlert(const char* type, const char* msg, const char* extra, const char* payloadJSON) {
-  if (!sdAvailable) return;
-  File f = SD.open("/alerts.log", FILE_APPEND);
-  if (!f) return;
+  if (!journalsOpen) return;
   // write payloadJSON if provided, else compose small JSON
   if (payloadJSON && strlen(payloadJSON) > 0) {
-    f.println(payloadJSON);
+    alertJournal.append(JOURNAL_ALERT, payloadJSON, strlen(payloadJSON));
   } else {
     char line[512];
-    snprintf(line, sizeof(line), "{\"time\":\"%s\",\"type\":\"%s\",\"msg\":\"%s\",\"extra\":\"%s\"}",
-             isoNow().c_str(), type, msg, extra ? extra : "");
-    f.println(line);
+    char ts[ISO_TIME_LEN];
+    int n = snprintf(line, sizeof(line), "{\"time\":\"%s\",\"type\":\"%s\",\"msg\":\"%s\",\"extra\":\"%s\"}",
+                     isoNow(ts), type, msg, extra ? extra : "");
+    alertJournal.append(JOURNAL_ALERT, line, n);
+  }
+}
+
+// ---------- SD RETENTION ----------
+// Raw rows go to the raw journal, which keeps the newest RAW_JOURNAL_BLOCKS
+// worth. Minute and hour aggregates are built in RAM while logging and
+// appended when the bucket closes, so a raw row is already rolled up by
+// the time the ring overwrites it. Long range queries read /hour or /min
+// (KB, not MB); old aggregate files are deleted once an hour.
+const char* SENSLOG_HEADER = "time,dhtT,dhtH,bmeT,bmeH,bmeP,mqRaw,soilRaw,gpsLat,gpsLng";
+
+// Without an RTC: seconds since boot. No calendar date (RTClib counts
+// from 2000, so a small unixtime wraps to ~2106): good for intervals
+// and black box names only; the dated /min and /hour files need the RTC.
+DateTime clockNow() {
+  if (rtcAvailable) return rtc.now();
+  return DateTime((uint32_t)(millis() / 1000));
+}
+
+// Appends a line, writing the header first if the file is new
+void sdAppendWithHeader(const char* path, const char* header, const char* line) {
+  bool fresh = !SD.exists(path);
+  File f = SD.open(path, FILE_APPEND);
+  if (!f) return;
+  if (fresh) f.println(header);
+  f.println(line);
+  f.close();
+}
+
+// Deletes files in dir whose name sorts before cutoff (same name format)
+void sweepOldFiles(const char* dir, const char* cutoff) {
+  char victims[8][32];
+  uint8_t n;
+  do {
+    n = 0;
+    File d = SD.open(dir);
+    if (!d) return;
+    File f = d.openNextFile();
+    while (f && n < 8) {
+      const char* name = f.name();
+      if (!f.isDirectory() && strlen(name) == strlen(cutoff) && strcmp(name, cutoff) < 0) {
+        snprintf(victims[n++], sizeof(victims[0]), "%s/%s", dir, name);
+      }
+      f.close();
+      f = d.openNextFile();
+    }
+    d.close();
+    for (uint8_t i = 0; i < n; i++) SD.remove(victims[i]);
+  } while (n == sizeof(victims) / sizeof(victims[0]));
+}
+
+void sweepRetention(const DateTime& now) {
+  char cutoff[24];
+  if (rtcAvailable) {  // the fallback clock has no date: every file would look expired
+    DateTime minEdge(now.unixtime() - (uint32_t)MIN_RETENTION_DAYS * 86400UL);
+    snprintf(cutoff, sizeof(cutoff), "%04d%02d%02d.csv", minEdge.year(), minEdge.month(), minEdge.day());
+    sweepOldFiles("/min", cutoff);
+
+    int months = now.year() * 12 + (now.month() - 1) - HOUR_RETENTION_MONTHS;
+    snprintf(cutoff, sizeof(cutoff), "%04d%02d.csv", months / 12, months % 12 + 1);
+    sweepOldFiles("/hour", cutoff);
+  }
+
+  if (now.unixtime() > BB_RETENTION_DAYS * 86400UL) {  // not on the 1970 fallback clock
+    snprintf(cutoff, sizeof(cutoff), "%08lX.hbb", (unsigned long)(now.unixtime() - BB_RETENTION_DAYS * 86400UL));
+    sweepOldFiles(BB_DIR, cutoff);
+  }
+}
+
+void sdLogSensorSnapshot(const DateTime& now, const char* snapshotCsvLine) {
+  if (!sdAvailable) return;
+  if (now.unixtime() / 3600 != sweptHour) {
+    // new hour (or first write after boot): drop what expired
+    sweptHour = now.unixtime() / 3600;
+    sweepRetention(now);
+  }
+  if (journalsOpen) rawJournal.append(JOURNAL_SNAPSHOT, snapshotCsvLine, strlen(snapshotCsvLine));
+}
+
+// GET_RAW YYYYMMDDHH: the rows of that hour still in the raw journal.
+// Rows are in time order, so the hour is found by binary search on the
+// block headers and reading stops after it: ~13 block reads + the hour,
+// not the whole ring, on the loop task. (Rows from a boot without RTC
+// are dated 1970 and break the order; they can hide rows from this.)
+void sendRawHour(const char* hour) {
+  char prefix[16];  // rows start with "YYYY-MM-DDTHH
+  if (strlen(hour) != 10 || !journalsOpen) {
+    SerialBT.printf("{\"error\":\"no raw rows for %s\"}\n", hour);
+    return;
   }
+  snprintf(prefix, sizeof(prefix), "\"%.4s-%.2s-%.2sT%.2s", hour, hour + 4, hour + 6, hour + 8);
+  size_t plen = strlen(prefix);
+  // <0: the row is before the hour, 0: in it, >0: after it
+  auto order = [&](const char* data, uint16_t len) {
+    int c = memcmp(data, prefix, len < plen ? len : plen);
+    return c ? c : (len < plen ? -1 : 0);
+  };
+  uint32_t from = rawJournal.seek(journalScratch, [&](const char* data, uint16_t len) { return order(data, len) < 0; });
+  SerialBT.println(SENSLOG_HEADER);
+  rawJournal.forEachFrom(journalScratch, from, [&](uint32_t seq, uint16_t kind, const char* data, uint16_t len) {
+    int c = order(data, len);
+    if (c > 0) return false;
+    if (c == 0) {
+      SerialBT.write((const uint8_t*)data, len);
+      SerialBT.write('\n');
+    }
+    return true;
+  });
+}
+
+// Fixed point -> text, eg. 2345 with scale 100 -> "23.45"
+void fmtFixed(char* out, size_t len, int32_t v, int16_t scale) {
+  if (scale == 1) { snprintf(out, len, "%ld", (long)v); return; }
+  const char* sign = (v < 0) ? "-" : "";
+  int32_t a = (v < 0) ? -v : v;
+  snprintf(out, len, (scale == 100) ? "%s%ld.%02ld" : "%s%ld.%01ld", sign, (long)(a / scale), (long)(a % scale));
+}
+
+// One aggregate row: time,<ch>_min,<ch>_max,<ch>_mean,<ch>_n,...
+void sdLogAggregate(const char* path, uint32_t bucketStart, const HistoryAccum<AGG_CHANNELS>& acc) {
+  if (!sdAvailable) return;
+  static char header[384];
+  if (!header[0]) {
+    size_t h = snprintf(header, sizeof(header), "time");
+    for (uint8_t c = 0; c < AGG_CHANNELS; c++) {
+      h += snprintf(header + h, sizeof(header) - h, ",%s_min,%s_max,%s_mean,%s_n",
+                    AGG_NAMES[c], AGG_NAMES[c], AGG_NAMES[c], AGG_NAMES[c]);
+    }
+  }
+  DateTime t(bucketStart);
+  char line[320];
+  size_t n = snprintf(line, sizeof(line), "\"%04d-%02d-%02dT%02d:%02d:00\"",
+                      t.year(), t.month(), t.day(), t.hour(), t.minute());
+  HistoryRollup<AGG_CHANNELS> r = acc.result();
+  for (uint8_t c = 0; c < AGG_CHANNELS; c++) {
+    if (acc.count(c) == 0) { n += snprintf(line + n, sizeof(line) - n, ",,,,0"); continue; }
+    char lo[16], hi[16], avg[16];
+    fmtFixed(lo, sizeof(lo), r.lo[c], AGG_SCALE[c]);
+    fmtFixed(hi, sizeof(hi), r.hi[c], AGG_SCALE[c]);
+    fmtFixed(avg, sizeof(avg), r.avg[c], AGG_SCALE[c]);
+    n += snprintf(line + n, sizeof(line) - n, ",%s,%s,%s,%u", lo, hi, avg, (unsigned)acc.count(c));
+  }
+  sdAppendWithHeader(path, header, line);
+}
+
+// Folds one snapshot into the open minute/hour, closing buckets on rollover
+// (not without the RTC: the files are named by date)
+void rollupSnapshot(const DateTime& now, const HistoryPoint<AGG_CHANNELS>& p) {
+  if (!rtcAvailable) return;
+  uint32_t t = now.unixtime();
+  char path[24];
+  if (minuteKey != 0 && t / 60 != minuteKey) {
+    DateTime b(minuteKey * 60);
+    snprintf(path, sizeof(path), "/min/%04d%02d%02d.csv", b.year(), b.month(), b.day());
+    sdLogAggregate(path, minuteKey * 60, minuteAgg);
+    minuteAgg.reset();
+  }
+  if (hourKey != 0 && t / 3600 != hourKey) {
+    DateTime b(hourKey * 3600);
+    snprintf(path, sizeof(path), "/hour/%04d%02d.csv", b.year(), b.month());
+    sdLogAggregate(path, hourKey * 3600, hourAgg);
+    hourAgg.reset();
+  }
+  minuteKey = t / 60;
+  hourKey = t / 3600;
+  minuteAgg.add(p);
+  hourAgg.add(p);
+}
+
+int16_t toFixed(float v, int16_t scale) {
+  if (isnan(v)) return HISTORY_NO_DATA;
+  long f = lroundf(v * scale);
+  return (int16_t)constrain(f, -32767L, 32767L); // garbage from a missing sensor must not wrap
+}
+
+// Streams a file from SD to the BT client (used by GET_* commands)
+void sendSdFile(const char* path) {
+  File f = SD.open(path, FILE_READ);
+  if (!f) {
+    SerialBT.printf("{\"error\":\"no file %s\"}\n", path);
+    return;
+  }
+  uint8_t buf[256];
+  size_t n;
+  while ((n = f.read(buf, sizeof(buf))) > 0) SerialBT.write(buf, n);
   f.close();
 }
 
-void sdLogSensorSnapshot(const char* snapshotCsvLine) {
+// ---------- BLACK BOX ----------
+// fast = MQ-2, soil raw on every loop pass (~100 Hz awake, nothing
+// while asleep: a gap), slow = DHT / BME every scheduled sample.
+// A frozen event is written to BB_DIR 512 bytes per loop pass, then
+// released. Without a card it stays in RAM (BT "GET_EVENT") until the
+// next alert replaces it. An absent sensor is HISTORY_NO_DATA.
+Blackbox<2, 1024, 1600, 4, 8> blackbox;
+File bbFile;
+size_t bbWritten = 0;
+
+void pollBlackbox() {
+  if (blackbox.poll(millis())) {
+    Serial.printf("Black box: event %lu, %u bytes\n", (unsigned long)blackbox.header().id,
+                  (unsigned)blackbox.eventBytes());
+    if (!sdAvailable) return;  // kept in RAM
+    char path[24];
+    snprintf(path, sizeof(path), BB_DIR "/%08lX.hbb", (unsigned long)clockNow().unixtime());
+    bbFile = SD.open(path, FILE_WRITE);
+    bbWritten = 0;
+    if (!bbFile) {
+      Serial.printf("Black box: cannot write %s\n", path);
+      blackbox.release();
+      return;
+    }
+  }
+  if (blackbox.state() != BB_FROZEN || !bbFile) return;
+  uint8_t buf[512];
+  size_t n = blackbox.readEvent(bbWritten, buf, sizeof(buf));
+  if (n > 0 && bbFile.write(buf, n) == n) bbWritten += n;
+  else n = 0;  // card full / pulled: give up on this one
+  if (n == sizeof(buf)) return;
+  bbFile.close();
+  blackbox.release();
+}
+
+// EVENTS: recorder state, then one line per event file
+void sendEventList() {
+  char out[192];
+  blackbox.json(out, sizeof(out));
+  SerialBT.println(out);
   if (!sdAvailable) return;
-  File f = SD.open("/senslog.csv", FILE_APPEND);
-  if (!f) return;
-  f.println(snapshotCsvLine);
+  File d = SD.open(BB_DIR);
+  if (!d) return;
+  File f = d.openNextFile();
+  while (f) {
+    if (!f.isDirectory()) SerialBT.printf("{\"event\":\"%s\",\"bytes\":%lu}\n", f.name(), (unsigned long)f.size());
+    f.close();
+    f = d.openNextFile();
+  }
+  d.close();
+}
+
+// GET_EVENT name: {"event":name,"bytes":N} line, then the N bytes of the
+// file; no name: the event in RAM (units without a card)
+void sendEvent(const char* name) {
+  if (!*name) {
+    if (blackbox.state() != BB_FROZEN || bbFile) {
+      SerialBT.println("{\"error\":\"no event in RAM\"}");
+      return;
+    }
+    size_t size = blackbox.eventBytes();
+    SerialBT.printf("{\"event\":\"ram\",\"bytes\":%u}\n", (unsigned)size);
+    uint8_t buf[256];
+    for (size_t at = 0; at < size; at += sizeof(buf)) {
+      SerialBT.write(buf, blackbox.readEvent(at, buf, sizeof(buf)));
+    }
+    return;
+  }
+  char path[40];
+  snprintf(path, sizeof(path), BB_DIR "/%s", name);
+  File f;
+  if (sdAvailable && !strchr(name, '/')) f = SD.open(path, FILE_READ);
+  if (!f) {
+    SerialBT.printf("{\"error\":\"no event %s\"}\n", name);
+    return;
+  }
+  SerialBT.printf("{\"event\":\"%s\",\"bytes\":%lu}\n", name, (unsigned long)f.size());
+  uint8_t buf[256];
+  size_t n;
+  while ((n = f.read(buf, sizeof(buf))) > 0) SerialBT.write(buf, n);
   f.close();
 }
 
 void sendBluetoothAlert(const char* type, const char* msg, const char* extra,
                         float dhtT, float dhtH, float bmeT, float bmeH, float bmeP,
                         int mqRaw, int soilRaw, double gpsLat, double gpsLng) {
-  // Compose JSON line (simple, line-based)
-  // Example: {"type":"TILT","msg":"Tilt detected","time":"...","extra":"x","dhtT":..,"dhtH":..,"bmeT":..,"bmeH":..,"bmeP":..,"mq":..,"soil":..,"gps":"lat,lng"}
-  char gpsField[64] = "";
-  if (gpsLat != 0.0 || gpsLng != 0.0) {
-    snprintf(gpsField, sizeof(gpsField), ",\"gps\":\"%.6f,%.6f\"", gpsLat, gpsLng);
-  }
-  snprintf(jsonBuf, sizeof(jsonBuf),
-           "{\"type\":\"%s\",\"msg\":\"%s\",\"time\":\"%s\",\"extra\":\"%s\",\"dhtT\":%.2f,\"dhtH\":%.2f,\"bmeT\":%.2f,\"bmeH\":%.2f,\"bmeP\":%.2f,\"mq\":%d,\"soil\":%d%s}",
-           type, msg, isoNow().c_str(), extra ? extra : "",
-           isnan(dhtT) ? 0.0 : dhtT, isnan(dhtH) ? 0.0 : dhtH,
-           isnan(bmeT) ? 0.0 : bmeT, isnan(bmeH) ? 0.0 : bmeH, isnan(bmeP) ? 0.0 : bmeP,
-           mqRaw, soilRaw, gpsField);
+  // Compose JSON line (simple, line-based, src/log_format.h)
+  // Example: {"type":"SLIDE","msg":"Landslide risk","time":"...","extra":"x","dhtT":..,"dhtH":..,"bmeT":..,"bmeH":..,"bmeP":..,"mq":..,"soil":..,"gps":"lat,lng"}
+  char ts[ISO_TIME_LEN];
+  formatAlertJson(jsonBuf, sizeof(jsonBuf), type, msg, isoNow(ts), extra, dhtT, dhtH, bmeT, bmeH, bmeP,
+                  mqRaw, soilRaw, gpsLat, gpsLng);
   // Send
   SerialBT.println(jsonBuf);
-  Serial.println("[ALERT_SENT] " + String(jsonBuf));
+  Serial.print("[ALERT_SENT] ");
+  Serial.println(jsonBuf);
   // SD log
   sdLogAlert(type, msg, extra, jsonBuf);
 }
 
+// ---------- POWER ----------
+// A sleeping unit hears the mesh only while awake: units that relay
+// for others should be on mains/solar, in a profile with powerSave off.
+// GPS bytes that arrive during sleep are lost; the last fix is kept.
+const PowerConfig POWER_CONFIG = { SENSOR_REPORT_INTERVAL_MS, MOTION_HOLD_MS, ALERT_HOLD_MS,
+                                   BOOT_LINK_MS, LINK_PERIOD_MS, LINK_WINDOW_MS, 20 };
+PowerPolicy power;
+EnergyMeter energy;
+PowerState powerState = POWER_LINK;
+bool btUp = false;
+bool oledOn = true;
+unsigned long powerMark = 0;   // energy counted up to here
+
+void setBluetooth(bool on) {
+  if (on == btUp) return;
+  if (on) SerialBT.begin("ESP32_MONITOR");
+  else SerialBT.end();
+  btUp = on;
+}
+
+void setOled(bool on) {
+  if (on == oledOn) return;
+  display.ssd1306_command(on ? SSD1306_DISPLAYON : SSD1306_DISPLAYOFF);
+  oledOn = on;
+}
+
+// Count the awake time since the last mark with the rails as they are
+void powerAccount() {
+  unsigned long now = millis();
+  energy.add(now - powerMark, true, BOARD.features.mesh, btUp, oledOn);
+  powerMark = now;
+}
+
+// Switch BT / OLED for the current state
+void powerApply() {
+  if constexpr (!BOARD.features.powerSave) return;
+  powerAccount();
+  powerState = power.state(millis());
+  bool on = (powerState == POWER_LINK || powerState == POWER_ALERT);
+  setBluetooth(on);
+  setOled(on);
+}
+
+// MPU6050 INT is latched: reading the status clears it
+void checkMotion() {
+  if (digitalRead(PIN_MPU_INT) == HIGH) {
+    mpu.getMotionInterruptStatus();
+    power.onMotion(millis());
+  }
+}
+
+// End of loop(): light sleep until the next sample or BT window,
+// or until the tilt switch / MPU6050 wakes us
+void powerSleep() {
+  power.setBtClient(btUp && SerialBT.hasClient());
+  powerApply();
+  if (dht.busy()) {
+    delay(1); // DHT22 read in flight (a few ms): RMT stops in light sleep
+    return;
+  }
+  uint32_t ms = power.sleepMs(millis());
+  if (ms == 0) {
+    delay(10);
+    return;
+  }
+
+  // a wake pin that is already active would wake us at once: leave it to the timer
+  bool tiltWake = digitalRead(PIN_TILT) == HIGH;
+  bool mpuWake = digitalRead(PIN_MPU_INT) == LOW;
+  if (tiltWake) gpio_wakeup_enable((gpio_num_t)PIN_TILT, GPIO_INTR_LOW_LEVEL);
+  if (mpuWake) gpio_wakeup_enable((gpio_num_t)PIN_MPU_INT, GPIO_INTR_HIGH_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000ULL);
+  Serial.flush();
+  if constexpr (BOARD.features.mesh) esp_wifi_stop(); // RF is off in light sleep anyway
+
+  unsigned long t0 = millis();
+  esp_light_sleep_start();
+  unsigned long slept = millis() - t0;
+
+  if constexpr (BOARD.features.mesh) {
+    esp_wifi_start();
+    esp_wifi_set_channel(MESH_CHANNEL, WIFI_SECOND_CHAN_NONE);
+  }
+  if (tiltWake) gpio_wakeup_disable((gpio_num_t)PIN_TILT);
+  if (mpuWake) gpio_wakeup_disable((gpio_num_t)PIN_MPU_INT);
+  energy.add(slept, false, false, false, false);
+  energy.addWakeup();
+  powerMark = millis();
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO) {
+    power.onMotion(millis());
+    // woken by the tilt switch: count it even if it opened again already
+    if (tiltWake && digitalRead(PIN_MPU_INT) == LOW) {
+      tiltEdges++;
+      lastTiltLevel = LOW;
+    }
+  }
+}
+
+// ---------- ALERT MESH (ESP-NOW) ----------
+// Radio callbacks only queue events; meshTask owns the AlertMesh
+// object, relays at once and sounds the buzzer, then loop() shows,
+// sends and logs the remote alert like a local one.
+class EspNowTransport : public MeshTransport {
+public:
+  bool broadcast(const uint8_t* data, size_t len) override {
+    static const uint8_t all[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    return esp_now_send(all, data, len) == ESP_OK;
+  }
+  bool unicast(const MeshAddr& to, const uint8_t* data, size_t len) override {
+    if (!esp_now_is_peer_exist(to.b)) {
+      esp_now_peer_info_t peer = {};
+      memcpy(peer.peer_addr, to.b, 6);
+      peer.channel = 0; // current channel
+      peer.encrypt = false;
+      if (esp_now_add_peer(&peer) != ESP_OK) return false;
+    }
+    return esp_now_send(to.b, data, len) == ESP_OK;
+  }
+};
+
+enum { MESH_EV_RX, MESH_EV_SENT_OK, MESH_EV_SENT_FAIL, MESH_EV_ORIGINATE };
+
+struct MeshEvent {
+  uint8_t op;
+  int8_t rssi;
+  uint8_t len;
+  MeshAddr addr;
+  uint8_t data[sizeof(MeshFrame)];
+};
+
+EspNowTransport meshRadio;
+AlertMesh mesh(meshRadio);
+QueueHandle_t meshQueue = NULL;
+
+// Remote alert handed from meshTask to loop()
+portMUX_TYPE meshMux = portMUX_INITIALIZER_UNLOCKED;
+volatile bool meshAlertPending = false;
+MeshFrame meshAlertFrame;
+
+// Wi-Fi task context: copy and leave
+void onEspNowRecv(const esp_now_recv_info_t* info, const uint8_t* data, int len) {
+  if (len != sizeof(MeshFrame) || meshQueue == NULL) return;
+  MeshEvent ev;
+  ev.op = MESH_EV_RX;
+  ev.rssi = (int8_t)info->rx_ctrl->rssi;
+  ev.len = (uint8_t)len;
+  memcpy(ev.addr.b, info->src_addr, 6);
+  memcpy(ev.data, data, len);
+  xQueueSend(meshQueue, &ev, 0);
+}
+
+void onEspNowSent(const uint8_t* mac, esp_now_send_status_t status) {
+  if (meshQueue == NULL || mac[0] == 0xFF) return; // broadcasts have no ACK
+  MeshEvent ev;
+  ev.op = (status == ESP_NOW_SEND_SUCCESS) ? MESH_EV_SENT_OK : MESH_EV_SENT_FAIL;
+  memcpy(ev.addr.b, mac, 6);
+  xQueueSend(meshQueue, &ev, 0);
+}
+
+// meshTask context: new alert from another unit
+void onMeshAlert(const MeshFrame& f, const MeshAddr& from, void* ctx) {
+  if (f.kind != MESH_ALERT_CLEAR) digitalWrite(PIN_BUZZER, HIGH); // sound now, loop() beeps it off
+  portENTER_CRITICAL(&meshMux);
+  meshAlertFrame = f;
+  meshAlertPending = true;
+  portEXIT_CRITICAL(&meshMux);
+}
+
+void meshTask(void* arg) {
+  MeshEvent ev;
+  uint32_t wait = 50;
+  for (;;) {
+    if (xQueueReceive(meshQueue, &ev, pdMS_TO_TICKS(wait)) == pdTRUE) {
+      uint32_t now = millis();
+      if (ev.op == MESH_EV_RX) mesh.onReceive(ev.addr, ev.rssi, ev.data, ev.len, now);
+      else if (ev.op == MESH_EV_SENT_OK) mesh.onSendResult(ev.addr, true);
+      else if (ev.op == MESH_EV_SENT_FAIL) mesh.onSendResult(ev.addr, false);
+      else if (ev.op == MESH_EV_ORIGINATE) {
+        int16_t value;
+        memcpy(&value, ev.data + 1, sizeof(value));
+        mesh.originate(ev.data[0], 3, value, now);
+      }
+    }
+    wait = mesh.poll(millis());
+    if (wait == 0) wait = 1;
+    if (wait > 50) wait = 50;
+  }
+}
+
+void setupMesh() {
+  WiFi.mode(WIFI_STA);
+  esp_wifi_set_channel(MESH_CHANNEL, WIFI_SECOND_CHAN_NONE);
+  if (esp_now_init() != ESP_OK) {
+    Serial.println("ESP-NOW init fail, mesh off");
+    return;
+  }
+  esp_now_peer_info_t all = {};
+  memset(all.peer_addr, 0xFF, 6);
+  all.channel = 0;
+  all.encrypt = false;
+  esp_now_add_peer(&all);
+  esp_now_register_recv_cb(onEspNowRecv);
+  esp_now_register_send_cb(onEspNowSent);
+
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  uint32_t nodeId = ((uint32_t)mac[2] << 24) | ((uint32_t)mac[3] << 16) | ((uint32_t)mac[4] << 8) | mac[5];
+  // boot count in NVS: receivers tell this boot (seq from 0 again) from
+  // frames of an earlier one played back
+  Preferences meshPrefs;
+  meshPrefs.begin("mesh", false);
+  uint32_t boot = meshPrefs.getUInt("boot", 0) + 1;
+  meshPrefs.putUInt("boot", boot);
+  meshPrefs.end();
+  mesh.begin(nodeId, MESH_KEY, boot);
+  mesh.onAlert(onMeshAlert, NULL);
+
+  meshQueue = xQueueCreate(16, sizeof(MeshEvent));
+  // above loop() priority, so relaying never waits for a sensor read
+  xTaskCreatePinnedToCore(meshTask, "mesh", 4096, NULL, 3, NULL, 1);
+  Serial.printf("Mesh node %08lX on channel %d\n", (unsigned long)nodeId, MESH_CHANNEL);
+}
+
+// Local alert -> other units (called from triggerAlert)
+void meshSendAlert(const char* type, int16_t value) {
+  if constexpr (!BOARD.features.mesh) return;
+  if (meshQueue == NULL) return;
+  uint8_t kind = MESH_ALERT_TEST;
+  if (strcmp(type, "MQ2") == 0) kind = MESH_ALERT_SMOKE;
+  else if (strcmp(type, "SLIDE") == 0) kind = MESH_ALERT_LANDSLIDE;
+  else if (strcmp(type, "SOIL") == 0) kind = MESH_ALERT_SOIL;
+  else if (strcmp(type, "DHT") == 0) kind = MESH_ALERT_HEAT;
+  MeshEvent ev;
+  ev.op = MESH_EV_ORIGINATE;
+  ev.data[0] = kind;
+  memcpy(ev.data + 1, &value, sizeof(value));
+  xQueueSend(meshQueue, &ev, 0);
+}
+
 void triggerAlert(const char* type, const char* msg, const char* extra,
                   float dhtT=NAN, float dhtH=NAN, float bmeT=NAN, float bmeH=NAN, float bmeP=NAN,
                   int mqRaw=0, int soilRaw=0, double gpsLat=0.0, double gpsLng=0.0) {
+  // black box: 10 s before this alert + 5 s after (no card: the last event is replaced)
+  if (!sdAvailable) blackbox.release();
+  blackbox.trigger(millis(), type);
   // set overlay
   alertActive = true;
   alertSince = millis();
   strncpy(alertType, type, sizeof(alertType)-1);
   strncpy(alertMsg, msg, sizeof(alertMsg)-1);
   if (extra) strncpy(alertExtra, extra, sizeof(alertExtra)-1); else alertExtra[0]=0;
+  // tell the other units first (remote alerts arrive as type "MESH" and are not sent back)
+  if (strcmp(type, "MESH") != 0) {
+    int16_t value = (strcmp(type, "SOIL") == 0) ? soilRaw
+                  : (strcmp(type, "SLIDE") == 0) ? (int16_t)landslide.level()
+                  : (strcmp(type, "DHT") == 0 && !isnan(dhtT)) ? (int16_t)(dhtT * 10) : mqRaw;
+    meshSendAlert(type, value);
+  }
   // beep
   digitalWrite(PIN_BUZZER, HIGH);
   delay(120);
   digitalWrite(PIN_BUZZER, LOW);
+  // stay awake with BT + OLED on (after mesh + buzzer: BT start takes a while)
+  power.onAlert(millis());
+  powerApply();
   // send to app and log on SD
   sendBluetoothAlert(type, msg, extra, dhtT, dhtH, bmeT, bmeH, bmeP, mqRaw, soilRaw, gpsLat, gpsLng);
 }
@@ -183,6 +951,80 @@ void drawAlertOverlay() {
   display.setTextColor(SSD1306_WHITE); // restore
 }
 
+// ---------- ALERT RULES ----------
+// Reads RULES_FILE (writes the defaults first if it is missing) and
+// compiles it. A file that does not compile keeps the old rules, or
+// the defaults at boot.
+void loadRules() {
+  static char text[RULES_TEXT_MAX];
+  size_t n = 0;
+  if (sdAvailable) {
+    if (!SD.exists(RULES_FILE)) {
+      File f = SD.open(RULES_FILE, FILE_WRITE);
+      if (f) { f.print(DEFAULT_RULES); f.close(); }
+    }
+    File f = SD.open(RULES_FILE);
+    if (f) { n = f.read((uint8_t*)text, sizeof(text) - 1); f.close(); }
+  }
+  text[n] = 0;
+  if (n == 0) snprintf(rulesError, sizeof(rulesError), "%s missing or empty", RULES_FILE);
+  if (n > 0 && alertRules.compile(text, RULE_SIGNAL_NAMES, SIG_COUNT, rulesError, sizeof(rulesError))) {
+    Serial.printf("%u rules from %s\n", alertRules.count(), RULES_FILE);
+    return;
+  }
+  Serial.printf("%s: %s\n", RULES_FILE, rulesError);
+  if (alertRules.count() == 0) alertRules.compile(DEFAULT_RULES, RULE_SIGNAL_NAMES, SIG_COUNT, NULL, 0);
+}
+
+const char* alertMessage(const char* type) {
+  for (const AlertText& a : ALERT_TEXTS) if (strcmp(a.type, type) == 0) return a.msg;
+  return "Rule alert";
+}
+
+// ---------- SENSOR HEALTH ----------
+// An I2C device answers its address (missing: one NACKed byte)
+bool i2cPresent(uint8_t addr) {
+  Wire.beginTransmission(addr);
+  return Wire.endTransmission() == 0;
+}
+
+// At boot, and when a probe finds the MPU6050 again (settings are lost with the plug)
+bool mpuBegin() {
+  if (!mpu.begin(MPU_ADDR)) return false;
+  // motion interrupt on INT, latched until read (wakes from light sleep)
+  mpu.setHighPassFilter(MPU6050_HIGHPASS_0_63_HZ);
+  mpu.setMotionDetectionThreshold(2);
+  mpu.setMotionDetectionDuration(20);
+  mpu.setInterruptPinLatch(true);
+  mpu.setInterruptPinPolarity(false); // active high
+  mpu.setMotionInterrupt(true);
+  return true;
+}
+
+bool bmeBegin() {
+  if constexpr (BOARD.features.bme280) {
+    for (uint8_t addr : { 0x76, 0x77 }) {
+      if (bme->begin(addr)) {
+        bmeAddr = addr;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// DHT22: start / finish a background read; when one finishes its
+// status goes to the health (no reply = missing)
+void pollDht() {
+  uint32_t now = millis();
+  bool wasBusy = dht.busy();
+  if (!wasBusy && !health[DEV_DHT].due(now)) return;
+  dht.poll();
+  if (!wasBusy || dht.busy()) return;
+  uint8_t st = dht.cache.lastStatus();
+  health[DEV_DHT].report(st == DHT_OK ? READ_OK : (st == DHT_NO_REPLY ? READ_MISSING : READ_BAD), now);
+}
+
 // ---------- SETUP ----------
 void setup() {
   Serial.begin(115200);
@@ -193,7 +1035,7 @@ void setup() {
   pinMode(PIN_BUZZER, OUTPUT);
   digitalWrite(PIN_BUZZER, LOW);
 
-  Wire.begin(21, 22); // SDA, SCL
+  Wire.begin(BOARD.pins.i2cSda, BOARD.pins.i2cScl);
 
   if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) {
     Serial.println("OLED init fail");
@@ -206,20 +1048,28 @@ void setup() {
     display.display();
   }
 
-  if (!bme.begin(0x76)) {
-    Serial.println("BME280 not found at 0x76; trying 0x77...");
-    bme.begin(0x77);
+  // not found: ABSENT, probed again with backoff (sensor health)
+  uint32_t bootMs = millis();
+  if constexpr (BOARD.features.bme280) {
+    bool found = bmeBegin();
+    if (!found) Serial.println("BME280 not found at 0x76 / 0x77");
+    health[DEV_BME].begin("bme", HEALTH_BUS, found, bootMs);
   }
 
-  if (!mpu.begin()) {
-    Serial.println("MPU6050 not found");
-  }
+  bool mpuFound = mpuBegin();
+  if (!mpuFound) Serial.println("MPU6050 not found");
+  health[DEV_MPU].begin("mpu", HEALTH_BUS, mpuFound, bootMs);
+  pinMode(PIN_MPU_INT, INPUT_PULLDOWN); // stays LOW without an MPU
 
-  dht.begin();
+  dht.begin(PIN_DHT);
+  health[DEV_DHT].begin("dht", HEALTH_BUS, true, bootMs);
+  health[DEV_GAS].begin("gas", HEALTH_ANALOG, true, bootMs);
+  health[DEV_SOIL].begin("soil", HEALTH_ANALOG, true, bootMs);
 
   if (!rtc.begin()) {
     Serial.println("RTC not found");
   } else {
+    rtcAvailable = true;
     if (rtc.lostPower()) {
       rtc.adjust(DateTime(F(__DATE__), F(__TIME__)));
     }
@@ -228,26 +1078,26 @@ void setup() {
   if (SD.begin(SD_CS)) {
     sdAvailable = true;
     Serial.println("SD mounted");
-    // ensure senslog header exists
-    File fh = SD.open("/senslog.csv", FILE_READ);
-    if (!fh) {
-      File f = SD.open("/senslog.csv", FILE_WRITE);
-      if (f) {
-        f.println("time,dhtT,dhtH,bmeT,bmeH,bmeP,mqRaw,soilRaw,gpsLat,gpsLng");
-        f.close();
-      }
-    } else fh.close();
+    // aggregate tiers (headers are written when each file is created)
+    SD.mkdir("/min");
+    SD.mkdir("/hour");
+    SD.mkdir(BB_DIR);
+    openJournals();
   } else {
     sdAvailable = false;
     Serial.println("SD mount failed");
   }
+  loadRules();
 
   // Serial ports
   SerialGPS.begin(9600, SERIAL_8N1, GPS_RX_PIN, GPS_TX_PIN);
-  if (ENABLE_SIM800L) SerialSIM.begin(9600, SERIAL_8N1, SIM800_RX_PIN, SIM800_TX_PIN);
+  if constexpr (BOARD.features.modem) SerialSIM.begin(9600, SERIAL_8N1, SIM800_RX_PIN, SIM800_TX_PIN);
+
+  // Alert mesh (Wi-Fi STA + ESP-NOW, runs next to BT)
+  if constexpr (BOARD.features.mesh) setupMesh();
 
   // Bluetooth
-  SerialBT.begin("ESP32_MONITOR");
+  setBluetooth(true);
   Serial.println("BT started: ESP32_MONITOR");
 
   display.clearDisplay();
@@ -255,106 +1105,183 @@ void setup() {
   display.println("ESP32 Monitor Ready");
   display.display();
   delay(800);
+
+  power.begin(POWER_CONFIG, millis());
+  powerMark = millis();
+  heapWatch.begin(millis());
+  landslide.begin(LANDSLIDE_CONFIG_DEFAULT, millis());
+  blackbox.begin(BB_PRE_MS, BB_POST_MS, "mq,soil;dhtT,dhtH,bmeT,bmeP");
+
+  bootReportJson(BOARD, millis(), ESP.getSketchSize(), ESP.getFreeHeap(), ESP.getMinFreeHeap(), bootReport,
+                 sizeof(bootReport));
+  Serial.println(bootReport);
 }
 
 // ---------- SENSOR READ / CHECK ----------
-float readMQ2Raw() { return (float)analogRead(PIN_MQ2); }
-int readSoilRaw() { return analogRead(PIN_SOIL); }
+// Soil / MQ-2 raw value; 0 while the input is ABSENT (not read)
+int readAnalog(HealthDevice dev, int pin, int minRaw) {
+  uint32_t now = millis();
+  if (!health[dev].due(now)) return 0;
+  int v = analogRead(pin);
+  health[dev].report(v >= minRaw ? READ_OK : READ_MISSING, now);
+  return v;
+}
+
+float readMQ2Raw() { return (float)readAnalog(DEV_GAS, PIN_MQ2, GAS_MIN_RAW); }
+
+// BME280 temperature (C), humidity (%), pressure (hPa); NAN without one
+// (or while it is ABSENT)
+void readBme(float& t, float& h, float& p) {
+  t = h = p = NAN;
+  if constexpr (BOARD.features.bme280) {
+    uint32_t now = millis();
+    if (!health[DEV_BME].due(now)) return;
+    bool wasAbsent = health[DEV_BME].absent();
+    if (!i2cPresent(bmeAddr)) {
+      health[DEV_BME].report(READ_MISSING, now);
+      return;
+    }
+    if (wasAbsent && !bmeBegin()) {
+      health[DEV_BME].report(READ_BAD, now);  // something answers, not a BME280
+      return;
+    }
+    t = bme->readTemperature();
+    h = bme->readHumidity();
+    p = bme->readPressure()/100.0F;
+    health[DEV_BME].report(isnan(t) ? READ_BAD : READ_OK, now);
+  }
+}
+int readSoilRaw() { return readAnalog(DEV_SOIL, PIN_SOIL, SOIL_MIN_RAW); }
+
+// Accelerometer (m/s^2) for the landslide detector; false while the
+// MPU6050 is ABSENT
+bool readAccel(float& ax, float& ay, float& az) {
+  uint32_t now = millis();
+  if (!health[DEV_MPU].due(now)) return false;
+  bool wasAbsent = health[DEV_MPU].absent();
+  if (!i2cPresent(MPU_ADDR)) {
+    health[DEV_MPU].report(READ_MISSING, now);
+    return false;
+  }
+  if (wasAbsent && !mpuBegin()) {
+    health[DEV_MPU].report(READ_BAD, now);
+    return false;
+  }
+  health[DEV_MPU].report(READ_OK, now);
+  sensors_event_t a, g, temp;
+  mpu.getEvent(&a, &g, &temp);
+  ax = a.acceleration.x;
+  ay = a.acceleration.y;
+  az = a.acceleration.z;
+  return true;
+}
 
 void readGPS() {
   while (SerialGPS.available()) gps.encode(SerialGPS.read());
 }
 
-void checkSensorsAndAlerts() {
-  unsigned long now = millis();
+// Alert relayed from another unit: show, send to app and log like a local one
+void handleMeshAlert() {
+  if (!meshAlertPending) return;
+  MeshFrame f;
+  portENTER_CRITICAL(&meshMux);
+  f = meshAlertFrame;
+  meshAlertPending = false;
+  portEXIT_CRITICAL(&meshMux);
 
-  // DHT check (periodic)
-  if (now - lastDHTread > DHT_READ_INTERVAL_MS) {
-    lastDHTread = now;
-    float h = dht.readHumidity();
-    float t = dht.readTemperature();
-    if (!isnan(t) && !isnan(h)) {
-      if ((t > DHT_TEMP_HIGH || h > DHT_HUM_HIGH) && (now - lastDhtAlert > ALERT_MIN_INTERVAL_MS)) {
-        lastDhtAlert = now;
-        char extra[80];
-        snprintf(extra, sizeof(extra), "t:%.1f,h:%.1f", t, h);
-        // read other sensor values for context
-        float bmeT = bme.readTemperature();
-        float bmeH = bme.readHumidity();
-        float bmeP = bme.readPressure()/100.0F;
-        int mq = (int)readMQ2Raw();
-        int soil = readSoilRaw();
-        double glat = gps.location.isValid() ? gps.location.lat() : 0.0;
-        double glng = gps.location.isValid() ? gps.location.lng() : 0.0;
-        triggerAlert("DHT", "Temperature/Humidity high", extra, t, h, bmeT, bmeH, bmeP, mq, soil, glat, glng);
-      }
-    }
-  }
+  char msg[48];
+  snprintf(msg, sizeof(msg), "%s at unit %08lX", meshKindName(f.kind), (unsigned long)f.origin);
+  char extra[32];
+  snprintf(extra, sizeof(extra), "v:%d,hops:%u", f.value, (unsigned)(f.hops + 1));
+  double glat = gps.location.isValid() ? gps.location.lat() : 0.0;
+  double glng = gps.location.isValid() ? gps.location.lng() : 0.0;
+  float bmeT, bmeH, bmeP;
+  readBme(bmeT, bmeH, bmeP);
+  triggerAlert("MESH", msg, extra, dht.temperature(), dht.humidity(), bmeT, bmeH, bmeP,
+               (int)readMQ2Raw(), readSoilRaw(), glat, glng);
+}
 
-  // MQ-2
+// sample = scheduled sample (landslide only then)
+void checkSensorsAndAlerts(bool sample) {
+  unsigned long now = millis();
   int mq = (int)readMQ2Raw();
-  if (mq > MQ2_SMOKE_THRESHOLD && (now - lastMQ2Alert > ALERT_MIN_INTERVAL_MS)) {
-    lastMQ2Alert = now;
-    char extra[64];
-    snprintf(extra, sizeof(extra), "mq:%d", mq);
-    float dhtT = dht.readTemperature();
-    float dhtH = dht.readHumidity();
-    float bmeT = bme.readTemperature();
-    float bmeH = bme.readHumidity();
-    float bmeP = bme.readPressure()/100.0F;
-    double glat = gps.location.isValid() ? gps.location.lat() : 0.0;
-    double glng = gps.location.isValid() ? gps.location.lng() : 0.0;
-    triggerAlert("MQ2", "Smoke/Gas detected", extra, dhtT, dhtH, bmeT, bmeH, bmeP, mq, readSoilRaw(), glat, glng);
-  }
-
-  // Soil
   int soil = readSoilRaw();
-  if (soil > SOIL_DRY_THRESHOLD && (now - lastSoilAlert > ALERT_MIN_INTERVAL_MS)) {
-    lastSoilAlert = now;
-    char extra[64];
-    snprintf(extra, sizeof(extra), "soil:%d", soil);
-    float dhtT = dht.readTemperature();
-    float dhtH = dht.readHumidity();
-    float bmeT = bme.readTemperature();
-    float bmeH = bme.readHumidity();
-    float bmeP = bme.readPressure()/100.0F;
-    double glat = gps.location.isValid() ? gps.location.lat() : 0.0;
-    double glng = gps.location.isValid() ? gps.location.lng() : 0.0;
-    triggerAlert("SOIL", "Soil dry", extra, dhtT, dhtH, bmeT, bmeH, bmeP, mq, soil, glat, glng);
-  }
-
-  // Tilt / Vibration
+  lastDhtH = dht.humidity();
+  lastDhtT = dht.temperature();
+  int16_t fast[2] = { toFixed(health[DEV_GAS].absent() ? NAN : mq, 1),
+                      toFixed(health[DEV_SOIL].absent() ? NAN : soil, 1) };
+  blackbox.pushFast(now, fast);
+
+  // Tilt switch: closures only feed the landslide detector
   int tilt = digitalRead(PIN_TILT);
-  if (tilt == LOW && (now - lastTiltAlert > ALERT_MIN_INTERVAL_MS)) {
-    lastTiltAlert = now;
-    double glat = gps.location.isValid() ? gps.location.lat() : 0.0;
-    double glng = gps.location.isValid() ? gps.location.lng() : 0.0;
-    triggerAlert("TILT", "Tilt/Vibration detected", NULL, dht.readTemperature(), dht.readHumidity(),
-                 bme.readTemperature(), bme.readHumidity(), bme.readPressure()/100.0F,
-                 mq, soil, glat, glng);
+  if (tilt == LOW && lastTiltLevel == HIGH) tiltEdges++;
+  lastTiltLevel = tilt;
+
+  // Landslide risk (scheduled sample; not without soil or MPU data)
+  float ax, ay, az;
+  if (sample && !health[DEV_SOIL].absent() && readAccel(ax, ay, az)) {
+    int soilPct = map(soil, 0, 4095, 100, 0);
+    landslide.update(now, soilPct, ax, ay, az, tiltEdges);
+    tiltEdges = 0;
+  }
+
+  // an ABSENT input is NAN: no rule on it fires
+  float values[SIG_COUNT];
+  values[SIG_DHT_T] = lastDhtT;
+  values[SIG_DHT_H] = lastDhtH;
+  values[SIG_MQ] = health[DEV_GAS].absent() ? NAN : mq;
+  values[SIG_SOIL] = health[DEV_SOIL].absent() ? NAN : soil;
+  values[SIG_SLIDE] = landslide.level();
+  uint8_t fired[4];
+  uint8_t n = alertRules.evaluate(now, values, fired, sizeof(fired));
+  if (n == 0) return;
+
+  // read other sensor values for context (once, most urgent alert first)
+  float bmeT, bmeH, bmeP;
+  readBme(bmeT, bmeH, bmeP);
+  double glat = gps.location.isValid() ? gps.location.lat() : 0.0;
+  double glng = gps.location.isValid() ? gps.location.lng() : 0.0;
+  for (uint8_t i = 0; i < n; i++) {
+    const char* type = alertRules.name(fired[i]);
+    char extra[80];
+    if (strcmp(type, "SLIDE") == 0) {
+      snprintf(extra, sizeof(extra), "risk:%s,score:%u,why:%u", landslideRiskName(landslide.level()),
+               (unsigned)landslide.score(), (unsigned)landslide.reasons());
+    } else {
+      snprintf(extra, sizeof(extra), "t:%.1f,h:%.1f,mq:%d,soil:%d,line:%u", lastDhtT, lastDhtH, mq, soil,
+               (unsigned)alertRules.rule(fired[i]).line);
+    }
+    triggerAlert(type, alertMessage(type), extra, lastDhtT, lastDhtH, bmeT, bmeH, bmeP, mq, soil, glat, glng);
   }
 }
 
 // Compose and log periodic sensor CSV snapshot (for analytics)
 void logSensorSnapshot() {
-  float dhtT = dht.readTemperature();
-  float dhtH = dht.readHumidity();
-  float bmeT = bme.readTemperature();
-  float bmeH = bme.readHumidity();
-  float bmeP = bme.readPressure()/100.0F;
+  float dhtT = dht.temperature();
+  float dhtH = dht.humidity();
+  float bmeT, bmeH, bmeP;
+  readBme(bmeT, bmeH, bmeP);
   int mq = (int)readMQ2Raw();
   int soil = readSoilRaw();
   double glat = gps.location.isValid() ? gps.location.lat() : 0.0;
   double glng = gps.location.isValid() ? gps.location.lng() : 0.0;
 
   // CSV: time,dhtT,dhtH,bmeT,bmeH,bmeP,mqRaw,soilRaw,gpsLat,gpsLng
-  snprintf(csvBuf, sizeof(csvBuf), "\"%s\",%.2f,%.2f,%.2f,%.2f,%.2f,%d,%d,%.6f,%.6f",
-           isoNow().c_str(),
-           isnan(dhtT) ? 0.0 : dhtT, isnan(dhtH) ? 0.0 : dhtH,
-           isnan(bmeT) ? 0.0 : bmeT, isnan(bmeH) ? 0.0 : bmeH, isnan(bmeP) ? 0.0 : bmeP,
-           mq, soil, glat, glng);
+  char ts[ISO_TIME_LEN];
+  formatSnapshotCsv(csvBuf, sizeof(csvBuf), isoNow(ts), dhtT, dhtH, bmeT, bmeH, bmeP, mq, soil, glat, glng);
   Serial.println(csvBuf);
-  sdLogSensorSnapshot(csvBuf);
+
+  DateTime now = clockNow();
+  sdLogSensorSnapshot(now, csvBuf);
+
+  // NaN readings are left out of the aggregates (count shows coverage)
+  HistoryPoint<AGG_CHANNELS> p = { { toFixed(dhtT, 100), toFixed(dhtH, 100), toFixed(bmeT, 100),
+                                     toFixed(bmeH, 100), toFixed(bmeP, 10),
+                                     toFixed(health[DEV_GAS].absent() ? NAN : mq, 1),
+                                     toFixed(health[DEV_SOIL].absent() ? NAN : soil, 1) } };
+  rollupSnapshot(now, p);
+  int16_t slow[4] = { toFixed(dhtT, 10), toFixed(dhtH, 10), toFixed(bmeT, 10), toFixed(bmeP, 1) };
+  blackbox.pushSlow(millis(), slow);
 }
 
 // ---------- DISPLAY ----------
@@ -364,16 +1291,19 @@ void updateDisplay() {
   display.setTextColor(SSD1306_WHITE);
   display.setCursor(0, 0);
   // Line 1: Time
-  display.println(isoNow());
+  char ts[ISO_TIME_LEN];
+  display.println(isoNow(ts));
   // Line 2: DHT
-  float dhtT = dht.readTemperature();
-  float dhtH = dht.readHumidity();
+  float dhtT = dht.temperature();
+  float dhtH = dht.humidity();
   if (!isnan(dhtT) && !isnan(dhtH)) {
     display.printf("DHT T:%.1fC H:%.1f%%\n", dhtT, dhtH);
   } else display.println("DHT: --");
   // Line 3: BME
-  if (bme.sensorID()) {
-    display.printf("BME T:%.1f P:%.0f\n", bme.readTemperature(), bme.readPressure()/100.0F);
+  float bmeT, bmeH, bmeP;
+  readBme(bmeT, bmeH, bmeP);
+  if (!isnan(bmeT)) {
+    display.printf("BME T:%.1f P:%.0f\n", bmeT, bmeP);
   } else display.println("BME: --");
   // Line 4: MQ2 / Soil
   display.printf("MQ:%d Soil:%d\n", (int)readMQ2Raw(), readSoilRaw());
@@ -396,38 +1326,133 @@ void loop() {
   // quick GPS read
   readGPS();
 
+  // DHT22: start / finish a background read (cached, every 2 s)
+  pollDht();
+
+  // movement since the last loop (MPU6050 INT)
+  checkMotion();
+
   // check sensors and generate alerts if needed
-  checkSensorsAndAlerts();
+  bool sample = power.sampleDue(millis());
+  checkSensorsAndAlerts(sample);
+
+  // alerts from other units (buzzer is already on, see onMeshAlert)
+  handleMeshAlert();
 
   static unsigned long lastDisplay = 0;
-  if (millis() - lastDisplay > 1500) {
+  if (oledOn && millis() - lastDisplay > 1500) {
     lastDisplay = millis();
     updateDisplay();
   }
 
-  if (millis() - lastSensorReport > SENSOR_REPORT_INTERVAL_MS) {
-    lastSensorReport = millis();
-    logSensorSnapshot();
-  }
+  if (sample) logSensorSnapshot();
+
+  // black box: freeze the event after its post window, write it out
+  pollBlackbox();
 
   // handle incoming BT commands (optional)
-  if (SerialBT.available()) {
-    String cmd = SerialBT.readStringUntil('\n');
-    Serial.println("BT_CMD: " + cmd);
-    if (cmd.indexOf("STATUS") >= 0) {
+  if (btUp && SerialBT.available()) {
+    char cmd[48];
+    size_t n = SerialBT.readBytesUntil('\n', cmd, sizeof(cmd) - 1);
+    while (n > 0 && isspace((unsigned char)cmd[n - 1])) n--;
+    cmd[n] = 0;
+    Serial.print("BT_CMD: ");
+    Serial.println(cmd);
+    if (strstr(cmd, "STATUS")) {
       // reply with summary
-      float dhtT = dht.readTemperature();
-      float dhtH = dht.readHumidity();
+      float dhtT = dht.temperature();
+      float dhtH = dht.humidity();
       int mq = (int)readMQ2Raw();
       int soil = readSoilRaw();
+      char states[96];
+      healthSummaryJson(health, DEV_COUNT, states, sizeof(states));
       char out[256];
-      snprintf(out, sizeof(out), "{\"status\":\"ok\",\"dhtT\":%.2f,\"dhtH\":%.2f,\"mq\":%d,\"soil\":%d}",
-               isnan(dhtT) ? 0.0 : dhtT, isnan(dhtH) ? 0.0 : dhtH, mq, soil);
+      formatStatusJson(out, sizeof(out), dhtT, dhtH, mq, soil, states);
       SerialBT.println(out);
-    } else if (cmd.indexOf("PING") >= 0) {
+    } else if (strstr(cmd, "PING")) {
       SerialBT.println("{\"pong\":1}");
+    } else if (strstr(cmd, "SLIDE_ZERO")) {
+      // unit re-mounted: its current inclination becomes the reference
+      landslide.rebaseline(millis());
+      SerialBT.println("{\"slide\":\"rebaseline\"}");
+    } else if (strstr(cmd, "SLIDE")) {
+      char out[192];
+      landslide.json(out, sizeof(out));
+      SerialBT.println(out);
+    } else if (strstr(cmd, "RULES_RELOAD")) {
+      // after editing /rules.txt: compile it, or say which line is wrong
+      loadRules();
+      char out[128];
+      snprintf(out, sizeof(out), "{\"rules\":%u,\"error\":\"%s\"}", alertRules.count(), rulesError);
+      SerialBT.println(out);
+    } else if (strstr(cmd, "RULES")) {
+      char out[192];
+      for (uint8_t i = 0; i < alertRules.count(); i++) {
+        alertRules.json(i, out, sizeof(out));
+        SerialBT.println(out);
+      }
+    } else if (strstr(cmd, "DHT_RAW")) {
+      // last capture as pulses, for tools/dht_check.cpp --captures
+      dht.printRaw(SerialBT);
+    } else if (strstr(cmd, "DHT")) {
+      char out[224];
+      dht.cache.json(out, sizeof(out), millis());
+      SerialBT.println(out);
+    } else if (strstr(cmd, "HEALTH")) {
+      // one line per sensor: state, counters, next probe
+      char out[192];
+      for (uint8_t i = 0; i < DEV_COUNT; i++) {
+        health[i].json(out, sizeof(out), millis());
+        SerialBT.println(out);
+      }
+    } else if (strstr(cmd, "BOARD")) {
+      SerialBT.println(bootReport);
+    } else if (strstr(cmd, "HEAP")) {
+      char out[192];
+      heapWatch.json(out, sizeof(out));
+      SerialBT.println(out);
+    } else if (strstr(cmd, "POWER")) {
+      powerAccount();
+      char out[192];
+      snprintf(out, sizeof(out),
+               "{\"state\":\"%s\",\"awakePct\":%.1f,\"wakeups\":%lu,\"mAh\":%.2f,\"mAhPerDay\":%.1f}",
+               powerStateName(powerState),
+               energy.totalMs ? 100.0 * energy.ms[RAIL_CPU] / energy.totalMs : 100.0,
+               (unsigned long)energy.wakeups, energy.mAh(POWER_MODEL_DEFAULT),
+               energy.mAhPerDay(POWER_MODEL_DEFAULT));
+      SerialBT.println(out);
+    } else if (strncmp(cmd, "GET_HOURS ", 10) == 0 || strncmp(cmd, "GET_MINUTES ", 12) == 0) {
+      // GET_HOURS YYYYMM | GET_MINUTES YYYYMMDD
+      const char* arg = strchr(cmd, ' ') + 1;
+      const char* dir = (cmd[4] == 'H') ? "/hour" : "/min";
+      char path[40];
+      snprintf(path, sizeof(path), "%s/%s.csv", dir, arg);
+      sendSdFile(path);
+    } else if (strncmp(cmd, "GET_RAW ", 8) == 0) {
+      sendRawHour(cmd + 8);  // GET_RAW YYYYMMDDHH
+    } else if (strncmp(cmd, "GET_EVENT", 9) == 0) {
+      sendEvent(cmd[9] == ' ' ? cmd + 10 : "");  // GET_EVENT 6650A1F3.hbb
+    } else if (strstr(cmd, "EVENTS")) {
+      sendEventList();
+    } else if (strstr(cmd, "GET_ALERTS")) {
+      // every alert still in the journal, oldest first
+      if (journalsOpen) {
+        alertJournal.forEach(journalScratch, [](uint32_t seq, uint16_t kind, const char* data, uint16_t len) {
+          SerialBT.write((const uint8_t*)data, len);
+          SerialBT.write('\n');
+        });
+      }
+    } else if (strstr(cmd, "JOURNAL")) {
+      char out[192];
+      alertJournal.json(out, sizeof(out));
+      SerialBT.printf("{\"alerts\":%s,", out);
+      rawJournal.json(out, sizeof(out));
+      SerialBT.printf("\"raw\":%s}\n", out);
     }
   }
 
-  delay(10);
+  heapWatch.poll(millis());
+
+  if constexpr (BOARD.features.powerSave) powerSleep();
+  else delay(dht.busy() ? 1 : 10); // keep the DHT22 start pulse short
 }
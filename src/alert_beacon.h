@@ -0,0 +1,244 @@
+/****************************************************************
+ * HIMBUDDY - UDP ALERT BEACON (hotspot broadcast)
+ *
+ * Phones on the unit's hotspot learn about an alert without polling:
+ * when currentAlert starts, changes or clears, the unit broadcasts one
+ * small datagram to the SoftAP subnet (192.168.4.255). The radio sends
+ * a broadcast once for every client, so 1 phone or 10 cost the unit
+ * the same: no per-client work, no sockets per phone.
+ *
+ * Broadcasts are not acknowledged and Wi-Fi drops some, so each change
+ * is sent BEACON_REPEATS times, BEACON_GAP_MS, 2x, 4x ... apart (0,
+ * 20, 60, 140 ms), and the current state again every BEACON_REFRESH_MS
+ * for phones that join later. All copies of one change carry the same
+ * (unit, boot, seq); a listener keeps the first and drops the rest.
+ * seq starts again at 1 when the unit reboots: the boot id (random,
+ * new every begin()) tells the listener to forget the seq it had.
+ *
+ * Packet (52 bytes, little endian):
+ *   magic "HBA2", unit id, boot id, seq (+1 per change), unit uptime
+ *   ms of the change, active (1 = alert, 0 = all clear), repeat (0 =
+ *   first copy, 255 = refresh), text length, 0, alert text (24 bytes,
+ *   NUL padded), FNV-1a 32 of the bytes before it.
+ *
+ * UdpBeaconSocket is plain BSD sockets: lwIP on the unit, Linux or the
+ * Android NDK on the other side (tools/alert_listener.cpp, which also
+ * runs the broadcaster against listeners on loopback).
+ * No heap, no Arduino headers. Not thread safe.
+ ****************************************************************/
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define BEACON_PORT 47267
+#define BEACON_MAGIC 0x32414248u      // "HBA2" (HBA1: no boot id)
+#define BEACON_TEXT_LEN 24
+#define BEACON_REPEATS 4              // copies of each change
+#define BEACON_GAP_MS 20              // first gap, doubled every repeat
+#define BEACON_REFRESH_MS 5000        // current state again (late joiners)
+#define BEACON_REFRESH 255            // repeat value of a refresh copy
+#define BEACON_UNITS 8                // units a listener tells apart
+
+#pragma pack(push, 1)
+struct BeaconPacket {
+  uint32_t magic;
+  uint32_t unit;
+  uint32_t boot;
+  uint32_t seq;
+  uint32_t changedMs;
+  uint8_t active;
+  uint8_t repeat;
+  uint8_t textLen;
+  uint8_t reserved;
+  char text[BEACON_TEXT_LEN];
+  uint32_t check;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(BeaconPacket) == 52, "sent as raw bytes");
+
+inline uint32_t beaconCheck(const BeaconPacket& p) {
+  const uint8_t* b = (const uint8_t*)&p;
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < offsetof(BeaconPacket, check); i++) h = (h ^ b[i]) * 16777619u;
+  return h;
+}
+
+// Checks a received datagram; false if it is not a (whole) beacon
+inline bool beaconDecode(const uint8_t* data, size_t len, BeaconPacket& out) {
+  if (len != sizeof(BeaconPacket)) return false;
+  memcpy(&out, data, sizeof(out));
+  if (out.magic != BEACON_MAGIC || out.check != beaconCheck(out) || out.textLen > BEACON_TEXT_LEN) return false;
+  return true;
+}
+
+// ==============================================================
+//                    SOCKET
+// ==============================================================
+class BeaconTransport {
+public:
+  virtual ~BeaconTransport() {}
+  virtual bool send(const uint8_t* data, size_t len) = 0;
+};
+
+// One UDP socket, SO_BROADCAST, sending to ip:port
+class UdpBeaconSocket : public BeaconTransport {
+public:
+  ~UdpBeaconSocket() { close(); }
+
+  bool open(const char* ip, uint16_t port = BEACON_PORT) {
+    close();
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip, &to.sin_addr) != 1) return false;
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return false;
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+    return true;
+  }
+
+  void close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+  }
+
+  bool send(const uint8_t* data, size_t len) override {
+    return fd >= 0 && sendto(fd, data, len, 0, (const sockaddr*)&to, sizeof(to)) == (ssize_t)len;
+  }
+
+private:
+  int fd = -1;
+  sockaddr_in to;
+};
+
+// ==============================================================
+//                    BROADCASTER (unit)
+// ==============================================================
+class AlertBeacon {
+public:
+  // bootId: different on every boot (esp_random() on the unit)
+  void begin(BeaconTransport& t, uint32_t unitId, uint32_t bootId) {
+    transport = &t;
+    unit = unitId;
+    boot = bootId;
+  }
+
+  // Every loop pass: alert = the current alert text ("" = none).
+  // Starts a burst when it changed, sends the copies that are due.
+  void update(uint32_t nowMs, const char* alert) {
+    if (!transport) return;
+    if (!alert) alert = "";
+    if (!started || strncmp(alert, text, BEACON_TEXT_LEN) != 0) {
+      started = true;
+      size_t len = strnlen(alert, BEACON_TEXT_LEN);  // longer: cut at 24
+      memset(text, 0, sizeof(text));
+      memcpy(text, alert, len);
+      seq++;
+      changedMs = nowMs;
+      sentCopies = 0;
+    }
+    if (sentCopies < BEACON_REPEATS) {
+      // copy k goes out at GAP * (2^k - 1) after the change
+      uint32_t due = BEACON_GAP_MS * ((1u << sentCopies) - 1);
+      if (nowMs - changedMs >= due) {
+        sendCopy(nowMs, sentCopies);
+        sentCopies++;
+      }
+    } else if (nowMs - lastSend >= BEACON_REFRESH_MS) {
+      sendCopy(nowMs, BEACON_REFRESH);
+    }
+  }
+
+  // ms until update() has a copy to send (for the loop's sleep)
+  uint32_t nextDueMs(uint32_t nowMs) const {
+    if (!started) return BEACON_REFRESH_MS;
+    uint32_t at = sentCopies < BEACON_REPEATS ? changedMs + BEACON_GAP_MS * ((1u << sentCopies) - 1)
+                                              : lastSend + BEACON_REFRESH_MS;
+    return (int32_t)(at - nowMs) > 0 ? at - nowMs : 0;
+  }
+
+  uint32_t sequence() const { return seq; }
+  uint32_t sent() const { return sentCount; }
+  uint32_t errors() const { return errorCount; }
+
+private:
+  void sendCopy(uint32_t nowMs, uint8_t repeat) {
+    BeaconPacket p;
+    memset(&p, 0, sizeof(p));
+    p.magic = BEACON_MAGIC;
+    p.unit = unit;
+    p.boot = boot;
+    p.seq = seq;
+    p.changedMs = changedMs;
+    p.active = text[0] != 0;
+    p.repeat = repeat;
+    p.textLen = (uint8_t)strnlen(text, BEACON_TEXT_LEN);
+    memcpy(p.text, text, p.textLen);
+    p.check = beaconCheck(p);
+    lastSend = nowMs;
+    if (transport->send((const uint8_t*)&p, sizeof(p))) sentCount++;
+    else errorCount++;
+  }
+
+  BeaconTransport* transport = nullptr;
+  uint32_t unit = 0, boot = 0;
+  bool started = false;
+  char text[BEACON_TEXT_LEN] = {};
+  uint32_t seq = 0, changedMs = 0, lastSend = 0;
+  uint8_t sentCopies = 0;
+  uint32_t sentCount = 0, errorCount = 0;
+};
+
+// ==============================================================
+//                    LISTENER (phone side)
+// ==============================================================
+// Keeps the last (boot, seq) per unit: accept() is true once per change
+class BeaconListener {
+public:
+  bool accept(const uint8_t* data, size_t len, BeaconPacket& out) {
+    if (!beaconDecode(data, len, out)) {
+      badCount++;
+      return false;
+    }
+    Unit* u = find(out.unit);
+    // same change again (repeat / refresh), or an older one arriving late;
+    // another boot id: the unit restarted, its seqs count from 1 again
+    if (u->known && out.boot == u->boot && (int32_t)(out.seq - u->seq) <= 0) return false;
+    u->known = true;
+    u->boot = out.boot;
+    u->seq = out.seq;
+    return true;
+  }
+
+  uint32_t bad() const { return badCount; }
+
+private:
+  struct Unit {
+    uint32_t id;
+    uint32_t boot;
+    uint32_t seq;
+    bool known;
+  };
+
+  Unit* find(uint32_t id) {
+    for (Unit& u : units) {
+      if (u.known && u.id == id) return &u;
+    }
+    Unit* slot = &units[next++ % BEACON_UNITS];  // new unit (or the oldest one goes)
+    *slot = { id, 0, 0, false };
+    return slot;
+  }
+
+  Unit units[BEACON_UNITS] = {};
+  uint32_t next = 0;
+  uint32_t badCount = 0;
+};
@@ -0,0 +1,395 @@
+/****************************************************************
+ * HIMBUDDY - NODE TO NODE ALERT RELAY (MESH)
+ *
+ * When one unit on the slope detects danger, every other unit
+ * should sound within milliseconds. Each alert is a small signed
+ * frame that is flooded through the nodes:
+ *   - SipHash-2-4 tag with a shared key (fake frames are dropped)
+ *   - per origin: its boot count + the highest seq seen with a window
+ *     of the 32 before it, so every node relays a frame only once and
+ *     a recorded frame played back later is dropped, however much
+ *     traffic came in between. The boot count (NVS on the unit) goes
+ *     up every boot and seq starts at 0 again: a rebooted node is
+ *     heard at once, a frame from an older boot never is.
+ *     (A node that forgot the origin, after its own reboot or with
+ *     more than MESH_ORIGINS origins, takes its next frame as new.)
+ *   - TTL, so a frame dies after MESH_DEFAULT_TTL hops
+ *   - every relay is one broadcast, plus a few spaced-out unicast
+ *     retries to neighbours with a weak link (RSSI / lost sends).
+ *     Hearing the neighbour relay the frame counts as its ACK.
+ *
+ * The radio is behind MeshTransport: ESP-NOW on the ESP32,
+ * UDP multicast in tools/mesh_sim.cpp. No heap, no Arduino headers.
+ * Not thread safe: call everything from one task.
+ ****************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define MESH_MAGIC 0xB7
+#define MESH_VERSION 2              // 1: no boot count
+#ifndef MESH_DEFAULT_TTL
+#define MESH_DEFAULT_TTL 16     // enough for a line of ~30 units
+#endif
+#define MESH_ORIGINS 32         // origins we keep a replay window for
+#define MESH_WINDOW 32          // seqs below the highest still accepted once
+#define MESH_MAX_PEERS 16       // neighbours we keep link stats for
+#define MESH_PENDING_SLOTS 24   // queued unicast retries
+#define MESH_RETRY_BASE_MS 4    // retry n is sent after 4, 8, 16 ms
+
+enum MeshAlertKind {
+  MESH_ALERT_CLEAR = 0,
+  MESH_ALERT_SMOKE = 1,
+  MESH_ALERT_QUAKE = 2,
+  MESH_ALERT_FLOOD = 3,
+  MESH_ALERT_LANDSLIDE = 4,
+  MESH_ALERT_HEAT = 5,
+  MESH_ALERT_SOIL = 6,
+  MESH_ALERT_TEST = 7
+};
+
+inline const char* meshKindName(uint8_t kind) {
+  static const char* const names[] = { "CLEAR", "SMOKE", "QUAKE", "FLOOD", "LANDSLIDE", "HEAT", "SOIL", "TEST" };
+  return kind < sizeof(names) / sizeof(names[0]) ? names[kind] : "UNKNOWN";
+}
+
+struct MeshAddr {
+  uint8_t b[6];
+  bool operator==(const MeshAddr& o) const { return memcmp(b, o.b, 6) == 0; }
+};
+
+#pragma pack(push, 1)
+struct MeshFrame {
+  uint8_t magic;
+  uint8_t version;
+  uint8_t ttl;      // hops left   (changed by relays, not signed)
+  uint8_t hops;     // hops so far (changed by relays, not signed)
+  uint8_t kind;     // MeshAlertKind
+  uint8_t level;    // severity 0..3
+  int16_t value;    // reading that tripped the alert (sensor units)
+  uint32_t origin;  // node id of the sender
+  uint32_t boot;    // the origin's boot count
+  uint32_t seq;     // per-origin sequence number, from 0 every boot
+  uint8_t tag[8];   // SipHash-2-4 of magic, version, kind..seq
+};
+#pragma pack(pop)
+
+static_assert(sizeof(MeshFrame) == 28, "MeshFrame is sent as raw bytes");
+
+// ==============================================================
+//                    RADIO INTERFACE
+// ==============================================================
+class MeshTransport {
+public:
+  virtual ~MeshTransport() {}
+  virtual bool broadcast(const uint8_t* data, size_t len) = 0;
+  virtual bool unicast(const MeshAddr& to, const uint8_t* data, size_t len) = 0;
+};
+
+// ==============================================================
+//                    SIPHASH-2-4 (64 bit tag)
+// ==============================================================
+inline uint64_t meshSipHash(const uint8_t key[16], const uint8_t* in, size_t len) {
+  #define MESH_ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+  #define MESH_SIPROUND \
+    do { v0 += v1; v1 = MESH_ROTL(v1, 13); v1 ^= v0; v0 = MESH_ROTL(v0, 32); \
+         v2 += v3; v3 = MESH_ROTL(v3, 16); v3 ^= v2; \
+         v0 += v3; v3 = MESH_ROTL(v3, 21); v3 ^= v0; \
+         v2 += v1; v1 = MESH_ROTL(v1, 17); v1 ^= v2; v2 = MESH_ROTL(v2, 32); } while (0)
+  uint64_t k0 = 0, k1 = 0;
+  for (int i = 7; i >= 0; i--) { k0 = (k0 << 8) | key[i]; k1 = (k1 << 8) | key[8 + i]; }
+  uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+  uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+  uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+  uint64_t v3 = 0x7465646279746573ULL ^ k1;
+  uint64_t b = ((uint64_t)len) << 56;
+  size_t full = len & ~(size_t)7;
+  for (size_t i = 0; i < full; i += 8) {
+    uint64_t m = 0;
+    for (int j = 7; j >= 0; j--) m = (m << 8) | in[i + j];
+    v3 ^= m; MESH_SIPROUND; MESH_SIPROUND; v0 ^= m;
+  }
+  for (size_t j = 0; j < (len & 7); j++) b |= ((uint64_t)in[full + j]) << (8 * j);
+  v3 ^= b; MESH_SIPROUND; MESH_SIPROUND; v0 ^= b;
+  v2 ^= 0xff;
+  MESH_SIPROUND; MESH_SIPROUND; MESH_SIPROUND; MESH_SIPROUND;
+  return v0 ^ v1 ^ v2 ^ v3;
+  #undef MESH_SIPROUND
+  #undef MESH_ROTL
+}
+
+// ==============================================================
+//                    RELAY ENGINE
+// ==============================================================
+typedef void (*MeshAlertHandler)(const MeshFrame& frame, const MeshAddr& from, void* ctx);
+
+struct MeshStats {
+  uint32_t rx, dup, rejected, replayed, delivered, relayed, retries;
+};
+
+class AlertMesh {
+public:
+  explicit AlertMesh(MeshTransport& t) : radio(t) {}
+
+  // bootCount: higher than on every earlier boot of this node
+  void begin(uint32_t id, const uint8_t k[16], uint32_t bootCount) {
+    nodeId = id;
+    memcpy(key, k, sizeof(key));
+    boot = bootCount;
+    nextSeq = 0;
+    memset(origins, 0, sizeof(origins));
+    memset(peers, 0, sizeof(peers));
+    memset(pending, 0, sizeof(pending));
+    memset(&stats, 0, sizeof(stats));
+  }
+
+  // Called for every new, valid alert from another node
+  void onAlert(MeshAlertHandler fn, void* ctx) { handler = fn; handlerCtx = ctx; }
+
+  // Sends a new alert from this node. Returns its sequence number.
+  uint32_t originate(uint8_t kind, uint8_t level, int16_t value, uint32_t nowMs) {
+    MeshFrame f;
+    f.magic = MESH_MAGIC;
+    f.version = MESH_VERSION;
+    f.ttl = MESH_DEFAULT_TTL;
+    f.hops = 0;
+    f.kind = kind;
+    f.level = level;
+    f.value = value;
+    f.origin = nodeId;
+    f.boot = boot;
+    f.seq = nextSeq++;
+    sign(f, f.tag);
+    send(f, NULL, nowMs);
+    return f.seq;
+  }
+
+  // Feed every frame the radio receives
+  void onReceive(const MeshAddr& from, int8_t rssi, const uint8_t* data, size_t len, uint32_t nowMs) {
+    stats.rx++;
+    if (len != sizeof(MeshFrame)) { stats.rejected++; return; }
+    MeshFrame f;
+    memcpy(&f, data, sizeof(f));
+    if (f.magic != MESH_MAGIC || f.version != MESH_VERSION) { stats.rejected++; return; }
+    uint8_t expect[8];
+    sign(f, expect);
+    if (memcmp(expect, f.tag, sizeof(expect)) != 0) { stats.rejected++; return; }
+
+    MeshPeer* p = peer(from, rssi, nowMs);
+    p->rssi = (int8_t)((p->rssi * 7 + rssi) / 8);
+
+    Origin* o = f.origin == nodeId ? NULL : origin(f.origin, nowMs);
+    SeenAs seen = o ? check(*o, f) : SEEN_DUP;
+    if (seen != SEEN_NEW) {
+      // Neighbour relayed a frame we already have: it got it, stop retrying
+      if (seen == SEEN_DUP) stats.dup++;
+      else stats.replayed++;
+      cancelRetries(f.origin, f.seq, from);
+      return;
+    }
+    accept(*o, f);
+    stats.delivered++;
+    if (handler) handler(f, from, handlerCtx);
+
+    if (f.ttl > 1) {
+      f.ttl--;
+      f.hops++;
+      stats.relayed++;
+      send(f, &from, nowMs);
+    }
+  }
+
+  // Delivery result of a unicast (ESP-NOW send callback)
+  void onSendResult(const MeshAddr& to, bool ok) {
+    for (uint8_t i = 0; i < MESH_MAX_PEERS; i++) {
+      MeshPeer& p = peers[i];
+      if (!p.used || !(p.addr == to)) continue;
+      // delivery rate in %, moving average over ~8 sends
+      p.okPct = (uint8_t)(p.okPct - p.okPct / 8 + (ok ? 100 / 8 : 0));
+      if (ok) {
+        for (uint8_t k = 0; k < MESH_PENDING_SLOTS; k++) {
+          if (pending[k].used && pending[k].peer == i) pending[k].used = false;
+        }
+      }
+    }
+  }
+
+  // Sends retries that are due. Returns ms until the next one (0xFFFFFFFF = none).
+  uint32_t poll(uint32_t nowMs) {
+    uint32_t next = 0xFFFFFFFF;
+    for (uint8_t k = 0; k < MESH_PENDING_SLOTS; k++) {
+      Pending& q = pending[k];
+      if (!q.used) continue;
+      if ((int32_t)(nowMs - q.due) >= 0) {
+        radio.unicast(peers[q.peer].addr, (const uint8_t*)&q.frame, sizeof(q.frame));
+        stats.retries++;
+        q.attempt++;
+        if (q.attempt >= q.attempts) { q.used = false; continue; }
+        q.due = nowMs + ((uint32_t)MESH_RETRY_BASE_MS << q.attempt);
+      }
+      uint32_t wait = q.due - nowMs;
+      if ((int32_t)wait < 0) wait = 0;
+      if (wait < next) next = wait;
+    }
+    return next;
+  }
+
+  // How many unicast retries a neighbour gets, from its link quality
+  static uint8_t retriesFor(int8_t rssi, uint8_t okPct) {
+    if (rssi < -85 || okPct < 50) return 3;
+    if (rssi < -75 || okPct < 80) return 2;
+    if (okPct < 95) return 1;
+    return 0;
+  }
+
+  MeshStats stats;
+
+private:
+  struct MeshPeer {
+    MeshAddr addr;
+    int8_t rssi;
+    uint8_t okPct;
+    bool used;
+    uint32_t lastMs;
+  };
+
+  struct Pending {
+    MeshFrame frame;
+    uint8_t peer;
+    uint8_t attempt;
+    uint8_t attempts;
+    bool used;
+    uint32_t due;
+  };
+
+  // Replay window of one origin: top = highest seq of its newest boot,
+  // bit k of `bits` = seq top - k was accepted
+  struct Origin {
+    uint32_t id;
+    uint32_t boot;
+    uint32_t top;
+    uint32_t bits;
+    uint32_t lastMs;
+    bool used;   // slot taken
+    bool known;  // a frame was accepted (boot, top, bits are set)
+  };
+
+  enum SeenAs : uint8_t { SEEN_NEW, SEEN_DUP, SEEN_OLD };
+
+  void sign(const MeshFrame& f, uint8_t out[8]) const {
+    uint8_t msg[2 + 16];
+    msg[0] = f.magic;
+    msg[1] = f.version;
+    memcpy(msg + 2, &f.kind, 16); // kind, level, value, origin, boot, seq
+    uint64_t h = meshSipHash(key, msg, sizeof(msg));
+    for (uint8_t i = 0; i < 8; i++) out[i] = (uint8_t)(h >> (8 * i));
+  }
+
+  // New, already accepted (dup), or too old / an older boot (replay)
+  SeenAs check(const Origin& o, const MeshFrame& f) const {
+    if (!o.known) return SEEN_NEW;
+    int32_t b = (int32_t)(f.boot - o.boot);
+    if (b != 0) return b > 0 ? SEEN_NEW : SEEN_OLD;
+    int32_t d = (int32_t)(f.seq - o.top);
+    if (d > 0) return SEEN_NEW;
+    if (d <= -MESH_WINDOW) return SEEN_OLD;
+    return (o.bits >> -d) & 1 ? SEEN_DUP : SEEN_NEW;
+  }
+
+  void accept(Origin& o, const MeshFrame& f) {
+    if (!o.known || f.boot != o.boot) {
+      o.known = true;
+      o.boot = f.boot;
+      o.top = f.seq;
+      o.bits = 1;
+      return;
+    }
+    int32_t d = (int32_t)(f.seq - o.top);
+    if (d > 0) {
+      o.bits = d < MESH_WINDOW ? o.bits << d : 0;
+      o.bits |= 1;
+      o.top = f.seq;
+    } else {
+      o.bits |= 1u << -d;
+    }
+  }
+
+  // Finds (or adds) an origin. When full, the longest silent one is replaced.
+  Origin* origin(uint32_t id, uint32_t nowMs) {
+    uint8_t victim = 0;
+    for (uint8_t i = 0; i < MESH_ORIGINS; i++) {
+      if (origins[i].used && origins[i].id == id) { origins[i].lastMs = nowMs; return &origins[i]; }
+      if (!origins[i].used) { victim = i; break; }
+      if ((int32_t)(origins[i].lastMs - origins[victim].lastMs) < 0) victim = i;
+    }
+    Origin& o = origins[victim];
+    memset(&o, 0, sizeof(o));
+    o.id = id;
+    o.used = true;
+    o.lastMs = nowMs;
+    return &o;
+  }
+
+  // Finds (or adds) a neighbour. When full, the longest silent one is replaced.
+  MeshPeer* peer(const MeshAddr& a, int8_t rssi, uint32_t nowMs) {
+    uint8_t victim = 0;
+    for (uint8_t i = 0; i < MESH_MAX_PEERS; i++) {
+      if (peers[i].used && peers[i].addr == a) { peers[i].lastMs = nowMs; return &peers[i]; }
+      if (!peers[i].used) { victim = i; break; }
+      if ((int32_t)(peers[i].lastMs - peers[victim].lastMs) < 0) victim = i;
+    }
+    for (uint8_t k = 0; k < MESH_PENDING_SLOTS; k++) {
+      if (pending[k].used && pending[k].peer == victim) pending[k].used = false;
+    }
+    MeshPeer& p = peers[victim];
+    p.addr = a;
+    p.rssi = rssi;
+    p.okPct = 100;
+    p.used = true;
+    p.lastMs = nowMs;
+    return &p;
+  }
+
+  void cancelRetries(uint32_t origin, uint32_t seq, const MeshAddr& from) {
+    for (uint8_t k = 0; k < MESH_PENDING_SLOTS; k++) {
+      Pending& q = pending[k];
+      if (q.used && q.frame.origin == origin && q.frame.seq == seq && peers[q.peer].addr == from) q.used = false;
+    }
+  }
+
+  // One broadcast now, then retries to weak neighbours (not back to 'except')
+  void send(const MeshFrame& f, const MeshAddr* except, uint32_t nowMs) {
+    radio.broadcast((const uint8_t*)&f, sizeof(f));
+    for (uint8_t i = 0; i < MESH_MAX_PEERS; i++) {
+      const MeshPeer& p = peers[i];
+      if (!p.used || (except && p.addr == *except)) continue;
+      uint8_t n = retriesFor(p.rssi, p.okPct);
+      if (n == 0) continue;
+      for (uint8_t k = 0; k < MESH_PENDING_SLOTS; k++) {
+        Pending& q = pending[k];
+        if (q.used) continue;
+        q.frame = f;
+        q.peer = i;
+        q.attempt = 0;
+        q.attempts = n;
+        q.used = true;
+        // small per-node offset so neighbours don't retry in lockstep
+        q.due = nowMs + MESH_RETRY_BASE_MS + (nodeId + i) % 3;
+        break;
+      }
+    }
+  }
+
+  MeshTransport& radio;
+  MeshAlertHandler handler = NULL;
+  void* handlerCtx = NULL;
+  uint32_t nodeId = 0;
+  uint32_t boot = 0;
+  uint32_t nextSeq = 0;
+  uint8_t key[16];
+  Origin origins[MESH_ORIGINS];
+  MeshPeer peers[MESH_MAX_PEERS];
+  Pending pending[MESH_PENDING_SLOTS];
+};
@@ -0,0 +1,121 @@
+/****************************************************************
+ * HIMBUDDY - MICROBENCHMARK HARNESS
+ *
+ * Times one small routine the same way on a PC (nanoseconds,
+ * tools/microbench.cpp) and on the ESP32 (CPU cycles, BENCH_ON_BOOT
+ * in HimBuddy.c):
+ *   1. calibrate: double the batch until one batch takes minTicks
+ *      (so clock resolution and call overhead do not matter)
+ *   2. warm up one batch (caches, branch predictors, lazy init)
+ *   3. time `samples` batches, per-call cost = batch time / batch
+ * and reports min / median / p90 / mean / MAD over the batches. The
+ * median with its MAD (median absolute deviation) is the figure to
+ * compare between builds: an outlier batch (interrupt, preemption)
+ * moves the mean but hardly the median.
+ *
+ * Results are one JSON object per routine:
+ *   {"name":..,"unit":"ns","calls":..,"samples":..,"min":..,"median":..,"p90":..,"mean":..,"mad":..}
+ *
+ * No heap, no Arduino headers: the clock is passed in.
+ ****************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define BENCH_SAMPLES_MAX 64
+
+struct BenchClock {
+  uint64_t (*now)();
+  const char* unit;        // "ns" or "cycles"
+  uint64_t minTicks;       // one batch takes at least this long
+};
+
+struct BenchResult {
+  const char* name;
+  const char* unit;
+  uint32_t batch;          // calls per sample
+  uint16_t samples;
+  double min, median, p90, mean, mad;  // per call
+};
+
+// Keeps a result alive so the compiler cannot drop the work
+template <typename T>
+inline void benchKeep(const T& v) {
+#if defined(__GNUC__)
+  asm volatile("" : : "g"(&v) : "memory");
+#else
+  static volatile const void* sink;
+  sink = &v;
+#endif
+}
+
+class Bench {
+public:
+  explicit Bench(const BenchClock& c, uint16_t samplesPerRun = 31) : clock(c) {
+    samples = samplesPerRun < 3 ? 3 : (samplesPerRun > BENCH_SAMPLES_MAX ? BENCH_SAMPLES_MAX : samplesPerRun);
+  }
+
+  // fn() is one call of the routine
+  template <typename Fn>
+  BenchResult run(const char* name, Fn fn) {
+    uint32_t batch = 1;
+    for (;;) {
+      uint64_t t = timeBatch(fn, batch);
+      if (t >= clock.minTicks || batch >= (1u << 30)) break;
+      batch *= t * 4 < clock.minTicks ? 4 : 2;
+    }
+    timeBatch(fn, batch);  // warm-up
+
+    double per[BENCH_SAMPLES_MAX];
+    double sum = 0;
+    for (uint16_t i = 0; i < samples; i++) {
+      per[i] = (double)timeBatch(fn, batch) / batch;
+      sum += per[i];
+    }
+    sortSmall(per, samples);
+
+    BenchResult r;
+    r.name = name;
+    r.unit = clock.unit;
+    r.batch = batch;
+    r.samples = samples;
+    r.min = per[0];
+    r.median = per[samples / 2];
+    r.p90 = per[(samples * 9) / 10];
+    r.mean = sum / samples;
+    double dev[BENCH_SAMPLES_MAX];
+    for (uint16_t i = 0; i < samples; i++) dev[i] = per[i] > r.median ? per[i] - r.median : r.median - per[i];
+    sortSmall(dev, samples);
+    r.mad = dev[samples / 2];
+    return r;
+  }
+
+  static int json(const BenchResult& r, char* out, size_t len) {
+    return snprintf(out, len,
+                    "{\"name\":\"%s\",\"unit\":\"%s\",\"calls\":%lu,\"samples\":%u,\"min\":%.1f,\"median\":%.1f,"
+                    "\"p90\":%.1f,\"mean\":%.1f,\"mad\":%.1f}",
+                    r.name, r.unit, (unsigned long)r.batch * r.samples, (unsigned)r.samples, r.min, r.median, r.p90,
+                    r.mean, r.mad);
+  }
+
+private:
+  template <typename Fn>
+  uint64_t timeBatch(Fn& fn, uint32_t n) {
+    uint64_t t0 = clock.now();
+    for (uint32_t i = 0; i < n; i++) fn();
+    return clock.now() - t0;
+  }
+
+  static void sortSmall(double* v, uint16_t n) {
+    for (uint16_t i = 1; i < n; i++) {
+      double x = v[i];
+      uint16_t j = i;
+      while (j > 0 && v[j - 1] > x) { v[j] = v[j - 1]; j--; }
+      v[j] = x;
+    }
+  }
+
+  BenchClock clock;
+  uint16_t samples;
+};
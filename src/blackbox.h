@@ -0,0 +1,275 @@
+/****************************************************************
+ * HIMBUDDY - BLACK BOX (samples before + after every alert)
+ *
+ * An alert used to leave one summary line; the waveform that caused
+ * it was gone. The black box keeps the last seconds of two streams in
+ * RAM, overwritten all the time:
+ *   fast  high-rate samples (MPU6050 FIFO at 100 Hz, ADC every pass)
+ *   slow  the rest, now and then (soil / gas / DHT once a second)
+ * trigger() copies the pre-trigger window (preMs) out of the rings
+ * into the event, the next samples are added to it for postMs, then
+ * poll() freezes it. Pushing never waits for anything: the event is
+ * read out later with readEvent() in pieces of any size (SD file in
+ * 512 byte writes, web / BT download), and release() frees it for
+ * the next alert. A trigger while the post window is open only adds
+ * to that event's trigger count; one while the frozen event is not
+ * released yet is counted as dropped.
+ *
+ * Event file (little endian):
+ *   BlackboxHeader (60 bytes), channel names "ax,ay,az;soil,gas,.."
+ *   (NUL padded to 4, fast channels before ';'), then
+ *   fastCount x (u16 ms since the previous fast sample, i16 x fastCh)
+ *   slowCount x (u16 ms since the previous slow sample, i16 x slowCh)
+ *   u32 FNV-1a of everything before it
+ * The first sample of a stream is at fastT0 / slowT0 (dt 0); the ones
+ * before the trigger come first (fastPre / slowPre of them). A gap of
+ * more than 65 s between two samples is stored as 65535.
+ *
+ * blackboxParse() checks a file; tools/blackbox_decode.cpp turns it
+ * into CSV. No heap, no Arduino headers. Not thread safe.
+ ****************************************************************/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BLACKBOX_MAGIC 0x31424248u   // "HBB1"
+#define BLACKBOX_CAUSE_LEN 24
+#define BLACKBOX_NAMES_MAX 64
+
+struct BlackboxHeader {
+  uint32_t magic;
+  uint16_t headerLen;   // this + names (multiple of 4)
+  uint8_t fastCh, slowCh;
+  uint32_t id;          // event number (per unit)
+  uint32_t triggerMs;   // uptime of the (first) trigger
+  uint32_t fastT0, slowT0;
+  uint16_t fastCount, fastPre;
+  uint16_t slowCount, slowPre;
+  uint16_t triggers;    // 1 + triggers during the post window
+  uint16_t reserved;
+  char cause[BLACKBOX_CAUSE_LEN];  // alert text, NUL padded
+};
+static_assert(sizeof(BlackboxHeader) == 60, "BlackboxHeader layout");
+
+enum BlackboxState : uint8_t { BB_IDLE, BB_CAPTURING, BB_FROZEN };
+
+inline const char* blackboxStateName(uint8_t s) {
+  static const char* const names[] = { "idle", "capturing", "frozen" };
+  return s <= BB_FROZEN ? names[s] : "?";
+}
+
+inline uint32_t blackboxHash(uint32_t h, const uint8_t* p, size_t n) {
+  for (size_t i = 0; i < n; i++) h = (h ^ p[i]) * 16777619u;
+  return h;
+}
+
+template <uint8_t CH>
+struct BlackboxSample {
+  uint32_t ms;
+  int16_t v[CH];
+};
+
+// ==============================================================
+//                    RECORDER
+// ==============================================================
+// FAST_RING: fast samples kept for the pre window, FAST_EVENT: pre +
+// post window; SLOW_N: slow samples, ring and event
+template <uint8_t FAST_CH, uint16_t FAST_RING, uint16_t FAST_EVENT, uint8_t SLOW_CH, uint8_t SLOW_N>
+class Blackbox {
+public:
+  static constexpr size_t FAST_BYTES = 2 + 2 * FAST_CH;
+  static constexpr size_t SLOW_BYTES = 2 + 2 * SLOW_CH;
+  static constexpr size_t MAX_BYTES =
+    sizeof(BlackboxHeader) + BLACKBOX_NAMES_MAX + FAST_EVENT * FAST_BYTES + SLOW_N * SLOW_BYTES + 4;
+
+  // names: "fast,..;slow,.." (for the decoder)
+  void begin(uint32_t preWindowMs, uint32_t postWindowMs, const char* channelNames) {
+    preMs = preWindowMs;
+    postMs = postWindowMs;
+    size_t n = strnlen(channelNames, BLACKBOX_NAMES_MAX - 1);
+    memset(names, 0, sizeof(names));
+    memcpy(names, channelNames, n);
+    namesLen = (uint16_t)((n + 1 + 3) & ~3u);
+    fastNext = slowNext = 0;
+    st = BB_IDLE;
+    events = merged = dropped = 0;
+  }
+
+  void pushFast(uint32_t ms, const int16_t* v) {
+    BlackboxSample<FAST_CH>& s = fastRing[fastNext++ % FAST_RING];
+    s.ms = ms;
+    memcpy(s.v, v, sizeof(s.v));
+    if (st == BB_CAPTURING && head.fastCount < FAST_EVENT) fast[head.fastCount++] = s;
+  }
+
+  void pushSlow(uint32_t ms, const int16_t* v) {
+    BlackboxSample<SLOW_CH>& s = slowRing[slowNext++ % SLOW_N];
+    s.ms = ms;
+    memcpy(s.v, v, sizeof(s.v));
+    if (st == BB_CAPTURING && head.slowCount < SLOW_N) slow[head.slowCount++] = s;
+  }
+
+  // An alert. false: the last event is not released yet (dropped)
+  bool trigger(uint32_t nowMs, const char* cause) {
+    if (st == BB_CAPTURING) {
+      if (head.triggers < 0xFFFF) head.triggers++;
+      merged++;
+      return true;
+    }
+    if (st == BB_FROZEN) {
+      dropped++;
+      return false;
+    }
+    memset(&head, 0, sizeof(head));
+    head.magic = BLACKBOX_MAGIC;
+    head.headerLen = (uint16_t)(sizeof(BlackboxHeader) + namesLen);
+    head.fastCh = FAST_CH;
+    head.slowCh = SLOW_CH;
+    head.id = ++events;
+    head.triggerMs = nowMs;
+    head.triggers = 1;
+    strncpy(head.cause, cause ? cause : "", BLACKBOX_CAUSE_LEN - 1);
+    head.fastPre = copyPre(fastRing, fastNext, FAST_RING, fast, nowMs);
+    head.slowPre = copyPre(slowRing, slowNext, SLOW_N, slow, nowMs);
+    head.fastCount = head.fastPre;
+    head.slowCount = head.slowPre;
+    st = BB_CAPTURING;
+    return true;
+  }
+
+  // Every loop pass. true: the event just froze (read it out, release())
+  bool poll(uint32_t nowMs) {
+    if (st != BB_CAPTURING) return false;
+    if (nowMs - head.triggerMs < postMs && head.fastCount < FAST_EVENT) return false;
+    head.fastT0 = head.fastCount ? fast[0].ms : 0;
+    head.slowT0 = head.slowCount ? slow[0].ms : 0;
+    st = BB_FROZEN;
+    check = 2166136261u;
+    uint8_t buf[64];
+    size_t size = eventBytes();
+    for (size_t at = 0; at + 4 < size;) {
+      size_t n = readEvent(at, buf, size - 4 - at < sizeof(buf) ? size - 4 - at : sizeof(buf));
+      check = blackboxHash(check, buf, n);
+      at += n;
+    }
+    return true;
+  }
+
+  void release() {
+    if (st == BB_FROZEN) st = BB_IDLE;
+  }
+
+  BlackboxState state() const { return st; }
+  const BlackboxHeader& header() const { return head; }  // of the event (capturing / frozen)
+
+  size_t eventBytes() const {
+    return head.headerLen + head.fastCount * FAST_BYTES + head.slowCount * SLOW_BYTES + 4;
+  }
+
+  // Bytes [offset, offset + len) of the frozen event's file; returns
+  // how many (0 = past the end)
+  size_t readEvent(size_t offset, uint8_t* out, size_t len) const {
+    size_t size = eventBytes();
+    size_t done = 0;
+    while (done < len && offset < size) {
+      uint8_t rec[sizeof(BlackboxHeader) + BLACKBOX_NAMES_MAX];
+      size_t start, n;  // the record that holds offset
+      size_t fastAt = head.headerLen, slowAt = fastAt + head.fastCount * FAST_BYTES, endAt = size - 4;
+      if (offset < fastAt) {
+        memcpy(rec, &head, sizeof(head));
+        memcpy(rec + sizeof(head), names, namesLen);
+        start = 0;
+        n = head.headerLen;
+      } else if (offset < slowAt) {
+        size_t i = (offset - fastAt) / FAST_BYTES;
+        start = fastAt + i * FAST_BYTES;
+        n = record(rec, fast[i].ms, i ? fast[i - 1].ms : fast[0].ms, fast[i].v, FAST_CH);
+      } else if (offset < endAt) {
+        size_t i = (offset - slowAt) / SLOW_BYTES;
+        start = slowAt + i * SLOW_BYTES;
+        n = record(rec, slow[i].ms, i ? slow[i - 1].ms : slow[0].ms, slow[i].v, SLOW_CH);
+      } else {
+        memcpy(rec, &check, 4);
+        start = endAt;
+        n = 4;
+      }
+      size_t k = start + n - offset;
+      if (k > len - done) k = len - done;
+      memcpy(out + done, rec + (offset - start), k);
+      done += k;
+      offset += k;
+    }
+    return done;
+  }
+
+  // {"state","events","merged","dropped","id","cause","bytes","fast","slow"}
+  int json(char* out, size_t len) const {
+    return snprintf(out, len,
+                    "{\"state\":\"%s\",\"events\":%lu,\"merged\":%lu,\"dropped\":%lu,\"id\":%lu,\"cause\":\"%s\","
+                    "\"bytes\":%u,\"fast\":%u,\"slow\":%u}",
+                    blackboxStateName(st), (unsigned long)events, (unsigned long)merged, (unsigned long)dropped,
+                    (unsigned long)head.id, head.cause, st == BB_IDLE && !events ? 0u : (unsigned)eventBytes(),
+                    head.fastCount, head.slowCount);
+  }
+
+private:
+  // Samples of the last preMs (oldest first) from a ring into the event
+  template <uint8_t CH>
+  uint16_t copyPre(const BlackboxSample<CH>* ring, uint32_t next, uint16_t size, BlackboxSample<CH>* to,
+                   uint32_t nowMs) {
+    uint32_t have = next < size ? next : size;
+    uint32_t first = next - have;
+    while (first != next && nowMs - ring[first % size].ms > preMs) first++;
+    uint16_t n = 0;
+    for (uint32_t i = first; i != next; i++) to[n++] = ring[i % size];
+    return n;
+  }
+
+  static size_t record(uint8_t* rec, uint32_t ms, uint32_t prevMs, const int16_t* v, uint8_t ch) {
+    uint32_t dt = ms - prevMs;
+    uint16_t d = dt > 0xFFFF ? 0xFFFF : (uint16_t)dt;
+    memcpy(rec, &d, 2);
+    memcpy(rec + 2, v, 2 * ch);
+    return 2 + 2 * ch;
+  }
+
+  uint32_t preMs = 0, postMs = 0;
+  char names[BLACKBOX_NAMES_MAX];
+  uint16_t namesLen = 4;
+  BlackboxSample<FAST_CH> fastRing[FAST_RING];
+  BlackboxSample<SLOW_CH> slowRing[SLOW_N];
+  uint32_t fastNext = 0, slowNext = 0;
+  BlackboxState st = BB_IDLE;
+  BlackboxHeader head = {};
+  BlackboxSample<FAST_CH> fast[FAST_EVENT];
+  BlackboxSample<SLOW_CH> slow[SLOW_N];
+  uint32_t check = 0;
+  uint32_t events = 0, merged = 0, dropped = 0;
+};
+
+// ==============================================================
+//                    PARSER
+// ==============================================================
+// Checks one event file. Sets where the names and the two streams
+// start; false when it is cut short, from another format or damaged.
+inline bool blackboxParse(const uint8_t* b, size_t len, BlackboxHeader& h, const char*& names, size_t& fastAt,
+                          size_t& slowAt) {
+  if (len < sizeof(BlackboxHeader) + 4) return false;
+  memcpy(&h, b, sizeof(h));
+  if (h.magic != BLACKBOX_MAGIC || h.headerLen < sizeof(h) + 4 || h.headerLen > sizeof(h) + BLACKBOX_NAMES_MAX ||
+      h.headerLen % 4 || h.fastCh == 0 || h.slowCh == 0 || h.fastPre > h.fastCount || h.slowPre > h.slowCount) {
+    return false;
+  }
+  fastAt = h.headerLen;
+  slowAt = fastAt + (size_t)h.fastCount * (2 + 2 * h.fastCh);
+  size_t size = slowAt + (size_t)h.slowCount * (2 + 2 * h.slowCh) + 4;
+  if (size != len || b[h.headerLen - 1] != 0) return false;
+  uint32_t check;
+  memcpy(&check, b + len - 4, 4);
+  if (blackboxHash(2166136261u, b, len - 4) != check) return false;
+  names = (const char*)b + sizeof(h);
+  return true;
+}
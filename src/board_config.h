@@ -0,0 +1,180 @@
+/****************************************************************
+ * HIMBUDDY - BOARD PROFILES (pins + features, chosen at compile time)
+ *
+ * The three sketches are three wirings of the same parts, and they
+ * grew three pin maps (MQ-2 on 33, 32 or 34, the buzzer on 25, 14 or
+ * 27). Every pin and every optional part now lives in one profile
+ * here, and a sketch takes both from BOARD:
+ *   PROFILE_WEB      HimBuddy.c       Wi-Fi hotspot + web UI
+ *   PROFILE_BT_CALL  esp32.c          BT + SIM800L call + SAM speech + SD
+ *   PROFILE_BT_SD    esp32fullcode.c  BT + SD journals + BME280 + mesh
+ * A build picks another profile (a new board, a unit without the
+ * modem) with -DHIMBUDDY_PROFILE=PROFILE_...; each sketch sets its own
+ * as the default before including this file.
+ *
+ * Everything is constexpr, so a feature that is off is gone from the
+ * binary: `if constexpr (BOARD.features.x)` drops the code, and
+ * Feature<on, T> drops the object (no storage, no constructor, so the
+ * library is not linked either). BOARD_CHECK() rejects a profile at
+ * compile time when two parts share a pin, an output sits on an
+ * input-only pin, an analog sensor is on ADC2 while Wi-Fi is on, or
+ * a feature is on without its pins.
+ *
+ * Boot report: bootReportJson() (sketch size, heap, boot time) on the
+ * unit; per-profile flash / RAM of a build: tools/profile_size.cpp.
+ * No Arduino headers.
+ ****************************************************************/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <utility>
+
+#define PIN_NONE -1
+
+struct BoardPins {
+  int8_t dht, mq2, soil, tilt, mpuInt;
+  int8_t buzzer, led, audioOut;
+  int8_t sdCs;
+  int8_t gpsRx, gpsTx;
+  int8_t modemRx, modemTx;
+  int8_t i2cSda, i2cScl;
+};
+
+struct BoardFeatures {
+  bool web;        // SoftAP hotspot + web UI (Wi-Fi on)
+  bool bt;         // Bluetooth serial app
+  bool sd;         // SD card (logs, journals, rules file)
+  bool modem;      // SIM800L emergency call
+  bool tts;        // SAM speech on the call (needs the modem)
+  bool bme280;     // BME280 temperature / humidity / pressure
+  bool mesh;       // ESP-NOW alert relay (Wi-Fi on)
+  bool powerSave;  // light sleep between samples
+};
+
+struct BoardProfile {
+  const char* name;
+  BoardPins pins;
+  BoardFeatures features;
+};
+
+// ==============================================================
+//                    PROFILES
+// ==============================================================
+// pins in BoardPins order, features in BoardFeatures order
+constexpr BoardProfile PROFILE_WEB = {
+  "web",
+  { 4, 33, 32, PIN_NONE, PIN_NONE, 25, PIN_NONE, PIN_NONE, PIN_NONE, 16, 17, PIN_NONE, PIN_NONE, 21, 22 },
+  { true, false, false, false, false, false, false, false },
+};
+
+constexpr BoardProfile PROFILE_BT_CALL = {
+  "bt_call",
+  { 4, 32, 34, 35, PIN_NONE, 14, 26, 25, 5, 12, 13, 16, 17, 21, 22 },
+  { false, true, true, true, true, false, false, false },
+};
+
+constexpr BoardProfile PROFILE_BT_SD = {
+  "bt_sd",
+  { 15, 34, 35, 14, 4, 27, PIN_NONE, PIN_NONE, 5, 16, 17, 26, 25, 21, 22 },
+  { false, true, true, false, false, true, true, true },
+};
+
+// ==============================================================
+//                    COMPILE-TIME CHECKS
+// ==============================================================
+constexpr bool boardPinsDistinct(const BoardProfile& p) {
+  const int8_t pins[] = { p.pins.dht,    p.pins.mq2,   p.pins.soil,    p.pins.tilt,    p.pins.mpuInt,
+                          p.pins.buzzer, p.pins.led,   p.pins.audioOut, p.pins.sdCs,   p.pins.gpsRx,
+                          p.pins.gpsTx,  p.pins.modemRx, p.pins.modemTx, p.pins.i2cSda, p.pins.i2cScl };
+  for (size_t i = 0; i < sizeof(pins); i++) {
+    for (size_t j = i + 1; j < sizeof(pins); j++) {
+      if (pins[i] != PIN_NONE && pins[i] == pins[j]) return false;
+    }
+  }
+  return true;
+}
+
+// GPIO 34-39 are inputs only
+constexpr bool boardInputOnly(int8_t pin) { return pin >= 34 && pin <= 39; }
+
+constexpr bool boardOutputsOk(const BoardProfile& p) {
+  return !boardInputOnly(p.pins.buzzer) && !boardInputOnly(p.pins.led) && !boardInputOnly(p.pins.audioOut) &&
+         !boardInputOnly(p.pins.sdCs) && !boardInputOnly(p.pins.gpsTx) && !boardInputOnly(p.pins.modemTx);
+}
+
+// ADC2 cannot be read while Wi-Fi runs: analog sensors on ADC1 (32-39)
+constexpr bool boardAnalogOk(const BoardProfile& p) {
+  bool wifi = p.features.web || p.features.mesh;
+  return !wifi || ((p.pins.mq2 >= 32 && p.pins.mq2 <= 39) && (p.pins.soil >= 32 && p.pins.soil <= 39));
+}
+
+constexpr bool boardFeaturePinsOk(const BoardProfile& p) {
+  const BoardFeatures& f = p.features;
+  return (!f.sd || p.pins.sdCs != PIN_NONE) && (!f.modem || (p.pins.modemRx != PIN_NONE && p.pins.modemTx != PIN_NONE)) &&
+         (!f.tts || (f.modem && p.pins.audioOut != PIN_NONE)) && (!f.powerSave || p.pins.mpuInt != PIN_NONE);
+}
+
+#define BOARD_CHECK(p)                                                               \
+  static_assert(boardPinsDistinct(p), #p ": two parts on one pin");                  \
+  static_assert(boardOutputsOk(p), #p ": output on an input-only pin (34-39)");     \
+  static_assert(boardAnalogOk(p), #p ": analog sensor on ADC2 with Wi-Fi on");       \
+  static_assert(boardFeaturePinsOk(p), #p ": feature on without its pins (or TTS without the modem)")
+
+BOARD_CHECK(PROFILE_WEB);
+BOARD_CHECK(PROFILE_BT_CALL);
+BOARD_CHECK(PROFILE_BT_SD);
+
+#ifdef HIMBUDDY_PROFILE
+constexpr BoardProfile BOARD = HIMBUDDY_PROFILE;
+BOARD_CHECK(BOARD);
+#endif
+
+// ==============================================================
+//                    OPTIONAL OBJECTS
+// ==============================================================
+// The object of a feature: built when the feature is on; when it is
+// off, no storage and no constructor (use it only inside
+// `if constexpr` on the same feature, where -> is never run)
+template <bool On, typename T>
+class Feature {
+public:
+  template <typename... Args>
+  Feature(Args&&... args) : obj(std::forward<Args>(args)...) {}
+  T* operator->() { return &obj; }
+  T& operator*() { return obj; }
+
+private:
+  T obj;
+};
+
+template <typename T>
+class Feature<false, T> {
+public:
+  template <typename... Args>
+  constexpr Feature(Args&&...) {}
+  T* operator->() { return nullptr; }
+};
+
+// ==============================================================
+//                    BOOT REPORT
+// ==============================================================
+// {"profile","features":[..],"bootMs","sketchBytes","freeHeap","minFreeHeap"}
+inline int bootReportJson(const BoardProfile& p, uint32_t bootMs, uint32_t sketchBytes, uint32_t freeHeap,
+                          uint32_t minFreeHeap, char* out, size_t len) {
+  const BoardFeatures& f = p.features;
+  const bool on[] = { f.web, f.bt, f.sd, f.modem, f.tts, f.bme280, f.mesh, f.powerSave };
+  const char* const names[] = { "web", "bt", "sd", "modem", "tts", "bme280", "mesh", "powerSave" };
+  int n = snprintf(out, len, "{\"profile\":\"%s\",\"features\":[", p.name);
+  bool first = true;
+  for (size_t i = 0; i < sizeof(on) && n >= 0 && (size_t)n < len; i++) {
+    if (!on[i]) continue;
+    n += snprintf(out + n, len - n, "%s\"%s\"", first ? "" : ",", names[i]);
+    first = false;
+  }
+  if (n < 0 || (size_t)n >= len) return n;
+  return n + snprintf(out + n, len - n, "],\"bootMs\":%lu,\"sketchBytes\":%lu,\"freeHeap\":%lu,\"minFreeHeap\":%lu}",
+                      (unsigned long)bootMs, (unsigned long)sketchBytes, (unsigned long)freeHeap,
+                      (unsigned long)minFreeHeap);
+}
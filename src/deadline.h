@@ -0,0 +1,201 @@
+/****************************************************************
+ * HIMBUDDY - LOOP DEADLINES + STALL TRACE (survives a reset)
+ *
+ * loop() is cut into stages (sensor read, OLED, SD log, the steps of
+ * an emergency call, ...), each with a time budget. mark(stage) ends
+ * the running stage and starts the next one; a stage that took longer
+ * than its budget goes into the stall trace with its duration and
+ * start time.
+ *
+ * The trace is a ring of STALL_RING records in RTC memory (the sketch
+ * puts it in RTC_NOINIT_ATTR), so it is still there after a watchdog
+ * reset, a panic or a brownout. Only power-on starts it over. The
+ * stage running at any moment is written there too: if the unit
+ * resets inside one (stuck I2C, a hung SD card), the next boot finds
+ * it still open and records it as unfinished, with the reset reason.
+ *
+ * Watchdog: mark() returns true when a stage finished, which is real
+ * progress; only then does the sketch feed the task watchdog. A stage
+ * that never ends starves it, the unit resets, and the trace says
+ * where it was.
+ *
+ * `logged` remembers how far the trace got onto the SD card, so every
+ * record is written there once, across boots.
+ * No heap, no Arduino headers (tools/deadline_sim.cpp runs it on a PC).
+ ****************************************************************/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define STALL_RING 32                 // records kept (oldest overwritten)
+#define STALL_MAGIC 0x4C545348u       // "HSTL"
+#define STALL_NONE 0xFF               // no stage running
+#define STALL_UNFINISHED 0xFFFFFFFFu  // durationUs: reset inside the stage
+#define DEADLINE_MAX_STAGES 16
+
+struct DeadlineStage {
+  const char* name;
+  uint32_t budgetMs;
+};
+
+struct StallRecord {
+  uint32_t seq;         // running number, over all boots
+  uint32_t atMs;        // uptime when the stage started
+  uint32_t durationUs;  // or STALL_UNFINISHED
+  uint16_t boot;        // boot number since power-on
+  uint8_t stage;
+  uint8_t resetReason;  // unfinished only: esp_reset_reason() of the next boot
+};
+
+// ==============================================================
+//                    STALL TRACE (RTC memory)
+// ==============================================================
+// Plain data: no constructor, so RTC_NOINIT_ATTR leaves it alone
+struct StallTrace {
+  uint32_t magic;
+  uint32_t next;      // seq of the next record
+  uint32_t logged;    // records before this seq are on the SD card
+  uint16_t boot;
+  uint8_t openStage;  // running now (STALL_NONE: between loop passes)
+  uint8_t reserved;
+  uint32_t openAtMs;
+  StallRecord ring[STALL_RING];
+  uint32_t check;     // FNV-1a of everything above but openStage / openAtMs
+
+  // At boot, before the first mark(). Keeps the trace unless this is a
+  // power-on or it does not check out; a stage left open by the last
+  // boot is recorded as unfinished.
+  void start(bool powerOn, uint8_t resetReason, uint8_t stageCount) {
+    if (powerOn || !valid(stageCount)) {
+      magic = STALL_MAGIC;
+      next = logged = 0;
+      boot = 0;
+      openStage = STALL_NONE;
+    }
+    if (openStage < stageCount) push(openStage, openAtMs, STALL_UNFINISHED, resetReason);
+    openStage = STALL_NONE;
+    boot++;
+    seal();
+  }
+
+  uint32_t first() const { return next > STALL_RING ? next - STALL_RING : 0; }  // oldest seq kept
+  const StallRecord& at(uint32_t seq) const { return ring[seq % STALL_RING]; }
+
+  void push(uint8_t stage, uint32_t atMs, uint32_t durationUs, uint8_t resetReason) {
+    StallRecord& r = ring[next % STALL_RING];
+    r.seq = next++;
+    r.atMs = atMs;
+    r.durationUs = durationUs;
+    r.boot = boot;
+    r.stage = stage;
+    r.resetReason = resetReason;
+    if ((int32_t)(next - logged) > STALL_RING) logged = next - STALL_RING;  // overwritten before the SD saw them
+    seal();
+  }
+
+  void setLogged(uint32_t seq) {
+    logged = seq;
+    seal();
+  }
+
+  bool valid(uint8_t stageCount) const {
+    if (magic != STALL_MAGIC || check != hash() || (int32_t)(next - logged) < 0) return false;
+    for (uint32_t s = first(); s != next; s++) {
+      if (at(s).seq != s || at(s).stage >= stageCount) return false;
+    }
+    return true;
+  }
+
+private:
+  void seal() { check = hash(); }
+
+  uint32_t hash() const {
+    uint32_t h = 2166136261u;
+    auto add = [&h](const void* p, size_t n) {
+      for (size_t i = 0; i < n; i++) h = (h ^ ((const uint8_t*)p)[i]) * 16777619u;
+    };
+    add(&magic, sizeof(magic));
+    add(&next, sizeof(next));
+    add(&logged, sizeof(logged));
+    add(&boot, sizeof(boot));
+    add(ring, sizeof(ring));
+    return h;
+  }
+};
+
+// One record as a JSON line (BT "STALLS", /stalls.log)
+inline int stallJson(const StallRecord& r, const DeadlineStage* stages, char* out, size_t len) {
+  if (r.durationUs == STALL_UNFINISHED) {
+    return snprintf(out, len, "{\"seq\":%lu,\"boot\":%u,\"stage\":\"%s\",\"at\":%lu,\"us\":null,\"reset\":%u}",
+                    (unsigned long)r.seq, r.boot, stages[r.stage].name, (unsigned long)r.atMs, r.resetReason);
+  }
+  return snprintf(out, len, "{\"seq\":%lu,\"boot\":%u,\"stage\":\"%s\",\"at\":%lu,\"us\":%lu,\"budgetMs\":%lu}",
+                  (unsigned long)r.seq, r.boot, stages[r.stage].name, (unsigned long)r.atMs,
+                  (unsigned long)r.durationUs, (unsigned long)stages[r.stage].budgetMs);
+}
+
+// ==============================================================
+//                    DEADLINE MONITOR
+// ==============================================================
+class LoopDeadline {
+public:
+  void begin(StallTrace& t, const DeadlineStage* table, uint8_t count) {
+    trace = &t;
+    stages = table;
+    stageCount = count > DEADLINE_MAX_STAGES ? DEADLINE_MAX_STAGES : count;
+    running = STALL_NONE;
+    for (uint8_t i = 0; i < DEADLINE_MAX_STAGES; i++) maxUs[i] = overruns[i] = 0;
+  }
+
+  // Ends the running stage and starts `stage`. true: a stage finished
+  // (feed the watchdog now)
+  bool mark(uint8_t stage, uint32_t nowUs, uint32_t nowMs) {
+    bool done = finish(nowUs);
+    running = stage < stageCount ? stage : STALL_NONE;
+    startUs = nowUs;
+    startMs = nowMs;
+    trace->openAtMs = nowMs;  // time first: the stage is what a reset looks at
+    trace->openStage = running;
+    return done;
+  }
+
+  // End of the loop pass: no stage running
+  bool end(uint32_t nowUs) {
+    bool done = finish(nowUs);
+    running = STALL_NONE;
+    trace->openStage = STALL_NONE;
+    return done;
+  }
+
+  uint8_t count() const { return stageCount; }
+  uint32_t worstUs(uint8_t stage) const { return maxUs[stage]; }
+  uint32_t overrunCount(uint8_t stage) const { return overruns[stage]; }
+
+  int json(uint8_t stage, char* out, size_t len) const {
+    return snprintf(out, len, "{\"stage\":\"%s\",\"budgetMs\":%lu,\"maxUs\":%lu,\"overruns\":%lu}", stages[stage].name,
+                    (unsigned long)stages[stage].budgetMs, (unsigned long)maxUs[stage],
+                    (unsigned long)overruns[stage]);
+  }
+
+private:
+  bool finish(uint32_t nowUs) {
+    if (running == STALL_NONE) return false;
+    uint32_t us = nowUs - startUs;
+    if (us > maxUs[running]) maxUs[running] = us;
+    if (us > stages[running].budgetMs * 1000) {
+      overruns[running]++;
+      trace->push(running, startMs, us, 0);
+    }
+    return true;
+  }
+
+  StallTrace* trace = nullptr;
+  const DeadlineStage* stages = nullptr;
+  uint8_t stageCount = 0;
+  uint8_t running = STALL_NONE;
+  uint32_t startUs = 0, startMs = 0;
+  uint32_t maxUs[DEADLINE_MAX_STAGES];
+  uint32_t overruns[DEADLINE_MAX_STAGES];
+};
@@ -0,0 +1,210 @@
+/****************************************************************
+ * HIMBUDDY - DHT22 PULSE DECODER + READING CACHE
+ *
+ * The DHT library bit-bangs the DHT22 reply with interrupts off for
+ * ~5 ms per call. esp32fullcode.c instead lets the RMT peripheral
+ * record the reply as (level, duration) pulses and decodes them here,
+ * in loop() time, with no timing-critical code at all.
+ *
+ * Reply (after the host's >= 1 ms low start pulse):
+ *   low 80 us, high 80 us              response
+ *   40 x (low 50 us, high 26-28 us)    bit 0
+ *        (low 50 us, high 70 us)       bit 1
+ *   bytes: humidity x10 (2), temperature x10 (2, bit 15 = minus), checksum
+ * The sensor's clock drifts with temperature and from part to part, so
+ * a bit is judged against its own low pulse (same clock): high shorter
+ * than low = 0, longer = 1. Within 1/8 of the low of each other it is
+ * an error, not a guess. A reply must also end right after bit 40:
+ * a noise spike that splits a pulse shifts every later bit, and the
+ * 8 bit checksum alone would let 1 in 256 of those through.
+ *
+ * DhtCache keeps the last good reading for the sensor's 2 s minimum
+ * period and says when the next read is due; after DHT_STALE_MS
+ * without a good reading it gives NAN, like the DHT library does.
+ *
+ * No Arduino headers: tools/dht_check.cpp runs the decoder on made-up
+ * and captured (BT "DHT_RAW") waveforms, corrupted ones included.
+ ****************************************************************/
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define DHT_MIN_PERIOD_MS 2000   // DHT22: one conversion per 2 s
+#define DHT_STALE_MS 10000       // no good reading this long -> NAN
+#define DHT_START_US 1100        // host start pulse (>= 1 ms)
+#define DHT_IDLE_US 250          // line high this long: reply over
+
+// pulse windows (us), wide: +-30 % and more
+#define DHT_RESP_MIN 40
+#define DHT_RESP_MAX 120
+#define DHT_LOW_MIN 20
+#define DHT_LOW_MAX 90
+#define DHT_HIGH_MIN 8
+#define DHT_HIGH_MAX 110
+
+enum DhtStatus : uint8_t {
+  DHT_OK,
+  DHT_NO_REPLY,       // no response pulses (no sensor, wiring)
+  DHT_TRUNCATED,      // reply stopped before 40 bits
+  DHT_BAD_TIMING,     // a pulse outside every window
+  DHT_CHECKSUM,
+  DHT_OUT_OF_RANGE,   // checksum fine, value impossible for a DHT22
+  DHT_STATUS_COUNT
+};
+
+inline const char* dhtStatusName(uint8_t s) {
+  static const char* const names[] = { "ok", "no_reply", "truncated", "bad_timing", "checksum", "out_of_range" };
+  return s < DHT_STATUS_COUNT ? names[s] : "?";
+}
+
+struct DhtPulse {
+  uint8_t level;
+  uint16_t us;
+};
+
+struct DhtReading {
+  uint8_t status;
+  float temperature;   // C
+  float humidity;      // %
+  uint8_t bytes[5];
+};
+
+// RMT RX words (duration0:15, level0:1, duration1:15, level1:1, 1 us
+// ticks) -> pulses. A zero duration ends the capture; equal levels next
+// to each other are joined. Returns the pulse count.
+inline size_t dhtPulsesFromSymbols(const uint32_t* words, size_t n, DhtPulse* out, size_t max) {
+  size_t k = 0;
+  for (size_t i = 0; i < n; i++) {
+    for (int half = 0; half < 2; half++) {
+      uint32_t w = half ? words[i] >> 16 : words[i];
+      uint16_t us = (uint16_t)(w & 0x7FFF);
+      uint8_t level = (uint8_t)((w >> 15) & 1);
+      if (us == 0) return k;
+      if (k > 0 && out[k - 1].level == level) {
+        uint32_t sum = (uint32_t)out[k - 1].us + us;
+        out[k - 1].us = (uint16_t)(sum > 0xFFFF ? 0xFFFF : sum);
+        continue;
+      }
+      if (k == max) return k;
+      out[k].level = level;
+      out[k].us = us;
+      k++;
+    }
+  }
+  return k;
+}
+
+inline bool dhtIn(uint16_t us, uint16_t lo, uint16_t hi) { return us >= lo && us <= hi; }
+
+inline DhtReading dhtDecode(const DhtPulse* p, size_t n) {
+  DhtReading r = { DHT_NO_REPLY, NAN, NAN, { 0, 0, 0, 0, 0 } };
+  // response: low ~80 then high ~80, within the first few pulses (the
+  // capture may start with the end of the start pulse and the pull-up)
+  size_t i = 0;
+  for (; i + 1 < n && i < 4; i++) {
+    if (p[i].level == 0 && dhtIn(p[i].us, DHT_RESP_MIN, DHT_RESP_MAX) && p[i + 1].level == 1 &&
+        dhtIn(p[i + 1].us, DHT_RESP_MIN, DHT_RESP_MAX)) {
+      break;
+    }
+  }
+  if (i + 1 >= n || i >= 4) {
+    r.status = n < 4 ? DHT_NO_REPLY : DHT_BAD_TIMING;
+    return r;
+  }
+  i += 2;
+
+  for (uint8_t bit = 0; bit < 40; bit++, i += 2) {
+    if (i + 1 >= n) {
+      r.status = DHT_TRUNCATED;
+      return r;
+    }
+    const DhtPulse& lo = p[i];
+    const DhtPulse& hi = p[i + 1];
+    if (lo.level != 0 || hi.level != 1 || !dhtIn(lo.us, DHT_LOW_MIN, DHT_LOW_MAX)) {
+      r.status = DHT_BAD_TIMING;
+      return r;
+    }
+    int diff = (int)hi.us - (int)lo.us;  // 0: ~27 - 50, 1: ~70 - 50
+    int margin = lo.us / 8;
+    if (!dhtIn(hi.us, DHT_HIGH_MIN, DHT_HIGH_MAX) || (diff <= margin && diff >= -margin)) {
+      r.status = DHT_BAD_TIMING;
+      return r;
+    }
+    r.bytes[bit / 8] = (uint8_t)((r.bytes[bit / 8] << 1) | (diff > 0 ? 1 : 0));
+  }
+  // then one last low (and maybe the start of the idle high), nothing more
+  if (i >= n) {
+    r.status = DHT_TRUNCATED;
+    return r;
+  }
+  if (n - i > 2 || p[i].level != 0 || !dhtIn(p[i].us, DHT_LOW_MIN, DHT_LOW_MAX)) {
+    r.status = DHT_BAD_TIMING;
+    return r;
+  }
+
+  if ((uint8_t)(r.bytes[0] + r.bytes[1] + r.bytes[2] + r.bytes[3]) != r.bytes[4]) {
+    r.status = DHT_CHECKSUM;
+    return r;
+  }
+  float h = ((r.bytes[0] << 8) | r.bytes[1]) * 0.1f;
+  float t = (((r.bytes[2] & 0x7F) << 8) | r.bytes[3]) * 0.1f;
+  if (r.bytes[2] & 0x80) t = -t;
+  if (h > 100.0f || t < -40.0f || t > 80.0f) {
+    r.status = DHT_OUT_OF_RANGE;
+    return r;
+  }
+  r.status = DHT_OK;
+  r.temperature = t;
+  r.humidity = h;
+  return r;
+}
+
+// ==============================================================
+//                    READING CACHE
+// ==============================================================
+class DhtCache {
+public:
+  // a new read may start (the sensor's minimum period is over)
+  bool due(uint32_t nowMs) const { return !startedOnce || nowMs - lastStart >= DHT_MIN_PERIOD_MS; }
+
+  void started(uint32_t nowMs) {
+    startedOnce = true;
+    lastStart = nowMs;
+  }
+
+  void update(uint32_t nowMs, const DhtReading& r) {
+    if (r.status < DHT_STATUS_COUNT) counts[r.status]++;
+    last = r.status;
+    if (r.status != DHT_OK) return;
+    t = r.temperature;
+    h = r.humidity;
+    goodOnce = true;
+    lastGood = nowMs;
+  }
+
+  bool fresh(uint32_t nowMs) const { return goodOnce && nowMs - lastGood < DHT_STALE_MS; }
+  float temperature(uint32_t nowMs) const { return fresh(nowMs) ? t : NAN; }
+  float humidity(uint32_t nowMs) const { return fresh(nowMs) ? h : NAN; }
+  uint8_t lastStatus() const { return last; }
+  uint32_t count(uint8_t status) const { return status < DHT_STATUS_COUNT ? counts[status] : 0; }
+
+  int json(char* out, size_t len, uint32_t nowMs) const {
+    return snprintf(out, len,
+                    "{\"t\":%.1f,\"h\":%.1f,\"ageMs\":%ld,\"last\":\"%s\",\"ok\":%lu,\"noReply\":%lu,"
+                    "\"truncated\":%lu,\"badTiming\":%lu,\"checksum\":%lu,\"outOfRange\":%lu}",
+                    fresh(nowMs) ? t : 0.0, fresh(nowMs) ? h : 0.0, goodOnce ? (long)(nowMs - lastGood) : -1L,
+                    dhtStatusName(last), (unsigned long)counts[DHT_OK], (unsigned long)counts[DHT_NO_REPLY],
+                    (unsigned long)counts[DHT_TRUNCATED], (unsigned long)counts[DHT_BAD_TIMING],
+                    (unsigned long)counts[DHT_CHECKSUM], (unsigned long)counts[DHT_OUT_OF_RANGE]);
+  }
+
+private:
+  float t = NAN, h = NAN;
+  bool startedOnce = false, goodOnce = false;
+  uint32_t lastStart = 0, lastGood = 0;
+  uint8_t last = DHT_NO_REPLY;
+  uint32_t counts[DHT_STATUS_COUNT] = {};
+};
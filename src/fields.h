@@ -0,0 +1,358 @@
+/****************************************************************
+ * HIMBUDDY - FIELD SCHEMA + FIXED-POINT FORMATTER
+ *
+ * A record (plain struct) is described once, as a table of FieldDef:
+ * name, type, decimals and where the member sits. The same table
+ * writes it
+ *   JSON    "name":value,...   text values quoted (not escaped)
+ *   CSV     value,value,...    text values quoted
+ *   binary  little endian, per field: text = length byte + bytes,
+ *           int = int32, float / double = int32 of value x 10^decimals
+ *           (NAN: INT32_MIN), lat/lng = two of those
+ * straight into the caller's buffer, no heap.
+ *
+ * Numbers are printed with integer arithmetic only: the double is
+ * split into its 53 bit mantissa and binary exponent, the mantissa
+ * multiplied by 5^decimals exactly (128 bits in two 64 bit halves) and
+ * shifted down, rounding half to even on the exact value the way
+ * printf does. So fieldsFixed(v, 2) is byte for byte "%.2f", without
+ * the newlib float printf. NAN / inf, |v| >= 1e9 or more than 9
+ * decimals fall back to snprintf (never seen in sensor data).
+ *
+ * No Arduino headers: tools/fields_check.cpp compares every format
+ * with its snprintf version on random values and times both.
+ ****************************************************************/
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FIELDS_MAX_DECIMALS 9
+#define FIELDS_NUM_LEN 24      // longest fieldsFixed() text + NUL
+
+enum FieldType : uint8_t {
+  FIELD_TEXT,     // const char* (NULL = "")
+  FIELD_INT,      // int32_t
+  FIELD_FLOAT,    // float
+  FIELD_DOUBLE,   // double
+  FIELD_LATLNG,   // double lat, lng next to each other: "lat,lng" text
+};
+
+enum FieldFlag : uint8_t {
+  FIELD_NAN_ZERO = 1,    // NAN written as 0 (sensor missing)
+  FIELD_OMIT_ZERO = 2,   // JSON: left out when 0 (lat/lng: both 0)
+};
+
+struct FieldDef {
+  const char* name;
+  uint8_t type;
+  uint8_t decimals;
+  uint8_t flags;
+  uint16_t offset;       // offsetof(record, member)
+};
+
+// ==============================================================
+//                    NUMBERS
+// ==============================================================
+// "00".."99": two digits per divide
+inline const char* fieldsDigitPairs() {
+  static const char PAIRS[] =
+      "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+      "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+      "8081828384858687888990919293949596979899";
+  return PAIRS;
+}
+
+// exactly `digits` digits of v (zero padded) ending at end
+inline void fieldsDigitsBack(char* end, uint32_t v, int digits) {
+  const char* pairs = fieldsDigitPairs();
+  for (; digits >= 2; digits -= 2) {
+    const char* d = pairs + 2 * (v % 100);
+    v /= 100;
+    *--end = d[1];
+    *--end = d[0];
+  }
+  if (digits) *--end = (char)('0' + v % 10);
+}
+
+inline int fieldsDigitCount(uint32_t v) {
+  int n = 1;
+  while (v >= 100) {
+    v /= 100;
+    n += 2;
+  }
+  return n + (v >= 10);
+}
+
+inline size_t fieldsU32(char* out, uint32_t v) {
+  int n = fieldsDigitCount(v);
+  fieldsDigitsBack(out + n, v, n);
+  return (size_t)n;
+}
+
+// v with `decimals` digits after the point, as printf("%.*f") writes
+// it; out holds FIELDS_NUM_LEN. Returns the length, 0 if v is outside
+// the exact range (the caller uses snprintf then).
+inline size_t fieldsFixed(char* out, double v, uint8_t decimals) {
+  static const uint32_t POW5[] = { 1, 5, 25, 125, 625, 3125, 15625, 78125, 390625, 1953125 };
+  static const uint32_t POW10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+  if (decimals > FIELDS_MAX_DECIMALS || !(fabs(v) < 1e9)) return 0;  // (NAN fails the compare too)
+
+  // |v| = mant * 2^(e - 53) exactly, straight from the IEEE 754 bits
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  bool neg = bits >> 63;  // "-0.00" like printf
+  int e = (int)((bits >> 52) & 0x7FF) - 1022;
+  uint64_t mant = bits & 0xFFFFFFFFFFFFFull;
+  if (e == -1022) e++;          // subnormal: no hidden bit
+  else mant |= 1ull << 52;
+
+  // |v| * 10^d = mant * 5^d * 2^(e - 53 + d); mant * 5^d < 2^75 -> hi:lo
+  uint64_t a = (mant & 0xFFFFFFFFu) * POW5[decimals];
+  uint64_t b = (mant >> 32) * POW5[decimals];
+  uint64_t lo = a + (b << 32);
+  uint64_t hi = (b >> 32) + (lo < a);
+  int shift = e - 53 + decimals;
+
+  uint64_t q;  // |v| * 10^d rounded, < 1e18
+  if (shift >= 0) {
+    q = lo << shift;  // (only for |v| >= 2^43, not in range: kept for safety)
+  } else {
+    unsigned s = (unsigned)-shift;
+    int cmp;  // dropped bits against half of the last kept one: -1, 0, 1
+    if (s < 64) {
+      q = (lo >> s) | (hi << (64 - s));
+      uint64_t rem = lo & ((1ull << s) - 1), half = 1ull << (s - 1);
+      cmp = rem < half ? -1 : rem > half;
+    } else if (s == 64) {
+      q = hi;
+      cmp = lo < (1ull << 63) ? -1 : lo > (1ull << 63);
+    } else if (s < 128) {
+      q = hi >> (s - 64);
+      uint64_t remHi = hi & ((1ull << (s - 64)) - 1), halfHi = 1ull << (s - 65);
+      cmp = remHi < halfHi ? -1 : (remHi > halfHi || lo) ? 1 : 0;
+    } else {
+      q = 0;
+      cmp = -1;  // the whole product is below 2^75 <= half
+    }
+    if (cmp > 0 || (cmp == 0 && (q & 1))) q++;
+  }
+
+  // integer and fraction parts both fit 32 bits: no 64 bit divides per
+  // digit, and none at all for sensor values (q < 2^32)
+  uint32_t whole, frac;
+  if (q <= UINT32_MAX) {
+    whole = (uint32_t)q / POW10[decimals];
+    frac = (uint32_t)q - whole * POW10[decimals];
+  } else {
+    whole = (uint32_t)(q / POW10[decimals]);
+    frac = (uint32_t)(q - (uint64_t)whole * POW10[decimals]);
+  }
+  char* p = out;
+  if (neg) *p++ = '-';
+  p += fieldsU32(p, whole);
+  if (decimals) {
+    *p++ = '.';
+    p += decimals;
+    fieldsDigitsBack(p, frac, decimals);
+  }
+  *p = 0;
+  return (size_t)(p - out);
+}
+
+// value x 10^decimals as the int32 the binary encoding carries
+inline int32_t fieldsScaled(double v, uint8_t decimals) {
+  if (isnan(v)) return INT32_MIN;
+  double s = v * pow(10.0, decimals);
+  if (s >= 2147483647.0) return INT32_MAX;
+  if (s <= -2147483647.0) return -INT32_MAX;
+  return (int32_t)lround(s);
+}
+
+// ==============================================================
+//                    WRITER
+// ==============================================================
+// Appends to a fixed buffer; past its end text is counted, not
+// written, so finish() returns what snprintf would have.
+class FieldWriter {
+public:
+  FieldWriter(char* buf, size_t size) : out(buf), cap(size) {}
+
+  void put(char c) {
+    if (n + 1 < cap) out[n] = c;
+    n++;
+  }
+  void put(const char* s) { put(s, strlen(s)); }
+  // a few chars only known at run time (field names, text values): a
+  // byte loop is cheaper than the strlen + memcpy calls
+  void putShort(const char* s) {
+    while (*s && n + 1 < cap) out[n++] = *s++;
+    for (; *s; s++) n++;
+  }
+  void put(const char* s, size_t len) {
+    if (n + len < cap) {
+      memcpy(out + n, s, len);
+      n += len;
+      return;
+    }
+    for (size_t i = 0; i < len; i++) put(s[i]);
+  }
+
+  void putInt(int32_t v) {
+    char num[12];
+    char* p = n + sizeof(num) <= cap ? out + n : num;  // room: straight into the buffer
+    size_t k = 0;
+    if (v < 0) p[k++] = '-';
+    k += fieldsU32(p + k, v < 0 ? 0u - (uint32_t)v : (uint32_t)v);
+    if (p == num) put(num, k);
+    else n += k;
+  }
+
+  void putFixed(double v, uint8_t decimals) {
+    if (n + FIELDS_NUM_LEN <= cap) {
+      // room for any number: straight into the buffer
+      size_t k = fieldsFixed(out + n, v, decimals);
+      n += k;
+      if (k) return;
+    } else {
+      char num[FIELDS_NUM_LEN];
+      size_t k = fieldsFixed(num, v, decimals);
+      put(num, k);
+      if (k) return;
+    }
+    putSlow(v, decimals);
+  }
+
+  // NUL terminates; the full length, like snprintf's return
+  int finish() {
+    if (cap) out[n < cap ? n : cap - 1] = 0;
+    return (int)n;
+  }
+
+private:
+  void putSlow(double v, uint8_t decimals) {
+    char big[328];  // "%.9f" of DBL_MAX
+    snprintf(big, sizeof(big), "%.*f", (int)decimals, v);
+    put(big);
+  }
+
+  char* out;
+  size_t cap;
+  size_t n = 0;
+};
+
+// ==============================================================
+//                    SCHEMA
+// ==============================================================
+inline const char* fieldText(const FieldDef& f, const void* rec) {
+  const char* s = *(const char* const*)((const char*)rec + f.offset);
+  return s ? s : "";
+}
+
+inline int32_t fieldInt(const FieldDef& f, const void* rec) {
+  return *(const int32_t*)((const char*)rec + f.offset);
+}
+
+// FLOAT / DOUBLE value (i = 1: the lng of a LATLNG), NAN_ZERO applied
+inline double fieldNumber(const FieldDef& f, const void* rec, int i = 0) {
+  const char* at = (const char*)rec + f.offset;
+  double v = f.type == FIELD_FLOAT ? (double)*(const float*)at : ((const double*)at)[i];
+  return (f.flags & FIELD_NAN_ZERO) && isnan(v) ? 0.0 : v;
+}
+
+inline bool fieldZero(const FieldDef& f, const void* rec) {
+  switch (f.type) {
+    case FIELD_TEXT: return fieldText(f, rec)[0] == 0;
+    case FIELD_INT: return fieldInt(f, rec) == 0;
+    case FIELD_LATLNG: return fieldNumber(f, rec, 0) == 0.0 && fieldNumber(f, rec, 1) == 0.0;
+    default: return fieldNumber(f, rec) == 0.0;
+  }
+}
+
+inline void fieldValue(FieldWriter& w, const FieldDef& f, const void* rec) {
+  switch (f.type) {
+    case FIELD_TEXT:
+      w.put('"');
+      w.put(fieldText(f, rec));
+      w.put('"');
+      break;
+    case FIELD_INT:
+      w.putInt(fieldInt(f, rec));
+      break;
+    case FIELD_LATLNG:
+      w.put('"');
+      w.putFixed(fieldNumber(f, rec, 0), f.decimals);
+      w.put(',');
+      w.putFixed(fieldNumber(f, rec, 1), f.decimals);
+      w.put('"');
+      break;
+    default:
+      w.putFixed(fieldNumber(f, rec), f.decimals);
+  }
+}
+
+// "name":value pairs, no braces: a reply can put its own fields around
+inline void fieldsJson(FieldWriter& w, const FieldDef* f, size_t n, const void* rec) {
+  bool first = true;
+  for (size_t i = 0; i < n; i++) {
+    if ((f[i].flags & FIELD_OMIT_ZERO) && fieldZero(f[i], rec)) continue;
+    if (!first) w.put(',');
+    first = false;
+    w.put('"');
+    w.putShort(f[i].name);
+    w.put("\":");
+    fieldValue(w, f[i], rec);
+  }
+}
+
+inline void fieldsCsv(FieldWriter& w, const FieldDef* f, size_t n, const void* rec) {
+  for (size_t i = 0; i < n; i++) {
+    if (i) w.put(',');
+    fieldValue(w, f[i], rec);
+  }
+}
+
+inline void fieldsCsvHeader(FieldWriter& w, const FieldDef* f, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (i) w.put(',');
+    w.putShort(f[i].name);
+  }
+}
+
+// Binary encoding (see top); returns the bytes written, 0 if len is too small
+inline size_t fieldsBinary(uint8_t* out, size_t len, const FieldDef* f, size_t n, const void* rec) {
+  size_t at = 0;
+  auto i32 = [&](int32_t v) {
+    if (at + 4 > len) return false;
+    for (int b = 0; b < 4; b++) out[at++] = (uint8_t)((uint32_t)v >> (8 * b));
+    return true;
+  };
+  for (size_t i = 0; i < n; i++) {
+    bool ok;
+    switch (f[i].type) {
+      case FIELD_TEXT: {
+        const char* s = fieldText(f[i], rec);
+        size_t k = strlen(s);
+        if (k > 255) k = 255;
+        ok = at + 1 + k <= len;
+        if (ok) {
+          out[at++] = (uint8_t)k;
+          memcpy(out + at, s, k);
+          at += k;
+        }
+        break;
+      }
+      case FIELD_INT: ok = i32(fieldInt(f[i], rec)); break;
+      case FIELD_LATLNG:
+        ok = i32(fieldsScaled(fieldNumber(f[i], rec, 0), f[i].decimals)) &&
+             i32(fieldsScaled(fieldNumber(f[i], rec, 1), f[i].decimals));
+        break;
+      default: ok = i32(fieldsScaled(fieldNumber(f[i], rec), f[i].decimals));
+    }
+    if (!ok) return 0;
+  }
+  return at;
+}
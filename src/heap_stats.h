@@ -0,0 +1,79 @@
+/****************************************************************
+ * HIMBUDDY - HEAP TELEMETRY (ESP32 ONLY)
+ *
+ * Tracks what matters for units that run for weeks:
+ *   - free / lowest-ever free bytes
+ *   - largest free block (a big request fails when this is small,
+ *     even with plenty of free bytes = fragmentation)
+ *   - allocated blocks, and how many were added since the previous
+ *     sample (keeps growing = something allocates and keeps it)
+ *   - failed allocations (counted by an IDF callback)
+ *
+ * heap_caps_get_info() walks the heap, so poll() only samples every
+ * few seconds. Allocations that are freed again between two samples
+ * are not visible here; the hot paths simply use none (fixed buffers).
+ ****************************************************************/
+#pragma once
+
+#include <esp_heap_caps.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct HeapStats {
+  uint32_t freeBytes;
+  uint32_t minFree;      // lowest free since boot
+  uint32_t largestBlock;
+  uint32_t allocBlocks;
+  uint8_t fragPct;       // 100 - largest block as % of free
+};
+
+inline HeapStats heapStatsNow() {
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+  HeapStats s;
+  s.freeBytes = (uint32_t)info.total_free_bytes;
+  s.minFree = (uint32_t)info.minimum_free_bytes;
+  s.largestBlock = (uint32_t)info.largest_free_block;
+  s.allocBlocks = (uint32_t)info.allocated_blocks;
+  s.fragPct = s.freeBytes ? (uint8_t)(100 - (uint64_t)s.largestBlock * 100 / s.freeBytes) : 0;
+  return s;
+}
+
+class HeapWatch {
+public:
+  void begin(uint32_t now) {
+    heap_caps_register_failed_alloc_callback(onFailedAlloc);
+    last = heapStatsNow();
+    lastMs = now;
+  }
+
+  // Takes a new sample every periodMs; true when it did
+  bool poll(uint32_t now, uint32_t periodMs = 10000) {
+    if (now - lastMs < periodMs) return false;
+    lastMs = now;
+    HeapStats s = heapStatsNow();
+    blockDelta = (int32_t)(s.allocBlocks - last.allocBlocks);
+    last = s;
+    return true;
+  }
+
+  const HeapStats& stats() const { return last; }
+
+  // {"free":..,"minFree":..,"largest":..,"frag":..,"blocks":..,"blockDelta":..,"failed":..}
+  int json(char* out, size_t len) const {
+    return snprintf(out, len,
+                    "{\"free\":%lu,\"minFree\":%lu,\"largest\":%lu,\"frag\":%u,\"blocks\":%lu,\"blockDelta\":%ld,\"failed\":%lu}",
+                    (unsigned long)last.freeBytes, (unsigned long)last.minFree, (unsigned long)last.largestBlock,
+                    (unsigned)last.fragPct, (unsigned long)last.allocBlocks, (long)blockDelta,
+                    (unsigned long)failedAllocs);
+  }
+
+  static inline volatile uint32_t failedAllocs = 0;
+
+private:
+  static void onFailedAlloc(size_t size, uint32_t caps, const char* fn) { failedAllocs++; }
+
+  HeapStats last = {};
+  uint32_t lastMs = 0;
+  int32_t blockDelta = 0;
+};
@@ -0,0 +1,185 @@
+/****************************************************************
+ * HIMBUDDY - MULTI-RESOLUTION SENSOR HISTORY (IN RAM)
+ *
+ * Three fixed-size rings, filled from one 1 Hz sample stream:
+ *   - SECONDS : last 10 min, 1 value per second
+ *   - MINUTES : last 24 h,   min/max/mean per minute
+ *   - HOURS   : last 30 days, min/max/mean per hour
+ *
+ * Every sample goes straight into the second ring and into the
+ * running minute + hour accumulators, so work per sample is O(1)
+ * and nothing is ever re-scanned. No heap, no Arduino headers
+ * (so the same code can be compiled on a PC).
+ ****************************************************************/
+#pragma once
+
+#include <stdint.h>
+
+// Value stored when a channel had no valid reading (eg. DHT NaN)
+#define HISTORY_NO_DATA INT16_MIN
+
+// ==============================================================
+//                    FIXED SIZE RING
+// ==============================================================
+template <typename T, uint16_t CAP>
+class HistoryRing {
+public:
+  void push(const T& item) {
+    buf[head] = item;
+    head = (head + 1) % CAP;
+    if (count < CAP) count++;
+  }
+
+  // i = 0 is the OLDEST entry still kept
+  const T& at(uint16_t i) const { return buf[(head + CAP - count + i) % CAP]; }
+
+  uint16_t size() const { return count; }
+  static uint16_t capacity() { return CAP; }
+
+private:
+  T buf[CAP];
+  uint16_t head = 0;
+  uint16_t count = 0;
+};
+
+// ==============================================================
+//                    ROLLUP (MIN / MAX / MEAN)
+// ==============================================================
+template <uint8_t N>
+struct HistoryPoint {
+  int16_t v[N];
+};
+
+template <uint8_t N>
+struct HistoryRollup {
+  int16_t lo[N];
+  int16_t hi[N];
+  int16_t avg[N];
+};
+
+template <uint8_t N>
+class HistoryAccum {
+public:
+  HistoryAccum() { reset(); }
+
+  void reset() {
+    for (uint8_t c = 0; c < N; c++) { sum[c] = 0; n[c] = 0; lo[c] = INT16_MAX; hi[c] = INT16_MIN; }
+  }
+
+  void add(const HistoryPoint<N>& p) {
+    for (uint8_t c = 0; c < N; c++) {
+      int16_t v = p.v[c];
+      if (v == HISTORY_NO_DATA) continue; // skip missing readings
+      sum[c] += v;
+      n[c]++;
+      if (v < lo[c]) lo[c] = v;
+      if (v > hi[c]) hi[c] = v;
+    }
+  }
+
+  // Number of valid readings folded into channel c
+  uint16_t count(uint8_t c) const { return n[c]; }
+
+  HistoryRollup<N> result() const {
+    HistoryRollup<N> r;
+    for (uint8_t c = 0; c < N; c++) {
+      if (n[c] == 0) { r.lo[c] = r.hi[c] = r.avg[c] = HISTORY_NO_DATA; continue; }
+      r.lo[c] = lo[c];
+      r.hi[c] = hi[c];
+      r.avg[c] = (int16_t)(sum[c] / (int32_t)n[c]);
+    }
+    return r;
+  }
+
+private:
+  int32_t sum[N];
+  uint16_t n[N];
+  int16_t lo[N];
+  int16_t hi[N];
+};
+
+// ==============================================================
+//                    THREE-TIER HISTORY
+// ==============================================================
+template <uint8_t N>
+class SensorHistory {
+public:
+  static const uint16_t SEC_SLOTS  = 600;  // 10 min @ 1 s
+  static const uint16_t MIN_SLOTS  = 1440; // 24 h   @ 1 min
+  static const uint16_t HOUR_SLOTS = 720;  // 30 d   @ 1 h
+
+  HistoryRing<HistoryPoint<N>, SEC_SLOTS>   seconds;
+  HistoryRing<HistoryRollup<N>, MIN_SLOTS>  minutes;
+  HistoryRing<HistoryRollup<N>, HOUR_SLOTS> hours;
+
+  // Add the reading for uptime second 'sec' (a counter that does not
+  // wrap in practice: millis() / 1000 does, after 49.7 days). If the
+  // caller was late (blocked loop), the missing seconds are filled with
+  // this reading, so every tier stays aligned to wall-clock seconds.
+  void record(uint32_t sec, const HistoryPoint<N>& p) {
+    if (started && (int32_t)(sec - nextSec) < 0) return; // same second again
+    if (!started) { nextSec = sec; started = true; }
+
+    if (sec - nextSec >= SEC_SLOTS) {
+      // Long stall: only the last 10 min get the current reading,
+      // everything before that is "no data", skipped in one step.
+      skip(sec - nextSec - SEC_SLOTS + 1);
+    }
+    while ((int32_t)(sec - nextSec) >= 0) pushOne(p);
+  }
+
+  // Uptime second of the newest 1 s sample (valid once size() > 0)
+  uint32_t lastSecond() const { return nextSec - 1; }
+
+  // Seconds already folded into the current (open) minute / hour
+  uint16_t openMinuteSecs() const { return minuteFill; }
+  uint16_t openHourSecs() const { return hourFill; }
+
+private:
+  // n seconds without data. Only closed minutes / hours are pushed (at
+  // most a ring full each, whatever n is); the second ring is refilled
+  // by record() right after, so it is left alone.
+  void skip(uint32_t n) {
+    nextSec += n;
+    skipTier(minuteAcc, minuteFill, 60, minutes, n);
+    skipTier(hourAcc, hourFill, 3600, hours, n);
+  }
+
+  template <typename Ring>
+  static void skipTier(HistoryAccum<N>& acc, uint16_t& fill, uint16_t len, Ring& ring, uint32_t n) {
+    if (n < (uint32_t)(len - fill)) { fill += n; return; }
+    n -= len - fill;
+    ring.push(acc.result());  // the open bucket ends
+    acc.reset();
+    uint32_t empty = n / len;
+    if (empty > Ring::capacity()) empty = Ring::capacity();
+    HistoryRollup<N> none = acc.result();  // nothing added: all NO_DATA
+    while (empty--) ring.push(none);
+    fill = n % len;
+  }
+
+  void pushOne(const HistoryPoint<N>& p) {
+    seconds.push(p);
+    minuteAcc.add(p);
+    hourAcc.add(p);
+    nextSec++;
+
+    if (++minuteFill >= 60) {
+      minutes.push(minuteAcc.result());
+      minuteAcc.reset();
+      minuteFill = 0;
+    }
+    if (++hourFill >= 3600) {
+      hours.push(hourAcc.result());
+      hourAcc.reset();
+      hourFill = 0;
+    }
+  }
+
+  HistoryAccum<N> minuteAcc;
+  HistoryAccum<N> hourAcc;
+  uint16_t minuteFill = 0;
+  uint16_t hourFill = 0;
+  uint32_t nextSec = 0;
+  bool started = false;
+};
@@ -0,0 +1,302 @@
+/****************************************************************
+ * HIMBUDDY - RING JOURNAL (power-loss safe log on the SD card)
+ *
+ * A file of a fixed size, made once (zero filled), that is written as
+ * a circular log of 512 byte blocks. Appending never grows a file, so
+ * FAT never allocates clusters or touches the FAT table mid-run, and
+ * every append costs the same: one block write + sync.
+ *
+ * Block  : header (magic, block seq, used bytes, records, CRC32) +
+ *          records. A block lives at index seq % blocks, so its seq
+ *          says where it is and which lap of the ring it belongs to.
+ * Record : record seq, length, kind + the bytes (a text line). A
+ *          record never spans two blocks.
+ * Append : the record is added to the head block in RAM and the whole
+ *          block is rewritten in place. A full block is left as it is
+ *          and the next record starts block seq + 1.
+ *
+ * A power cut can only tear the block being written: its CRC fails
+ * and the block is dropped on the next boot. So at most the records
+ * of the last (partial) block are lost; every older block is intact.
+ *
+ * Recovery (begin): blocks 0..head are on the current lap, the rest
+ * on the previous one (or empty), so the head is found with a binary
+ * search over the block headers: ~log2(blocks) + 2 block reads, not a
+ * scan of the card.
+ *
+ * The file is behind JournalStore: an Arduino SD File on the unit, a
+ * disk image file in tools/journal_sim.cpp (power-cut tests, dump).
+ * No heap, no Arduino headers. Not thread safe.
+ ****************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define JOURNAL_BLOCK_SIZE 512
+#define JOURNAL_MAGIC 0x4A425548u      // "HUBJ"
+
+struct JournalBlockHeader {
+  uint32_t magic;
+  uint32_t seq;       // block seq (index = seq % blocks)
+  uint16_t used;      // payload bytes
+  uint16_t records;
+  uint32_t crc;       // CRC32 of the header (crc = 0) + used payload bytes
+};
+
+struct JournalRecordHeader {
+  uint32_t seq;       // record seq, +1 per record over the whole journal
+  uint16_t len;
+  uint16_t kind;      // caller's tag (alert, snapshot, ...)
+};
+
+static_assert(sizeof(JournalBlockHeader) == 16, "written as raw bytes");
+static_assert(sizeof(JournalRecordHeader) == 8, "written as raw bytes");
+
+#define JOURNAL_PAYLOAD (JOURNAL_BLOCK_SIZE - sizeof(JournalBlockHeader))
+#define JOURNAL_RECORD_MAX (JOURNAL_PAYLOAD - sizeof(JournalRecordHeader))  // 488 bytes
+
+struct JournalBlock {
+  JournalBlockHeader h;
+  uint8_t payload[JOURNAL_PAYLOAD];
+};
+
+static_assert(sizeof(JournalBlock) == JOURNAL_BLOCK_SIZE, "one SD sector");
+
+// CRC32 (IEEE, reflected), 16 entry table: small and fast enough for
+// 512 bytes next to an SD write
+inline uint32_t journalCrc(uint32_t crc, const uint8_t* p, size_t len) {
+  static const uint32_t T[16] = { 0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+                                  0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+                                  0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C };
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= p[i];
+    crc = (crc >> 4) ^ T[crc & 15];
+    crc = (crc >> 4) ^ T[crc & 15];
+  }
+  return ~crc;
+}
+
+// ==============================================================
+//                    STORAGE INTERFACE
+// ==============================================================
+class JournalStore {
+public:
+  virtual ~JournalStore() {}
+  virtual bool read(uint32_t offset, uint8_t* buf, size_t len) = 0;
+  virtual bool write(uint32_t offset, const uint8_t* buf, size_t len) = 0;
+  virtual bool sync() = 0;
+};
+
+// ==============================================================
+//                    JOURNAL
+// ==============================================================
+class Journal {
+public:
+  // store holds blocks * JOURNAL_BLOCK_SIZE bytes (zero filled when new)
+  bool begin(JournalStore& s, uint32_t blockCount) {
+    store = &s;
+    blocks = blockCount;
+    reads = 0;
+    writeErrors = 0;
+    unwritten = false;
+    if (blocks < 2) return false;
+    recover();
+    recoveryReadCount = reads;
+    return true;
+  }
+
+  // Adds one record and writes it through to the store. false: too long,
+  // or the store failed (the record stays in RAM and goes out with the next)
+  bool append(uint16_t kind, const void* data, size_t len) {
+    if (!store || len > JOURNAL_RECORD_MAX) return false;
+    if (cur.h.used + sizeof(JournalRecordHeader) + len > JOURNAL_PAYLOAD) {
+      // head block full: it stays as written, the record starts the next one
+      if (unwritten) writeHead();  // (after a store error only)
+      cur.h.seq++;
+      cur.h.used = 0;
+      cur.h.records = 0;
+    }
+    JournalRecordHeader r = { nextRecord++, (uint16_t)len, kind };
+    memcpy(cur.payload + cur.h.used, &r, sizeof(r));
+    memcpy(cur.payload + cur.h.used + sizeof(r), data, len);
+    cur.h.used += (uint16_t)(sizeof(r) + len);
+    cur.h.records++;
+    cur.h.crc = blockCrc(cur);
+    return writeHead();
+  }
+
+  // Every record still in the ring, oldest first: fn(seq, kind, data, len).
+  // scratch is one block of the caller's RAM (the head block is not touched).
+  template <typename Fn>
+  uint32_t forEach(JournalBlock& scratch, Fn fn) {
+    return forEachFrom(scratch, firstSeq(), [&](uint32_t seq, uint16_t kind, const char* data, uint16_t len) {
+      fn(seq, kind, data, len);
+      return true;
+    });
+  }
+
+  // Same, from block seq `from` on (see seek()), until fn returns false
+  template <typename Fn>
+  uint32_t forEachFrom(JournalBlock& scratch, uint32_t from, Fn fn) {
+    if (empty()) return 0;
+    if (from < firstSeq()) from = firstSeq();
+    uint32_t n = 0;
+    for (uint32_t seq = from; seq <= cur.h.seq; seq++) {
+      const JournalBlock* b = block(seq, scratch);
+      if (!b) continue;  // torn long ago / never written
+      uint16_t at = 0;
+      for (uint16_t i = 0; i < b->h.records; i++) {
+        JournalRecordHeader r;
+        memcpy(&r, b->payload + at, sizeof(r));
+        at += sizeof(r);
+        if (at + r.len > b->h.used) break;
+        n++;
+        if (!fn(r.seq, r.kind, (const char*)b->payload + at, r.len)) return n;
+        at += r.len;
+      }
+    }
+    return n;
+  }
+
+  // For records appended in key order (time stamped lines): the block
+  // seq to start forEachFrom() at for a key. before(data, len) is true
+  // for a record that sorts before the key. Returns the last block whose
+  // first record is before it (the key's records may start mid-block),
+  // in ~log2(blocks) block reads. An unreadable block counts as not
+  // before: the search moves left, so nothing is skipped.
+  template <typename Before>
+  uint32_t seek(JournalBlock& scratch, Before before) {
+    if (empty()) return 0;
+    uint32_t lo = firstSeq(), hi = cur.h.seq;
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo + 1) / 2;
+      const JournalBlock* b = block(mid, scratch);
+      JournalRecordHeader r;
+      if (b) memcpy(&r, b->payload, sizeof(r));
+      if (b && sizeof(r) + r.len <= b->h.used && before((const char*)b->payload + sizeof(r), r.len)) lo = mid;
+      else hi = mid - 1;
+    }
+    return lo;
+  }
+
+  bool empty() const { return cur.h.records == 0; }
+  uint32_t head() const { return cur.h.seq % blocks; }          // block index being filled
+  uint32_t headSeq() const { return cur.h.seq; }
+  uint16_t headRecords() const { return cur.h.records; }        // lost if the next write is torn
+  uint32_t nextSeq() const { return nextRecord; }               // record seq of the next append
+  uint32_t blockCount() const { return blocks; }
+  uint32_t recoveryReads() const { return recoveryReadCount; }  // block reads done by begin()
+  uint32_t errors() const { return writeErrors; }
+
+  int json(char* out, size_t len) const {
+    return snprintf(out, len, "{\"blocks\":%lu,\"head\":%lu,\"headSeq\":%lu,\"nextSeq\":%lu,\"recoveryReads\":%lu,"
+                    "\"writeErrors\":%lu}",
+                    (unsigned long)blocks, (unsigned long)head(), (unsigned long)cur.h.seq,
+                    (unsigned long)nextRecord, (unsigned long)recoveryReadCount, (unsigned long)writeErrors);
+  }
+
+private:
+  uint32_t offsetOf(uint32_t seq) const { return (seq % blocks) * JOURNAL_BLOCK_SIZE; }
+
+  bool writeHead() {
+    unwritten = !(store->write(offsetOf(cur.h.seq), (const uint8_t*)&cur, sizeof(cur)) && store->sync());
+    if (unwritten) writeErrors++;
+    return !unwritten;
+  }
+
+  static uint32_t blockCrc(const JournalBlock& b) {
+    JournalBlockHeader h = b.h;
+    h.crc = 0;
+    uint32_t crc = journalCrc(0, (const uint8_t*)&h, sizeof(h));
+    return journalCrc(crc, b.payload, b.h.used);
+  }
+
+  // Oldest block seq still in the ring
+  uint32_t firstSeq() const { return cur.h.seq >= blocks - 1 ? cur.h.seq - (blocks - 1) : 0; }
+
+  // Block seq from the ring (the head from RAM); NULL if it is not there
+  const JournalBlock* block(uint32_t seq, JournalBlock& scratch) {
+    if (seq == cur.h.seq) return &cur;
+    if (!readBlock(seq % blocks, scratch) || scratch.h.seq != seq) return nullptr;
+    return &scratch;
+  }
+
+  // Reads block index i; false if it was never written, torn or not ours
+  bool readBlock(uint32_t i, JournalBlock& b) {
+    reads++;
+    if (!store->read(i * JOURNAL_BLOCK_SIZE, (uint8_t*)&b, sizeof(b))) return false;
+    if (b.h.magic != JOURNAL_MAGIC || b.h.seq % blocks != i || b.h.used > JOURNAL_PAYLOAD) return false;
+    if (b.h.records == 0) return false;  // only blocks with a record are written
+    return b.h.crc == blockCrc(b);
+  }
+
+  // lap of block index i (-1: not valid)
+  int64_t lapOf(uint32_t i, JournalBlock& b) {
+    return readBlock(i, b) ? (int64_t)(b.h.seq / blocks) : -1;
+  }
+
+  void recover() {
+    JournalBlock& b = cur;  // recovery reads straight into the head buffer
+    uint32_t head;
+    int64_t lap = lapOf(0, b);
+    if (lap < 0) {
+      // block 0 empty or torn: either nothing was written yet, or the
+      // last lap ended at the final block and block 0 was being written
+      if (lapOf(blocks - 1, b) < 0) {
+        reset(0, 0);
+        return;
+      }
+      head = blocks - 1;
+    } else {
+      // blocks 0..head are on `lap`, the rest are not: last index on it
+      uint32_t lo = 0, hi = blocks - 1;
+      while (lo < hi) {
+        uint32_t mid = lo + (hi - lo + 1) / 2;
+        if (lapOf(mid, b) == lap) lo = mid;
+        else hi = mid - 1;
+      }
+      head = lo;
+    }
+    // walk on while the next block carries on the sequence (normally one read)
+    if (!readBlock(head, b)) {
+      reset(0, 0);
+      return;
+    }
+    static JournalBlock next;  // not on the (small) loop task stack
+    for (uint32_t i = 0; i < blocks; i++) {
+      uint32_t n = (b.h.seq + 1) % blocks;
+      if (!readBlock(n, next) || next.h.seq != b.h.seq + 1) break;
+      b = next;
+    }
+    // next record seq: after the last record of the head block
+    uint16_t at = 0;
+    uint32_t last = 0;
+    for (uint16_t i = 0; i < b.h.records; i++) {
+      JournalRecordHeader r;
+      memcpy(&r, b.payload + at, sizeof(r));
+      last = r.seq;
+      at += sizeof(r) + r.len;
+    }
+    nextRecord = last + 1;
+  }
+
+  void reset(uint32_t seq, uint32_t record) {
+    memset(&cur, 0, sizeof(cur));
+    cur.h.magic = JOURNAL_MAGIC;
+    cur.h.seq = seq;
+    nextRecord = record;
+  }
+
+  JournalStore* store = nullptr;
+  uint32_t blocks = 0;
+  uint32_t nextRecord = 0;
+  uint32_t reads = 0;
+  uint32_t recoveryReadCount = 0;
+  uint32_t writeErrors = 0;
+  bool unwritten = false;     // the last write of the head block failed
+  JournalBlock cur;  // head block as written (or about to be)
+};
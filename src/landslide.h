@@ -0,0 +1,203 @@
+/****************************************************************
+ * HIMBUDDY - LANDSLIDE EARLY WARNING (STREAMING)
+ *
+ * A tilt switch alone says "something moved", too late and too often.
+ * The precursors are slower:
+ *   - soil getting wetter fast (rain soaking the slope)
+ *   - the ground, and the unit bolted to it, slowly leaning: the
+ *     gravity vector of the MPU6050 drifting over hours
+ *   - the tilt switch chattering more and more
+ * Each is tracked with exponential averages, so update() is O(1)
+ * with a few floats of state, whatever the sample rate. Rates come
+ * from a fast and a slow average of the same value: on a steady
+ * ramp their gap is rate x (slow tau - fast tau).
+ *
+ * Points per precursor add up to a graded risk. Soil alone (heavy
+ * rain on stable ground) tops out at WATCH; WARNING needs some
+ * movement, DANGER mostly movement. The level goes up at once and
+ * down only after it stayed lower for holdMs.
+ *
+ * No Arduino headers: tools/landslide_replay.cpp replays recorded or
+ * made-up days through the same code on a PC.
+ ****************************************************************/
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+enum LandslideRisk : uint8_t { SLIDE_NORMAL, SLIDE_WATCH, SLIDE_WARNING, SLIDE_DANGER };
+
+inline const char* landslideRiskName(uint8_t r) {
+  switch (r) {
+    case SLIDE_NORMAL:  return "Safe";
+    case SLIDE_WATCH:   return "Watch";
+    case SLIDE_WARNING: return "Warning";
+    case SLIDE_DANGER:  return "Danger";
+    default:            return "?";
+  }
+}
+
+// Why the score is what it is (bits of LandslideDetector::reasons())
+enum LandslideReason : uint8_t {
+  SLIDE_R_SATURATED = 1,   // soil wetter than soilWetPct
+  SLIDE_R_WETTING = 2,     // soil getting wetter fast
+  SLIDE_R_LEANED = 4,      // inclination moved since the baseline
+  SLIDE_R_CREEPING = 8,    // inclination still changing
+  SLIDE_R_TILT = 16,       // tilt switch active
+};
+
+struct LandslideConfig {
+  // averaging (seconds)
+  float soilFastS, soilSlowS;    // soil level / trend
+  float accelS;                  // gravity vector (removes vibration)
+  float leanFastS, leanSlowS;    // inclination trend
+  float tiltS;                   // tilt switch activity memory
+  uint32_t baselineMs;           // settle time before the reference gravity vector is taken
+  uint32_t holdMs;               // a lower level must last this long
+  // points: one at the first limit, two at the second
+  float soilWetPct;              // +1
+  float wetRate1, wetRate2;      // %/h
+  float leanDeg1, leanDeg2;      // degrees from the baseline
+  float creepDeg1, creepDeg2;    // degrees/h
+  float tiltPerH1, tiltPerH2;    // switch closures per hour
+};
+
+const LandslideConfig LANDSLIDE_CONFIG_DEFAULT = {
+  900, 7200, 600, 1800, 10800, 3600, 600000, 1800000,
+  80, 10, 25, 0.5f, 2, 0.1f, 0.5f, 3, 10,
+};
+
+class LandslideDetector {
+public:
+  void begin(const LandslideConfig& c, uint32_t now) {
+    cfg = c;
+    started = false;
+    startMs = lastMs = now;
+    based = false;
+    tiltRate = 0;
+    lvl = SLIDE_NORMAL;
+    lowerSince = now;
+    why = 0;
+    pts = 0;
+  }
+
+  // Re-take the reference inclination (unit re-mounted)
+  void rebaseline(uint32_t now) {
+    based = false;
+    startMs = now;
+    leanFast = leanSlow = 0;
+  }
+
+  // One sample. soilPct: 0 = dry .. 100 = wet. a*: accelerometer,
+  // any unit (only the direction is used). tiltEdges: switch closures
+  // since the last call. True when the risk level went up.
+  bool update(uint32_t now, float soilPct, float ax, float ay, float az, uint16_t tiltEdges) {
+    if (!started) {
+      started = true;
+      soilFast = soilSlow = soilPct;
+      gx = ax; gy = ay; gz = az;
+      leanFast = leanSlow = 0;
+      lastMs = now;
+    }
+    float dt = (float)(uint32_t)(now - lastMs) / 1000.0f;
+    lastMs = now;
+
+    soilFast += k(dt, cfg.soilFastS) * (soilPct - soilFast);
+    soilSlow += k(dt, cfg.soilSlowS) * (soilPct - soilSlow);
+
+    float ka = k(dt, cfg.accelS);
+    gx += ka * (ax - gx);
+    gy += ka * (ay - gy);
+    gz += ka * (az - gz);
+    if (!based && now - startMs >= cfg.baselineMs) {
+      based = true;
+      rx = gx; ry = gy; rz = gz;
+      leanFast = leanSlow = 0;
+    }
+    if (based) {
+      float l = angleToBaseline();
+      leanFast += k(dt, cfg.leanFastS) * (l - leanFast);
+      leanSlow += k(dt, cfg.leanSlowS) * (l - leanSlow);
+    }
+
+    tiltRate *= 1.0f - k(dt, cfg.tiltS);
+    tiltRate += tiltEdges;
+
+    return grade(now);
+  }
+
+  LandslideRisk level() const { return lvl; }
+  uint8_t score() const { return pts; }
+  uint8_t reasons() const { return why; }
+  float soilPct() const { return soilFast; }
+  float wettingPerH() const { return (soilFast - soilSlow) * 3600.0f / (cfg.soilSlowS - cfg.soilFastS); }
+  float leanDeg() const { return based ? leanFast : 0; }
+  float creepDegPerH() const { return (leanFast - leanSlow) * 3600.0f / (cfg.leanSlowS - cfg.leanFastS); }
+  float tiltPerH() const { return tiltRate * 3600.0f / cfg.tiltS; }
+
+  // {"risk":"..","score":..,"reasons":..,"soil":..,"wetPerH":..,"leanDeg":..,"creepDegPerH":..,"tiltPerH":..}
+  int json(char* out, size_t len) const {
+    return snprintf(out, len,
+                    "{\"risk\":\"%s\",\"score\":%u,\"reasons\":%u,\"soil\":%.1f,\"wetPerH\":%.1f,"
+                    "\"leanDeg\":%.2f,\"creepDegPerH\":%.3f,\"tiltPerH\":%.1f,\"baseline\":%s}",
+                    landslideRiskName(lvl), (unsigned)pts, (unsigned)why, soilFast, wettingPerH(), leanDeg(),
+                    creepDegPerH(), tiltPerH(), based ? "true" : "false");
+  }
+
+private:
+  // EMA gain for a step of dt seconds
+  static float k(float dt, float tau) { return dt <= 0 ? 0.0f : 1.0f - expf(-dt / tau); }
+
+  float angleToBaseline() const {
+    float cx = gy * rz - gz * ry, cy = gz * rx - gx * rz, cz = gx * ry - gy * rx;
+    float cross = sqrtf(cx * cx + cy * cy + cz * cz);
+    float dot = gx * rx + gy * ry + gz * rz;
+    return atan2f(cross, dot) * 57.29578f;
+  }
+
+  static uint8_t points(float v, float one, float two) { return v >= two ? 2 : (v >= one ? 1 : 0); }
+
+  bool grade(uint32_t now) {
+    uint8_t wet = soilFast >= cfg.soilWetPct ? 1 : 0;
+    uint8_t wetting = points(wettingPerH(), cfg.wetRate1, cfg.wetRate2);
+    uint8_t lean = based ? points(leanFast, cfg.leanDeg1, cfg.leanDeg2) : 0;
+    uint8_t creep = based ? points(creepDegPerH(), cfg.creepDeg1, cfg.creepDeg2) : 0;
+    uint8_t tilt = points(tiltPerH(), cfg.tiltPerH1, cfg.tiltPerH2);
+    why = (wet ? SLIDE_R_SATURATED : 0) | (wetting ? SLIDE_R_WETTING : 0) | (lean ? SLIDE_R_LEANED : 0) |
+          (creep ? SLIDE_R_CREEPING : 0) | (tilt ? SLIDE_R_TILT : 0);
+    pts = wet + wetting + lean + creep + tilt;
+
+    uint8_t moving = lean + creep + tilt;
+    LandslideRisk target = SLIDE_NORMAL;
+    if (pts >= 2) target = SLIDE_WATCH;
+    if (moving && pts >= 4) target = SLIDE_WARNING;
+    if (moving >= 3 && pts >= 6) target = SLIDE_DANGER;
+
+    if (target > lvl) {
+      lvl = target;
+      lowerSince = now;
+      return true;
+    }
+    if (target == lvl) lowerSince = now;
+    else if (now - lowerSince >= cfg.holdMs) {
+      lvl = target;
+      lowerSince = now;
+    }
+    return false;
+  }
+
+  LandslideConfig cfg = {};
+  bool started = false;
+  uint32_t startMs = 0, lastMs = 0;
+  float soilFast = 0, soilSlow = 0;
+  float gx = 0, gy = 0, gz = 0;       // filtered gravity vector
+  float rx = 0, ry = 0, rz = 0;       // baseline
+  bool based = false;
+  float leanFast = 0, leanSlow = 0;   // degrees from the baseline
+  float tiltRate = 0;                 // decaying closure count
+  LandslideRisk lvl = SLIDE_NORMAL;
+  uint32_t lowerSince = 0;
+  uint8_t why = 0;
+  uint8_t pts = 0;
+};
@@ -0,0 +1,130 @@
+/****************************************************************
+ * HIMBUDDY - LOG / ALERT LINE FORMATS
+ *
+ * The text esp32fullcode.c writes most often: the ISO timestamp, the
+ * alert JSON (Bluetooth + /alerts.jnl), the 5 s snapshot CSV row
+ * (/raw.jnl, src/journal.h) and the BT STATUS reply. Kept here so
+ * tools/microbench.cpp times exactly the code the unit runs, and
+ * tools/backtest.cpp reads what it writes.
+ *
+ * All of them are one SensorRecord written through a FieldDef table
+ * (src/fields.h): no float printf, byte for byte what the snprintf
+ * formats of before wrote (tools/fields_check.cpp keeps them side by
+ * side). NAN readings are written as 0.
+ ****************************************************************/
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "fields.h"
+
+#define ISO_TIME_LEN 20        // "YYYY-MM-DDTHH:MM:SS" + NUL
+
+inline char* isoPut2(char* p, unsigned v) {
+  p[0] = (char)('0' + v / 10 % 10);
+  p[1] = (char)('0' + v % 10);
+  return p + 2;
+}
+
+inline void formatIsoTime(char* out, int year, int month, int day, int hour, int minute, int second) {
+  // fields wrap like the "%04u-%02u-..." of before: always 19 chars
+  unsigned y = (unsigned)year % 10000u;
+  char* p = isoPut2(isoPut2(out, y / 100), y % 100);
+  *p++ = '-';
+  p = isoPut2(p, (unsigned)month % 100u);
+  *p++ = '-';
+  p = isoPut2(p, (unsigned)day % 100u);
+  *p++ = 'T';
+  p = isoPut2(p, (unsigned)hour % 100u);
+  *p++ = ':';
+  p = isoPut2(p, (unsigned)minute % 100u);
+  *p++ = ':';
+  p = isoPut2(p, (unsigned)second % 100u);
+  *p = 0;
+}
+
+// Without an RTC: uptime as a time of day on 1970-01-01
+inline void formatUptimeIso(char* out, unsigned long ms) {
+  unsigned long s = ms / 1000;
+  formatIsoTime(out, 1970, 1, 1, (int)((s / 3600) % 24), (int)((s / 60) % 60), (int)(s % 60));
+}
+
+inline double logValue(float v) { return isnan(v) ? 0.0 : v; }
+
+// One reading of everything, what the lines below are made of
+struct SensorRecord {
+  const char* type;    // alert only
+  const char* msg;     // alert only
+  const char* time;
+  const char* extra;   // alert only
+  float dhtT, dhtH, bmeT, bmeH, bmeP;
+  int32_t mq, soil;
+  double lat, lng;     // together: FIELD_LATLNG
+};
+
+#define SENSOR_FIELD(name, member, type, decimals, flags) \
+  { name, type, decimals, flags, (uint16_t)offsetof(SensorRecord, member) }
+#define SENSOR_READING(name, member) SENSOR_FIELD(name, member, FIELD_FLOAT, 2, FIELD_NAN_ZERO)
+
+// {"type":..,"msg":..,"time":..,"extra":..,"dhtT":..,"dhtH":..,"bmeT":..,"bmeH":..,"bmeP":..,"mq":..,"soil":..[,"gps":"lat,lng"]}
+const FieldDef ALERT_FIELDS[] = {
+  SENSOR_FIELD("type", type, FIELD_TEXT, 0, 0),     SENSOR_FIELD("msg", msg, FIELD_TEXT, 0, 0),
+  SENSOR_FIELD("time", time, FIELD_TEXT, 0, 0),     SENSOR_FIELD("extra", extra, FIELD_TEXT, 0, 0),
+  SENSOR_READING("dhtT", dhtT),                     SENSOR_READING("dhtH", dhtH),
+  SENSOR_READING("bmeT", bmeT),                     SENSOR_READING("bmeH", bmeH),
+  SENSOR_READING("bmeP", bmeP),                     SENSOR_FIELD("mq", mq, FIELD_INT, 0, 0),
+  SENSOR_FIELD("soil", soil, FIELD_INT, 0, 0),      SENSOR_FIELD("gps", lat, FIELD_LATLNG, 6, FIELD_OMIT_ZERO),
+};
+
+// "time",dhtT,dhtH,bmeT,bmeH,bmeP,mqRaw,soilRaw,gpsLat,gpsLng (the names are the SENSLOG header)
+const FieldDef SNAPSHOT_FIELDS[] = {
+  SENSOR_FIELD("time", time, FIELD_TEXT, 0, 0),     SENSOR_READING("dhtT", dhtT),
+  SENSOR_READING("dhtH", dhtH),                     SENSOR_READING("bmeT", bmeT),
+  SENSOR_READING("bmeH", bmeH),                     SENSOR_READING("bmeP", bmeP),
+  SENSOR_FIELD("mqRaw", mq, FIELD_INT, 0, 0),       SENSOR_FIELD("soilRaw", soil, FIELD_INT, 0, 0),
+  SENSOR_FIELD("gpsLat", lat, FIELD_DOUBLE, 6, 0),  SENSOR_FIELD("gpsLng", lng, FIELD_DOUBLE, 6, 0),
+};
+
+// {"status":"ok","dhtT":..,"dhtH":..,"mq":..,"soil":..}
+const FieldDef STATUS_FIELDS[] = {
+  SENSOR_READING("dhtT", dhtT), SENSOR_READING("dhtH", dhtH),
+  SENSOR_FIELD("mq", mq, FIELD_INT, 0, 0), SENSOR_FIELD("soil", soil, FIELD_INT, 0, 0),
+};
+
+#define FIELD_COUNT(table) (sizeof(table) / sizeof(table[0]))
+
+inline int formatAlertJson(char* out, size_t len, const char* type, const char* msg, const char* time,
+                           const char* extra, float dhtT, float dhtH, float bmeT, float bmeH, float bmeP,
+                           int mqRaw, int soilRaw, double gpsLat, double gpsLng) {
+  SensorRecord r = { type, msg, time, extra, dhtT, dhtH, bmeT, bmeH, bmeP, mqRaw, soilRaw, gpsLat, gpsLng };
+  FieldWriter w(out, len);
+  w.put('{');
+  fieldsJson(w, ALERT_FIELDS, FIELD_COUNT(ALERT_FIELDS), &r);
+  w.put('}');
+  return w.finish();
+}
+
+inline int formatSnapshotCsv(char* out, size_t len, const char* time, float dhtT, float dhtH, float bmeT,
+                             float bmeH, float bmeP, int mqRaw, int soilRaw, double gpsLat, double gpsLng) {
+  SensorRecord r = { nullptr, nullptr, time, nullptr, dhtT, dhtH, bmeT, bmeH, bmeP, mqRaw, soilRaw, gpsLat, gpsLng };
+  FieldWriter w(out, len);
+  fieldsCsv(w, SNAPSHOT_FIELDS, FIELD_COUNT(SNAPSHOT_FIELDS), &r);
+  return w.finish();
+}
+
+// health: a JSON object sent along as "health" (sensor states), or NULL
+inline int formatStatusJson(char* out, size_t len, float dhtT, float dhtH, int mqRaw, int soilRaw,
+                            const char* health = nullptr) {
+  SensorRecord r = { nullptr, nullptr, nullptr, nullptr, dhtT, dhtH, NAN, NAN, NAN, mqRaw, soilRaw, 0, 0 };
+  FieldWriter w(out, len);
+  w.put("{\"status\":\"ok\",");
+  fieldsJson(w, STATUS_FIELDS, FIELD_COUNT(STATUS_FIELDS), &r);
+  if (health) {
+    w.put(",\"health\":");
+    w.put(health);
+  }
+  w.put('}');
+  return w.finish();
+}
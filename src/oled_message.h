@@ -0,0 +1,189 @@
+/****************************************************************
+ * HIMBUDDY - WEB MESSAGE QUEUE + SCROLLING TEXT STRIP
+ *
+ * MessageQueue: the texts phones send to the OLED (/msg, /ws "M"),
+ * bounded, each with a priority and an expiry. The next one shown is
+ * the highest priority, oldest first; one that waited past its expiry
+ * is dropped unseen. When full, a new message pushes out the lowest
+ * priority (oldest) one, or is refused if everything waiting outranks
+ * it. Counters say how many were dropped either way.
+ *
+ * TextStrip: a message is drawn once, glyph by glyph, into a strip of
+ * columns in the SSD1306 frame buffer layout (pages of 8 rows, one
+ * byte per column, bit 0 = top). A frame then only copies the 128
+ * columns in view into the frame buffer: one memcpy per page, the same
+ * cost for 3 characters or 63. The glyphs come from the caller (the
+ * Adafruit GFX 5x7 font on the unit), scaled 1x or 2x.
+ *
+ * Scrolling: text wider than the view holds STRIP_HOLD_MS at the start,
+ * moves STRIP_PX_PER_S to its end and holds there again; that is one
+ * pass (passMs). Text that fits does not move.
+ *
+ * Not thread safe; no heap, no Arduino headers (tools/message_check.cpp
+ * runs both on a PC).
+ ****************************************************************/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define STRIP_MAX_SCALE 2           // pages per strip: 8 px per scale step
+#define STRIP_MAX_COLS 768          // 64 chars x 12 px (text size 2)
+#define STRIP_HOLD_MS 1000          // still at the start and the end of a pass
+#define STRIP_PX_PER_S 40
+
+// ==============================================================
+//                    MESSAGE QUEUE
+// ==============================================================
+template <size_t N, size_t LEN>
+class MessageQueue {
+public:
+  struct Message {
+    char text[LEN];
+    uint8_t priority;     // higher first
+    uint32_t expiresMs;   // dropped if still waiting then
+    uint32_t seq;         // order of arrival
+  };
+
+  // false: refused (everything waiting outranks it)
+  bool push(const char* text, uint8_t priority, uint32_t nowMs, uint32_t ttlMs) {
+    dropExpired(nowMs);
+    size_t slot = count;
+    if (count == N) {
+      slot = lowest();
+      if (q[slot].priority > priority) {
+        refusedCount++;
+        return false;
+      }
+      replacedCount++;
+    } else {
+      count++;
+    }
+    Message& m = q[slot];
+    size_t len = strnlen(text, LEN - 1);  // longer: cut
+    memcpy(m.text, text, len);
+    m.text[len] = 0;
+    m.priority = priority;
+    m.expiresMs = nowMs + ttlMs;
+    m.seq = nextSeq++;
+    return true;
+  }
+
+  // Takes out the message to show next; false if none is waiting
+  bool pop(uint32_t nowMs, Message& out) {
+    dropExpired(nowMs);
+    if (count == 0) return false;
+    size_t best = 0;
+    for (size_t i = 1; i < count; i++) {
+      if (q[i].priority > q[best].priority || (q[i].priority == q[best].priority && q[i].seq < q[best].seq)) best = i;
+    }
+    out = q[best];
+    remove(best);
+    return true;
+  }
+
+  void clear() { count = 0; }
+  size_t size() const { return count; }
+  uint32_t expired() const { return expiredCount; }    // waited too long
+  uint32_t replaced() const { return replacedCount; }  // pushed out by a newer one (queue full)
+  uint32_t refused() const { return refusedCount; }    // queue full of higher priority
+
+private:
+  // lowest priority, oldest among those
+  size_t lowest() const {
+    size_t w = 0;
+    for (size_t i = 1; i < count; i++) {
+      if (q[i].priority < q[w].priority || (q[i].priority == q[w].priority && q[i].seq < q[w].seq)) w = i;
+    }
+    return w;
+  }
+
+  void dropExpired(uint32_t nowMs) {
+    for (size_t i = 0; i < count;) {
+      if ((int32_t)(nowMs - q[i].expiresMs) >= 0) {
+        remove(i);
+        expiredCount++;
+      } else {
+        i++;
+      }
+    }
+  }
+
+  void remove(size_t i) {
+    q[i] = q[--count];  // order lives in seq, not in the slots
+  }
+
+  Message q[N];
+  size_t count = 0;
+  uint32_t nextSeq = 0;
+  uint32_t expiredCount = 0, replacedCount = 0, refusedCount = 0;
+};
+
+// ==============================================================
+//                    TEXT STRIP
+// ==============================================================
+class TextStrip {
+public:
+  // glyph(c, cols): the 5 columns of character c, bit 0 = top row.
+  // Each character takes 6 columns (5 + space) x scale, like GFX text.
+  template <typename Glyph>
+  void render(const char* text, uint8_t textScale, Glyph glyph) {
+    scale = textScale < 1 ? 1 : textScale > STRIP_MAX_SCALE ? STRIP_MAX_SCALE : textScale;
+    w = 0;
+    memset(cols, 0, sizeof(cols));
+    for (const char* c = text; *c && w + 6 * scale <= STRIP_MAX_COLS; c++) {
+      uint8_t g[5];
+      glyph(*c, g);
+      for (int x = 0; x < 6; x++) {
+        uint8_t col = x < 5 ? g[x] : 0;
+        uint16_t tall = scale == 1 ? col : stretch2(col);  // rows doubled at 2x
+        for (uint8_t k = 0; k < scale; k++, w++) {
+          for (uint8_t p = 0; p < scale; p++) cols[p][w] = (uint8_t)(tall >> (8 * p));
+        }
+      }
+    }
+  }
+
+  uint16_t width() const { return w; }
+  uint8_t pages() const { return scale; }
+
+  // Left edge of the view after ms on screen (see top)
+  uint16_t scrollX(uint32_t ms, uint16_t view) const {
+    if (w <= view || ms <= STRIP_HOLD_MS) return 0;
+    uint32_t x = (uint32_t)((uint64_t)(ms - STRIP_HOLD_MS) * STRIP_PX_PER_S / 1000);
+    return (uint16_t)(x < (uint32_t)(w - view) ? x : w - view);
+  }
+
+  // One pass: start hold + the move + end hold (0 moves: just the holds)
+  uint32_t passMs(uint16_t view) const {
+    uint32_t move = w > view ? (uint32_t)(w - view) * 1000 / STRIP_PX_PER_S : 0;
+    return 2 * STRIP_HOLD_MS + move;
+  }
+
+  // Copies strip columns [x, x + view) to frame buffer fb (fbWidth columns
+  // per page) from page `page` down; columns past the text are cleared
+  void blit(uint8_t* fb, uint16_t fbWidth, uint8_t page, uint16_t x, uint16_t view) const {
+    uint16_t n = x < w ? (uint16_t)(w - x) : 0;
+    if (n > view) n = view;
+    for (uint8_t p = 0; p < scale; p++) {
+      uint8_t* row = fb + (size_t)(page + p) * fbWidth;
+      if (n) memcpy(row, cols[p] + x, n);
+      memset(row + n, 0, view - n);
+    }
+  }
+
+private:
+  // bit i -> bits 2i and 2i + 1
+  static uint16_t stretch2(uint8_t b) {
+    uint16_t v = 0;
+    for (int i = 0; i < 8; i++) {
+      if (b & (1 << i)) v |= (uint16_t)(3u << (2 * i));
+    }
+    return v;
+  }
+
+  uint8_t cols[STRIP_MAX_SCALE][STRIP_MAX_COLS];
+  uint16_t w = 0;
+  uint8_t scale = 1;
+};
@@ -0,0 +1,161 @@
+/****************************************************************
+ * HIMBUDDY - POWER MANAGER (DUTY CYCLE + ENERGY MODEL)
+ *
+ * Decides, from millis(), what the unit may switch off right now:
+ *   - DUTY   : light sleep between scheduled samples, BT + OLED off.
+ *              Wakes on the timer, the MPU6050 motion interrupt or
+ *              the tilt pin.
+ *   - MOTION : woken by movement, stays awake and samples every loop
+ *              for a while (radios still off)
+ *   - LINK   : BT up so the app can connect (boot, a short window
+ *              every few minutes, or while a client is connected)
+ *   - ALERT  : after any alert everything stays on, no sleep, so the
+ *              alert path never waits for a wake-up
+ *
+ * The energy model adds up time per rail and turns it into mAh, so
+ * the same numbers come out of the firmware (BT "POWER") and out of
+ * tools/power_sim.cpp. No Arduino headers.
+ ****************************************************************/
+#pragma once
+
+#include <stdint.h>
+
+enum PowerState : uint8_t { POWER_DUTY, POWER_MOTION, POWER_LINK, POWER_ALERT };
+
+inline const char* powerStateName(uint8_t s) {
+  switch (s) {
+    case POWER_DUTY:   return "DUTY";
+    case POWER_MOTION: return "MOTION";
+    case POWER_LINK:   return "LINK";
+    case POWER_ALERT:  return "ALERT";
+    default:           return "?";
+  }
+}
+
+struct PowerConfig {
+  uint32_t sampleMs;     // scheduled sensor sample period
+  uint32_t motionHoldMs; // awake this long after a motion wake
+  uint32_t alertHoldMs;  // everything on this long after the last alert
+  uint32_t bootLinkMs;   // BT up after power-on (pairing, setup)
+  uint32_t linkPeriodMs; // BT comes up every ... (0 = never)
+  uint32_t linkWindowMs; // ... for this long
+  uint32_t minSleepMs;   // shorter gaps are not worth the wake-up cost
+};
+
+// ==============================================================
+//                    POLICY
+// ==============================================================
+class PowerPolicy {
+public:
+  void begin(const PowerConfig& c, uint32_t now) {
+    cfg = c;
+    bootMs = now;
+    nextSample = now;
+    lastAlert = lastMotion = 0;
+    alertSeen = motionSeen = false;
+    btClient = false;
+  }
+
+  void onAlert(uint32_t now) { lastAlert = now; alertSeen = true; }
+  void onMotion(uint32_t now) { lastMotion = now; motionSeen = true; }
+  void setBtClient(bool connected) { btClient = connected; }
+
+  // True once per sample period; a late caller is resynced, not
+  // given a burst of back-to-back samples.
+  bool sampleDue(uint32_t now) {
+    if ((int32_t)(now - nextSample) < 0) return false;
+    nextSample += cfg.sampleMs;
+    if ((int32_t)(now - nextSample) >= 0) nextSample = now + cfg.sampleMs;
+    return true;
+  }
+
+  PowerState state(uint32_t now) const {
+    if (alertSeen && now - lastAlert < cfg.alertHoldMs) return POWER_ALERT;
+    if (btClient || now - bootMs < cfg.bootLinkMs) return POWER_LINK;
+    if (cfg.linkPeriodMs && (now - bootMs) % cfg.linkPeriodMs < cfg.linkWindowMs) return POWER_LINK;
+    if (motionSeen && now - lastMotion < cfg.motionHoldMs) return POWER_MOTION;
+    return POWER_DUTY;
+  }
+
+  // How long the unit may light-sleep now (0 = stay awake). Never
+  // past the next sample or the next BT window.
+  uint32_t sleepMs(uint32_t now) const {
+    if (state(now) != POWER_DUTY) return 0;
+    int32_t toSample = (int32_t)(nextSample - now);
+    if (toSample <= 0) return 0;
+    uint32_t ms = (uint32_t)toSample;
+    if (cfg.linkPeriodMs) {
+      uint32_t toLink = cfg.linkPeriodMs - (now - bootMs) % cfg.linkPeriodMs;
+      if (toLink < ms) ms = toLink;
+    }
+    return ms < cfg.minSleepMs ? 0 : ms;
+  }
+
+private:
+  PowerConfig cfg = {};
+  uint32_t bootMs = 0;
+  uint32_t nextSample = 0;
+  uint32_t lastAlert = 0;
+  uint32_t lastMotion = 0;
+  bool alertSeen = false;
+  bool motionSeen = false;
+  bool btClient = false;
+};
+
+// ==============================================================
+//                    ENERGY MODEL
+// ==============================================================
+enum PowerRail : uint8_t { RAIL_CPU, RAIL_SLEEP, RAIL_WIFI, RAIL_BT, RAIL_OLED, RAIL_COUNT };
+
+inline const char* powerRailName(uint8_t r) {
+  static const char* const names[RAIL_COUNT] = { "cpu", "sleep", "wifi", "bt", "oled" };
+  return r < RAIL_COUNT ? names[r] : "?";
+}
+
+// Average current per rail while it is on (mA, from datasheets and
+// bench readings of one unit, 3.3 V side). 'always' is what cannot
+// be switched by firmware: MQ-2 heater, GPS module, regulators.
+struct PowerModel {
+  float mA[RAIL_COUNT];
+  float always;
+};
+
+// CPU 80 MHz, RF listening (ESP-NOW), BT SPP idle, OLED ~30% lit
+const PowerModel POWER_MODEL_DEFAULT = { { 30.0f, 0.8f, 68.0f, 32.0f, 12.0f }, 4.0f };
+
+class EnergyMeter {
+public:
+  void reset() {
+    for (uint8_t r = 0; r < RAIL_COUNT; r++) ms[r] = 0;
+    totalMs = 0;
+    wakeups = 0;
+  }
+
+  // One stretch of 'dt' ms: awake or asleep, and which rails were on
+  void add(uint32_t dt, bool awake, bool wifi, bool bt, bool oled) {
+    ms[awake ? RAIL_CPU : RAIL_SLEEP] += dt;
+    if (awake && wifi) ms[RAIL_WIFI] += dt; // RF is off in light sleep
+    if (bt) ms[RAIL_BT] += dt;
+    if (oled) ms[RAIL_OLED] += dt;
+    totalMs += dt;
+  }
+
+  void addWakeup() { wakeups++; }
+
+  // Charge used by one rail, or by everything (rail = RAIL_COUNT)
+  float mAh(const PowerModel& m, uint8_t rail = RAIL_COUNT) const {
+    if (rail < RAIL_COUNT) return m.mA[rail] * (float)ms[rail] / 3600000.0f;
+    float sum = m.always * (float)totalMs / 3600000.0f;
+    for (uint8_t r = 0; r < RAIL_COUNT; r++) sum += mAh(m, r);
+    return sum;
+  }
+
+  // Same, scaled to a 24 h day
+  float mAhPerDay(const PowerModel& m, uint8_t rail = RAIL_COUNT) const {
+    return totalMs ? mAh(m, rail) * 86400000.0f / (float)totalMs : 0.0f;
+  }
+
+  uint64_t ms[RAIL_COUNT] = {};
+  uint64_t totalMs = 0;
+  uint32_t wakeups = 0;
+};
@@ -0,0 +1,275 @@
+/****************************************************************
+ * HIMBUDDY - VIBRATION CLASSIFIER (FIXED-POINT FFT)
+ *
+ * Input : MPU6050 acceleration, 3 axes in mg, QUAKE_FS samples/s
+ * Window: QUAKE_N samples (2.56 s), a new one every QUAKE_HOP (1.28 s)
+ *
+ * Per window:
+ *   - gravity (mean) removed, peak ground acceleration (PGA), RMS,
+ *     kurtosis-like peakiness, how many of 8 sub-blocks carry energy
+ *   - Hann window + Q15 radix-2 FFT (x + jy in one FFT, z in a
+ *     second), power in 5 bands, dominant frequency, share of the
+ *     energy around the dominant peak
+ *   - label:
+ *       QUIET      below the noise floor
+ *       IMPULSIVE  footsteps, door slams, knocks (short / peaky)
+ *       MACHINERY  pumps, engines, traffic (steady, narrow peak or
+ *                  mostly above 10 Hz)
+ *       SEISMIC    steady, broadband, mostly 0.5 - 10 Hz
+ *
+ * Integer only after begin() (which fills the tables). No heap, no
+ * Arduino headers: tools/quake_bench.cpp runs the same code on a PC.
+ ****************************************************************/
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define QUAKE_FS 100      // samples per second (MPU6050 FIFO rate)
+#define QUAKE_LOG2N 8
+#define QUAKE_N (1 << QUAKE_LOG2N)
+#define QUAKE_HOP (QUAKE_N / 2)
+#define QUAKE_BANDS 5
+#define QUAKE_BLOCKS 8    // sub-blocks for "how steady is it"
+
+// Classifier limits (tuned with tools/quake_bench.cpp, -D to try others)
+#ifndef QUAKE_NOISE_MG
+#define QUAKE_NOISE_MG 4          // RMS below this = QUIET
+#endif
+#ifndef QUAKE_PEAKY_X10
+#define QUAKE_PEAKY_X10 40        // peakiness >= 4.0 -> IMPULSIVE
+#endif
+#ifndef QUAKE_BUSY_DIV
+#define QUAKE_BUSY_DIV 8          // busy sub-block: >= 1/8 of the busiest one
+#endif
+#ifndef QUAKE_MIN_BLOCKS
+#define QUAKE_MIN_BLOCKS 4        // fewer busy sub-blocks -> IMPULSIVE
+#endif
+#ifndef QUAKE_TONAL_PCT
+#define QUAKE_TONAL_PCT 65        // energy in the peak bin +-1 -> MACHINERY
+#endif
+#ifndef QUAKE_TONAL_BINS
+#define QUAKE_TONAL_BINS 1
+#endif
+#ifndef QUAKE_LOW_PCT
+#define QUAKE_LOW_PCT 70          // energy in 0.5-10 Hz -> SEISMIC
+#endif
+
+// Band edges in Hz x10: 0.5-2, 2-5, 5-10, 10-20, 20-50
+const uint16_t QUAKE_BAND_EDGES_X10[QUAKE_BANDS + 1] = { 5, 20, 50, 100, 200, 500 };
+
+enum QuakeClass : uint8_t { QUAKE_QUIET, QUAKE_SEISMIC, QUAKE_IMPULSIVE, QUAKE_MACHINERY, QUAKE_CLASSES };
+
+inline const char* quakeClassName(uint8_t c) {
+  switch (c) {
+    case QUAKE_QUIET:     return "QUIET";
+    case QUAKE_SEISMIC:   return "SEISMIC";
+    case QUAKE_IMPULSIVE: return "IMPULSIVE";
+    case QUAKE_MACHINERY: return "MACHINERY";
+    default:              return "?";
+  }
+}
+
+struct QuakeFeatures {
+  uint8_t cls;
+  uint16_t pgaMg;       // peak |a| without gravity
+  uint16_t rmsMg;
+  uint16_t domHzX10;    // dominant frequency
+  uint8_t peakyX10;     // mean(e^2)/mean(e)^2 x10, e = |a|^2 (noise ~17, sine ~15, knocks >> 40)
+  uint8_t busyBlocks;   // sub-blocks with >= 1/4 of the busiest one's energy
+  uint8_t tonalPct;     // energy within +-QUAKE_TONAL_BINS of the dominant peak
+  uint8_t lowPct;       // energy in 0.5 - 10 Hz
+  uint32_t band[QUAKE_BANDS]; // relative band power
+};
+
+// ==============================================================
+//                    Q15 FFT
+// ==============================================================
+class QuakeFft {
+public:
+  void begin() {
+    for (int i = 0; i < QUAKE_N / 2; i++) {
+      double a = 2.0 * M_PI * i / QUAKE_N;
+      cosT[i] = (int16_t)lrint(32767.0 * cos(a));
+      sinT[i] = (int16_t)lrint(32767.0 * sin(a));
+    }
+    for (int i = 0; i < QUAKE_N; i++) {
+      hann[i] = (int16_t)lrint(32767.0 * 0.5 * (1.0 - cos(2.0 * M_PI * i / QUAKE_N)));
+      int r = 0;
+      for (int b = 0; b < QUAKE_LOG2N; b++) r |= ((i >> b) & 1) << (QUAKE_LOG2N - 1 - b);
+      rev[i] = (uint8_t)r;
+    }
+  }
+
+  // In place, forward, every stage scaled by 1/2 (no overflow)
+  void run(int16_t* re, int16_t* im) const {
+    for (int i = 0; i < QUAKE_N; i++) {
+      int j = rev[i];
+      if (j > i) {
+        int16_t t = re[i]; re[i] = re[j]; re[j] = t;
+        t = im[i]; im[i] = im[j]; im[j] = t;
+      }
+    }
+    for (int len = 2, step = QUAKE_N / 2; len <= QUAKE_N; len <<= 1, step >>= 1) {
+      int half = len >> 1;
+      for (int i = 0; i < QUAKE_N; i += len) {
+        for (int k = 0; k < half; k++) {
+          int32_t c = cosT[k * step], s = sinT[k * step];
+          int a = i + k, b = a + half;
+          // (re + j im) * (c - j s)
+          int32_t tr = (re[b] * c + im[b] * s) >> 15;
+          int32_t ti = (im[b] * c - re[b] * s) >> 15;
+          int32_t ar = re[a], ai = im[a];
+          re[a] = (int16_t)((ar + tr) >> 1);
+          im[a] = (int16_t)((ai + ti) >> 1);
+          re[b] = (int16_t)((ar - tr) >> 1);
+          im[b] = (int16_t)((ai - ti) >> 1);
+        }
+      }
+    }
+  }
+
+  int16_t hann[QUAKE_N];
+
+private:
+  int16_t cosT[QUAKE_N / 2];
+  int16_t sinT[QUAKE_N / 2];
+  uint8_t rev[QUAKE_N];
+};
+
+inline uint32_t quakeIsqrt(uint64_t v) {
+  uint64_t r = 0, bit = (uint64_t)1 << 62;
+  while (bit > v) bit >>= 2;
+  while (bit) {
+    if (v >= r + bit) { v -= r + bit; r = (r >> 1) + bit; }
+    else r >>= 1;
+    bit >>= 2;
+  }
+  return (uint32_t)r;
+}
+
+// ==============================================================
+//                    DETECTOR (STREAMING)
+// ==============================================================
+class QuakeDetector {
+public:
+  void begin() {
+    fft.begin();
+    for (int b = 0; b <= QUAKE_BANDS; b++) {
+      bandBin[b] = (uint16_t)((QUAKE_BAND_EDGES_X10[b] * QUAKE_N + 5 * QUAKE_FS) / (10 * QUAKE_FS));
+      if (bandBin[b] > QUAKE_N / 2) bandBin[b] = QUAKE_N / 2;
+    }
+    reset();
+  }
+
+  void reset() {
+    head = 0;
+    filled = 0;
+    sinceWindow = 0;
+    windows = 0;
+    memset(&feat, 0, sizeof(feat));
+  }
+
+  // One sample (mg). True when a window was just analysed: see last()
+  bool push(int16_t x, int16_t y, int16_t z) {
+    ax[head] = x; ay[head] = y; az[head] = z;
+    head = (head + 1) & (QUAKE_N - 1);
+    if (filled < QUAKE_N) filled++;
+    if (++sinceWindow < QUAKE_HOP || filled < QUAKE_N) return false;
+    sinceWindow = 0;
+    analyse();
+    windows++;
+    return true;
+  }
+
+  const QuakeFeatures& last() const { return feat; }
+  uint32_t windowCount() const { return windows; }
+
+private:
+  void analyse() {
+    // oldest sample first
+    int32_t mx = 0, my = 0, mz = 0;
+    for (int i = 0; i < QUAKE_N; i++) { mx += ax[i]; my += ay[i]; mz += az[i]; }
+    mx /= QUAKE_N; my /= QUAKE_N; mz /= QUAKE_N;
+
+    // time domain: PGA, RMS, peakiness, busy sub-blocks
+    uint64_t sumE = 0, sumE2 = 0;
+    uint32_t maxE = 0;
+    uint64_t blockE[QUAKE_BLOCKS] = {};
+    for (int n = 0; n < QUAKE_N; n++) {
+      int i = (head + n) & (QUAKE_N - 1);
+      int32_t x = ax[i] - mx, y = ay[i] - my, z = az[i] - mz;
+      uint32_t e = (uint32_t)(x * x + y * y + z * z);
+      sumE += e;
+      sumE2 += (uint64_t)e * e;
+      if (e > maxE) maxE = e;
+      blockE[n / (QUAKE_N / QUAKE_BLOCKS)] += e;
+
+      // windowed, scaled x4 (fits Q15 up to +-8 g of motion)
+      int32_t w = fft.hann[n];
+      re1[n] = sat16(((x * w) >> 15) << 2);
+      im1[n] = sat16(((y * w) >> 15) << 2);
+      re2[n] = sat16(((z * w) >> 15) << 2);
+      im2[n] = 0;
+    }
+    feat.pgaMg = (uint16_t)quakeIsqrt(maxE);
+    feat.rmsMg = (uint16_t)quakeIsqrt(sumE / QUAKE_N);
+    uint64_t meanE = sumE / QUAKE_N;
+    feat.peakyX10 = (uint8_t)(meanE ? clampU((sumE2 / QUAKE_N) * 10 / (meanE * meanE), 255) : 0);
+    uint64_t maxBlock = 0;
+    for (int b = 0; b < QUAKE_BLOCKS; b++) if (blockE[b] > maxBlock) maxBlock = blockE[b];
+    feat.busyBlocks = 0;
+    for (int b = 0; b < QUAKE_BLOCKS; b++) if (blockE[b] * QUAKE_BUSY_DIV >= maxBlock && maxBlock) feat.busyBlocks++;
+
+    // spectrum: x+jy and z, power per bin = (|Z[k]|^2 + |Z[N-k]|^2) / 2
+    fft.run(re1, im1);
+    fft.run(re2, im2);
+    uint64_t total = 0, best = 0;
+    int bestBin = bandBin[0];
+    uint64_t band[QUAKE_BANDS] = {};
+    for (int k = bandBin[0]; k < QUAKE_N / 2; k++) {
+      uint64_t p = binPower(k);
+      total += p;
+      for (int b = 0; b < QUAKE_BANDS; b++) if (k >= bandBin[b] && k < bandBin[b + 1]) band[b] += p;
+      if (p > best) { best = p; bestBin = k; }
+    }
+    uint64_t nearPeak = 0;
+    for (int k = bestBin - QUAKE_TONAL_BINS; k <= bestBin + QUAKE_TONAL_BINS; k++) {
+      if (k >= bandBin[0] && k < QUAKE_N / 2) nearPeak += binPower(k);
+    }
+    feat.domHzX10 = (uint16_t)((bestBin * QUAKE_FS * 10 + QUAKE_N / 2) / QUAKE_N);
+    feat.tonalPct = (uint8_t)(total ? nearPeak * 100 / total : 0);
+    feat.lowPct = (uint8_t)(total ? (band[0] + band[1] + band[2]) * 100 / total : 0);
+    for (int b = 0; b < QUAKE_BANDS; b++) feat.band[b] = (uint32_t)clampU(band[b] >> 8, 0xFFFFFFFFu);
+
+    feat.cls = classify(feat);
+  }
+
+  static uint8_t classify(const QuakeFeatures& f) {
+    if (f.rmsMg < QUAKE_NOISE_MG) return QUAKE_QUIET;
+    if (f.peakyX10 >= QUAKE_PEAKY_X10 || f.busyBlocks < QUAKE_MIN_BLOCKS) return QUAKE_IMPULSIVE;
+    if (f.tonalPct >= QUAKE_TONAL_PCT || f.lowPct < QUAKE_LOW_PCT) return QUAKE_MACHINERY;
+    return QUAKE_SEISMIC;
+  }
+
+  uint64_t binPower(int k) const {
+    int m = (QUAKE_N - k) & (QUAKE_N - 1);
+    return (sq(re1[k]) + sq(im1[k]) + sq(re1[m]) + sq(im1[m]) +
+            sq(re2[k]) + sq(im2[k]) + sq(re2[m]) + sq(im2[m])) >> 1;
+  }
+
+  static uint64_t sq(int16_t v) { return (uint64_t)((int32_t)v * v); }
+  static int16_t sat16(int32_t v) { return v > 32767 ? 32767 : (v < -32768 ? -32768 : (int16_t)v); }
+  static uint64_t clampU(uint64_t v, uint64_t hi) { return v > hi ? hi : v; }
+
+  QuakeFft fft;
+  int16_t ax[QUAKE_N], ay[QUAKE_N], az[QUAKE_N]; // ring, head = oldest
+  int16_t re1[QUAKE_N], im1[QUAKE_N], re2[QUAKE_N], im2[QUAKE_N];
+  uint16_t bandBin[QUAKE_BANDS + 1];
+  uint16_t head = 0;
+  uint16_t filled = 0;
+  uint16_t sinceWindow = 0;
+  uint32_t windows = 0;
+  QuakeFeatures feat = {};
+};
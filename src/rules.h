@@ -0,0 +1,452 @@
+/****************************************************************
+ * HIMBUDDY - ALERT RULE ENGINE (TEXT -> BYTECODE)
+ *
+ * Alert conditions as text, one rule per line, '#' = comment:
+ *
+ *   gas > 2500 for 3s and temp_rate > 0.5/min -> FIRE priority 1
+ *   soil < 1500 and soil > 10 -> FLOOD priority 1 cooldown 30s
+ *
+ *   condition  compare signals / numbers with > >= < <= == !=, join
+ *              with and / or / not and ( ). <signal>_rate is the
+ *              signal's change per second (smoothed over ~30 s);
+ *              numbers may carry /s /min /h to say per what.
+ *   for D      after a comparison or a ( group ): that part counts
+ *              only once it held for D (ms, s, min, h); before the
+ *              -> : the whole condition must hold for D
+ *   -> NAME    what fires (the sketch maps it to its alert)
+ *   priority N 1 = most urgent (default 5); ties keep file order
+ *   cooldown D fire again every D while it holds, and never twice
+ *              within D. Without it: once per episode.
+ *
+ * compile() turns the text into one flat table of postfix bytecode
+ * (1-2 bytes per step) with a constant pool; the firmware hands
+ * evaluate() one array of floats per snapshot. No heap, no
+ * exceptions: the new program is built next to the running one and
+ * only swapped in when the whole text compiled, else the old rules
+ * stay and err says which line.
+ * Used by all three sketches; tools/rules_check.cpp compiles and
+ * benchmarks a rules file on a PC before it goes onto the SD card.
+ ****************************************************************/
+#pragma once
+
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RULES_MAX 128
+#define RULES_CODE_MAX 2048
+#define RULES_CONST_MAX 256
+#define RULES_NAME_POOL 1024
+#define RULES_NAME_MAX 24             // longest name + NUL
+#define RULES_SIGNALS_MAX 32
+#define RULES_STACK 16
+#define RULES_TIMERS_MAX 64
+#define RULES_RATE_TAU_S 30.0f
+#define RULES_DEFAULT_PRIORITY 5
+
+enum RuleOp : uint8_t {
+  RULE_OP_END, RULE_OP_SIG, RULE_OP_RATE, RULE_OP_CONST,
+  RULE_OP_GT, RULE_OP_GE, RULE_OP_LT, RULE_OP_LE, RULE_OP_EQ, RULE_OP_NE,
+  RULE_OP_AND, RULE_OP_OR, RULE_OP_NOT, RULE_OP_FOR,
+};
+
+struct Rule {
+  uint16_t code;       // first instruction
+  uint16_t name;       // offset in the name pool
+  uint16_t line;       // in the source text
+  uint8_t priority;
+  uint32_t forMs;
+  uint32_t cooldownMs;
+};
+
+struct RuleState {
+  uint32_t trueSince;
+  uint32_t lastFired;
+  uint32_t fires;
+  bool on;             // condition true now
+  bool held;           // ... and for long enough
+  bool episode;        // fired since it became true
+  bool everFired;
+};
+
+class RuleEngine {
+public:
+  // Replaces the rules on success. On failure the old ones stay and
+  // err says "line N: ...".
+  bool compile(const char* text, const char* const* signalNames, uint8_t signalCount, char* err, size_t errLen) {
+    if (signalCount > RULES_SIGNALS_MAX) return fail(err, errLen, 0, "too many signals");
+    Program& next = prog[live ^ 1];
+    memset(&next, 0, sizeof(next));
+    next.signalCount = signalCount;
+    Parser b = { &next, signalNames, NULL, 0, 0, NULL };
+    uint16_t lineNo = 0;
+    const char* p = text;
+    while (*p) {
+      lineNo++;
+      const char* end = strchr(p, '\n');
+      size_t len = end ? (size_t)(end - p) : strlen(p);
+      char line[160];
+      if (len >= sizeof(line)) return fail(err, errLen, lineNo, "line too long");
+      memcpy(line, p, len);
+      line[len] = 0;
+      p += end ? len + 1 : len;
+      if (!compileLine(b, line, lineNo)) return fail(err, errLen, lineNo, b.error);
+    }
+
+    // accepted: swap in, start every rule from scratch
+    live ^= 1;
+    memset(state, 0, sizeof(state));
+    memset(timing, 0, sizeof(timing));
+    ratesStarted = false;
+    if (err && errLen) err[0] = 0;
+    return true;
+  }
+
+  // One snapshot: values[] in the order of signalNames. Writes the
+  // rules that fire now into fired[] (most urgent first), returns how
+  // many.
+  uint8_t evaluate(uint32_t now, const float* values, uint8_t* fired, uint8_t maxFired) {
+    updateRates(now, values);
+    uint8_t n = 0;
+    const Program& g = prog[live];
+    for (uint8_t i = 0; i < g.ruleCount; i++) {
+      const Rule& r = g.rules[i];
+      RuleState& s = state[i];
+      if (!run(g, r.code, now, values)) {
+        s.on = s.held = s.episode = false;
+        continue;
+      }
+      if (!s.on) { s.on = true; s.trueSince = now; }
+      if (!s.held && now - s.trueSince >= r.forMs) s.held = true;
+      if (!s.held) continue;
+      bool cooled = !s.everFired || now - s.lastFired >= r.cooldownMs;
+      bool again = !s.episode || r.cooldownMs;
+      if (!cooled || !again) continue;
+      s.lastFired = now;
+      s.episode = s.everFired = true;
+      s.fires++;
+      if (n < maxFired) insertByPriority(fired, n++, i);
+    }
+    return n;
+  }
+
+  // Most urgent rule whose condition holds right now (-1 = none)
+  int16_t topHeld() const {
+    const Program& g = prog[live];
+    int16_t best = -1;
+    for (uint8_t i = 0; i < g.ruleCount; i++) {
+      if (state[i].held && (best < 0 || g.rules[i].priority < g.rules[best].priority)) best = i;
+    }
+    return best;
+  }
+
+  uint8_t count() const { return prog[live].ruleCount; }
+  const char* name(uint8_t i) const { return prog[live].names + prog[live].rules[i].name; }
+  const Rule& rule(uint8_t i) const { return prog[live].rules[i]; }
+  const RuleState& status(uint8_t i) const { return state[i]; }
+  uint16_t codeBytes() const { return prog[live].codeLen; }
+
+  // {"name":..,"line":..,"priority":..,"forMs":..,"cooldownMs":..,"held":..,"fires":..}
+  int json(uint8_t i, char* out, size_t len) const {
+    const Rule& r = rule(i);
+    return snprintf(out, len, "{\"name\":\"%s\",\"line\":%u,\"priority\":%u,\"forMs\":%lu,\"cooldownMs\":%lu,\"held\":%s,\"fires\":%lu}",
+                    name(i), (unsigned)r.line, (unsigned)r.priority, (unsigned long)r.forMs,
+                    (unsigned long)r.cooldownMs, state[i].held ? "true" : "false", (unsigned long)state[i].fires);
+  }
+
+private:
+  // ---------- compiler ----------
+  struct Program {
+    uint8_t code[RULES_CODE_MAX];
+    uint16_t codeLen;
+    float consts[RULES_CONST_MAX];
+    uint16_t constCount;
+    char names[RULES_NAME_POOL];
+    uint16_t nameLen;
+    Rule rules[RULES_MAX];
+    uint8_t ruleCount;
+    uint8_t signalCount;
+    bool rateUsed[RULES_SIGNALS_MAX];
+    uint32_t timerMs[RULES_TIMERS_MAX];  // durations of the inner 'for's
+    uint8_t timerCount;
+  };
+
+  struct Parser {
+    Program* g;        // being built
+    const char* const* signals;
+    const char* p;     // parse position
+    int depth, maxDepth;
+    const char* error;
+  };
+
+  static bool fail(char* err, size_t errLen, uint16_t line, const char* msg) {
+    if (err && errLen) {
+      if (line) snprintf(err, errLen, "line %u: %s", (unsigned)line, msg);
+      else snprintf(err, errLen, "%s", msg);
+    }
+    return false;
+  }
+
+  static void skipSpace(Parser& b) {
+    while (*b.p == ' ' || *b.p == '\t' || *b.p == '\r') b.p++;
+  }
+
+  // keyword followed by a non-identifier character
+  static bool accept(Parser& b, const char* word) {
+    skipSpace(b);
+    size_t n = strlen(word);
+    if (strncmp(b.p, word, n) != 0) return false;
+    if (isalnum((unsigned char)word[n - 1]) && (isalnum((unsigned char)b.p[n]) || b.p[n] == '_')) return false;
+    b.p += n;
+    return true;
+  }
+
+  static bool ident(Parser& b, char* out, size_t len) {
+    skipSpace(b);
+    if (!isalpha((unsigned char)*b.p) && *b.p != '_') return false;
+    size_t n = 0;
+    while (isalnum((unsigned char)*b.p) || *b.p == '_') {
+      if (n + 1 < len) out[n++] = *b.p;
+      b.p++;
+    }
+    out[n] = 0;
+    return true;
+  }
+
+  static bool number(Parser& b, float& v) {
+    skipSpace(b);
+    char* end;
+    v = strtof(b.p, &end);
+    if (end == b.p) return false;
+    b.p = end;
+    return true;
+  }
+
+  // "3s" "500ms" "2min" "1h" (a bare number is seconds)
+  static bool duration(Parser& b, uint32_t& ms) {
+    float v;
+    if (!number(b, v) || v < 0) return false;
+    float scale = 1000;
+    if (strncmp(b.p, "ms", 2) == 0) { scale = 1; b.p += 2; }
+    else if (strncmp(b.p, "min", 3) == 0) { scale = 60000; b.p += 3; }
+    else if (*b.p == 's') { b.p++; }
+    else if (*b.p == 'h') { scale = 3600000; b.p++; }
+    ms = (uint32_t)(v * scale + 0.5f);
+    return true;
+  }
+
+  static bool emit(Parser& b, uint8_t op, int arg = -1) {
+    Program& g = *b.g;
+    if (g.codeLen + 2 > RULES_CODE_MAX) { b.error = "rules too large"; return false; }
+    g.code[g.codeLen++] = op;
+    if (arg >= 0) g.code[g.codeLen++] = (uint8_t)arg;
+    if (op == RULE_OP_SIG || op == RULE_OP_RATE || op == RULE_OP_CONST) {
+      if (++b.depth > b.maxDepth) b.maxDepth = b.depth;
+    } else if (op != RULE_OP_NOT && op != RULE_OP_FOR && op != RULE_OP_END) {
+      b.depth--;
+    }
+    if (b.maxDepth > RULES_STACK) { b.error = "condition too deep"; return false; }
+    return true;
+  }
+
+  static bool value(Parser& b) {
+    Program& g = *b.g;
+    char id[32];
+    if (ident(b, id, sizeof(id))) {
+      for (uint8_t i = 0; i < g.signalCount; i++) {
+        if (strcmp(id, b.signals[i]) == 0) return emit(b, RULE_OP_SIG, i);
+      }
+      size_t n = strlen(id);
+      if (n > 5 && strcmp(id + n - 5, "_rate") == 0) {
+        id[n - 5] = 0;
+        for (uint8_t i = 0; i < g.signalCount; i++) {
+          if (strcmp(id, b.signals[i]) == 0) { g.rateUsed[i] = true; return emit(b, RULE_OP_RATE, i); }
+        }
+      }
+      b.error = "unknown signal";
+      return false;
+    }
+    float v;
+    if (!number(b, v)) { b.error = "expected a signal or a number"; return false; }
+    if (*b.p == '/') {
+      if (strncmp(b.p, "/min", 4) == 0) { v /= 60; b.p += 4; }
+      else if (strncmp(b.p, "/h", 2) == 0) { v /= 3600; b.p += 2; }
+      else if (strncmp(b.p, "/s", 2) == 0) { b.p += 2; }
+      else { b.error = "rate unit is /s, /min or /h"; return false; }
+    }
+    uint16_t k = 0;
+    while (k < g.constCount && g.consts[k] != v) k++;
+    if (k == g.constCount) {
+      if (g.constCount == RULES_CONST_MAX) { b.error = "too many numbers"; return false; }
+      g.consts[g.constCount++] = v;
+    }
+    return emit(b, RULE_OP_CONST, k);
+  }
+
+  static bool comparison(Parser& b) {
+    if (!value(b)) return false;
+    skipSpace(b);
+    static const struct { const char* text; uint8_t op; } OPS[] = {
+      { ">=", RULE_OP_GE }, { "<=", RULE_OP_LE }, { "==", RULE_OP_EQ }, { "!=", RULE_OP_NE },
+      { ">", RULE_OP_GT }, { "<", RULE_OP_LT },
+    };
+    for (const auto& o : OPS) {
+      size_t n = strlen(o.text);
+      if (strncmp(b.p, o.text, n) == 0) {
+        b.p += n;
+        return value(b) && emit(b, o.op);
+      }
+    }
+    b.error = "expected > >= < <= == or !=";
+    return false;
+  }
+
+  // "for D" after a comparison or group, unless it is the rule's own
+  // (the one right before ->)
+  static bool timed(Parser& b) {
+    const char* at = b.p;
+    if (!accept(b, "for")) return true;
+    uint32_t ms;
+    if (!duration(b, ms)) { b.error = "bad duration after 'for'"; return false; }
+    if (accept(b, "->")) { b.p = at; return true; }
+    Program& g = *b.g;
+    if (g.timerCount == RULES_TIMERS_MAX) { b.error = "too many 'for's"; return false; }
+    g.timerMs[g.timerCount] = ms;
+    return emit(b, RULE_OP_FOR, g.timerCount++);
+  }
+
+  static bool unary(Parser& b) {
+    if (accept(b, "not")) return unary(b) && emit(b, RULE_OP_NOT);
+    if (accept(b, "(")) {
+      if (!expr(b)) return false;
+      if (!accept(b, ")")) { b.error = "missing )"; return false; }
+      return timed(b);
+    }
+    return comparison(b) && timed(b);
+  }
+
+  static bool conj(Parser& b) {
+    if (!unary(b)) return false;
+    while (accept(b, "and")) {
+      if (!unary(b) || !emit(b, RULE_OP_AND)) return false;
+    }
+    return true;
+  }
+
+  static bool expr(Parser& b) {
+    if (!conj(b)) return false;
+    while (accept(b, "or")) {
+      if (!conj(b) || !emit(b, RULE_OP_OR)) return false;
+    }
+    return true;
+  }
+
+  static bool compileLine(Parser& b, char* line, uint16_t lineNo) {
+    Program& g = *b.g;
+    char* hash = strchr(line, '#');
+    if (hash) *hash = 0;
+    b.p = line;
+    skipSpace(b);
+    if (!*b.p) return true;
+    if (g.ruleCount == RULES_MAX) { b.error = "too many rules"; return false; }
+
+    Rule r = {};
+    r.code = g.codeLen;
+    r.line = lineNo;
+    r.priority = RULES_DEFAULT_PRIORITY;
+    b.depth = b.maxDepth = 0;
+    if (!expr(b)) return false;
+    if (accept(b, "for") && !duration(b, r.forMs)) { b.error = "bad duration after 'for'"; return false; }
+    if (!accept(b, "->")) { b.error = "expected -> NAME"; return false; }
+    char name[RULES_NAME_MAX];
+    if (!ident(b, name, sizeof(name))) { b.error = "expected a name after ->"; return false; }
+    size_t n = strlen(name) + 1;
+    if (g.nameLen + n > RULES_NAME_POOL) { b.error = "names too long"; return false; }
+    r.name = g.nameLen;
+    memcpy(g.names + g.nameLen, name, n);
+    g.nameLen += n;
+    for (;;) {
+      if (accept(b, "priority")) {
+        float v;
+        if (!number(b, v) || v < 1 || v > 255) { b.error = "priority is 1..255"; return false; }
+        r.priority = (uint8_t)v;
+      } else if (accept(b, "cooldown")) {
+        if (!duration(b, r.cooldownMs)) { b.error = "bad duration after 'cooldown'"; return false; }
+      } else break;
+    }
+    skipSpace(b);
+    if (*b.p) { b.error = "unexpected text"; return false; }
+    if (!emit(b, RULE_OP_END)) return false;
+    g.rules[g.ruleCount++] = r;
+    return true;
+  }
+
+  // ---------- runtime ----------
+  void updateRates(uint32_t now, const float* v) {
+    float dt = ratesStarted ? (float)(uint32_t)(now - rateMs) / 1000.0f : 0;
+    if (ratesStarted && dt <= 0) return;
+    float k = 1.0f - expf(-dt / RULES_RATE_TAU_S);
+    const Program& g = prog[live];
+    for (uint8_t i = 0; i < g.signalCount; i++) {
+      if (!g.rateUsed[i] || isnan(v[i])) continue;
+      if (ratesStarted && !isnan(prev[i])) rate[i] += k * ((v[i] - prev[i]) / dt - rate[i]);
+      else rate[i] = 0;
+      prev[i] = v[i];
+    }
+    ratesStarted = true;
+    rateMs = now;
+  }
+
+  bool run(const Program& g, uint16_t pc, uint32_t now, const float* v) {
+    float st[RULES_STACK];
+    int sp = 0;
+    const uint8_t* c = g.code + pc;
+    for (;;) {
+      switch (*c++) {
+        case RULE_OP_SIG:   st[sp++] = v[*c++]; break;
+        case RULE_OP_RATE:  st[sp++] = rate[*c++]; break;
+        case RULE_OP_CONST: st[sp++] = g.consts[*c++]; break;
+        case RULE_OP_GT:    sp--; st[sp - 1] = st[sp - 1] > st[sp]; break;
+        case RULE_OP_GE:    sp--; st[sp - 1] = st[sp - 1] >= st[sp]; break;
+        case RULE_OP_LT:    sp--; st[sp - 1] = st[sp - 1] < st[sp]; break;
+        case RULE_OP_LE:    sp--; st[sp - 1] = st[sp - 1] <= st[sp]; break;
+        case RULE_OP_EQ:    sp--; st[sp - 1] = st[sp - 1] == st[sp]; break;
+        case RULE_OP_NE:    sp--; st[sp - 1] = st[sp - 1] != st[sp]; break;
+        case RULE_OP_AND:   sp--; st[sp - 1] = st[sp - 1] != 0 && st[sp] != 0; break;
+        case RULE_OP_OR:    sp--; st[sp - 1] = st[sp - 1] != 0 || st[sp] != 0; break;
+        case RULE_OP_NOT:   st[sp - 1] = st[sp - 1] == 0; break;
+        case RULE_OP_FOR: {
+          uint8_t t = *c++;
+          if (st[sp - 1] == 0) { timing[t] = false; break; }
+          if (!timing[t]) { timing[t] = true; since[t] = now; }
+          st[sp - 1] = now - since[t] >= g.timerMs[t];
+          break;
+        }
+        default:            return sp > 0 && st[0] != 0; // RULE_OP_END
+      }
+    }
+  }
+
+  void insertByPriority(uint8_t* fired, uint8_t n, uint8_t i) const {
+    uint8_t at = n;
+    const Rule* rules = prog[live].rules;
+    while (at > 0 && rules[fired[at - 1]].priority > rules[i].priority) {
+      fired[at] = fired[at - 1];
+      at--;
+    }
+    fired[at] = i;
+  }
+
+  Program prog[2] = {};  // running one + the one compile() builds
+  uint8_t live = 0;
+  RuleState state[RULES_MAX] = {};
+  uint32_t since[RULES_TIMERS_MAX] = {};  // inner 'for' started at
+  bool timing[RULES_TIMERS_MAX] = {};
+  float prev[RULES_SIGNALS_MAX] = {};
+  float rate[RULES_SIGNALS_MAX] = {};
+  uint32_t rateMs = 0;
+  bool ratesStarted = false;
+};
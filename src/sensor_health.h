@@ -0,0 +1,175 @@
+/****************************************************************
+ * HIMBUDDY - SENSOR HEALTH (ok / degraded / absent, backoff probes)
+ *
+ * A sensor that is not plugged in used to be read like any other, on
+ * every pass: a soil or MQ-2 input left floating reads near 0, the
+ * DHT22 times out, and a missing BME280 / MPU6050 costs an I2C NACK
+ * (or the Wire timeout on a bus without pull-ups) on every call.
+ *
+ * One SensorHealth per device. Each read is reported as
+ *   READ_OK       a plausible value
+ *   READ_BAD      the device answered, but wrong (checksum, range)
+ *   READ_MISSING  no answer / floating input
+ * and moves the device between three states:
+ *   OK        every read goes to the device
+ *   DEGRADED  still read every time; okAfter good reads in a row -> OK
+ *   ABSENT    absentAfter MISSING reads in a row. due() says no, so the
+ *             caller skips the read (and uses "no data"), except for a
+ *             probe every probeMs, doubling after every probe that
+ *             finds nothing, up to probeMaxMs
+ * A probe that gets any answer brings the device back as DEGRADED and
+ * report() returns true: the sketch then runs the device's begin()
+ * again (it may have been power-cycled with the plug).
+ *
+ * The cost of an absent device is then one due() per call plus one
+ * probe per backoff period, so loop() runs as fast with sensors
+ * missing as with all of them present (tools/health_sim.cpp).
+ * No heap, no Arduino headers.
+ ****************************************************************/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+enum HealthState : uint8_t { HEALTH_OK, HEALTH_DEGRADED, HEALTH_ABSENT };
+enum HealthRead : uint8_t { READ_OK, READ_BAD, READ_MISSING };
+
+inline const char* healthStateName(uint8_t s) {
+  static const char* const names[] = { "ok", "degraded", "absent" };
+  return s <= HEALTH_ABSENT ? names[s] : "?";
+}
+
+struct HealthConfig {
+  uint8_t absentAfter;   // MISSING reads in a row -> ABSENT
+  uint8_t okAfter;       // good reads in a row: DEGRADED -> OK
+  uint32_t probeMs;      // first probe after going ABSENT
+  uint32_t probeMaxMs;   // backoff doubles up to this
+};
+
+// I2C / one-wire parts: a probe is a bus transfer, back off far
+constexpr HealthConfig HEALTH_BUS = { 3, 3, 1000, 60000 };
+// analog inputs: a probe is one ADC read, and the gas / flood sensors
+// raise alarms, so a re-plugged one is seen again within 15 s
+constexpr HealthConfig HEALTH_ANALOG = { 5, 3, 1000, 15000 };
+
+class SensorHealth {
+public:
+  // found = false: the device's begin() failed, start ABSENT
+  void begin(const char* deviceName, const HealthConfig& c, bool found, uint32_t nowMs) {
+    name = deviceName;
+    cfg = c;
+    st = HEALTH_OK;
+    goodRun = missRun = 0;
+    reads = errors = missing = probes = skips = changes = 0;
+    backoffMs = cfg.probeMs;
+    if (!found) goAbsent(nowMs);
+  }
+
+  // true: read the device now. Always, unless ABSENT; then only when
+  // the backoff has run out (a probe, report() its result)
+  bool due(uint32_t nowMs) {
+    if (st != HEALTH_ABSENT) return true;
+    if ((int32_t)(nowMs - nextProbeMs) < 0) {
+      skips++;
+      return false;
+    }
+    probes++;
+    nextProbeMs = nowMs + backoffMs;  // in case the result never comes
+    return true;
+  }
+
+  // Result of a read that due() allowed. true: the device was ABSENT
+  // and answered (run its begin() again)
+  bool report(HealthRead r, uint32_t nowMs) {
+    reads++;
+    if (r == READ_MISSING) {
+      missing++;
+      goodRun = 0;
+      if (st == HEALTH_ABSENT) {
+        backoffMs = backoffMs > cfg.probeMaxMs / 2 ? cfg.probeMaxMs : backoffMs * 2;
+        nextProbeMs = nowMs + backoffMs;
+      } else if (++missRun >= cfg.absentAfter) {
+        goAbsent(nowMs);
+      } else {
+        setState(HEALTH_DEGRADED);
+      }
+      return false;
+    }
+    bool back = st == HEALTH_ABSENT;
+    missRun = 0;
+    if (r == READ_BAD) {
+      errors++;
+      goodRun = 0;
+      setState(HEALTH_DEGRADED);
+    } else {
+      if (goodRun < 255) goodRun++;
+      if (back) setState(HEALTH_DEGRADED);
+      if (st == HEALTH_DEGRADED && goodRun >= cfg.okAfter) setState(HEALTH_OK);
+    }
+    if (back) backoffMs = cfg.probeMs;
+    return back;
+  }
+
+  HealthState state() const { return st; }
+  bool absent() const { return st == HEALTH_ABSENT; }
+  const char* deviceName() const { return name; }
+  uint32_t backoff() const { return backoffMs; }
+  uint32_t nextProbe() const { return nextProbeMs; }
+  uint32_t probeCount() const { return probes; }
+  uint32_t skipCount() const { return skips; }
+  uint32_t changeCount() const { return changes; }
+
+  // {"name","state","reads","errors","missing","probes","skips","changes","probeInMs"}
+  int json(char* out, size_t len, uint32_t nowMs) const {
+    long probeIn = -1;  // not ABSENT
+    if (st == HEALTH_ABSENT) probeIn = (int32_t)(nextProbeMs - nowMs) > 0 ? (long)(nextProbeMs - nowMs) : 0;
+    return snprintf(out, len,
+                    "{\"name\":\"%s\",\"state\":\"%s\",\"reads\":%lu,\"errors\":%lu,\"missing\":%lu,\"probes\":%lu,"
+                    "\"skips\":%lu,\"changes\":%lu,\"probeInMs\":%ld}",
+                    name, healthStateName(st), (unsigned long)reads, (unsigned long)errors, (unsigned long)missing,
+                    (unsigned long)probes, (unsigned long)skips, (unsigned long)changes, probeIn);
+  }
+
+private:
+  void setState(HealthState s) {
+    if (s != st) changes++;
+    st = s;
+  }
+
+  void goAbsent(uint32_t nowMs) {
+    setState(HEALTH_ABSENT);
+    missRun = 0;
+    backoffMs = cfg.probeMs;
+    nextProbeMs = nowMs + backoffMs;
+  }
+
+  const char* name = "";
+  HealthConfig cfg = HEALTH_BUS;
+  HealthState st = HEALTH_OK;
+  uint8_t goodRun = 0, missRun = 0;
+  uint32_t backoffMs = 0, nextProbeMs = 0;
+  uint32_t reads = 0, errors = 0, missing = 0, probes = 0, skips = 0, changes = 0;
+};
+
+// [{..},..] of every device (web /api/health, BT "HEALTH")
+inline int healthListJson(const SensorHealth* list, uint8_t count, uint32_t nowMs, char* out, size_t len) {
+  int n = snprintf(out, len, "[");
+  for (uint8_t i = 0; i < count && n >= 0 && (size_t)n < len; i++) {
+    if (i) n += snprintf(out + n, len - n, ",");
+    if ((size_t)n < len) n += list[i].json(out + n, len - n, nowMs);
+  }
+  if (n < 0 || (size_t)n >= len) return n;
+  return n + snprintf(out + n, len - n, "]");
+}
+
+// {"soil":"ok","gas":"absent",..} (BT "STATUS")
+inline int healthSummaryJson(const SensorHealth* list, uint8_t count, char* out, size_t len) {
+  int n = snprintf(out, len, "{");
+  for (uint8_t i = 0; i < count && n >= 0 && (size_t)n < len; i++) {
+    n += snprintf(out + n, len - n, "%s\"%s\":\"%s\"", i ? "," : "", list[i].deviceName(),
+                  healthStateName(list[i].state()));
+  }
+  if (n < 0 || (size_t)n >= len) return n;
+  return n + snprintf(out + n, len - n, "}");
+}
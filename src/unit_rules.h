@@ -0,0 +1,25 @@
+/****************************************************************
+ * HIMBUDDY - ALERT RULE SIGNALS + FACTORY RULES (BT + SD UNIT)
+ *
+ * The signals esp32fullcode.c feeds to its alert rules (src/rules.h),
+ * in values[] order, and the rules it writes to /rules.txt when the
+ * card has none. tools/backtest.cpp replays logs through the same
+ * table and the same default rules, so both stay the same by
+ * construction. The rule name is the alert type.
+ *
+ * Signals: dhtT, dhtH (C, %), mq, soil (raw ADC 0-4095),
+ *          slide (0 Safe .. 3 Danger)
+ * No Arduino headers.
+ ****************************************************************/
+#pragma once
+
+enum RuleSignalIndex { SIG_DHT_T, SIG_DHT_H, SIG_MQ, SIG_SOIL, SIG_SLIDE, SIG_COUNT };
+const char* const RULE_SIGNAL_NAMES[SIG_COUNT] = { "dhtT", "dhtH", "mq", "soil", "slide" };
+
+const char DEFAULT_RULES[] =
+  "dhtT > 45 or dhtH > 85 -> DHT cooldown 5s\n"
+  "mq > 300 -> MQ2 cooldown 5s\n"
+  "soil > 2000 -> SOIL cooldown 5s\n"
+  "# landslide: on reaching Warning, and again on Danger\n"
+  "slide >= 2 -> SLIDE\n"
+  "slide >= 3 -> SLIDE\n";
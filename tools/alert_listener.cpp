@@ -0,0 +1,389 @@
+/****************************************************************
+ * HIMBUDDY - ALERT BEACON LISTENER (Linux / Android NDK)
+ *
+ * Reference listener for the UDP alert broadcast of HimBuddy.c
+ * (src/alert_beacon.h). Join the unit's hotspot and run it: one line
+ * per alert start / change / all clear, repeats dropped.
+ *
+ * --loopback runs the unit's broadcaster too, on this machine:
+ *   schedule  copies of a change at 0 / 20 / 60 / 140 ms, refresh every
+ *             5 s, all with one seq (made-up clock, no sockets)
+ *   garbage   short, long and bit-flipped datagrams are all rejected
+ *   reboot    a unit that restarts (seq from 1 again, new boot id) is
+ *             heard at once; copies from before the reboot stay dropped
+ *   delivery  AlertBeacon -> 127.255.255.255 -> --clients sockets on one
+ *             port, each losing --loss % of what it receives. Every
+ *             change must reach every client, the first copy within
+ *             100 ms (p99). With loss, changes whose copies were all
+ *             lost are counted against loss^4.
+ *
+ * Build : g++ -O2 -std=c++17 -pthread -I. tools/alert_listener.cpp -o alert_listener
+ * Run   : ./alert_listener                  (listen on the hotspot)
+ *         ./alert_listener --loopback
+ *         ./alert_listener --loopback --clients 50 --alerts 200 --loss 20
+ ****************************************************************/
+#include <poll.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/alert_beacon.h"
+
+struct Options {
+  bool loopback = false;
+  int port = BEACON_PORT;
+  int clients = 10;
+  int alerts = 40;
+  int lossPct = 0;
+  unsigned seed = 1;
+};
+
+static long failures = 0;
+
+static void fail(const char* what) {
+  if (failures++ < 10) printf("FAIL %s\n", what);
+}
+
+static std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+static double nowUs() {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// UDP socket bound to port on all addresses; other listeners may share it
+static int bindListener(int port) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) return -1;
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  sockaddr_in a = {};
+  a.sin_family = AF_INET;
+  a.sin_port = htons((uint16_t)port);
+  a.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd, (sockaddr*)&a, sizeof(a)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// ==============================================================
+//                    LISTEN (on the hotspot)
+// ==============================================================
+static int listenHotspot(const Options& o) {
+  int fd = bindListener(o.port);
+  if (fd < 0) {
+    perror("bind");
+    return 1;
+  }
+  printf("listening on udp %d\n", o.port);
+  BeaconListener listener;
+  uint8_t buf[256];
+  for (;;) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n < 0) break;
+    BeaconPacket p;
+    if (!listener.accept(buf, (size_t)n, p)) continue;
+    printf("unit %08lx seq %lu up %lu ms: %s%.*s\n", (unsigned long)p.unit, (unsigned long)p.seq,
+           (unsigned long)p.changedMs, p.active ? "ALERT " : "all clear", p.textLen, p.text);
+    fflush(stdout);
+  }
+  close(fd);
+  return 1;
+}
+
+// ==============================================================
+//                    SCHEDULE
+// ==============================================================
+struct Capture : BeaconTransport {
+  std::vector<BeaconPacket> sent;
+  std::vector<uint32_t> at;
+  uint32_t clock = 0;
+  bool send(const uint8_t* data, size_t len) override {
+    BeaconPacket p;
+    if (!beaconDecode(data, len, p)) return false;
+    sent.push_back(p);
+    at.push_back(clock);
+    return true;
+  }
+};
+
+static void checkSchedule() {
+  Capture cap;
+  AlertBeacon b;
+  b.begin(cap, 0x1234, 1);
+  uint32_t start = 0xFFFFFFF0u;  // wraps the 32 bit clock on the way
+  const char* last = nullptr;
+  auto run = [&](uint32_t from, uint32_t to, const char* alert) {
+    for (uint32_t t = from; t < to; t++) {
+      cap.clock = start + t;
+      // nextDueMs says 0 exactly when update() sends (the loop sleeps on it)
+      uint32_t due = b.nextDueMs(start + t);
+      size_t before = cap.sent.size();
+      b.update(start + t, alert);
+      if (alert == last && (due == 0) != (cap.sent.size() > before)) fail("nextDueMs disagrees with update");
+      last = alert;
+    }
+  };
+  run(0, 1, "");
+  run(1, 1000, "Earthquake");
+  run(1000, 12000, "");
+
+  // copy 0 of the boot state (burst cut short by the alert at 1),
+  // 4 copies of the alert, 4 of the clear, then the refreshes
+  const uint32_t offs[BEACON_REPEATS] = { 0, 20, 60, 140 };
+  if (cap.sent.size() < 1 + 2 * BEACON_REPEATS) {
+    fail("copies missing");
+    return;
+  }
+  if (cap.sent[0].seq != 1 || cap.sent[0].active || cap.at[0] != start) fail("boot copy");
+  size_t i = 1;
+  for (uint32_t change : { 1u, 1000u }) {
+    for (int k = 0; k < BEACON_REPEATS; k++, i++) {
+      const BeaconPacket& p = cap.sent[i];
+      if (cap.at[i] - start != change + offs[k] || p.repeat != k || p.changedMs != start + change) fail("copy time");
+      if (p.seq != (change == 1 ? 2u : 3u) || p.unit != 0x1234) fail("copy seq");
+      if (change == 1 && (!p.active || p.textLen != 10 || memcmp(p.text, "Earthquake", 10))) fail("copy text");
+      if (change == 1000 && (p.active || p.textLen)) fail("all clear copy");
+    }
+  }
+  int refreshes = 0;
+  for (; i < cap.sent.size(); i++, refreshes++) {
+    if (cap.sent[i].repeat != BEACON_REFRESH || cap.sent[i].seq != 3) fail("refresh copy");
+    if (cap.at[i] - start != 1000 + 140 + BEACON_REFRESH_MS * (uint32_t)(refreshes + 1)) fail("refresh time");
+  }
+  if (refreshes != 2) fail("refresh count");
+  printf("schedule: %zu copies, %d refreshes\n", cap.sent.size(), refreshes);
+}
+
+// ==============================================================
+//                    GARBAGE
+// ==============================================================
+static void checkGarbage(std::mt19937& rng) {
+  Capture cap;
+  AlertBeacon b;
+  b.begin(cap, 7, 1);
+  b.update(0, "Gas Leak");
+  BeaconPacket good = cap.sent[0];
+  long tried = 0;
+  for (int i = 0; i < 20000; i++) {
+    uint8_t buf[64];
+    memcpy(buf, &good, sizeof(good));
+    size_t len = sizeof(good);
+    switch (i % 3) {
+      case 0: len = rng() % sizeof(good); break;       // cut short
+      case 1: len = sizeof(good) + 1 + rng() % 15; break;  // longer
+      default: buf[rng() % sizeof(good)] ^= (uint8_t)(1u << (rng() % 8)); break;  // one bit flipped
+    }
+    BeaconListener l;
+    BeaconPacket p;
+    if (l.accept(buf, len, p)) fail("garbage accepted");
+    tried++;
+  }
+  BeaconListener l;
+  BeaconPacket p;
+  if (!l.accept((const uint8_t*)&good, sizeof(good), p) || l.accept((const uint8_t*)&good, sizeof(good), p)) {
+    fail("good packet not accepted once");
+  }
+  printf("garbage : %ld bad datagrams rejected\n", tried);
+}
+
+// ==============================================================
+//                    REBOOT
+// ==============================================================
+static void checkReboot() {
+  Capture cap;
+  BeaconListener l;
+  BeaconPacket p;
+  // first boot: 10 changes, seq up to 10
+  AlertBeacon before;
+  before.begin(cap, 0x42, 0xAAAA);
+  for (uint32_t t = 0; t < 10; t++) before.update(t * 1000, t % 2 ? "Fire" : "");
+  for (const BeaconPacket& s : cap.sent) l.accept((const uint8_t*)&s, sizeof(s), p);
+  BeaconPacket old = cap.sent.back();
+  cap.sent.clear();
+
+  // after the reboot seq is 1 again: every change must get through once
+  AlertBeacon after;
+  after.begin(cap, 0x42, 0xBBBB);
+  int heard = 0, changes = 3;
+  for (uint32_t t = 0; t < (uint32_t)changes; t++) {
+    size_t from = cap.sent.size();
+    for (uint32_t ms = 0; ms < 1000; ms++) after.update(t * 1000 + ms, t % 2 ? "" : "Gas Leak");
+    for (size_t i = from; i < cap.sent.size(); i++) heard += l.accept((const uint8_t*)&cap.sent[i], sizeof(p), p);
+  }
+  if (heard != changes) fail("changes after a reboot not heard once each");
+  // a late copy from the first boot counts as that boot's latest change
+  // (once), never drops the new boot's seqs
+  l.accept((const uint8_t*)&old, sizeof(old), p);
+  after.update(changes * 1000, "Earthquake");
+  if (!l.accept((const uint8_t*)&cap.sent.back(), sizeof(p), p)) fail("new boot lost after a late old copy");
+  printf("reboot  : %d of %d changes heard after the restart\n", heard, changes);
+}
+
+// ==============================================================
+//                    DELIVERY (loopback)
+// ==============================================================
+struct Change {
+  double atUs;
+  std::string text;
+};
+
+static void checkDelivery(const Options& o, std::mt19937& rng) {
+  std::vector<int> fds;
+  for (int c = 0; c < o.clients; c++) {
+    int fd = bindListener(o.port);
+    if (fd < 0) {
+      perror("bind");
+      fail("listener socket");
+      return;
+    }
+    fds.push_back(fd);
+  }
+  UdpBeaconSocket sock;
+  if (!sock.open("127.255.255.255", (uint16_t)o.port)) {
+    fail("broadcast socket");
+    return;
+  }
+
+  std::mutex mu;
+  std::vector<Change> changes(1);  // by seq (0 unused)
+  std::vector<std::vector<double>> latency(o.clients);
+  std::vector<std::vector<bool>> got(o.clients);
+  std::vector<BeaconListener> listeners(o.clients);
+  std::atomic<bool> done(false);
+  long wrongText = 0, lost = 0, received = 0;
+  unsigned lossSeed = rng();
+
+  std::thread rx([&] {
+    std::mt19937 loss(lossSeed);
+    std::vector<pollfd> pfd(fds.size());
+    for (size_t c = 0; c < fds.size(); c++) pfd[c] = { fds[c], POLLIN, 0 };
+    while (!done) {
+      if (poll(pfd.data(), pfd.size(), 10) <= 0) continue;
+      double t = nowUs();
+      for (size_t c = 0; c < pfd.size(); c++) {
+        if (!(pfd[c].revents & POLLIN)) continue;
+        uint8_t buf[256];
+        ssize_t n;
+        while ((n = recv(fds[c], buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+          received++;
+          if ((int)(loss() % 100) < o.lossPct) {
+            lost++;
+            continue;
+          }
+          BeaconPacket p;
+          if (!listeners[c].accept(buf, (size_t)n, p)) continue;
+          std::lock_guard<std::mutex> g(mu);
+          if (p.seq >= changes.size()) continue;
+          const Change& ch = changes[p.seq];
+          if (std::string(p.text, p.textLen) != ch.text || p.active != !ch.text.empty()) wrongText++;
+          if (got[c].size() <= p.seq) got[c].resize(p.seq + 1);
+          got[c][p.seq] = true;
+          latency[c].push_back(t - ch.atUs);
+        }
+      }
+    }
+  });
+
+  // the unit: one loop pass per ms, a new alert (or all clear) every 250 ms
+  const char* texts[] = { "Earthquake", "Gas Leak", "Fire", "Flood Risk", "Landslide Risk", "Sensor Fault" };
+  AlertBeacon beacon;
+  beacon.begin(sock, 0xB0DD1E, (uint32_t)rng());
+  const char* alert = "";
+  uint32_t startMs = 0xFFFFFF00u;
+  double start = nowUs();
+  int made = 0;
+  double nextChange = start;
+  double end = start + (o.alerts + 1) * 250000.0 + 300000;  // + the last burst
+  for (double t = start; t < end; t = nowUs()) {
+    if (made <= o.alerts && t >= nextChange) {
+      alert = (made % 2 == 0) ? texts[rng() % 6] : "";
+      made++;
+      nextChange += 250000;
+    }
+    {
+      std::lock_guard<std::mutex> g(mu);
+      if (strncmp(alert, changes.back().text.c_str(), BEACON_TEXT_LEN) != 0 || changes.size() == 1) {
+        changes.push_back({ t, alert });  // seq = index, set before the first copy goes
+      }
+    }
+    beacon.update(startMs + (uint32_t)((t - start) / 1000), alert);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));  // in flight
+  done = true;
+  rx.join();
+  for (int fd : fds) close(fd);
+
+  size_t seqs = changes.size() - 1;
+  if (beacon.sequence() != seqs) fail("seq is not one per change");
+  std::vector<double> all;
+  long missed = 0;
+  for (int c = 0; c < o.clients; c++) {
+    for (size_t s = 1; s <= seqs; s++) missed += !(s < got[c].size() && got[c][s]);
+    all.insert(all.end(), latency[c].begin(), latency[c].end());
+  }
+  std::sort(all.begin(), all.end());
+  auto pct = [&](double q) { return all.empty() ? 0.0 : all[std::min(all.size() - 1, (size_t)(q * all.size()))] / 1000; };
+  double p99 = pct(0.99);
+  printf("delivery: %d clients x %zu changes, %lu sent, %ld received, %ld lost (%d %%), %ld missed\n", o.clients,
+         seqs, (unsigned long)beacon.sent(), received, lost, o.lossPct, missed);
+  printf("latency : p50 %.2f ms, p99 %.2f ms, max %.2f ms (change -> first copy kept)\n", pct(0.5), p99,
+         all.empty() ? 0.0 : all.back() / 1000);
+  if (beacon.errors()) fail("send errors");
+  if (wrongText) fail("wrong alert text for its seq");
+  if (p99 >= 100) fail("p99 latency 100 ms or more");
+  double expect = (double)o.clients * seqs * pow(o.lossPct / 100.0, BEACON_REPEATS);
+  if (o.lossPct == 0 ? missed != 0 : missed > 5 * expect + 3) fail("changes missed");
+  if (o.lossPct) printf("missed  : %ld, expected about %.1f (loss^%d)\n", missed, expect, BEACON_REPEATS);
+}
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr,
+          "usage: alert_listener [--port 47267]\n"
+          "       alert_listener --loopback [--clients 10] [--alerts 40] [--loss 0] [--seed 1] [--port 47267]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--loopback") {
+      o.loopback = true;
+      continue;
+    }
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--port") o.port = atoi(v);
+    else if (a == "--clients") o.clients = atoi(v);
+    else if (a == "--alerts") o.alerts = atoi(v);
+    else if (a == "--loss") o.lossPct = atoi(v);
+    else if (a == "--seed") o.seed = (unsigned)atoi(v);
+    else usage();
+  }
+  if (o.port < 1 || o.port > 65535 || o.clients < 1 || o.alerts < 1 || o.lossPct < 0 || o.lossPct > 90) usage();
+  if (!o.loopback) return listenHotspot(o);
+
+  std::mt19937 rng(o.seed);
+  checkSchedule();
+  checkGarbage(rng);
+  checkReboot();
+  checkDelivery(o, rng);
+  printf("%s: %ld failed checks\n", failures ? "FAIL" : "OK", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,466 @@
+/****************************************************************
+ * HIMBUDDY - ALERT BACKTEST (runs on a PC)
+ *
+ * Streams recorded sensor logs through the detection code of
+ * esp32fullcode.c (the alert rules of src/rules.h with the signals and
+ * default rules of src/unit_rules.h + the landslide detector of
+ * src/landslide.h) on a virtual clock taken from the log
+ * timestamps, and prints every alert the unit would have raised.
+ * Tune a limit here instead of reflashing and waiting for weather.
+ *
+ * Logs (any number, replayed in time order, '#' = comment):
+ *   CSV   raw snapshots (BT "GET_RAW", journal_sim --dump raw.jnl, or
+ *         an old /raw/<hour>.csv or /senslog.csv):
+ *         "time",dhtT,dhtH,bmeT,bmeH,bmeP,mq,soil,gpsLat,gpsLng
+ *   JSON  alert lines (BT "GET_ALERTS", journal_sim --dump alerts.jnl,
+ *         an old /alerts.log): {"time":..,"dhtT":..,"dhtH":..,"mq":..,"soil":..}
+ * The logs have no accelerometer: the landslide detector sees the soil
+ * only (gravity straight down, no tilt), so "slide" tops out at Watch.
+ *
+ * Labels (--labels): one real event per line, "start,end,TYPE" with
+ * ISO times ("2025-07-01T14:00:00"), TYPE = rule name or * for any.
+ * An alert inside an event (+- --slack seconds) is a hit, else a false
+ * alarm; precision = hits / alerts, recall = events hit / events.
+ *
+ * Sweeps: every $NAME in the rules is replaced by the values given with
+ * --set NAME=a,b,c (several --set = every combination). The log is
+ * parsed once, the variants run on --jobs threads, one line each.
+ *
+ * --demo replays a made-up month of 5 s snapshots (smoke events and
+ * a drought, labelled) instead of logs; --dump writes it out as CSV.
+ *
+ * Build : g++ -O2 -std=c++17 -pthread -I. tools/backtest.cpp -o backtest
+ * Run   : ./backtest --log raw/2025070114.csv --log raw/2025070115.csv
+ *         ./backtest --log senslog.csv --rules rules.txt --labels events.csv
+ *         ./backtest --demo --rules sweep.txt --set MQ=200,250,300,350 --set HOLD=0s,10s,30s
+ ****************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/landslide.h"
+#include "src/rules.h"
+#include "src/unit_rules.h"
+
+struct Row {
+  int64_t t;          // unix seconds
+  float dhtT, dhtH;   // NAN = no reading
+  float mq, soil;
+};
+
+struct Label {
+  int64_t start, end;
+  std::string type;
+};
+
+struct Alert {
+  int64_t t;
+  uint8_t rule;
+};
+
+struct Options {
+  std::vector<std::string> logs;
+  std::string rules, labels, dump;
+  std::vector<std::pair<std::string, std::vector<std::string>>> sets;
+  int jobs = 0;
+  int slack = 60;
+  bool demo = false;
+  bool quiet = false;
+};
+
+// ==============================================================
+//                    PARSING
+// ==============================================================
+static int64_t daysFromCivil(int y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = (unsigned)(y - era * 400);
+  const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int64_t)doe - 719468;
+}
+
+static int digits(const char* s, int n) {
+  int v = 0;
+  for (int i = 0; i < n; i++) {
+    if (s[i] < '0' || s[i] > '9') return -1;
+    v = v * 10 + (s[i] - '0');
+  }
+  return v;
+}
+
+// "YYYY-MM-DDTHH:MM:SS" (or with a space) -> unix seconds, -1 = bad
+static int64_t parseIso(const char* s) {
+  int y = digits(s, 4), mo = digits(s + 5, 2), d = digits(s + 8, 2);
+  int h = digits(s + 11, 2), mi = digits(s + 14, 2), se = digits(s + 17, 2);
+  if (y < 0 || mo < 1 || mo > 12 || d < 1 || h < 0 || mi < 0 || se < 0 || s[4] != '-' || s[13] != ':') return -1;
+  return daysFromCivil(y, (unsigned)mo, (unsigned)d) * 86400 + h * 3600 + mi * 60 + se;
+}
+
+static void formatIso(int64_t t, char* out, size_t len) {
+  int64_t days = t >= 0 ? t / 86400 : (t - 86399) / 86400;
+  int64_t sec = t - days * 86400;
+  // civil from days (inverse of daysFromCivil)
+  days += 719468;
+  const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  const unsigned doe = (unsigned)(days - era * 146097);
+  const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const unsigned mp = (5 * doy + 2) / 153;
+  const unsigned d = doy - (153 * mp + 2) / 5 + 1;
+  const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+  const int y = (int)(yoe + era * 400 + (m <= 2));
+  snprintf(out, len, "%04d-%02u-%02uT%02d:%02d:%02d", y % 10000, m % 100, d % 100, (int)(sec / 3600),
+           (int)(sec / 60 % 60), (int)(sec % 60));
+}
+
+// Number after "key": in a JSON line (NAN = missing)
+static float jsonNumber(const char* line, const char* key) {
+  char pat[24];
+  snprintf(pat, sizeof(pat), "\"%s\":", key);
+  const char* p = strstr(line, pat);
+  return p ? strtof(p + strlen(pat), NULL) : NAN;
+}
+
+static bool parseJsonRow(const char* line, Row& r) {
+  const char* p = strstr(line, "\"time\":\"");
+  if (!p || (r.t = parseIso(p + 8)) < 0) return false;
+  r.dhtT = jsonNumber(line, "dhtT");
+  r.dhtH = jsonNumber(line, "dhtH");
+  r.mq = jsonNumber(line, "mq");
+  r.soil = jsonNumber(line, "soil");
+  // the firmware writes 0.00 for a missing DHT reading
+  if (r.dhtT == 0 && r.dhtH == 0) r.dhtT = r.dhtH = NAN;
+  return !std::isnan(r.mq) && !std::isnan(r.soil);
+}
+
+// time,dhtT,dhtH,bmeT,bmeH,bmeP,mq,soil[,...] (strtof, not sscanf: a
+// month of rows parses in a fraction of a second)
+static bool parseCsvRow(const char* line, Row& r) {
+  const char* p = line + (line[0] == '"');
+  if ((r.t = parseIso(p)) < 0) return false;
+  p = strchr(p, ',');
+  float v[7];
+  for (float& x : v) {
+    if (!p || *p != ',') return false;
+    char* end;
+    x = strtof(p + 1, &end);
+    if (end == p + 1) return false;
+    p = end;
+  }
+  r.dhtT = v[0];
+  r.dhtH = v[1];
+  r.mq = v[5];
+  r.soil = v[6];
+  if (r.dhtT == 0 && r.dhtH == 0) r.dhtT = r.dhtH = NAN;
+  return true;
+}
+
+static void loadLog(const std::string& path, std::vector<Row>& rows) {
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) { perror(path.c_str()); exit(1); }
+  char line[640];
+  size_t bad = 0;
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#' || line[0] == '\n' || strncmp(line, "time", 4) == 0) continue;
+    Row r;
+    if (line[0] == '{' ? parseJsonRow(line, r) : parseCsvRow(line, r)) rows.push_back(r);
+    else bad++;
+  }
+  fclose(f);
+  if (bad) fprintf(stderr, "%s: %zu lines skipped\n", path.c_str(), bad);
+}
+
+static std::vector<Label> loadLabels(const std::string& path) {
+  std::vector<Label> labels;
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) { perror(path.c_str()); exit(1); }
+  char line[160];
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#') continue;
+    char a[24], b[24], type[32];
+    if (sscanf(line, "%23[^,],%23[^,],%31s", a, b, type) != 3) continue;
+    Label l = { parseIso(a), parseIso(b), type };
+    if (l.start >= 0 && l.end >= l.start) labels.push_back(l);
+  }
+  fclose(f);
+  return labels;
+}
+
+static std::string readFile(const std::string& path) {
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) { perror(path.c_str()); exit(1); }
+  std::string text;
+  char buf[512];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, n);
+  fclose(f);
+  return text;
+}
+
+// ==============================================================
+//                    DEMO MONTH
+// ==============================================================
+// 30 days of 5 s snapshots: daily temperature / humidity swing, MQ2
+// drift with cooking spikes twice a day (not events), five smoke
+// events (labelled MQ2), rain showers, and a drought from day 21 that
+// takes the soil past the dry limit (labelled SOIL). Raw soil goes UP
+// when it dries.
+static void demoMonth(std::vector<Row>& rows, std::vector<Label>& labels) {
+  std::mt19937 rng(7);
+  std::normal_distribution<float> noise(0, 1);
+  std::uniform_real_distribution<float> uni(0, 1);
+  const int64_t t0 = parseIso("2025-07-01T00:00:00");
+  const int64_t days = 30;
+
+  struct Event { int64_t start, len; float level; };
+  std::vector<Event> smoke, cooking;
+  for (int64_t d = 0; d < days; d++) {
+    cooking.push_back({ t0 + d * 86400 + 7 * 3600 + (int64_t)(uni(rng) * 3600), 600, 180 });
+    cooking.push_back({ t0 + d * 86400 + 19 * 3600 + (int64_t)(uni(rng) * 3600), 900, 220 });
+    if (d % 6 == 3) smoke.push_back({ t0 + d * 86400 + (int64_t)(uni(rng) * 80000), 1200, 600 });
+  }
+  for (const Event& e : smoke) labels.push_back({ e.start, e.start + e.len, "MQ2" });
+
+  float soil = 1600, mq = 150;
+  int64_t dryFrom = -1;
+  for (int64_t t = t0; t < t0 + days * 86400; t += 5) {
+    double h = (double)((t - t0) % 86400) / 3600;
+    Row r;
+    r.t = t;
+    r.dhtT = (float)(18 + 8 * sin((h - 9) / 24 * 2 * M_PI)) + 0.2f * noise(rng);
+    r.dhtH = (float)(60 - 20 * sin((h - 9) / 24 * 2 * M_PI)) + 0.5f * noise(rng);
+    if (uni(rng) < 0.002f) r.dhtT = r.dhtH = NAN;  // DHT read fails now and then
+
+    mq += 0.001f * (150 - mq) + 0.3f * noise(rng);
+    float extra = 0;
+    for (const Event& e : cooking) if (t >= e.start && t < e.start + e.len) extra = e.level;
+    for (const Event& e : smoke) if (t >= e.start && t < e.start + e.len) extra = e.level;
+    r.mq = mq + extra + 8 * noise(rng);
+
+    // a shower every 3rd afternoon keeps it near 1600, until the drought
+    int64_t day = (t - t0) / 86400;
+    bool raining = day < 21 && day % 3 == 1 && h > 14 && h < 16;
+    soil += raining ? -2.0f : (day < 21 ? 6.0f : 30.0f) * 5 / 3600;
+    soil = std::max(1200.0f, std::min(2600.0f, soil));
+    if (dryFrom < 0 && soil > 2000) dryFrom = t;
+    r.soil = soil + 10 * noise(rng);
+    rows.push_back(r);
+  }
+  if (dryFrom >= 0) labels.push_back({ dryFrom, rows.back().t, "SOIL" });
+}
+
+static void dumpCsv(const std::string& path, const std::vector<Row>& rows) {
+  FILE* f = fopen(path.c_str(), "w");
+  if (!f) { perror(path.c_str()); exit(1); }
+  fprintf(f, "time,dhtT,dhtH,bmeT,bmeH,bmeP,mqRaw,soilRaw,gpsLat,gpsLng\n");
+  char ts[24];
+  for (const Row& r : rows) {
+    formatIso(r.t, ts, sizeof(ts));
+    fprintf(f, "\"%s\",%.2f,%.2f,0.00,0.00,0.00,%d,%d,0.000000,0.000000\n", ts, std::isnan(r.dhtT) ? 0.0 : r.dhtT,
+            std::isnan(r.dhtH) ? 0.0 : r.dhtH, (int)r.mq, (int)r.soil);
+  }
+  fclose(f);
+}
+
+// ==============================================================
+//                    REPLAY
+// ==============================================================
+struct Score {
+  size_t alerts = 0, hits = 0, events = 0, eventsHit = 0;
+  double replayMs = 0;
+};
+
+// One variant over all rows. Alerts go to out (if not NULL).
+static Score replay(const std::string& text, const std::vector<Row>& rows, const std::vector<Label>& labels,
+                    int slack, std::vector<Alert>* out, RuleEngine& engine) {
+  char err[64];
+  if (!engine.compile(text.c_str(), RULE_SIGNAL_NAMES, SIG_COUNT, err, sizeof(err))) {
+    fprintf(stderr, "rules: %s\n", err);
+    exit(1);
+  }
+  Score s;
+  std::vector<char> eventHit(labels.size(), 0);
+  LandslideDetector slide;
+  auto start = std::chrono::steady_clock::now();
+  const int64_t t0 = rows.empty() ? 0 : rows[0].t;
+  slide.begin(LANDSLIDE_CONFIG_DEFAULT, 0);
+
+  size_t from = 0;  // labels are sorted by start; first that may still match
+  for (const Row& r : rows) {
+    uint32_t now = (uint32_t)((r.t - t0) * 1000);  // virtual millis()
+    float soilPct = (4095 - r.soil) * 100.0f / 4095;
+    slide.update(now, soilPct, 0, 0, 1, 0);
+
+    float v[SIG_COUNT];
+    v[SIG_DHT_T] = r.dhtT;
+    v[SIG_DHT_H] = r.dhtH;
+    v[SIG_MQ] = r.mq;
+    v[SIG_SOIL] = r.soil;
+    v[SIG_SLIDE] = slide.level();
+    uint8_t fired[8];
+    uint8_t n = engine.evaluate(now, v, fired, sizeof(fired));
+    for (uint8_t i = 0; i < n; i++) {
+      s.alerts++;
+      if (out) out->push_back({ r.t, fired[i] });
+      while (from < labels.size() && labels[from].end + slack < r.t) from++;
+      bool hit = false;
+      for (size_t k = from; k < labels.size() && labels[k].start - slack <= r.t; k++) {
+        const Label& l = labels[k];
+        if (r.t > l.end + slack) continue;
+        if (l.type == "*" || l.type == engine.name(fired[i])) { hit = true; eventHit[k] = 1; }
+      }
+      s.hits += hit;
+    }
+  }
+  s.replayMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  s.events = labels.size();
+  for (char hit : eventHit) s.eventsHit += hit;
+  return s;
+}
+
+// $NAME -> value for one combination of the --set lists
+static std::string substitute(std::string text, const Options& o, size_t combo) {
+  for (const auto& set : o.sets) {
+    const std::string& value = set.second[combo % set.second.size()];
+    combo /= set.second.size();
+    std::string key = "$" + set.first;
+    for (size_t at; (at = text.find(key)) != std::string::npos;) text.replace(at, key.size(), value);
+  }
+  return text;
+}
+
+static std::string comboName(const Options& o, size_t combo) {
+  std::string name;
+  for (const auto& set : o.sets) {
+    if (!name.empty()) name += " ";
+    name += set.first + "=" + set.second[combo % set.second.size()];
+    combo /= set.second.size();
+  }
+  return name;
+}
+
+static void printScore(const Score& s, bool labelled) {
+  if (labelled) {
+    printf("%7zu alerts  precision %5.1f%%  recall %5.1f%% (%zu/%zu events)", s.alerts,
+           s.alerts ? 100.0 * s.hits / s.alerts : 100.0, s.events ? 100.0 * s.eventsHit / s.events : 100.0,
+           s.eventsHit, s.events);
+  } else {
+    printf("%7zu alerts", s.alerts);
+  }
+}
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr,
+          "usage: backtest (--log FILE ... | --demo) [--rules FILE] [--labels FILE] [--slack 60]\n"
+          "                [--set NAME=a,b,c ...] [--jobs N] [--dump FILE] [--quiet 1]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--demo") { o.demo = true; continue; }
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--log") o.logs.push_back(v);
+    else if (a == "--rules") o.rules = v;
+    else if (a == "--labels") o.labels = v;
+    else if (a == "--dump") o.dump = v;
+    else if (a == "--slack") o.slack = atoi(v);
+    else if (a == "--jobs") o.jobs = atoi(v);
+    else if (a == "--quiet") o.quiet = atoi(v) != 0;
+    else if (a == "--set") {
+      const char* eq = strchr(v, '=');
+      if (!eq) usage();
+      std::vector<std::string> values;
+      for (const char* p = eq + 1; *p;) {
+        const char* comma = strchr(p, ',');
+        size_t n = comma ? (size_t)(comma - p) : strlen(p);
+        values.push_back(std::string(p, n));
+        p += comma ? n + 1 : n;
+      }
+      if (values.empty()) usage();
+      o.sets.push_back({ std::string(v, eq - v), values });
+    } else usage();
+  }
+  if (o.logs.empty() && !o.demo) usage();
+
+  auto parseStart = std::chrono::steady_clock::now();
+  std::vector<Row> rows;
+  std::vector<Label> labels;
+  if (o.demo) demoMonth(rows, labels);
+  for (const std::string& path : o.logs) loadLog(path, rows);
+  std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.t < b.t; });
+  if (!o.labels.empty()) labels = loadLabels(o.labels);
+  std::sort(labels.begin(), labels.end(), [](const Label& a, const Label& b) { return a.start < b.start; });
+  double parseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - parseStart).count();
+  if (!o.dump.empty()) dumpCsv(o.dump, rows);
+  if (rows.empty()) { fprintf(stderr, "no snapshots\n"); return 1; }
+
+  std::string text = o.rules.empty() ? DEFAULT_RULES : readFile(o.rules);
+  bool labelled = !labels.empty();
+  char from[24], to[24];
+  formatIso(rows.front().t, from, sizeof(from));
+  formatIso(rows.back().t, to, sizeof(to));
+  printf("%zu snapshots, %s .. %s (%.1f days), %zu labelled events, parsed in %.0f ms\n\n", rows.size(), from, to,
+         (rows.back().t - rows.front().t) / 86400.0, labels.size(), parseMs);
+
+  size_t combos = 1;
+  for (const auto& set : o.sets) combos *= set.second.size();
+
+  if (combos == 1) {
+    // one run: every alert with its time
+    std::unique_ptr<RuleEngine> engine(new RuleEngine());
+    std::vector<Alert> alerts;
+    Score s = replay(substitute(text, o, 0), rows, labels, o.slack, &alerts, *engine);
+    if (!o.quiet) {
+      for (const Alert& a : alerts) {
+        char ts[24];
+        formatIso(a.t, ts, sizeof(ts));
+        printf("%s  %-12s line %u\n", ts, engine->name(a.rule), (unsigned)engine->rule(a.rule).line);
+      }
+      printf("\n");
+    }
+    printScore(s, labelled);
+    printf("\nreplay: %.1f ms, %.1f M snapshots/s\n", s.replayMs, rows.size() / s.replayMs / 1000);
+    return 0;
+  }
+
+  // sweep: every combination, spread over the cores
+  int jobs = o.jobs > 0 ? o.jobs : (int)std::max(1u, std::thread::hardware_concurrency());
+  std::vector<Score> scores(combos);
+  std::atomic<size_t> next(0);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int j = 0; j < jobs; j++) {
+    threads.emplace_back([&]() {
+      std::unique_ptr<RuleEngine> engine(new RuleEngine());
+      for (size_t c; (c = next++) < combos;) scores[c] = replay(substitute(text, o, c), rows, labels, o.slack, NULL, *engine);
+    });
+  }
+  for (std::thread& t : threads) t.join();
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  for (size_t c = 0; c < combos; c++) {
+    printf("%-32s ", comboName(o, c).c_str());
+    printScore(scores[c], labelled);
+    printf("  %6.1f ms\n", scores[c].replayMs);
+  }
+  printf("\n%zu variants on %d threads in %.0f ms (%.1f M snapshots/s)\n", combos, jobs, ms,
+         combos * rows.size() / ms / 1000);
+  return 0;
+}
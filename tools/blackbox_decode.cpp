@@ -0,0 +1,356 @@
+/****************************************************************
+ * HIMBUDDY - BLACK BOX EVENT DECODER (runs on a PC)
+ *
+ * Reads the event files of src/blackbox.h: from the SD card of the BT
+ * unit (the .hbb files in /bb, or BT "GET_EVENT name") or from the web unit
+ * (/api/blackbox?fmt=bin). For each file it checks the FNV check word
+ * and prints the event: cause, trigger time, per channel min / max
+ * before and after the trigger, sample rate and gaps. --csv writes
+ * <file>.fast.csv and <file>.slow.csv (ms, ms from the trigger, one
+ * column per channel) for a spreadsheet or a plot.
+ *
+ * --selftest runs the recorder the way HimBuddy.c does (100 Hz MPU
+ * samples, 1 Hz soil / gas / DHT) with alerts at random times: every
+ * event must hold exactly the samples of its pre / post window, read
+ * out in pieces of any size; a second alert in the post window is
+ * merged, one before release() dropped; a flipped byte or a cut file
+ * is refused. Also the time of pushFast(), trigger() and a readout.
+ *
+ * Build : g++ -O2 -std=c++17 -I. tools/blackbox_decode.cpp -o blackbox_decode
+ * Run   : ./blackbox_decode 0000002A.hbb --csv
+ *         curl -o last.hbb 'http://192.168.4.1/api/blackbox?fmt=bin' && ./blackbox_decode last.hbb
+ *         ./blackbox_decode --selftest --events 500 --seed 3
+ ****************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/blackbox.h"
+
+struct Options {
+  std::vector<std::string> files;
+  bool csv = false;
+  bool selftest = false;
+  long events = 200;
+  unsigned seed = 1;
+};
+
+static long failures = 0;
+
+static void fail(const char* what) {
+  if (failures++ < 10) printf("FAIL %s\n", what);
+}
+
+// ==============================================================
+//                    DECODE
+// ==============================================================
+struct Stream {
+  std::vector<std::string> names;
+  std::vector<uint32_t> ms;
+  std::vector<std::vector<int16_t>> v;
+  uint16_t pre = 0;
+};
+
+static std::vector<std::string> split(const std::string& s, char sep) {
+  std::vector<std::string> out;
+  size_t at = 0;
+  while (true) {
+    size_t next = s.find(sep, at);
+    out.push_back(s.substr(at, next == std::string::npos ? std::string::npos : next - at));
+    if (next == std::string::npos) return out;
+    at = next + 1;
+  }
+}
+
+static void readStream(const uint8_t* b, size_t at, uint16_t count, uint8_t ch, uint32_t t0, Stream& s) {
+  uint32_t t = t0;
+  for (uint16_t i = 0; i < count; i++, at += 2 + 2 * ch) {
+    uint16_t dt;
+    memcpy(&dt, b + at, 2);
+    t += dt;
+    s.ms.push_back(t);
+    std::vector<int16_t> v(ch);
+    memcpy(v.data(), b + at + 2, 2 * ch);
+    s.v.push_back(v);
+  }
+  while (s.names.size() < ch) s.names.push_back("ch" + std::to_string(s.names.size()));
+}
+
+static bool decode(const std::vector<uint8_t>& b, BlackboxHeader& h, Stream& fast, Stream& slow) {
+  const char* names;
+  size_t fastAt, slowAt;
+  if (!blackboxParse(b.data(), b.size(), h, names, fastAt, slowAt)) return false;
+  std::vector<std::string> groups = split(names, ';');
+  if (groups.size() > 0) fast.names = split(groups[0], ',');
+  if (groups.size() > 1) slow.names = split(groups[1], ',');
+  fast.pre = h.fastPre;
+  slow.pre = h.slowPre;
+  readStream(b.data(), fastAt, h.fastCount, h.fastCh, h.fastT0, fast);
+  readStream(b.data(), slowAt, h.slowCount, h.slowCh, h.slowT0, slow);
+  return true;
+}
+
+static void printStream(const char* label, const Stream& s, uint32_t triggerMs) {
+  if (s.ms.empty()) {
+    printf("  %s: no samples\n", label);
+    return;
+  }
+  long from = (long)(int32_t)(s.ms.front() - triggerMs), to = (long)(int32_t)(s.ms.back() - triggerMs);
+  uint32_t gap = 0;
+  for (size_t i = 1; i < s.ms.size(); i++) gap = std::max(gap, s.ms[i] - s.ms[i - 1]);
+  double hz = s.ms.size() > 1 && to > from ? (s.ms.size() - 1) * 1000.0 / (to - from) : 0;
+  printf("  %s: %zu samples (%u before the trigger), %+ld .. %+ld ms, %.1f Hz, longest gap %lu ms\n", label,
+         s.ms.size(), s.pre, from, to, hz, (unsigned long)gap);
+  for (size_t c = 0; c < s.names.size() && c < s.v[0].size(); c++) {
+    int lo[2] = { 32767, 32767 }, hi[2] = { -32768, -32768 };
+    for (size_t i = 0; i < s.v.size(); i++) {
+      int k = i < s.pre ? 0 : 1;
+      lo[k] = std::min(lo[k], (int)s.v[i][c]);
+      hi[k] = std::max(hi[k], (int)s.v[i][c]);
+    }
+    char before[32] = "-", after[32] = "-";
+    if (s.pre) snprintf(before, sizeof(before), "%d .. %d", lo[0], hi[0]);
+    if (s.v.size() > s.pre) snprintf(after, sizeof(after), "%d .. %d", lo[1], hi[1]);
+    printf("    %-8s before %-16s after %s\n", s.names[c].c_str(), before, after);
+  }
+}
+
+static bool writeCsv(const std::string& path, const Stream& s, uint32_t triggerMs) {
+  FILE* f = fopen(path.c_str(), "w");
+  if (!f) return false;
+  fprintf(f, "ms,rel_ms");
+  for (const std::string& n : s.names) fprintf(f, ",%s", n.c_str());
+  fprintf(f, "\n");
+  for (size_t i = 0; i < s.ms.size(); i++) {
+    fprintf(f, "%lu,%ld", (unsigned long)s.ms[i], (long)(int32_t)(s.ms[i] - triggerMs));
+    for (int16_t x : s.v[i]) fprintf(f, ",%d", x);
+    fprintf(f, "\n");
+  }
+  fclose(f);
+  return true;
+}
+
+static void decodeFile(const Options& o, const std::string& path) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) {
+    printf("FAIL %s: cannot open\n", path.c_str());
+    failures++;
+    return;
+  }
+  std::vector<uint8_t> b;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) b.insert(b.end(), chunk, chunk + n);
+  fclose(f);
+
+  BlackboxHeader h;
+  Stream fast, slow;
+  if (!decode(b, h, fast, slow)) {
+    printf("FAIL %s: not a black box event, cut short or damaged (%zu bytes)\n", path.c_str(), b.size());
+    failures++;
+    return;
+  }
+  char cause[BLACKBOX_CAUSE_LEN + 1] = {};
+  memcpy(cause, h.cause, BLACKBOX_CAUSE_LEN);
+  printf("%s: event %lu \"%s\" at %lu ms (%u trigger%s), %zu bytes\n", path.c_str(), (unsigned long)h.id, cause,
+         (unsigned long)h.triggerMs, h.triggers, h.triggers == 1 ? "" : "s", b.size());
+  printStream("fast", fast, h.triggerMs);
+  printStream("slow", slow, h.triggerMs);
+  if (o.csv && (!writeCsv(path + ".fast.csv", fast, h.triggerMs) || !writeCsv(path + ".slow.csv", slow, h.triggerMs))) {
+    printf("FAIL %s: cannot write the CSV files\n", path.c_str());
+    failures++;
+  }
+}
+
+// ==============================================================
+//                    SELF TEST
+// ==============================================================
+// same sizes as HimBuddy.c
+#define T_PRE_MS 6000
+#define T_POST_MS 3000
+typedef Blackbox<3, 640, 960, 4, 16> TestBox;
+static TestBox box;
+
+struct Pushed {
+  uint32_t ms;
+  int16_t v[4];
+};
+
+static void selftest(const Options& o) {
+  std::mt19937 rng(o.seed);
+  box.begin(T_PRE_MS, T_POST_MS, "ax,ay,az;soil,gas,temp,hum");
+  std::vector<Pushed> fastLog, slowLog;  // everything pushed
+  uint32_t ms = 0xFFFFFFFFu - 20000;       // millis() wraps on the way
+  long frozen = 0, merged = 0, dropped = 0;
+
+  for (long e = 0; e < o.events; e++) {
+    // run a random while, then an alert; sometimes a FIFO gap
+    uint32_t runMs = 2000 + rng() % 15000;
+    uint32_t triggerAt = ms + runMs;
+    bool second = rng() % 4 == 0, tooSoon = rng() % 5 == 0;
+    uint32_t secondAt = triggerAt + 1 + rng() % (T_POST_MS - 1);
+    bool triggered = false, secondDone = false;
+    uint32_t frozenAt = 0;
+    std::vector<uint8_t> file;
+    while (true) {
+      if (rng() % 500 == 0) ms += 200 + rng() % 1500;  // FIFO overflow: samples missing
+      ms += 10;
+      int16_t a[3] = { (int16_t)(rng() % 2000 - 1000), (int16_t)(rng() % 2000 - 1000), (int16_t)(1000 + rng() % 50) };
+      box.pushFast(ms, a);
+      fastLog.push_back({ ms, { a[0], a[1], a[2], 0 } });
+      if (ms % 1000 < 10) {
+        int16_t s[4] = { (int16_t)(rng() % 4096), (int16_t)(rng() % 4096), (int16_t)(rng() % 500), (int16_t)(rng() % 1000) };
+        box.pushSlow(ms, s);
+        slowLog.push_back({ ms, { s[0], s[1], s[2], s[3] } });
+      }
+      if (!triggered && (int32_t)(ms - triggerAt) >= 0) {
+        triggered = true;
+        triggerAt = ms;
+        if (!box.trigger(ms, "EARTHQUAKE!")) fail("trigger refused while idle");
+      }
+      if (triggered && second && !secondDone && (int32_t)(ms - secondAt) >= 0) {
+        secondDone = true;
+        box.trigger(ms, "FIRE ALERT!");
+        merged++;
+      }
+      if (box.poll(ms)) {
+        frozen++;
+        frozenAt = ms;
+        // read out in random pieces, as the SD writer / web would
+        size_t size = box.eventBytes(), at = 0;
+        file.resize(size);
+        while (at < size) {
+          size_t want = 1 + rng() % 700;
+          size_t n = box.readEvent(at, file.data() + at, std::min(want, size - at));
+          if (n == 0) break;
+          at += n;
+          if (tooSoon) {
+            // an alert while the event waits for its reader
+            if (box.trigger(ms, "FLOOD DETECTED!")) fail("trigger accepted before release()");
+            dropped++;
+            tooSoon = false;
+          }
+        }
+        if (at != size || box.readEvent(size, file.data(), 1) != 0) fail("readEvent size");
+        box.release();
+        break;
+      }
+    }
+
+    // check the file against the log
+    BlackboxHeader h;
+    Stream fast, slow;
+    if (!decode(file, h, fast, slow)) {
+      fail("event does not parse");
+      continue;
+    }
+    if (h.id != (uint32_t)(e + 1) || h.triggerMs != triggerAt || strcmp(h.cause, "EARTHQUAKE!") != 0 ||
+        h.triggers != (second ? 2 : 1)) {
+      fail("header differs");
+    }
+    if (fast.names.size() != 3 || slow.names.size() != 4 || fast.names[2] != "az" || slow.names[3] != "hum") {
+      fail("channel names");
+    }
+    // everything from preMs before the trigger up to the freeze, but at
+    // most `ring` samples before it
+    auto expect = [&](const std::vector<Pushed>& log, const Stream& s, size_t ring, uint8_t ch) {
+      std::vector<Pushed> want;
+      size_t pre = 0;
+      for (const Pushed& p : log) {
+        int32_t rel = (int32_t)(p.ms - triggerAt);
+        if (rel <= 0 && -rel <= T_PRE_MS) pre++;
+        if ((rel <= 0 && -rel <= T_PRE_MS) || (rel > 0 && (int32_t)(p.ms - frozenAt) <= 0)) want.push_back(p);
+      }
+      if (pre > ring) want.erase(want.begin(), want.begin() + (pre - ring));
+      if (std::min(pre, ring) != s.pre || want.size() != s.ms.size()) return false;
+      for (size_t i = 0; i < want.size(); i++) {
+        if (want[i].ms != s.ms[i] || memcmp(want[i].v, s.v[i].data(), 2 * ch) != 0) return false;
+      }
+      return true;
+    };
+    if (!expect(fastLog, fast, 640, 3)) fail("fast samples differ from the pre / post window");
+    if (!expect(slowLog, slow, 16, 4)) fail("slow samples differ from the pre / post window");
+    if (fast.pre == 0 || fast.ms.size() <= fast.pre) fail("no fast samples on one side of the trigger");
+
+    // damage: one flipped bit, one byte less
+    std::vector<uint8_t> bad = file;
+    bad[rng() % bad.size()] ^= (uint8_t)(1u << (rng() % 8));
+    if (decode(bad, h, fast, slow)) fail("flipped bit not noticed");
+    bad = file;
+    bad.pop_back();
+    if (decode(bad, h, fast, slow)) fail("cut file not noticed");
+
+    // logs only need the last pre window
+    if (fastLog.size() > 4000) fastLog.erase(fastLog.begin(), fastLog.end() - 2000);
+    if (slowLog.size() > 100) slowLog.erase(slowLog.begin(), slowLog.end() - 50);
+  }
+  printf("self  : %ld events, %ld merged alerts, %ld dropped (before release)\n", frozen, merged, dropped);
+  if (frozen != o.events) fail("not every alert froze an event");
+
+  // time
+  const long N = 10000000;
+  int16_t a[3] = { 1, 2, 3 };
+  auto t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < N; i++) {
+    a[0] = (int16_t)i;
+    box.pushFast((uint32_t)i * 10, a);
+  }
+  double pushNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / N;
+  uint32_t now = (uint32_t)N * 10;
+  t0 = std::chrono::steady_clock::now();
+  box.trigger(now, "TIMING");
+  double trigUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+  for (int i = 0; i < 300; i++) box.pushFast(now += 10, a);
+  box.poll(now);
+  static uint8_t file[TestBox::MAX_BYTES];
+  t0 = std::chrono::steady_clock::now();
+  size_t bytes = box.readEvent(0, file, sizeof(file));
+  double readUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+  box.release();
+  printf("time  : %.1f ns per pushFast(), %.1f us per trigger(), %.1f us to read a %zu byte event\n", pushNs, trigUs,
+         readUs, bytes);
+}
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr,
+          "usage: blackbox_decode file.hbb [file.hbb ...] [--csv]\n"
+          "       blackbox_decode --selftest [--events 200] [--seed 1]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a.compare(0, 2, "--") != 0) {
+      o.files.push_back(a);
+      continue;
+    }
+    if (a == "--csv") {
+      o.csv = true;
+      continue;
+    }
+    if (a == "--selftest") {
+      o.selftest = true;
+      continue;
+    }
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--events") o.events = atol(v);
+    else if (a == "--seed") o.seed = (unsigned)atoi(v);
+    else usage();
+  }
+  if ((o.files.empty() && !o.selftest) || o.events < 1) usage();
+  for (const std::string& f : o.files) decodeFile(o, f);
+  if (o.selftest) selftest(o);
+  printf("%s: %ld failed checks\n", failures ? "FAIL" : "OK", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,272 @@
+/****************************************************************
+ * HIMBUDDY - LOOP DEADLINE + STALL TRACE SIMULATOR (runs on a PC)
+ *
+ * Runs src/deadline.h, the stage budgets of esp32.c, over many made-up
+ * boots on a virtual clock:
+ *   - every loop pass goes through the esp32.c stages with random
+ *     durations; some run over budget, a few never end (a stuck I2C
+ *     read): the task watchdog, fed only when mark() says a stage
+ *     finished, resets the unit WDT_S later
+ *   - the StallTrace lives in one static object, like RTC_NOINIT
+ *     memory: kept over resets, filled with garbage at power-on, and
+ *     sometimes hit by a flipped bit (must then start over, not crash)
+ *   - checks against a plain model: every overrun and every hang is in
+ *     the ring (last STALL_RING of them) and lands on the "SD card"
+ *     exactly once, in order; no watchdog reset while every stage ends
+ *     in time
+ *   - ns per mark() (twice per stage on the unit)
+ *
+ * Build : g++ -O2 -std=c++17 -I. tools/deadline_sim.cpp -o deadline_sim
+ * Run   : ./deadline_sim
+ *         ./deadline_sim --boots 2000 --hang 5 --seed 3
+ ****************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/deadline.h"
+
+struct Options {
+  long boots = 500;
+  long passes = 400;   // loop passes per boot at most
+  int hangPct = 20;    // boots that end in a stage that never ends
+  int flipPct = 5;     // resets that flip a bit in the RTC trace
+  unsigned seed = 1;
+};
+
+// same stages and budgets as esp32.c
+enum { S_INPUT, S_SENSORS, S_OLED, S_BT_SEND, S_ALERT, S_SD_LOG, S_DIAL, S_SPEAK, S_LISTEN, S_GPS, S_BT_CMD, S_HOUSE, S_COUNT };
+const DeadlineStage STAGES[S_COUNT] = {
+  { "input", 5 },        { "sensors", 300 }, { "oled", 150 },        { "bt_send", 100 },
+  { "alert", 2500 },     { "sd_log", 250 },  { "call_dial", 16000 }, { "call_speak", 15000 },
+  { "call_listen", 10500 }, { "gps", 20 },   { "bt_cmd", 3000 },     { "housekeeping", 250 },
+};
+#define WDT_S 20
+#define RESET_TASK_WDT 6
+#define RESET_POWERON 1
+#define RESET_SW 3
+
+static long failures = 0;
+
+static void fail(const char* what) {
+  if (failures++ < 10) printf("FAIL %s\n", what);
+}
+
+static StallTrace rtc;  // "RTC memory"
+
+struct Expected {
+  uint8_t stage;
+  uint32_t atMs;
+  uint32_t us;
+  uint8_t reason;
+};
+
+// ==============================================================
+//                    SIMULATION
+// ==============================================================
+struct Sim {
+  std::mt19937 rng;
+  const Options& o;
+  std::vector<Expected> model;    // every record the trace should hold, in order
+  std::vector<StallRecord> sd;    // what reached the SD card
+  long overruns = 0, hangs = 0, wdtResets = 0, invalid = 0, powerOns = 0;
+  uint64_t maxFeedGapUs = 0;
+
+  Sim(const Options& opt) : rng(opt.seed), o(opt) {}
+
+  // duration of one stage: mostly well inside the budget, 2 % over it
+  // (but ending before the watchdog: longer is a hang, see boot())
+  uint32_t duration(uint8_t s) {
+    uint32_t budgetUs = STAGES[s].budgetMs * 1000;
+    if (rng() % 100 < 2) return std::min<uint32_t>(budgetUs + 1 + rng() % (budgetUs / 2 + 1000), WDT_S * 1000000u - 1);
+    return rng() % (budgetUs / 2 + 1);
+  }
+
+  void logSd() {
+    for (uint32_t s = rtc.logged; s != rtc.next; s++) sd.push_back(rtc.at(s));
+    rtc.setLogged(rtc.next);
+  }
+
+  void run() {
+    uint8_t reason = RESET_POWERON;
+    uint16_t bootNo = 0;
+    for (long b = 0; b < o.boots; b++) {
+      if (reason == RESET_POWERON) {
+        for (size_t i = 0; i < sizeof(rtc); i++) ((uint8_t*)&rtc)[i] = (uint8_t)rng();  // RTC garbage
+        powerOns++;
+        // the model starts over too
+        model.clear();
+        sd.clear();
+        bootNo = 0;
+      } else if ((int)(rng() % 100) < o.flipPct) {
+        ((uint8_t*)&rtc)[rng() % offsetof(StallTrace, check)] ^= (uint8_t)(1u << (rng() % 8));
+        if (!rtc.valid(S_COUNT)) {
+          // start() must notice and start over
+          invalid++;
+          model.clear();
+          sd.clear();
+          bootNo = 0;
+          modelOpenStage = STALL_NONE;
+        } else {
+          // the flip hit openStage / openAtMs (not checked): the trace
+          // holds, and start() records whatever they say now
+          modelOpenStage = rtc.openStage;
+          modelOpenAtMs = rtc.openAtMs;
+        }
+      }
+      bool powerOn = reason == RESET_POWERON;
+      if (!powerOn && modelOpenStage < S_COUNT) model.push_back({ modelOpenStage, modelOpenAtMs, STALL_UNFINISHED, reason });
+      rtc.start(powerOn, reason, S_COUNT);
+      bootNo++;
+      if (rtc.boot != bootNo) fail("boot number");
+      reason = boot();
+      if (reason == RESET_TASK_WDT) wdtResets++;
+      compare();
+    }
+  }
+
+  uint8_t modelOpenStage = STALL_NONE;
+  uint32_t modelOpenAtMs = 0;
+
+  // one life of the unit; returns the reason it reset
+  uint8_t boot() {
+    LoopDeadline d;
+    d.begin(rtc, STAGES, S_COUNT);
+    uint64_t us = (uint64_t)(rng() % 1000) * 1000;  // boot time
+    uint64_t lastFeed = us;
+    bool hang = (int)(rng() % 100) < o.hangPct;
+    long hangAt = hang ? (long)(rng() % o.passes) : -1;
+    logSd();  // setup()
+    modelOpenStage = STALL_NONE;
+    for (long p = 0; p < o.passes; p++) {
+      // a pass like esp32.c: sensors every few passes, an alert (call) rarely
+      uint8_t seq[S_COUNT];
+      int n = 0;
+      seq[n++] = S_INPUT;
+      if (p % 4 == 0) {
+        seq[n++] = S_SENSORS;
+        seq[n++] = S_OLED;
+        seq[n++] = S_BT_SEND;
+        if (rng() % 50 == 0) {
+          const uint8_t call[] = { S_ALERT, S_SD_LOG, S_DIAL, S_SPEAK, S_LISTEN, S_ALERT };
+          for (uint8_t s : call) seq[n++] = s;
+        }
+      }
+      seq[n++] = S_GPS;
+      if (rng() % 10 == 0) seq[n++] = S_BT_CMD;
+      seq[n++] = S_HOUSE;
+      int hangStage = p == hangAt ? (int)(rng() % n) : -1;
+
+      for (int i = 0; i < n; i++) {
+        uint8_t s = seq[i];
+        if (d.mark(s, (uint32_t)us, (uint32_t)(us / 1000))) {
+          if (us - lastFeed > maxFeedGapUs) maxFeedGapUs = us - lastFeed;
+          lastFeed = us;
+        }
+        modelOpenStage = s;
+        modelOpenAtMs = (uint32_t)(us / 1000);
+        if (i == hangStage) {
+          hangs++;
+          // never ends: the watchdog fires WDT_S after the last feed
+          if (rtc.openStage != s || rtc.openAtMs != modelOpenAtMs) fail("open stage not in RTC memory");
+          return RESET_TASK_WDT;
+        }
+        uint32_t took = duration(s);
+        if (took > STAGES[s].budgetMs * 1000) {
+          model.push_back({ s, (uint32_t)(us / 1000), took, 0 });
+          overruns++;
+        }
+        us += took;
+        if (us - lastFeed > (uint64_t)WDT_S * 1000000) fail("watchdog starved while every stage ended");
+      }
+      if (d.end((uint32_t)us)) lastFeed = us;
+      modelOpenStage = STALL_NONE;
+      if (p % 25 == 0) logSd();  // housekeeping (STALLS_LOG_MS)
+      us += 1000;
+    }
+    logSd();
+    // clean end of this life: a restart, now and then a power cut
+    return rng() % 10 == 0 ? RESET_POWERON : RESET_SW;
+  }
+
+  void compare() {
+    if (rtc.next != model.size()) {
+      fail("record count differs from the model");
+      return;
+    }
+    for (uint32_t s = rtc.first(); s != rtc.next; s++) {
+      const StallRecord& r = rtc.at(s);
+      const Expected& e = model[s];
+      if (r.seq != s || r.stage != e.stage || r.atMs != e.atMs || r.durationUs != e.us || r.resetReason != e.reason) {
+        fail("record differs from the model");
+        break;
+      }
+    }
+    // SD: strictly one per seq, in order, none lost (logged often enough)
+    for (size_t i = 0; i < sd.size(); i++) {
+      if (sd[i].seq != i) {
+        fail("SD log skips or repeats a record");
+        break;
+      }
+    }
+    if (rtc.logged > rtc.next || sd.size() != rtc.logged) fail("SD log and trace disagree");
+  }
+};
+
+// ==============================================================
+//                    TIME
+// ==============================================================
+static void timeMark() {
+  static StallTrace t;
+  t.start(true, RESET_POWERON, S_COUNT);
+  LoopDeadline d;
+  d.begin(t, STAGES, S_COUNT);
+  const long N = 20000000;
+  uint32_t us = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < N; i++) {
+    d.mark((uint8_t)(i % S_COUNT), us, us / 1000);
+    us += 3;
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / N;
+  printf("time  : %.1f ns per mark()\n", ns);
+}
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr, "usage: deadline_sim [--boots 500] [--passes 400] [--hang 20] [--flip 5] [--seed 1]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--boots") o.boots = atol(v);
+    else if (a == "--passes") o.passes = atol(v);
+    else if (a == "--hang") o.hangPct = atoi(v);
+    else if (a == "--flip") o.flipPct = atoi(v);
+    else if (a == "--seed") o.seed = (unsigned)atoi(v);
+    else usage();
+  }
+  if (o.boots < 1 || o.passes < 1 || o.hangPct < 0 || o.hangPct > 100 || o.flipPct < 0 || o.flipPct > 100) usage();
+  Sim sim(o);
+  sim.run();
+  printf("boots : %ld (%ld power-on, %ld watchdog resets, %ld traces dropped as corrupt)\n", o.boots, sim.powerOns,
+         sim.wdtResets, sim.invalid);
+  printf("trace : %ld overruns + %ld hangs recorded, %zu on SD this power cycle\n", sim.overruns, sim.hangs,
+         sim.sd.size());
+  printf("feed  : longest gap %.1f s (watchdog %d s)\n", sim.maxFeedGapUs / 1e6, WDT_S);
+  timeMark();
+  printf("%s: %ld failed checks\n", failures ? "FAIL" : "OK", failures);
+  return failures ? 1 : 0;
+}
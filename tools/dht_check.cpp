@@ -0,0 +1,222 @@
+/****************************************************************
+ * HIMBUDDY - DHT22 DECODER CHECK (runs on a PC)
+ *
+ * Runs src/dht22.h, the decoder esp32fullcode.c uses on the RMT
+ * capture, on waveforms:
+ *   made up  N replies of random readings, with pulse jitter and a
+ *            sensor clock off by up to --drift, packed into RMT words
+ *            and back like on the unit. Each is decoded clean and then
+ *            corrupted one way:
+ *              flip      one data bit's high time swapped (0 <-> 1)
+ *              truncate  the capture stops part way
+ *              glitch    a noise spike splits a pulse
+ *              stretch   every pulse 60 % too long (bad cable / clock)
+ *              ambiguous one bit's high time between 0 and 1
+ *              noreply   only the pull-up, no sensor
+ *   captured --captures FILE, lines printed by BT "DHT_RAW":
+ *            <status> <t|-> <h|-> <level:us> <level:us> ...
+ *            decoded again and compared with what the unit decoded.
+ * A corrupted reply must never come out as a good but wrong reading.
+ * A clean one may be rejected now and then (heavy jitter; the unit
+ * just reads again 2 s later), at most --max-reject % of them.
+ *
+ * Build : g++ -O2 -std=c++17 -I. tools/dht_check.cpp -o dht_check
+ * Run   : ./dht_check
+ *         ./dht_check --replies 100000 --drift 0.3 --jitter 3
+ *         ./dht_check --captures dht_raw.txt
+ ****************************************************************/
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/dht22.h"
+
+struct Options {
+  std::string captures;
+  int replies = 20000;
+  double drift = 0.15;   // sensor clock error, fraction
+  double jitter = 2;     // us, per pulse (sigma)
+  double maxRejectPct = 0.5;
+  unsigned seed = 1;
+};
+
+enum Corruption { C_NONE, C_FLIP, C_TRUNCATE, C_GLITCH, C_STRETCH, C_AMBIGUOUS, C_NOREPLY, C_COUNT };
+static const char* const CORRUPTION_NAMES[C_COUNT] = { "clean", "flip", "truncate", "glitch", "stretch",
+                                                       "ambiguous", "noreply" };
+
+// ==============================================================
+//                    MADE-UP REPLIES
+// ==============================================================
+struct Reply {
+  float t, h;
+  std::vector<DhtPulse> pulses;
+};
+
+static Reply makeReply(std::mt19937& rng, const Options& o, Corruption c) {
+  std::uniform_int_distribution<int> hum(0, 1000), temp(-400, 800), bitPick(0, 39);
+  std::uniform_real_distribution<double> drift(1 - o.drift, 1 + o.drift), uni(0, 1);
+  std::normal_distribution<double> jit(0, o.jitter);
+  Reply r;
+  int h10 = hum(rng), t10 = temp(rng);
+  r.h = h10 * 0.1f;
+  r.t = t10 * 0.1f;
+  uint8_t b[5] = { (uint8_t)(h10 >> 8), (uint8_t)h10, (uint8_t)((std::abs(t10) >> 8) | (t10 < 0 ? 0x80 : 0)),
+                   (uint8_t)std::abs(t10), 0 };
+  b[4] = (uint8_t)(b[0] + b[1] + b[2] + b[3]);
+
+  double k = drift(rng) * (c == C_STRETCH ? 1.6 : 1.0);
+  auto add = [&](uint8_t level, double us) {
+    double v = std::max(1.0, us * k + jit(rng));
+    r.pulses.push_back({ level, (uint16_t)std::lround(v) });
+  };
+  r.pulses.push_back({ 1, (uint16_t)(20 + uni(rng) * 20) });  // host lets go, pull-up until the sensor answers
+  if (c == C_NOREPLY) return r;
+  add(0, 80);
+  add(1, 80);
+  int flip = bitPick(rng), odd = bitPick(rng);
+  for (int i = 0; i < 40; i++) {
+    bool one = (b[i / 8] >> (7 - i % 8)) & 1;
+    if (c == C_FLIP && i == flip) one = !one;
+    add(0, 50);
+    if (c == C_AMBIGUOUS && i == odd) r.pulses.push_back({ 1, 50 });
+    else add(1, one ? 70 : 27);
+  }
+  add(0, 50);  // end of the reply, then the line idles high
+
+  if (c == C_TRUNCATE) r.pulses.resize(3 + (size_t)(uni(rng) * 78));
+  if (c == C_GLITCH) {
+    // a 5-15 us spike of the other level inside one pulse
+    size_t at = 1 + (size_t)(uni(rng) * (r.pulses.size() - 1));
+    DhtPulse p = r.pulses[at];
+    uint16_t spike = (uint16_t)(5 + uni(rng) * 10);
+    uint16_t before = (uint16_t)(p.us / 3);
+    uint16_t after = p.us > before + spike ? (uint16_t)(p.us - before - spike) : 1;
+    r.pulses[at].us = before;
+    r.pulses.insert(r.pulses.begin() + at + 1, { { (uint8_t)!p.level, spike }, { p.level, after } });
+  }
+  return r;
+}
+
+// Pack like the RMT RAM does (2 pulses per word, zero ends it) and unpack
+static std::vector<DhtPulse> viaRmt(const std::vector<DhtPulse>& in) {
+  std::vector<uint32_t> words((in.size() + 2) / 2, 0);
+  for (size_t i = 0; i < in.size(); i++) {
+    uint32_t half = (uint32_t)(in[i].us & 0x7FFF) | ((uint32_t)in[i].level << 15);
+    words[i / 2] |= (i % 2) ? half << 16 : half;
+  }
+  std::vector<DhtPulse> out(in.size() + 1);
+  out.resize(dhtPulsesFromSymbols(words.data(), words.size(), out.data(), out.size()));
+  return out;
+}
+
+static int madeUp(const Options& o) {
+  std::mt19937 rng(o.seed);
+  long total[C_COUNT] = {}, good[C_COUNT] = {}, wrong[C_COUNT] = {};
+  long status[C_COUNT][DHT_STATUS_COUNT] = {};
+  double decodeNs = 0;
+  long decodes = 0;
+
+  for (int n = 0; n < o.replies; n++) {
+    for (int c = 0; c < C_COUNT; c++) {
+      Reply r = makeReply(rng, o, (Corruption)c);
+      std::vector<DhtPulse> p = viaRmt(r.pulses);
+      auto t0 = std::chrono::steady_clock::now();
+      DhtReading d = dhtDecode(p.data(), p.size());
+      decodeNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+      decodes++;
+      total[c]++;
+      status[c][d.status]++;
+      if (d.status != DHT_OK) continue;
+      bool right = std::fabs(d.temperature - r.t) < 0.05f && std::fabs(d.humidity - r.h) < 0.05f;
+      if (right) good[c]++;
+      else wrong[c]++;
+    }
+  }
+
+  printf("%d replies per case, clock drift +-%.0f %%, jitter %.0f us\n", o.replies, o.drift * 100, o.jitter);
+  printf("%-10s %8s %8s", "case", "right", "WRONG");
+  for (int s = 1; s < DHT_STATUS_COUNT; s++) printf(" %12s", dhtStatusName(s));
+  printf("\n");
+  for (int c = 0; c < C_COUNT; c++) {
+    printf("%-10s %8ld %8ld", CORRUPTION_NAMES[c], good[c], wrong[c]);
+    for (int s = 1; s < DHT_STATUS_COUNT; s++) printf(" %12ld", status[c][s]);
+    printf("\n");
+  }
+  printf("decode: %.0f ns per reply on this PC\n", decodeNs / decodes);
+
+  long wrongValues = 0;
+  for (int c = 0; c < C_COUNT; c++) wrongValues += wrong[c];
+  double rejectPct = 100.0 * (total[C_NONE] - good[C_NONE] - wrong[C_NONE]) / total[C_NONE];
+  bool fail = wrongValues > 0 || rejectPct > o.maxRejectPct;
+  printf("%s: %ld replies read as a wrong value, %.3f %% of clean replies rejected (limit %.2f %%)\n",
+         fail ? "FAIL" : "OK", wrongValues, rejectPct, o.maxRejectPct);
+  return fail ? 1 : 0;
+}
+
+// ==============================================================
+//                    CAPTURED REPLIES
+// ==============================================================
+static int captured(const std::string& path) {
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) { perror(path.c_str()); return 1; }
+  char line[2048];
+  int lines = 0, mismatches = 0;
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#' || line[0] == '\n') continue;
+    char want[24], wt[16], wh[16];
+    int used = 0;
+    if (sscanf(line, "%23s %15s %15s %n", want, wt, wh, &used) != 3) continue;
+    std::vector<DhtPulse> p;
+    for (char* tok = strtok(line + used, " \t\r\n"); tok; tok = strtok(nullptr, " \t\r\n")) {
+      unsigned level, us;
+      if (sscanf(tok, "%u:%u", &level, &us) == 2) p.push_back({ (uint8_t)(level & 1), (uint16_t)us });
+    }
+    lines++;
+    DhtReading d = dhtDecode(p.data(), p.size());
+    bool same = strcmp(want, dhtStatusName(d.status)) == 0;
+    if (same && d.status == DHT_OK) {
+      same = std::fabs(d.temperature - atof(wt)) < 0.05 && std::fabs(d.humidity - atof(wh)) < 0.05;
+    }
+    printf("%4d  %zu pulses  unit: %s %s %s  here: %s", lines, p.size(), want, wt, wh, dhtStatusName(d.status));
+    if (d.status == DHT_OK) printf(" %.1f %.1f", d.temperature, d.humidity);
+    printf("%s\n", same ? "" : "  MISMATCH");
+    mismatches += !same;
+  }
+  fclose(f);
+  printf("%d captures, %d decoded differently\n", lines, mismatches);
+  return mismatches ? 1 : 0;
+}
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr,
+          "usage: dht_check [--replies 20000] [--drift 0.15] [--jitter 2] [--max-reject 0.5] [--seed 1]\n"
+          "       dht_check --captures FILE\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--captures") o.captures = v;
+    else if (a == "--replies") o.replies = atoi(v);
+    else if (a == "--drift") o.drift = atof(v);
+    else if (a == "--jitter") o.jitter = atof(v);
+    else if (a == "--max-reject") o.maxRejectPct = atof(v);
+    else if (a == "--seed") o.seed = (unsigned)atoi(v);
+    else usage();
+  }
+  if (!o.captures.empty()) return captured(o.captures);
+  if (o.replies < 1) usage();
+  return madeUp(o);
+}
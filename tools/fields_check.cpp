@@ -0,0 +1,340 @@
+/****************************************************************
+ * HIMBUDDY - FIELD FORMATTER CHECK + BENCHMARK (runs on a PC)
+ *
+ * src/log_format.h writes the alert JSON, snapshot CSV, STATUS reply
+ * and ISO time through src/fields.h instead of snprintf. This keeps
+ * the snprintf versions they replaced and checks, on random values:
+ *   - fieldsFixed(v, d) == "%.*f" for d = 0..9: readings, GPS, ties
+ *     (x.xx5 exactly), -0, tiny and huge values, NAN / inf
+ *   - every line is byte for byte the snprintf one, NAN readings,
+ *     no GPS and buffers too short (truncation, return value) too
+ *   - the binary encoding decodes back to the values
+ *   - the snapshot schema names are the SENSLOG header
+ * then times both versions of each line (ns per line on this PC) and
+ * fails when the three sensor lines together (what the unit writes:
+ * one of each) are less than --min-speedup times faster.
+ *
+ * Build : g++ -O2 -std=c++17 -I. tools/fields_check.cpp -o fields_check
+ * Run   : ./fields_check
+ *         ./fields_check --values 5000000 --seed 7
+ ****************************************************************/
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "src/log_format.h"
+
+struct Options {
+  long values = 1000000;      // random numbers per decimals
+  long lines = 200000;        // random records per line format
+  double minSpeedup = 5;
+  unsigned seed = 1;
+};
+
+// ==============================================================
+//                    THE SNPRINTF FORMATS (as before)
+// ==============================================================
+static int refAlertJson(char* out, size_t len, const SensorRecord& r) {
+  char gpsField[64] = "";
+  if (r.lat != 0.0 || r.lng != 0.0) snprintf(gpsField, sizeof(gpsField), ",\"gps\":\"%.6f,%.6f\"", r.lat, r.lng);
+  return snprintf(out, len,
+                  "{\"type\":\"%s\",\"msg\":\"%s\",\"time\":\"%s\",\"extra\":\"%s\",\"dhtT\":%.2f,\"dhtH\":%.2f,"
+                  "\"bmeT\":%.2f,\"bmeH\":%.2f,\"bmeP\":%.2f,\"mq\":%d,\"soil\":%d%s}",
+                  r.type, r.msg, r.time, r.extra ? r.extra : "", logValue(r.dhtT), logValue(r.dhtH),
+                  logValue(r.bmeT), logValue(r.bmeH), logValue(r.bmeP), (int)r.mq, (int)r.soil, gpsField);
+}
+
+static int refSnapshotCsv(char* out, size_t len, const SensorRecord& r) {
+  return snprintf(out, len, "\"%s\",%.2f,%.2f,%.2f,%.2f,%.2f,%d,%d,%.6f,%.6f", r.time, logValue(r.dhtT),
+                  logValue(r.dhtH), logValue(r.bmeT), logValue(r.bmeH), logValue(r.bmeP), (int)r.mq, (int)r.soil,
+                  r.lat, r.lng);
+}
+
+static int refStatusJson(char* out, size_t len, const SensorRecord& r) {
+  return snprintf(out, len, "{\"status\":\"ok\",\"dhtT\":%.2f,\"dhtH\":%.2f,\"mq\":%d,\"soil\":%d}",
+                  isnan(r.dhtT) ? 0.0 : r.dhtT, isnan(r.dhtH) ? 0.0 : r.dhtH, (int)r.mq, (int)r.soil);
+}
+
+static void refIsoTime(char* out, int y, int mo, int d, int h, int mi, int s) {
+  snprintf(out, ISO_TIME_LEN, "%04u-%02u-%02uT%02u:%02u:%02u", (unsigned)y % 10000u, (unsigned)mo % 100u,
+           (unsigned)d % 100u, (unsigned)h % 100u, (unsigned)mi % 100u, (unsigned)s % 100u);
+}
+
+static int newAlertJson(char* out, size_t len, const SensorRecord& r) {
+  return formatAlertJson(out, len, r.type, r.msg, r.time, r.extra, r.dhtT, r.dhtH, r.bmeT, r.bmeH, r.bmeP, r.mq,
+                         r.soil, r.lat, r.lng);
+}
+
+static int newSnapshotCsv(char* out, size_t len, const SensorRecord& r) {
+  return formatSnapshotCsv(out, len, r.time, r.dhtT, r.dhtH, r.bmeT, r.bmeH, r.bmeP, r.mq, r.soil, r.lat, r.lng);
+}
+
+static int newStatusJson(char* out, size_t len, const SensorRecord& r) {
+  return formatStatusJson(out, len, r.dhtT, r.dhtH, r.mq, r.soil);
+}
+
+// ==============================================================
+//                    RANDOM VALUES
+// ==============================================================
+static double randomValue(std::mt19937_64& rng, int decimals) {
+  std::uniform_int_distribution<int> pick(0, 9);
+  std::uniform_real_distribution<double> uni(-1, 1);
+  switch (pick(rng)) {
+    case 0: return (double)(float)(uni(rng) * 1100);                       // a float reading
+    case 1: return uni(rng) * 180;                                           // GPS
+    case 2: {                                                                // a tie: x.xx5 (inexact)
+      double p = pow(10.0, decimals);
+      return (std::floor(uni(rng) * 1000 * p) + 0.5) / p;
+    }
+    case 3: return std::ldexp((double)(rng() % 4096) * (uni(rng) < 0 ? -1 : 1), -(int)(rng() % 12));  // exact ties
+    case 4: return uni(rng) * std::pow(10.0, -(int)(rng() % 12));          // tiny, -0.00 and 0.00
+    case 5: return uni(rng) * 1e9;                                           // up to the exact range
+    case 6: return uni(rng) * 1e15;                                          // snprintf fallback
+    case 7: {
+      const double special[] = { 0.0, -0.0, NAN, -NAN, INFINITY, -INFINITY, 0.5, 1.5, 2.5, -0.5, 999999999.9999999,
+                                 1e-320, 0.125, 0.375, 1e9 };
+      return special[rng() % (sizeof(special) / sizeof(special[0]))];
+    }
+    default: {
+      uint64_t bits = rng();                                                 // any double at all
+      double d;
+      memcpy(&d, &bits, sizeof(d));
+      return d;
+    }
+  }
+}
+
+static SensorRecord randomRecord(std::mt19937_64& rng, char* time) {
+  static const char* const TYPES[] = { "MQ2", "SOIL", "QUAKE", "LANDSLIDE" };
+  static const char* const EXTRAS[] = { nullptr, "", "t:24.5,h:61.0,mq:412,soil:1830" };
+  std::uniform_real_distribution<double> uni(0, 1);
+  auto reading = [&](double lo, double hi) { return uni(rng) < 0.1 ? NAN : (float)(lo + uni(rng) * (hi - lo)); };
+  bool gps = uni(rng) < 0.7;
+  refIsoTime(time, 2020 + (int)(rng() % 10), 1 + (int)(rng() % 12), 1 + (int)(rng() % 28), (int)(rng() % 24),
+             (int)(rng() % 60), (int)(rng() % 60));
+  SensorRecord r = { TYPES[rng() % 4], "Smoke/Gas detected", time, EXTRAS[rng() % 3],
+                     reading(-40, 80), reading(0, 100), reading(-40, 85), reading(0, 100), reading(300, 1100),
+                     (int32_t)(rng() % 4096) - (int32_t)(rng() % 2), (int32_t)(rng() % 4096),
+                     gps ? -90 + uni(rng) * 180 : 0.0, gps ? -180 + uni(rng) * 360 : 0.0 };
+  return r;
+}
+
+// ==============================================================
+//                    CHECKS
+// ==============================================================
+static long mismatches = 0;
+
+static void mismatch(const char* what, const char* want, const char* got) {
+  if (mismatches++ < 10) printf("MISMATCH %s\n  snprintf: %s\n  fields  : %s\n", what, want, got);
+}
+
+static void checkNumbers(const Options& o, std::mt19937_64& rng) {
+  long exact = 0, fallback = 0;
+  for (int d = 0; d <= FIELDS_MAX_DECIMALS; d++) {
+    for (long i = 0; i < o.values; i++) {
+      double v = randomValue(rng, d);
+      char want[400], got[400];
+      snprintf(want, sizeof(want), "%.*f", d, v);
+      FieldWriter w(got, sizeof(got));
+      w.putFixed(v, (uint8_t)d);
+      w.finish();
+      char num[FIELDS_NUM_LEN];
+      if (fieldsFixed(num, v, (uint8_t)d)) exact++;
+      else fallback++;
+      if (strcmp(want, got) != 0) {
+        char what[64];
+        snprintf(what, sizeof(what), "%%.%df of %a", d, v);
+        mismatch(what, want, got);
+      }
+    }
+  }
+  printf("numbers : %ld values, %ld in the exact range, %ld through snprintf\n", exact + fallback, exact, fallback);
+}
+
+static void checkLines(const Options& o, std::mt19937_64& rng) {
+  struct Format {
+    const char* name;
+    int (*ref)(char*, size_t, const SensorRecord&);
+    int (*fast)(char*, size_t, const SensorRecord&);
+  } formats[] = { { "alert_json", refAlertJson, newAlertJson },
+                  { "snapshot_csv", refSnapshotCsv, newSnapshotCsv },
+                  { "status_json", refStatusJson, newStatusJson } };
+  char time[ISO_TIME_LEN];
+  for (const Format& f : formats) {
+    for (long i = 0; i < o.lines; i++) {
+      SensorRecord r = randomRecord(rng, time);
+      size_t len = i % 10 == 0 ? (size_t)(rng() % 80) : 512;  // every 10th into a short buffer
+      char want[512], got[512];
+      memset(want, 'x', sizeof(want));
+      memset(got, 'x', sizeof(got));
+      int nw = f.ref(want, len, r), ng = f.fast(got, len, r);
+      if (nw != ng || memcmp(want, got, sizeof(want)) != 0) {
+        char what[64];
+        snprintf(what, sizeof(what), "%s (buffer %zu, returned %d / %d)", f.name, len, nw, ng);
+        want[511] = got[511] = 0;
+        mismatch(what, want, got);
+      }
+    }
+  }
+
+  // ISO time, including out of range fields that wrap
+  for (long i = 0; i < o.lines; i++) {
+    int f[6];
+    for (int& v : f) v = (int)(rng() % 200) - (int)(rng() % 2) * 50;
+    f[0] = (int)(rng() % 30000) - 5000;
+    char want[ISO_TIME_LEN], got[ISO_TIME_LEN];
+    refIsoTime(want, f[0], f[1], f[2], f[3], f[4], f[5]);
+    formatIsoTime(got, f[0], f[1], f[2], f[3], f[4], f[5]);
+    if (strcmp(want, got) != 0) mismatch("iso_time", want, got);
+    unsigned long ms = (unsigned long)(rng() % 4000000000ull);
+    unsigned long s = ms / 1000;
+    snprintf(want, ISO_TIME_LEN, "1970-01-01T%02lu:%02lu:%02lu", (s / 3600) % 24, (s / 60) % 60, s % 60);
+    formatUptimeIso(got, ms);
+    if (strcmp(want, got) != 0) mismatch("uptime_iso", want, got);
+  }
+  printf("lines   : %ld per format (alert_json, snapshot_csv, status_json), %ld ISO times\n", o.lines, o.lines);
+}
+
+static int32_t le32(const uint8_t* p) {
+  return (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+static void checkBinary(const Options& o, std::mt19937_64& rng) {
+  char time[ISO_TIME_LEN];
+  long bad = 0;
+  size_t bytes = 0;
+  for (long i = 0; i < o.lines; i++) {
+    SensorRecord r = randomRecord(rng, time);
+    uint8_t buf[128];
+    size_t n = fieldsBinary(buf, sizeof(buf), ALERT_FIELDS, FIELD_COUNT(ALERT_FIELDS), &r);
+    bytes += n;
+    size_t at = 0;
+    bool ok = n > 0;
+    for (const FieldDef& f : ALERT_FIELDS) {
+      if (!ok) break;
+      if (f.type == FIELD_TEXT) {
+        const char* want = fieldText(f, &r);
+        ok = buf[at] == strlen(want) && memcmp(buf + at + 1, want, buf[at]) == 0;
+        at += 1 + buf[at];
+      } else if (f.type == FIELD_INT) {
+        ok = le32(buf + at) == fieldInt(f, &r);
+        at += 4;
+      } else {
+        for (int k = 0; k < (f.type == FIELD_LATLNG ? 2 : 1); k++) {
+          double want = fieldNumber(f, &r, k), got = le32(buf + at) / pow(10.0, f.decimals);
+          ok = ok && std::fabs(want - got) <= 0.5 / pow(10.0, f.decimals) + 1e-9;
+          at += 4;
+        }
+      }
+    }
+    ok = ok && at == n && fieldsBinary(buf, n - 1, ALERT_FIELDS, FIELD_COUNT(ALERT_FIELDS), &r) == 0;
+    if (!ok) bad++;
+  }
+  mismatches += bad;
+  printf("binary  : %ld alert records, %.1f bytes each, %ld did not decode back\n", o.lines,
+         (double)bytes / o.lines, bad);
+
+  char header[128];
+  FieldWriter w(header, sizeof(header));
+  fieldsCsvHeader(w, SNAPSHOT_FIELDS, FIELD_COUNT(SNAPSHOT_FIELDS));
+  w.finish();
+  if (strcmp(header, "time,dhtT,dhtH,bmeT,bmeH,bmeP,mqRaw,soilRaw,gpsLat,gpsLng") != 0) {
+    mismatch("SENSLOG header", "time,dhtT,dhtH,bmeT,bmeH,bmeP,mqRaw,soilRaw,gpsLat,gpsLng", header);
+  }
+}
+
+// ==============================================================
+//                    SPEED
+// ==============================================================
+// best of 9 rounds of each, taken in turns (so a busy moment of the
+// PC hits both): ns per call
+template <typename A, typename B>
+static void nsPerCall(A a, B b, double* nsA, double* nsB) {
+  const int N = 100000;
+  *nsA = *nsB = 1e30;
+  auto time = [&](auto fn) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++) fn(i);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / N;
+  };
+  for (int round = 0; round < 9; round++) {
+    *nsA = std::min(*nsA, time(a));
+    *nsB = std::min(*nsB, time(b));
+  }
+}
+
+static bool speed(const Options& o) {
+  // the microbench record: readings as the unit sees them, GPS fixed
+  const int N = 256;
+  static SensorRecord recs[N];
+  static char times[N][ISO_TIME_LEN];
+  std::mt19937_64 rng(o.seed);
+  for (int i = 0; i < N; i++) {
+    recs[i] = randomRecord(rng, times[i]);
+    recs[i].lat = 30.316494 + i * 1e-6;
+    recs[i].lng = 78.032188;
+  }
+  static char out[512];
+  volatile int sink = 0;
+  struct Pair {
+    const char* name;
+    int (*ref)(char*, size_t, const SensorRecord&);
+    int (*fast)(char*, size_t, const SensorRecord&);
+  } pairs[] = { { "alert_json", refAlertJson, newAlertJson },
+                { "snapshot_csv", refSnapshotCsv, newSnapshotCsv },
+                { "status_json", refStatusJson, newStatusJson } };
+  double refSum = 0, fastSum = 0;
+  printf("%-14s %12s %12s %8s\n", "ns per line", "snprintf", "fields", "speedup");
+  for (const Pair& p : pairs) {
+    double a, b;
+    nsPerCall([&](int i) { sink = sink + p.ref(out, sizeof(out), recs[i % N]); },
+              [&](int i) { sink = sink + p.fast(out, sizeof(out), recs[i % N]); }, &a, &b);
+    printf("%-14s %12.1f %12.1f %7.1fx\n", p.name, a, b, a / b);
+    refSum += a;
+    fastSum += b;
+  }
+  char ts[ISO_TIME_LEN];
+  double a, b;
+  nsPerCall([&](int i) { refIsoTime(ts, 2025, 7, 14, 13, i % 60, i % 60); sink = sink + ts[18]; },
+            [&](int i) { formatIsoTime(ts, 2025, 7, 14, 13, i % 60, i % 60); sink = sink + ts[18]; }, &a, &b);
+  printf("%-14s %12.1f %12.1f %7.1fx\n", "iso_time", a, b, a / b);
+  printf("%-14s %12.1f %12.1f %7.1fx\n", "3 lines", refSum, fastSum, refSum / fastSum);
+  return refSum / fastSum >= o.minSpeedup;
+}
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr, "usage: fields_check [--values 1000000] [--lines 200000] [--min-speedup 5] [--seed 1]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--values") o.values = atol(v);
+    else if (a == "--lines") o.lines = atol(v);
+    else if (a == "--min-speedup") o.minSpeedup = atof(v);
+    else if (a == "--seed") o.seed = (unsigned)atoi(v);
+    else usage();
+  }
+  if (o.values < 1 || o.lines < 1) usage();
+
+  std::mt19937_64 rng(o.seed);
+  checkNumbers(o, rng);
+  checkLines(o, rng);
+  checkBinary(o, rng);
+  bool fast = speed(o);
+  bool fail = mismatches > 0 || !fast;
+  printf("%s: %ld mismatches, lines at least %.1fx faster: %s\n", fail ? "FAIL" : "OK", mismatches,
+         o.minSpeedup, fast ? "yes" : "no");
+  return fail ? 1 : 0;
+}
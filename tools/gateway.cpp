@@ -0,0 +1,662 @@
+/****************************************************************
+ * HIMBUDDY - TELEMETRY GATEWAY (Linux)
+ *
+ * Collects the telemetry that the units already print, from many
+ * units at once, and keeps it in one store that can be queried
+ * across units:
+ *   - esp32.c        : {"temp":21.5} {"soil":40} ... {"alert":"Fire Detected!"}
+ *   - esp32fullcode.c: alert JSON lines, STATUS replies, senslog CSV rows,
+ *                      "[ALERT_SENT] {...}" lines from its USB serial
+ * Inputs: TCP (one connection per unit, optional "NODE <id>" first
+ * line), serial ports and Bluetooth serial (/dev/rfcommN). Lines are
+ * cut out of each connection buffer in place and parsed through
+ * string_views (no copy, no allocation per line).
+ *
+ * Store: append-only, one file per hour: <dir>/YYYYMMDDHH.rec with
+ * fixed 24 byte records (time ms, node, field, value), plus the alert
+ * text in <dir>/YYYYMMDDHH.alerts. A query only opens the hours it needs.
+ *
+ * Build : g++ -O2 -std=c++17 -pthread tools/gateway.cpp -o gateway
+ * Run   : ./gateway serve --store ./store --tcp 5050 --serial /dev/ttyUSB0=7 --serial /dev/rfcomm0=8
+ *         ./gateway query --store ./store --from 2025-10-18T00:00:00 --to 2025-10-19T00:00:00 --window 3600 [--field temp] [--node 7]
+ *         ./gateway bench --nodes 1000 --seconds 5
+ ****************************************************************/
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using std::string_view;
+
+// ==============================================================
+//                    FIELDS
+// ==============================================================
+enum Field : uint16_t {
+  F_TEMP, F_HUM, F_SOIL, F_MQ, F_BME_T, F_BME_H, F_BME_P, F_LAT, F_LNG,
+  F_FIRE, F_LANDSLIDE, F_VIBRATION, F_ALERT, F_COUNT
+};
+
+static const char* const FIELD_NAMES[F_COUNT] = {
+  "temp", "hum", "soil", "mq", "bmeT", "bmeH", "bmeP", "lat", "lng",
+  "fire", "landslide", "vibration", "alert"
+};
+
+// JSON key -> field (both sketches' spellings)
+static int fieldForKey(string_view k) {
+  if (k == "temp" || k == "dhtT") return F_TEMP;
+  if (k == "humidity" || k == "dhtH") return F_HUM;
+  if (k == "soil") return F_SOIL;
+  if (k == "mq") return F_MQ;
+  if (k == "bmeT") return F_BME_T;
+  if (k == "bmeH") return F_BME_H;
+  if (k == "bmeP") return F_BME_P;
+  if (k == "lat") return F_LAT;
+  if (k == "lon" || k == "lng") return F_LNG;
+  if (k == "fire") return F_FIRE;
+  if (k == "landslide") return F_LANDSLIDE;
+  if (k == "vibration") return F_VIBRATION;
+  return -1;
+}
+
+static int fieldByName(string_view n) {
+  for (int f = 0; f < F_COUNT; f++) if (n == FIELD_NAMES[f]) return f;
+  return -1;
+}
+
+// "Detected"/"High" -> 1, "Normal"/"Safe"/"Low" -> 0
+static double statusValue(string_view v) { return (v == "Detected" || v == "High") ? 1.0 : 0.0; }
+
+static bool toNumber(string_view s, double& out) {
+  while (!s.empty() && s.front() == ' ') s.remove_prefix(1);
+  if (!s.empty() && s.front() == '+') s.remove_prefix(1);
+  auto r = std::from_chars(s.data(), s.data() + s.size(), out);
+  return r.ec == std::errc();
+}
+
+static int64_t nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// ==============================================================
+//                    STORE (APPEND ONLY, HOURLY FILES)
+// ==============================================================
+#pragma pack(push, 1)
+struct Record {
+  int64_t tsMs;   // gateway receive time, UTC
+  uint32_t node;
+  uint16_t field;
+  uint16_t flags; // reserved
+  double value;
+};
+#pragma pack(pop)
+static_assert(sizeof(Record) == 24, "on-disk record");
+
+static std::string partitionName(const std::string& dir, int64_t hour, const char* ext) {
+  time_t t = (time_t)(hour * 3600);
+  tm g;
+  gmtime_r(&t, &g);
+  char name[32];
+  snprintf(name, sizeof(name), "/%04d%02d%02d%02d.%s", g.tm_year + 1900, g.tm_mon + 1, g.tm_mday, g.tm_hour, ext);
+  return dir + name;
+}
+
+class Store {
+public:
+  explicit Store(std::string d) : dir(std::move(d)) { mkdir(dir.c_str(), 0755); }
+  ~Store() { closePart(); }
+
+  void add(int64_t ts, uint32_t node, int field, double value) {
+    roll(ts);
+    Record r = { ts, node, (uint16_t)field, 0, value };
+    fwrite(&r, sizeof(r), 1, rec);
+    records++;
+  }
+
+  void alert(int64_t ts, uint32_t node, string_view text) {
+    roll(ts);
+    fprintf(alerts, "%lld,%u,%.*s\n", (long long)ts, node, (int)text.size(), text.data());
+  }
+
+  void flush() {
+    if (rec) fflush(rec);
+    if (alerts) fflush(alerts);
+  }
+
+  uint64_t records = 0;
+
+private:
+  void roll(int64_t ts) {
+    int64_t h = ts / 3600000;
+    if (h == hour && rec) return;
+    closePart();
+    hour = h;
+    rec = fopen(partitionName(dir, h, "rec").c_str(), "ab");
+    alerts = fopen(partitionName(dir, h, "alerts").c_str(), "ab");
+    if (!rec || !alerts) { perror("store"); exit(1); }
+    setvbuf(rec, NULL, _IOFBF, 1 << 20);
+  }
+
+  void closePart() {
+    if (rec) fclose(rec);
+    if (alerts) fclose(alerts);
+    rec = alerts = NULL;
+  }
+
+  std::string dir;
+  int64_t hour = -1;
+  FILE* rec = NULL;
+  FILE* alerts = NULL;
+};
+
+// ==============================================================
+//                    LINE PARSER (string_view, no copies)
+// ==============================================================
+struct ParseStats {
+  uint64_t lines = 0, bytes = 0, values = 0, alerts = 0, unknown = 0;
+};
+
+// Calls fn(key, value, quoted) for every pair of a flat JSON object
+template <typename Fn>
+static bool forEachPair(string_view s, Fn fn) {
+  size_t i = s.find('{');
+  if (i == string_view::npos) return false;
+  i++;
+  const size_t n = s.size();
+  while (i < n) {
+    while (i < n && (s[i] == ' ' || s[i] == ',')) i++;
+    if (i >= n || s[i] == '}') return true;
+    if (s[i] != '"') return false;
+    size_t ke = s.find('"', i + 1);
+    if (ke == string_view::npos) return false;
+    string_view key = s.substr(i + 1, ke - i - 1);
+    i = ke + 1;
+    while (i < n && (s[i] == ' ' || s[i] == ':')) i++;
+    if (i >= n) return false;
+    if (s[i] == '"') {
+      size_t ve = i + 1;
+      while (ve < n && s[ve] != '"') ve += (s[ve] == '\\') ? 2 : 1;
+      if (ve >= n) return false;
+      fn(key, s.substr(i + 1, ve - i - 1), true);
+      i = ve + 1;
+    } else {
+      size_t ve = i;
+      while (ve < n && s[ve] != ',' && s[ve] != '}') ve++;
+      string_view v = s.substr(i, ve - i);
+      while (!v.empty() && v.back() == ' ') v.remove_suffix(1);
+      fn(key, v, false);
+      i = ve;
+    }
+  }
+  return true;
+}
+
+// senslog row: "time",dhtT,dhtH,bmeT,bmeH,bmeP,mqRaw,soilRaw,gpsLat,gpsLng
+static bool parseCsvRow(string_view s, int64_t ts, uint32_t node, Store& store, ParseStats& st) {
+  static const int cols[9] = { F_TEMP, F_HUM, F_BME_T, F_BME_H, F_BME_P, F_MQ, F_SOIL, F_LAT, F_LNG };
+  size_t i = s.find('"', 1);
+  if (i == string_view::npos || i + 1 >= s.size() || s[i + 1] != ',') return false;
+  i += 2;
+  for (int c = 0; c < 9; c++) {
+    size_t e = s.find(',', i);
+    if (e == string_view::npos) e = s.size();
+    double v;
+    if (!toNumber(s.substr(i, e - i), v)) return false;
+    if (!((cols[c] == F_LAT || cols[c] == F_LNG) && v == 0.0)) { // 0,0 = no GPS fix
+      store.add(ts, node, cols[c], v);
+      st.values++;
+    }
+    i = e + 1;
+  }
+  return true;
+}
+
+static void parseLine(string_view line, int64_t ts, uint32_t node, Store& store, ParseStats& st) {
+  st.lines++;
+  st.bytes += line.size() + 1;
+  if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+  if (line.empty()) return;
+
+  if (line.front() == '"') {
+    if (!parseCsvRow(line, ts, node, store, st)) st.unknown++;
+    return;
+  }
+  if (line.find('{') == string_view::npos) { st.unknown++; return; } // header, log text...
+
+  string_view type, msg;
+  bool ok = forEachPair(line, [&](string_view k, string_view v, bool quoted) {
+    if (k == "alert") { type = v; return; }
+    if (k == "type") { type = v; return; }
+    if (k == "msg") { msg = v; return; }
+    if (k == "gps" && quoted) { // "lat,lng"
+      size_t c = v.find(',');
+      double la, lo;
+      if (c != string_view::npos && toNumber(v.substr(0, c), la) && toNumber(v.substr(c + 1), lo)) {
+        store.add(ts, node, F_LAT, la);
+        store.add(ts, node, F_LNG, lo);
+        st.values += 2;
+      }
+      return;
+    }
+    int f = fieldForKey(k);
+    if (f < 0) return;
+    double x;
+    if (quoted) x = statusValue(v);
+    else if (!toNumber(v, x)) return;
+    store.add(ts, node, f, x);
+    st.values++;
+  });
+  if (!ok) { st.unknown++; return; }
+  if (!type.empty()) {
+    store.add(ts, node, F_ALERT, 1.0);
+    char text[160];
+    int n = msg.empty() ? snprintf(text, sizeof(text), "%.*s", (int)type.size(), type.data())
+                        : snprintf(text, sizeof(text), "%.*s: %.*s", (int)type.size(), type.data(), (int)msg.size(), msg.data());
+    store.alert(ts, node, string_view(text, (size_t)std::min(n, (int)sizeof(text) - 1)));
+    st.alerts++;
+  }
+}
+
+// ==============================================================
+//                    LINE SCANNER (ONE PER CONNECTION)
+// ==============================================================
+// Reads into a fixed buffer; complete lines are handed out as views
+// into that buffer, only the unfinished tail is moved to the front.
+struct LineScanner {
+  char buf[8192];
+  size_t len = 0;
+
+  template <typename Fn>
+  ssize_t readFrom(int fd, Fn onLine) {
+    if (len == sizeof(buf)) len = 0; // line longer than buffer: drop it
+    ssize_t k = read(fd, buf + len, sizeof(buf) - len);
+    if (k <= 0) return k;
+    size_t end = len + (size_t)k;
+    size_t start = 0;
+    const char* nl;
+    while ((nl = (const char*)memchr(buf + start, '\n', end - start)) != NULL) {
+      size_t pos = (size_t)(nl - buf);
+      onLine(string_view(buf + start, pos - start));
+      start = pos + 1;
+    }
+    len = end - start;
+    if (start > 0 && len > 0) memmove(buf, buf + start, len);
+    return k;
+  }
+};
+
+// ==============================================================
+//                    INGEST (EPOLL, ONE THREAD)
+// ==============================================================
+struct Source {
+  int fd;
+  uint32_t node;
+  bool listener;
+  bool named;       // node id fixed (serial) or sent with "NODE <id>"
+  LineScanner scan;
+};
+
+class Gateway {
+public:
+  explicit Gateway(Store& s) : store(s) { ep = epoll_create1(0); }
+
+  bool listenTcp(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in a = {};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    a.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (sockaddr*)&a, sizeof(a)) != 0 || listen(fd, 1024) != 0) { perror("tcp"); close(fd); return false; }
+    socklen_t l = sizeof(a);
+    getsockname(fd, (sockaddr*)&a, &l);
+    boundPort = ntohs(a.sin_port);
+    add(fd, 0, true, false);
+    return true;
+  }
+
+  // path=node, eg. /dev/ttyUSB0=7 (115200 8N1 raw)
+  bool openSerial(const std::string& spec) {
+    size_t eq = spec.find('=');
+    std::string path = spec.substr(0, eq);
+    uint32_t node = eq == std::string::npos ? nextNode++ : (uint32_t)atoi(spec.c_str() + eq + 1);
+    int fd = open(path.c_str(), O_RDONLY | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) { perror(path.c_str()); return false; }
+    termios t;
+    if (tcgetattr(fd, &t) == 0) {
+      cfmakeraw(&t);
+      cfsetispeed(&t, B115200);
+      cfsetospeed(&t, B115200);
+      tcsetattr(fd, TCSANOW, &t);
+    }
+    add(fd, node, false, true);
+    return true;
+  }
+
+  // Handles events for up to timeoutMs. Returns false on fatal error.
+  bool step(int timeoutMs) {
+    epoll_event ev[256];
+    int n = epoll_wait(ep, ev, 256, timeoutMs);
+    if (n < 0) return errno == EINTR;
+    int64_t ts = nowMs();
+    for (int i = 0; i < n; i++) {
+      Source* s = (Source*)ev[i].data.ptr;
+      if (s->listener) { acceptAll(s->fd); continue; }
+      for (;;) {
+        ssize_t k = s->scan.readFrom(s->fd, [&](string_view line) { onLine(*s, line, ts); });
+        if (k > 0) continue;
+        if (k == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) drop(s);
+        break;
+      }
+    }
+    if (ts - lastFlush > 1000) { store.flush(); lastFlush = ts; }
+    return true;
+  }
+
+  size_t connections() const { return sources.size(); }
+
+  ParseStats stats;
+  uint16_t boundPort = 0;
+
+private:
+  void add(int fd, uint32_t node, bool listener, bool named) {
+    Source* s = new Source();
+    s->fd = fd;
+    s->node = node;
+    s->listener = listener;
+    s->named = named;
+    epoll_event e = {};
+    e.events = EPOLLIN;
+    e.data.ptr = s;
+    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &e);
+    sources[fd] = s;
+  }
+
+  void drop(Source* s) {
+    epoll_ctl(ep, EPOLL_CTL_DEL, s->fd, NULL);
+    close(s->fd);
+    sources.erase(s->fd);
+    delete s;
+  }
+
+  void acceptAll(int lfd) {
+    for (;;) {
+      int fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK);
+      if (fd < 0) return;
+      add(fd, nextNode++, false, false);
+    }
+  }
+
+  void onLine(Source& s, string_view line, int64_t ts) {
+    if (!s.named && line.compare(0, 5, "NODE ") == 0) {
+      s.node = (uint32_t)atoi(std::string(line.substr(5)).c_str());
+      s.named = true;
+      return;
+    }
+    parseLine(line, ts, s.node, store, stats);
+  }
+
+  Store& store;
+  int ep;
+  uint32_t nextNode = 100000; // unnamed TCP units get ids from here
+  int64_t lastFlush = 0;
+  std::unordered_map<int, Source*> sources;
+};
+
+// ==============================================================
+//                    QUERY (WINDOWED, ACROSS NODES)
+// ==============================================================
+static int64_t parseTime(const char* s) {
+  if (strchr(s, '-') == NULL) return (int64_t)atoll(s) * 1000; // epoch seconds
+  tm t = {};
+  if (!strptime(s, "%Y-%m-%dT%H:%M:%S", &t) && !strptime(s, "%Y-%m-%d", &t)) {
+    fprintf(stderr, "bad time %s\n", s);
+    exit(2);
+  }
+  return (int64_t)timegm(&t) * 1000;
+}
+
+struct WindowAgg {
+  uint64_t n = 0;
+  double lo = INFINITY, hi = -INFINITY, sum = 0;
+  std::unordered_set<uint32_t> nodes;
+};
+
+static int runQuery(const std::string& dir, int64_t from, int64_t to, int64_t windowMs, int field, long node) {
+  std::map<std::pair<int64_t, int>, WindowAgg> out;
+  uint64_t scanned = 0, bytes = 0;
+  for (int64_t h = from / 3600000; h * 3600000 < to; h++) {
+    std::string path = partitionName(dir, h, "rec");
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) continue;
+    struct stat sb;
+    fstat(fd, &sb);
+    size_t size = (size_t)sb.st_size - (size_t)sb.st_size % sizeof(Record);
+    if (size == 0) { close(fd); continue; }
+    void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) continue;
+    const Record* r = (const Record*)map;
+    size_t count = size / sizeof(Record);
+    bytes += size;
+    for (size_t i = 0; i < count; i++) {
+      const Record& x = r[i];
+      if (x.tsMs < from || x.tsMs >= to) continue;
+      if (field >= 0 && x.field != field) continue;
+      if (node >= 0 && x.node != (uint32_t)node) continue;
+      scanned++;
+      WindowAgg& w = out[{ x.tsMs - (x.tsMs - from) % windowMs, x.field }];
+      w.n++;
+      w.sum += x.value;
+      if (x.value < w.lo) w.lo = x.value;
+      if (x.value > w.hi) w.hi = x.value;
+      w.nodes.insert(x.node);
+    }
+    munmap(map, size);
+  }
+  printf("window_start,field,nodes,count,min,max,mean\n");
+  for (auto& kv : out) {
+    time_t t = (time_t)(kv.first.first / 1000);
+    tm g;
+    gmtime_r(&t, &g);
+    char ts[32];
+    strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%SZ", &g);
+    const WindowAgg& w = kv.second;
+    printf("%s,%s,%zu,%llu,%.4f,%.4f,%.4f\n", ts, FIELD_NAMES[kv.first.second], w.nodes.size(),
+           (unsigned long long)w.n, w.lo, w.hi, w.sum / (double)w.n);
+  }
+  fprintf(stderr, "read %.1f KB, %llu matching records\n", bytes / 1024.0, (unsigned long long)scanned);
+  return 0;
+}
+
+// ==============================================================
+//                    BENCHMARK (N SIMULATED UNITS OVER TCP)
+// ==============================================================
+// Lines in the formats the sketches print, varied per unit
+static std::string unitTraffic(int unit) {
+  char b[2048];
+  int n = 0;
+  double t = 18.0 + unit % 10, h = 40.0 + unit % 30;
+  n += snprintf(b + n, sizeof(b) - n, "{\"temp\":%.1f}\n{\"humidity\":%.1f}\n{\"soil\":%d}\n", t, h, unit % 100);
+  n += snprintf(b + n, sizeof(b) - n, "{\"fire\":\"Normal\"}\n{\"landslide\":\"Safe\"}\n{\"vibration\":\"Low\"}\n");
+  n += snprintf(b + n, sizeof(b) - n, "{\"lat\":31.%04d, \"lon\":77.%04d}\n", unit, unit);
+  n += snprintf(b + n, sizeof(b) - n, "\"2025-10-18T10:%02d:00\",%.2f,%.2f,%.2f,%.2f,1013.25,%d,%d,31.498200,77.805400\n",
+                unit % 60, t, h, t - 0.5, h + 1.0, 200 + unit % 50, 1800 + unit % 300);
+  n += snprintf(b + n, sizeof(b) - n, "{\"status\":\"ok\",\"dhtT\":%.2f,\"dhtH\":%.2f,\"mq\":%d,\"soil\":%d}\n", t, h, 210, 1900);
+  if (unit % 50 == 0) {
+    n += snprintf(b + n, sizeof(b) - n,
+                  "{\"type\":\"MQ2\",\"msg\":\"Smoke/Gas detected\",\"time\":\"2025-10-18T10:00:00\",\"extra\":\"mq:412\","
+                  "\"dhtT\":%.2f,\"dhtH\":%.2f,\"bmeT\":0.00,\"bmeH\":0.00,\"bmeP\":0.00,\"mq\":412,\"soil\":1800,\"gps\":\"31.498200,77.805400\"}\n", t, h);
+  }
+  return std::string(b, (size_t)n);
+}
+
+static int runBench(int units, int seconds) {
+  rlimit rl;
+  getrlimit(RLIMIT_NOFILE, &rl);
+  rl.rlim_cur = rl.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &rl);
+
+  char dir[] = "/tmp/himbuddy-gw-XXXXXX";
+  if (!mkdtemp(dir)) { perror("mkdtemp"); return 1; }
+
+  // 1) parser alone, in memory
+  {
+    Store store(std::string(dir) + "/parse");
+    ParseStats st;
+    std::vector<std::string> traffic;
+    for (int u = 0; u < units; u++) traffic.push_back(unitTraffic(u));
+    auto t0 = std::chrono::steady_clock::now();
+    int64_t ts = nowMs();
+    int rounds = 0;
+    while (std::chrono::steady_clock::now() - t0 < std::chrono::seconds(1)) {
+      for (int u = 0; u < units; u++) {
+        string_view all(traffic[u]);
+        size_t start = 0, nl;
+        while ((nl = all.find('\n', start)) != string_view::npos) {
+          parseLine(all.substr(start, nl - start), ts, (uint32_t)u, store, st);
+          start = nl + 1;
+        }
+      }
+      rounds++;
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    printf("parse+store (in memory): %.0f lines/s, %.1f MB/s, %.0f values/s\n",
+           st.lines / sec, st.bytes / sec / 1e6, st.values / sec);
+  }
+
+  // 2) full path: N TCP connections -> epoll -> scanner -> parser -> store
+  Store store(std::string(dir) + "/tcp");
+  Gateway gw(store);
+  if (!gw.listenTcp(0)) return 1;
+  std::atomic<bool> stop(false);
+  std::atomic<uint64_t> sentBytes(0);
+  std::thread sender([&]() {
+    std::vector<int> fds;
+    std::vector<std::string> traffic;
+    sockaddr_in a = {};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(gw.boundPort);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (int u = 0; u < units; u++) {
+      int fd = socket(AF_INET, SOCK_STREAM, 0);
+      if (connect(fd, (sockaddr*)&a, sizeof(a)) != 0) { perror("connect"); close(fd); continue; }
+      std::string hello = "NODE " + std::to_string(u) + "\n";
+      if (write(fd, hello.data(), hello.size()) < 0) perror("write");
+      fcntl(fd, F_SETFL, O_NONBLOCK);
+      fds.push_back(fd);
+      traffic.push_back(unitTraffic(u));
+    }
+    while (!stop) {
+      for (size_t i = 0; i < fds.size() && !stop; i++) {
+        ssize_t k = write(fds[i], traffic[i].data(), traffic[i].size());
+        if (k > 0) sentBytes += (uint64_t)k;
+        if (k > 0 && (size_t)k < traffic[i].size()) {
+          // keep line framing: finish this burst blocking
+          size_t off = (size_t)k;
+          while (off < traffic[i].size() && !stop) {
+            ssize_t m = write(fds[i], traffic[i].data() + off, traffic[i].size() - off);
+            if (m > 0) { off += (size_t)m; sentBytes += (uint64_t)m; }
+            else std::this_thread::yield();
+          }
+        }
+      }
+    }
+    for (int fd : fds) close(fd);
+  });
+
+  auto t0 = std::chrono::steady_clock::now();
+  auto end = t0 + std::chrono::seconds(seconds);
+  size_t peakConns = 0;
+  while (std::chrono::steady_clock::now() < end) {
+    gw.step(50);
+    if (gw.connections() > peakConns) peakConns = gw.connections();
+  }
+  stop = true;
+  double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  sender.join();
+  store.flush();
+  const ParseStats& st = gw.stats;
+  printf("tcp ingest (%d units, %zu connected): %.0f lines/s, %.1f MB/s, %.0f values/s, %.0f alerts/s, %llu unparsed\n",
+         units, peakConns - 1, st.lines / sec, st.bytes / sec / 1e6, st.values / sec, st.alerts / sec,
+         (unsigned long long)st.unknown);
+  printf("per unit: %.1f lines/s  (units send one line every 2-5 s in the field)\n", st.lines / sec / units);
+  std::string cleanup = std::string("rm -rf ") + dir;
+  if (system(cleanup.c_str()) != 0) fprintf(stderr, "left %s\n", dir);
+  return 0;
+}
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr,
+          "usage: gateway serve --store DIR [--tcp PORT] [--serial PATH[=NODE]]...\n"
+          "       gateway query --store DIR --from T --to T [--window SEC] [--field NAME] [--node N]\n"
+          "       gateway bench [--nodes 1000] [--seconds 5]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) usage();
+  std::string cmd = argv[1];
+  std::string dir = "./store";
+  std::vector<std::string> serials;
+  int tcpPort = -1, nodes = 1000, seconds = 5, field = -1;
+  long node = -1;
+  int64_t from = 0, to = 0, windowMs = 3600000;
+  for (int i = 2; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--store") dir = v;
+    else if (a == "--tcp") tcpPort = atoi(v);
+    else if (a == "--serial") serials.push_back(v);
+    else if (a == "--nodes") nodes = atoi(v);
+    else if (a == "--seconds") seconds = atoi(v);
+    else if (a == "--from") from = parseTime(v);
+    else if (a == "--to") to = parseTime(v);
+    else if (a == "--window") windowMs = (int64_t)atol(v) * 1000;
+    else if (a == "--node") node = atol(v);
+    else if (a == "--field") { field = fieldByName(v); if (field < 0) { fprintf(stderr, "unknown field %s\n", v); return 2; } }
+    else usage();
+  }
+
+  if (cmd == "bench") return runBench(nodes, seconds);
+  if (cmd == "query") {
+    if (to <= from || windowMs <= 0) usage();
+    return runQuery(dir, from, to, windowMs, field, node);
+  }
+  if (cmd != "serve") usage();
+
+  Store store(dir);
+  Gateway gw(store);
+  if (tcpPort >= 0 && !gw.listenTcp((uint16_t)tcpPort)) return 1;
+  for (auto& s : serials) gw.openSerial(s);
+  fprintf(stderr, "gateway: store %s, tcp %d, %zu serial\n", dir.c_str(), tcpPort, serials.size());
+  while (gw.step(1000)) {}
+  return 1;
+}
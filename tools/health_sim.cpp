@@ -0,0 +1,297 @@
+/****************************************************************
+ * HIMBUDDY - SENSOR HEALTH SIMULATOR (runs on a PC)
+ *
+ * Checks src/sensor_health.h, then runs HimBuddy.c's sensor reads on
+ * a virtual clock to show what an unplugged sensor costs loop():
+ *   - the state machine: ok -> degraded -> absent on missing reads,
+ *     bad reads never make a device absent, probes back off 1, 2, 4 ..
+ *     up to probeMaxMs, a probe that answers brings it back (and asks
+ *     for begin()), millis() wrapping on the way
+ *   - loop passes every --pass-ms with every sensor present, every
+ *     sensor missing, and sensors unplugged / plugged in at random;
+ *     each with and without the health check. A read costs what the
+ *     table below says; a missing I2C part costs --timeout-us (the
+ *     Wire timeout on a bus that lost its pull-ups with the plug)
+ *   - gates: with health, mean and p99 loop time with sensors missing
+ *     are no worse than with all present; an unplugged sensor is
+ *     absent within absentAfter reads, a plugged one found within
+ *     probeMaxMs
+ *   - ns per due() of an absent device (what is left on the hot path)
+ *
+ * Build : g++ -O2 -std=c++17 -I. tools/health_sim.cpp -o health_sim
+ * Run   : ./health_sim
+ *         ./health_sim --hours 6 --timeout-us 1000 --seed 3
+ ****************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/sensor_health.h"
+
+struct Options {
+  double hours = 2;
+  uint32_t passMs = 10;        // loop() pass (uiWait)
+  uint32_t timeoutUs = 50000;  // missing I2C part
+  unsigned seed = 1;
+};
+
+static long failures = 0;
+
+static void fail(const char* what) {
+  if (failures++ < 10) printf("FAIL %s\n", what);
+}
+
+// ==============================================================
+//                    STATE MACHINE
+// ==============================================================
+static void checkStates() {
+  const HealthConfig& c = HEALTH_BUS;
+  SensorHealth h;
+  uint32_t t = 0xFFFFFFFFu - 5000;  // millis() wraps in the middle of it
+  h.begin("mpu", c, true, t);
+  if (h.state() != HEALTH_OK || !h.due(t)) fail("a found device starts OK and is read");
+
+  // bad reads: degraded, never absent
+  for (int i = 0; i < 50; i++) h.report(READ_BAD, t += 10);
+  if (h.state() != HEALTH_DEGRADED) fail("bad reads did not make it DEGRADED (or made it ABSENT)");
+  for (int i = 0; i < c.okAfter - 1; i++) h.report(READ_OK, t += 10);
+  if (h.state() != HEALTH_DEGRADED) fail("OK again before okAfter good reads");
+  h.report(READ_OK, t += 10);
+  if (h.state() != HEALTH_OK) fail("not OK after okAfter good reads");
+
+  // missing reads: degraded, then absent
+  for (int i = 0; i < c.absentAfter - 1; i++) h.report(READ_MISSING, t += 10);
+  if (h.state() != HEALTH_DEGRADED) fail("not DEGRADED before absentAfter missing reads");
+  h.report(READ_OK, t += 10);
+  for (int i = 0; i < c.absentAfter - 1; i++) h.report(READ_MISSING, t += 10);
+  if (h.absent()) fail("missing reads with a good one between made it ABSENT");
+  h.report(READ_MISSING, t += 10);
+  if (!h.absent()) fail("not ABSENT after absentAfter missing reads in a row");
+
+  // backoff: probes at +1, +2, +4 .. s, capped, nothing in between
+  uint32_t expect = c.probeMs;
+  uint32_t since = t;
+  for (int probe = 0; probe < 12; probe++) {
+    uint32_t wait = 0;
+    while (!h.due(since + wait)) wait++;
+    if (wait != expect) {
+      char msg[96];
+      snprintf(msg, sizeof(msg), "probe %d after %lu ms, expected %lu", probe, (unsigned long)wait,
+               (unsigned long)expect);
+      fail(msg);
+      break;
+    }
+    since += wait;
+    if (h.report(READ_MISSING, since)) fail("a failed probe asked for begin()");
+    expect = std::min(expect * 2, c.probeMaxMs);
+  }
+  if (h.backoff() != c.probeMaxMs) fail("backoff not capped at probeMaxMs");
+
+  // a probe that answers: back, DEGRADED, begin() asked once, backoff reset
+  while (!h.due(since)) since++;
+  if (!h.report(READ_OK, since)) fail("the answering probe did not ask for begin()");
+  if (h.state() != HEALTH_DEGRADED) fail("back from ABSENT is not DEGRADED");
+  if (h.report(READ_OK, since + 10)) fail("begin() asked twice");
+  if (h.backoff() != c.probeMs) fail("backoff not reset after the device came back");
+
+  // a device whose begin() failed at boot: absent, probed after probeMs
+  SensorHealth b;
+  b.begin("bme", c, false, 1000);
+  if (!b.absent() || b.due(1000 + c.probeMs - 1) || !b.due(1000 + c.probeMs)) fail("not-found device timing");
+  // a probe nobody reports: no probe storm, the next one after a backoff
+  if (b.due(1000 + c.probeMs + 1) || !b.due(1000 + 2 * c.probeMs)) fail("unreported probe repeats at once");
+
+  char out[256];
+  b.json(out, sizeof(out), 1000);
+  if (!strstr(out, "\"name\":\"bme\"") || !strstr(out, "\"state\":\"absent\"")) fail("json");
+  SensorHealth list[2] = { h, b };
+  healthSummaryJson(list, 2, out, sizeof(out));
+  if (strcmp(out, "{\"mpu\":\"degraded\",\"bme\":\"absent\"}") != 0) fail("summary json");
+  size_t cut = strlen(out) / 2;  // too small: cut, not overrun
+  healthListJson(list, 2, 1000, out, cut);
+  if (strlen(out) != cut - 1) fail("list json overruns a short buffer");
+}
+
+// ==============================================================
+//                    LOOP SIMULATION
+// ==============================================================
+// HimBuddy.c per device: how often loop() reads it, what a read costs
+// present / missing (us). Bench figures of the parts, not measured here:
+//   soil, gas  analogRead ~10 us either way (screens, rules, history)
+//   dht        DHT library, interrupts off ~5 ms every 2 s (cached in
+//              between); a missing sensor times out after ~2.2 ms
+//   mpu        pollQuake(): INT status + FIFO count + ~1 sample, 100 kHz
+struct DevModel {
+  const char* name;
+  const HealthConfig* cfg;
+  uint32_t periodMs;
+  uint32_t presentUs;
+  uint32_t missingUs;  // 0 = --timeout-us
+  uint8_t everyNth;    // cost only on every n-th call (library cache)
+};
+
+const DevModel DEVICES[] = {
+  { "soil", &HEALTH_ANALOG, 250, 10, 10, 1 },
+  { "gas", &HEALTH_ANALOG, 250, 10, 10, 1 },
+  { "dht", &HEALTH_BUS, 1000, 5000, 2200, 2 },
+  { "mpu", &HEALTH_BUS, 10, 1600, 0, 1 },
+};
+constexpr size_t DEV_N = sizeof(DEVICES) / sizeof(DEVICES[0]);
+
+enum Scenario { ALL_PRESENT, ALL_MISSING, UNPLUGGING };
+const char* const SCENARIO_NAMES[] = { "all present", "all missing", "unplugging" };
+
+struct Result {
+  double meanUs = 0;
+  uint32_t p99Us = 0, maxUs = 0;
+  long probes = 0, unplugs = 0;
+  uint32_t worstAbsentMs[DEV_N] = {};  // unplugged -> ABSENT
+  uint32_t worstFoundMs[DEV_N] = {};   // plugged in -> read OK again
+};
+
+static Result simulate(const Options& o, Scenario sc, bool useHealth) {
+  std::mt19937 rng(o.seed);
+  std::exponential_distribution<double> flip(1.0 / (5 * 60 * 1000.0));  // mean 5 min between plug events
+  Result r;
+  SensorHealth health[DEV_N];
+  bool present[DEV_N];
+  uint32_t nextCall[DEV_N], calls[DEV_N] = {}, changedAt[DEV_N] = {};
+  double nextFlip[DEV_N];
+  bool waiting[DEV_N] = {};  // plug event not yet seen by the health
+  uint32_t ms = 0xFFFFFFFFu - 60000;  // wraps a minute in
+  for (size_t d = 0; d < DEV_N; d++) {
+    present[d] = sc != ALL_MISSING;
+    health[d].begin(DEVICES[d].name, *DEVICES[d].cfg, present[d], ms);
+    nextCall[d] = ms;
+    nextFlip[d] = flip(rng);
+  }
+
+  long passes = (long)(o.hours * 3600000.0 / o.passMs);
+  std::vector<uint32_t> cost(passes);
+  double total = 0;
+  for (long p = 0; p < passes; p++, ms += o.passMs) {
+    double elapsed = (double)p * o.passMs;
+    uint32_t us = 0;
+    for (size_t d = 0; d < DEV_N; d++) {
+      const DevModel& m = DEVICES[d];
+      if (sc == UNPLUGGING && elapsed >= nextFlip[d]) {
+        present[d] = !present[d];
+        nextFlip[d] = elapsed + flip(rng);
+        changedAt[d] = ms;
+        waiting[d] = true;
+        if (!present[d]) r.unplugs++;
+      }
+      if ((int32_t)(ms - nextCall[d]) >= 0) {
+        nextCall[d] = ms + m.periodMs;
+        bool read = !useHealth || health[d].due(ms);
+        if (useHealth && read && health[d].absent()) r.probes++;
+        bool cached = ++calls[d] % m.everyNth != 0;
+        if (read && !cached) us += present[d] ? m.presentUs : (m.missingUs ? m.missingUs : o.timeoutUs);
+        if (read && useHealth) health[d].report(present[d] ? READ_OK : READ_MISSING, ms);
+      }
+      if (!useHealth || !waiting[d]) continue;
+      if (!present[d] && health[d].absent()) {
+        r.worstAbsentMs[d] = std::max(r.worstAbsentMs[d], ms - changedAt[d]);
+        waiting[d] = false;
+      } else if (present[d] && !health[d].absent()) {
+        r.worstFoundMs[d] = std::max(r.worstFoundMs[d], ms - changedAt[d]);
+        waiting[d] = false;
+      }
+    }
+    cost[p] = us;
+    total += us;
+  }
+  r.meanUs = total / passes;
+  r.maxUs = *std::max_element(cost.begin(), cost.end());
+  std::nth_element(cost.begin(), cost.begin() + passes * 99 / 100, cost.end());
+  r.p99Us = cost[passes * 99 / 100];
+  return r;
+}
+
+static void runLoops(const Options& o) {
+  Result res[3][2];
+  printf("%-12s %-7s %10s %9s %9s %8s\n", "sensors", "health", "mean us", "p99 us", "max us", "probes");
+  for (int sc = 0; sc < 3; sc++) {
+    for (int h = 0; h < 2; h++) {
+      res[sc][h] = simulate(o, (Scenario)sc, h);
+      const Result& r = res[sc][h];
+      printf("%-12s %-7s %10.1f %9lu %9lu %8ld\n", SCENARIO_NAMES[sc], h ? "on" : "off", r.meanUs,
+             (unsigned long)r.p99Us, (unsigned long)r.maxUs, r.probes);
+    }
+  }
+  const Result& present = res[ALL_PRESENT][1];
+  const Result& missing = res[ALL_MISSING][1];
+  if (missing.meanUs > present.meanUs) fail("mean loop time with sensors missing above all present");
+  if (missing.p99Us > present.p99Us) fail("p99 loop time with sensors missing above all present");
+  if (res[ALL_PRESENT][0].meanUs != present.meanUs) fail("health changed the cost of present sensors");
+
+  const Result& u = res[UNPLUGGING][1];
+  printf("unplug: %ld events;", u.unplugs);
+  for (size_t d = 0; d < DEV_N; d++) {
+    const DevModel& m = DEVICES[d];
+    printf(" %s absent <= %lu ms, found <= %lu ms;", m.name, (unsigned long)u.worstAbsentMs[d],
+           (unsigned long)u.worstFoundMs[d]);
+    char msg[96];
+    if (u.worstAbsentMs[d] > m.cfg->absentAfter * std::max(m.periodMs, o.passMs) + o.passMs) {
+      snprintf(msg, sizeof(msg), "%s: unplugged, ABSENT only after %lu ms", m.name, (unsigned long)u.worstAbsentMs[d]);
+      fail(msg);
+    }
+    if (u.worstFoundMs[d] > m.cfg->probeMaxMs + m.periodMs + o.passMs) {
+      snprintf(msg, sizeof(msg), "%s: plugged in, found only after %lu ms", m.name, (unsigned long)u.worstFoundMs[d]);
+      fail(msg);
+    }
+  }
+  printf("\n");
+}
+
+// ==============================================================
+//                    TIME
+// ==============================================================
+static void timeDue() {
+  SensorHealth h;
+  h.begin("x", HEALTH_BUS, false, 0);
+  const long N = 50000000;
+  long yes = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < N; i++) {
+    if (h.due((uint32_t)(i >> 10))) {  // 1 ms per 1024 calls
+      yes++;
+      h.report(READ_MISSING, (uint32_t)(i >> 10));
+    }
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / N;
+  printf("time  : %.1f ns per due() of an absent device (%ld probes)\n", ns, yes);
+}
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr, "usage: health_sim [--hours 2] [--pass-ms 10] [--timeout-us 50000] [--seed 1]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--hours") o.hours = atof(v);
+    else if (a == "--pass-ms") o.passMs = (uint32_t)atol(v);
+    else if (a == "--timeout-us") o.timeoutUs = (uint32_t)atol(v);
+    else if (a == "--seed") o.seed = (unsigned)atoi(v);
+    else usage();
+  }
+  if (o.hours <= 0 || o.passMs < 1 || o.timeoutUs < 1) usage();
+  checkStates();
+  runLoops(o);
+  timeDue();
+  printf("%s: %ld failed checks\n", failures ? "FAIL" : "OK", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,271 @@
+/****************************************************************
+ * HIMBUDDY - RING JOURNAL POWER-CUT TEST (Linux)
+ *
+ * Runs src/journal.h (the SD journal of esp32fullcode.c) against a
+ * disk image file and pulls the plug over and over: every cycle boots
+ * the journal (recovery), checks what survived, appends records until
+ * a random byte budget runs out and tears the write in flight there.
+ *   tear     the write stops part way, the rest of the block is old
+ *   garbage  the rest of the block is random (a card losing a sector)
+ * After every boot it checks:
+ *   - every record read back is the one written with that seq, and
+ *     the seqs have no gap (nothing half-written comes back)
+ *   - no record is lost except those of the block that was torn
+ *   - recovery takes ~log2(blocks) block reads
+ *   - seek() + forEachFrom() find a record by key (its seq here, the
+ *     time on the unit) without reading the ring from the start
+ *
+ * --dump prints the records of an image, oldest first, one text line
+ * each: /alerts.jnl or /raw.jnl copied off a unit's SD card becomes
+ * the JSON / CSV lines tools/backtest.cpp reads.
+ *
+ * Build : g++ -O2 -std=c++17 -I. tools/journal_sim.cpp -o journal_sim
+ * Run   : ./journal_sim                          (256 blocks, 2000 cuts)
+ *         ./journal_sim --blocks 8192 --cuts 200 --mode garbage
+ *         ./journal_sim --dump raw.jnl > raw.csv
+ ****************************************************************/
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "src/journal.h"
+
+struct Options {
+  std::string image = "journal_sim.img";
+  std::string dump;
+  std::string mode = "both";      // tear | garbage | both
+  uint32_t blocks = 256;
+  int cuts = 2000;
+  int maxBlocksPerCut = 64;       // power is cut within this many block writes
+  unsigned seed = 1;
+};
+
+// ==============================================================
+//                    DISK IMAGE WITH A POWER SWITCH
+// ==============================================================
+class ImageStore : public JournalStore {
+public:
+  explicit ImageStore(int f) : fd(f) {}
+
+  bool read(uint32_t offset, uint8_t* buf, size_t len) override {
+    return pread(fd, buf, len, offset) == (ssize_t)len;
+  }
+
+  bool write(uint32_t offset, const uint8_t* buf, size_t len) override {
+    if (dead) return false;
+    writes++;
+    if (budget >= len) {
+      budget -= len;
+      return pwrite(fd, buf, len, offset) == (ssize_t)len;
+    }
+    // power cut: part of the block makes it, the rest is old or garbage
+    tornAt = offset;
+    if (pwrite(fd, buf, budget, offset) != (ssize_t)budget) exit(1);
+    if (garbage) {
+      uint8_t junk[JOURNAL_BLOCK_SIZE];
+      for (size_t i = budget; i < len; i++) junk[i] = (uint8_t)rng();
+      if (pwrite(fd, junk + budget, len - budget, offset + budget) != (ssize_t)(len - budget)) exit(1);
+    }
+    dead = true;
+    return false;
+  }
+
+  bool sync() override { return !dead; }
+
+  // the next power cut comes after `bytes` more bytes
+  void powerOn(size_t bytes, bool garbageMode) {
+    budget = bytes;
+    garbage = garbageMode;
+    dead = false;
+    tornAt = UINT32_MAX;
+  }
+
+  int fd;
+  bool dead = false;
+  bool garbage = false;
+  size_t budget = SIZE_MAX;
+  uint32_t tornAt = UINT32_MAX;
+  uint64_t writes = 0;
+  std::mt19937 rng{ 7 };
+};
+
+// Record seq -> its content (so a reader can check every byte)
+static size_t recordFor(uint32_t seq, char* out, uint16_t* kind) {
+  uint32_t h = seq * 2654435761u;
+  size_t len = 24 + (h >> 8) % 360;  // alert JSON / CSV row sized
+  size_t n = (size_t)snprintf(out, len + 1, "#%lu ", (unsigned long)seq);
+  for (size_t i = n; i < len; i++) out[i] = (char)('a' + (h >> (i % 24)) % 26);
+  *kind = (uint16_t)(1 + seq % 2);
+  return len;
+}
+
+static int openImage(const std::string& path, uint32_t blocks, bool fresh) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | (fresh ? O_TRUNC : 0), 0644);
+  if (fd < 0) { perror(path.c_str()); exit(1); }
+  if (fresh && ftruncate(fd, (off_t)blocks * JOURNAL_BLOCK_SIZE) != 0) { perror("ftruncate"); exit(1); }  // zeros
+  return fd;
+}
+
+// ==============================================================
+//                    POWER-CUT TEST
+// ==============================================================
+static int powerCuts(const Options& o) {
+  int fd = openImage(o.image, o.blocks, true);
+  ImageStore store(fd);
+  std::mt19937 rng(o.seed);
+  std::uniform_int_distribution<size_t> cutAt(1, (size_t)o.maxBlocksPerCut * JOURNAL_BLOCK_SIZE);
+
+  int64_t acked = -1;     // last record whose append() returned true
+  int64_t mustHave = -1;  // records up to here must survive the cut
+  uint64_t appended = 0, lost = 0, maxLost = 0, readsSum = 0, readsMax = 0, failures = 0;
+  uint32_t laps = 0;
+  double recoverUsMax = 0;
+  char want[512];
+
+  for (int cycle = 0; cycle <= o.cuts; cycle++) {
+    // boot: recover and check what survived
+    store.powerOn(SIZE_MAX, false);
+    static Journal j;
+    auto t0 = std::chrono::steady_clock::now();
+    j.begin(store, o.blocks);
+    recoverUsMax = std::max(recoverUsMax,
+                            std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+    readsSum += j.recoveryReads();
+    readsMax = std::max<uint64_t>(readsMax, j.recoveryReads());
+
+    int64_t first = -1, last = -1;
+    bool bad = false;
+    static JournalBlock scratch;
+    j.forEach(scratch, [&](uint32_t seq, uint16_t kind, const char* data, uint16_t len) {
+      uint16_t wantKind;
+      size_t wantLen = recordFor(seq, want, &wantKind);
+      if (last >= 0 && (int64_t)seq != last + 1) bad = true;            // gap or out of order
+      if (kind != wantKind || len != wantLen || memcmp(data, want, len) != 0) bad = true;  // not what was written
+      if (first < 0) first = seq;
+      last = seq;
+    });
+    if (first >= 0) {
+      // by key: the first record at or after it is the one with that seq
+      uint32_t key = (uint32_t)first + (uint32_t)cycle * 2654435761u % (uint32_t)(last - first + 1);
+      uint32_t from = j.seek(scratch, [&](const char* data, uint16_t) { return strtoul(data + 1, NULL, 10) < key; });
+      int64_t found = -1;
+      uint32_t visited = j.forEachFrom(scratch, from, [&](uint32_t seq, uint16_t, const char*, uint16_t) {
+        if (seq < key) return true;
+        found = seq;
+        return false;
+      });
+      if (found != (int64_t)key || visited > JOURNAL_PAYLOAD / sizeof(JournalRecordHeader) + 1) bad = true;
+    }
+    if (last > acked + 1) bad = true;              // more than was ever written
+    if (last < mustHave) bad = true;               // lost more than the torn block
+    if (j.nextSeq() != (uint32_t)(last + 1)) bad = true;
+    if (bad) {
+      failures++;
+      fprintf(stderr, "cut %d: survived %lld..%lld, acked %lld, must have %lld\n", cycle, (long long)first,
+              (long long)last, (long long)acked, (long long)mustHave);
+    }
+    if (acked > last) {
+      lost += (uint64_t)(acked - last);
+      maxLost = std::max<uint64_t>(maxLost, (uint64_t)(acked - last));
+    }
+    acked = last;  // lost seqs are written again (same content)
+    if (cycle == o.cuts) break;
+
+    // run until the power goes
+    bool garbage = o.mode == "garbage" || (o.mode == "both" && (rng() & 1));
+    store.powerOn(cutAt(rng), garbage);
+    for (;;) {
+      uint32_t seq = j.nextSeq();
+      uint16_t kind;
+      size_t len = recordFor(seq, want, &kind);
+      uint32_t headBefore = j.head();
+      uint16_t recsBefore = j.headRecords();
+      if (j.append(kind, want, len)) {
+        acked = seq;
+        appended++;
+        if (j.head() == 0 && j.headRecords() == 1 && j.headSeq() > 0) laps++;
+        continue;
+      }
+      // torn: a rewrite of the head block may take its records with it
+      bool rewrite = store.tornAt == headBefore * JOURNAL_BLOCK_SIZE && recsBefore > 0 && j.head() == headBefore;
+      mustHave = acked - (rewrite ? recsBefore : 0);
+      break;
+    }
+  }
+  close(fd);
+
+  printf("%d power cuts (%s), %u blocks, %lu laps of the ring\n", o.cuts, o.mode.c_str(), o.blocks,
+         (unsigned long)laps);
+  printf("%llu records appended, 1 block write per append (%llu writes)\n", (unsigned long long)appended,
+         (unsigned long long)store.writes);
+  printf("lost %llu records in total, at most %llu per cut (one block holds up to %u)\n",
+         (unsigned long long)lost, (unsigned long long)maxLost,
+         (unsigned)(JOURNAL_PAYLOAD / (sizeof(JournalRecordHeader) + 24)));
+  printf("recovery: %.1f block reads on average, %llu max (%u blocks), %.0f us max on this PC\n",
+         (double)readsSum / (o.cuts + 1), (unsigned long long)readsMax, o.blocks, recoverUsMax);
+  printf("%s: %llu failed checks\n", failures ? "FAIL" : "OK", (unsigned long long)failures);
+  return failures ? 1 : 0;
+}
+
+// ==============================================================
+//                    DUMP
+// ==============================================================
+static int dump(const std::string& path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) { perror(path.c_str()); return 1; }
+  int fd = openImage(path, 0, false);
+  ImageStore store(fd);
+  store.powerOn(0, false);  // read only: a write would tear at once
+  static Journal j;
+  if (!j.begin(store, (uint32_t)(st.st_size / JOURNAL_BLOCK_SIZE))) { fprintf(stderr, "%s: too small\n", path.c_str()); return 1; }
+  static JournalBlock scratch;
+  uint32_t n = j.forEach(scratch, [](uint32_t, uint16_t, const char* data, uint16_t len) {
+    printf("%.*s\n", (int)len, data);
+  });
+  char info[192];
+  j.json(info, sizeof(info));
+  fprintf(stderr, "%lu records, %s\n", (unsigned long)n, info);
+  close(fd);
+  return 0;
+}
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr,
+          "usage: journal_sim [--blocks 256] [--cuts 2000] [--mode tear|garbage|both] [--max-blocks 64]\n"
+          "                   [--image journal_sim.img] [--seed 1]\n"
+          "       journal_sim --dump IMAGE\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--blocks") o.blocks = (uint32_t)atol(v);
+    else if (a == "--cuts") o.cuts = atoi(v);
+    else if (a == "--mode") o.mode = v;
+    else if (a == "--max-blocks") o.maxBlocksPerCut = atoi(v);
+    else if (a == "--image") o.image = v;
+    else if (a == "--dump") o.dump = v;
+    else if (a == "--seed") o.seed = (unsigned)atoi(v);
+    else usage();
+  }
+  if (!o.dump.empty()) return dump(o.dump);
+  if (o.blocks < 2 || o.cuts < 0 || o.maxBlocksPerCut < 1) usage();
+  if (o.mode != "tear" && o.mode != "garbage" && o.mode != "both") usage();
+  if (journalCrc(0, (const uint8_t*)"123456789", 9) != 0xCBF43926u) { fprintf(stderr, "CRC32 broken\n"); return 1; }
+  return powerCuts(o);
+}
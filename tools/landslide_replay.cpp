@@ -0,0 +1,185 @@
+/****************************************************************
+ * HIMBUDDY - LANDSLIDE DETECTOR REPLAY (runs on a PC)
+ *
+ * Feeds a recording, or a made-up scenario, through src/landslide.h
+ * (the same detector esp32.c and esp32fullcode.c run) and prints every
+ * risk level change with the reasons behind it.
+ *
+ * CSV (one sample per line, '#' = comment):
+ *   seconds,soilPct,ax,ay,az,tiltEdges
+ * soilPct 0 = dry .. 100 = wet, a* in any unit, tiltEdges = switch
+ * closures since the previous line.
+ *
+ * Scenarios (5 s samples, like esp32fullcode.c):
+ *   dry      two quiet days
+ *   rain     a cloudburst soaks stable ground
+ *   traffic  trucks shake the unit, the tilt switch bumps now and then
+ *   creep    rain, then the slope starts to lean and finally slides
+ *
+ * Build : g++ -O2 -std=c++17 -I. tools/landslide_replay.cpp -o landslide_replay
+ * Run   : ./landslide_replay --scenario creep
+ *         ./landslide_replay --scenario rain --dump rain.csv
+ *         ./landslide_replay --csv slope_unit3.csv
+ ****************************************************************/
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/landslide.h"
+
+struct Row {
+  double sec;
+  float soil, ax, ay, az;
+  uint16_t tilt;
+};
+
+struct Options {
+  std::string csv;
+  std::string scenario = "creep";
+  std::string dump;
+  unsigned seed = 1;
+};
+
+// ==============================================================
+//                    SCENARIOS
+// ==============================================================
+static std::vector<Row> scenario(const std::string& name, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> noise(0, 1);
+  std::uniform_real_distribution<float> uni(0, 1);
+  const double step = 5;
+  double hours = 48;
+  std::vector<Row> rows;
+
+  for (double t = 0; t < hours * 3600; t += step) {
+    double h = t / 3600;
+    float soil = 30, leanDeg = 0, shake = 0.005f; // MPU6050 noise ~5 mg
+    float tiltPerH = 0;
+
+    if (name == "rain" || name == "creep") {
+      // rain from hour 10 to 16, soil soaks up to ~95 %, dries slowly
+      if (h > 10) soil = 30 + 65 * (float)std::min(1.0, (h - 10) / 4);
+      if (h > 16) soil = 95 - 20 * (float)std::min(1.0, (h - 16) / 24);
+    }
+    if (name == "creep" && h > 14) {
+      // creep speeds up: 0.05 deg/h, doubling every 4 h, slides at hour 34
+      double c = h - 14;
+      leanDeg = (float)(0.05 * 4 / log(2.0) * (pow(2.0, c / 4) - 1));
+      tiltPerH = (float)std::min(30.0, 0.5 * pow(2.0, c / 4));
+      if (h > 34) { leanDeg = 25; shake = 0.2f; tiltPerH = 120; }
+    }
+    if (name == "traffic") {
+      bool rush = fmod(h, 24) > 7 && fmod(h, 24) < 20;
+      shake = rush ? 0.05f : 0.01f;
+      tiltPerH = rush ? 1.0f : 0.1f;
+    }
+
+    float rad = leanDeg * (float)M_PI / 180;
+    Row r;
+    r.sec = t;
+    r.soil = std::max(0.0f, std::min(100.0f, soil + 1.5f * noise(rng)));
+    r.ax = sinf(rad) + shake * noise(rng);
+    r.ay = shake * noise(rng);
+    r.az = cosf(rad) + shake * noise(rng);
+    r.tilt = uni(rng) < tiltPerH * step / 3600 ? 1 : 0;
+    rows.push_back(r);
+  }
+  return rows;
+}
+
+static std::vector<Row> loadCsv(const std::string& path) {
+  std::vector<Row> rows;
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) { perror(path.c_str()); exit(1); }
+  char line[160];
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#') continue;
+    Row r;
+    unsigned tilt;
+    if (sscanf(line, "%lf,%f,%f,%f,%f,%u", &r.sec, &r.soil, &r.ax, &r.ay, &r.az, &tilt) == 6) {
+      r.tilt = (uint16_t)tilt;
+      rows.push_back(r);
+    }
+  }
+  fclose(f);
+  return rows;
+}
+
+static void dumpCsv(const std::string& path, const std::vector<Row>& rows) {
+  FILE* f = fopen(path.c_str(), "w");
+  if (!f) { perror(path.c_str()); exit(1); }
+  fprintf(f, "# seconds,soilPct,ax,ay,az,tiltEdges\n");
+  for (const Row& r : rows) fprintf(f, "%.0f,%.1f,%.4f,%.4f,%.4f,%u\n", r.sec, r.soil, r.ax, r.ay, r.az, r.tilt);
+  fclose(f);
+}
+
+static void printReasons(uint8_t why) {
+  static const char* const names[] = { "saturated", "wetting", "leaned", "creeping", "tilt" };
+  bool first = true;
+  for (int b = 0; b < 5; b++) {
+    if (why & (1 << b)) { printf("%s%s", first ? "" : "+", names[b]); first = false; }
+  }
+  if (first) printf("-");
+}
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr, "usage: landslide_replay [--scenario dry|rain|traffic|creep] [--csv FILE] [--dump FILE] [--seed 1]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--csv") o.csv = v;
+    else if (a == "--scenario") o.scenario = v;
+    else if (a == "--dump") o.dump = v;
+    else if (a == "--seed") o.seed = (unsigned)atoi(v);
+    else usage();
+  }
+  if (o.csv.empty() && o.scenario != "dry" && o.scenario != "rain" && o.scenario != "traffic" && o.scenario != "creep") {
+    usage();
+  }
+
+  std::vector<Row> rows = o.csv.empty() ? scenario(o.scenario, o.seed) : loadCsv(o.csv);
+  if (!o.dump.empty()) dumpCsv(o.dump, rows);
+  if (rows.empty()) { fprintf(stderr, "no samples\n"); return 1; }
+
+  LandslideDetector det;
+  uint32_t t0 = (uint32_t)(rows[0].sec * 1000);
+  det.begin(LANDSLIDE_CONFIG_DEFAULT, t0);
+  printf("%zu samples, %.1f h (%s)\n\n", rows.size(), (rows.back().sec - rows[0].sec) / 3600,
+         o.csv.empty() ? o.scenario.c_str() : o.csv.c_str());
+  printf("%8s  %-8s %5s %6s %7s %7s %8s %7s  %s\n", "hour", "risk", "score", "soil%", "wet/h", "lean", "creep/h",
+         "tilt/h", "reasons");
+
+  uint8_t shown = 0xFF;
+  auto start = std::chrono::steady_clock::now();
+  for (const Row& r : rows) {
+    det.update((uint32_t)(r.sec * 1000), r.soil, r.ax, r.ay, r.az, r.tilt);
+    if (det.level() != shown) {
+      shown = det.level();
+      printf("%8.2f  %-8s %5u %6.1f %7.1f %7.2f %8.3f %7.1f  ", (r.sec - rows[0].sec) / 3600,
+             landslideRiskName(det.level()), det.score(), det.soilPct(), det.wettingPerH(), det.leanDeg(),
+             det.creepDegPerH(), det.tiltPerH());
+      printReasons(det.reasons());
+      printf("\n");
+    }
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  char json[256];
+  det.json(json, sizeof(json));
+  printf("\nend: %s\n", json);
+  printf("update(): %.0f ns per sample on this PC, %zu bytes of state\n", ns / rows.size(), sizeof(det));
+  return 0;
+}
@@ -0,0 +1,946 @@
+/****************************************************************
+ * HIMBUDDY - WEB LOAD TEST (runs on a Linux PC on the hotspot)
+ *
+ * Two modes:
+ *   steps     N keep-alive connections sending GETs back to back, for
+ *             each N of --clients: how much the server can take
+ *   scenario  --scenario FILE: N simulated phones that act like real
+ *             ones, to compare one firmware release with the next
+ *             under the same load
+ *
+ * Scenario file (tools/scenarios/), one setting per line, # = comment:
+ *   name classroom-alert
+ *   clients 30              phones, one keep-alive connection each
+ *   seconds 60              time under load
+ *   seed 1                  same seed = same presses at the same times
+ *   timeout-ms 5000         no reply by then = timeout
+ *   idle 10                 seconds without load first (unit baseline)
+ *   poll / 2000             GET, again 2000 ms after the reply (the
+ *                           page's 2 s meta refresh)
+ *   press /up,/down 15000   one of them, on average every 15 s (random gaps)
+ *   post /msg?t=hi 45000    the same, for the message box
+ *   at 20 /msg?t=alert      one request at second 20 (starts the alarm)
+ * A 303 reply is followed to its Location like a browser does (kind
+ * "redirect") and restarts that phone's refresh timer. All phones come
+ * from this PC, so the 10 station limit of the hotspot does not apply.
+ *
+ * Per request kind: count, req/s, latency p50 / p90 / p99 / max,
+ * errors, timeouts, non-2xx. The unit's side comes from /api/perf
+ * (loop() pass avg / max, UI tick, button -> OLED) and /api/heap, read
+ * after the idle time and after the load. --report saves both tables
+ * as CSV; --baseline compares with a saved one and fails when a p99,
+ * an error rate or the loop pass time got worse than --max-regress %.
+ *
+ * --sim serves a stand-in for the firmware on 127.0.0.1 to try the
+ * harness and scenarios without a unit: one server thread, 12 sockets
+ * with LRU purge (WEB_MAX_SOCKETS), the same routes, the page sent in
+ * 512 byte chunks of --sim-chunk-us each. Its /api/perf times a host
+ * thread, not the ESP32 loop(), so --baseline leaves it out there.
+ *
+ * Build : g++ -O2 -std=c++17 -pthread tools/loadgen.cpp -o loadgen
+ * Run   : ./loadgen 192.168.4.1                  (10 and 20 clients, 10 s each)
+ *         ./loadgen 192.168.4.1 --clients 5,10,20 --seconds 30 --path /view_temp
+ *         ./loadgen 192.168.4.1 --scenario tools/scenarios/classroom_alert.txt --report v1.csv
+ *         ./loadgen 192.168.4.1 --scenario tools/scenarios/classroom_alert.txt --baseline v1.csv
+ *         ./loadgen --sim --scenario tools/scenarios/classroom_alert.txt
+ ****************************************************************/
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string host = "192.168.4.1";
+  int port = 80;
+  std::vector<int> clients = { 10, 20 };
+  int seconds = 10;
+  int timeoutMs = 5000;
+  std::string path = "/";
+  std::string scenario;   // scenario file ("" = steps)
+  std::string report;     // write results here (CSV)
+  std::string baseline;   // compare with this report
+  double maxRegressPct = 20;
+  bool sim = false;
+  int simChunkUs = 400;   // ~1.3 MB/s, about what the unit's Wi-Fi sends
+  int simPageBytes = 4500;
+};
+
+// ==============================================================
+//                    ONE HTTP CONNECTION
+// ==============================================================
+#define HTTP_ERROR -1     // connect refused / reset / bad reply
+#define HTTP_TIMEOUT -2   // no reply within the timeout
+
+struct Reply {
+  std::string body;       // only when asked for
+  std::string location;   // Location header (303)
+};
+
+class HttpConn {
+public:
+  HttpConn(const sockaddr_in& addr, int timeoutMs) : addr_(addr), timeoutMs_(timeoutMs) {}
+  ~HttpConn() { closeSock(); }
+
+  // Sends one GET and reads the whole reply. Returns the HTTP status,
+  // or HTTP_ERROR / HTTP_TIMEOUT (the connection is dropped then).
+  int get(const std::string& host, const std::string& path, Reply* reply = nullptr) {
+    std::string req = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: keep-alive\r\n\r\n";
+    reply_ = reply;
+    for (int attempt = 0; attempt < 2; attempt++) {
+      bool reused = fd_ >= 0;
+      timedOut_ = false;
+      gotBytes_ = false;
+      if (reply_) {
+        reply_->body.clear();
+        reply_->location.clear();
+      }
+      if (fd_ < 0 && !connectSock()) return failed();
+      if (sendAll(req.data(), req.size())) {
+        int status = readResponse();
+        if (status >= 0) {
+          if (!keepAlive_) closeSock();
+          return status;
+        }
+      }
+      // a keep-alive socket the server closed meanwhile (idle, or purged
+      // for a new one) before any reply: a browser sends again, once
+      if (!reused || gotBytes_ || timedOut_) break;
+      closeSock();
+    }
+    return failed();
+  }
+
+private:
+  int failed() {
+    closeSock();
+    return timedOut_ ? HTTP_TIMEOUT : HTTP_ERROR;
+  }
+
+  void noteErrno() {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS || errno == ETIMEDOUT) timedOut_ = true;
+  }
+
+  bool connectSock() {
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd_ < 0) return false;
+    timeval tv = { timeoutMs_ / 1000, (timeoutMs_ % 1000) * 1000 };
+    setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd_, (const sockaddr*)&addr_, sizeof(addr_)) != 0) {
+      noteErrno();
+      closeSock();
+      return false;
+    }
+    buf_.clear();
+    return true;
+  }
+
+  void closeSock() {
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+    buf_.clear();
+  }
+
+  bool sendAll(const char* p, size_t n) {
+    while (n > 0) {
+      ssize_t k = send(fd_, p, n, MSG_NOSIGNAL);
+      if (k <= 0) {
+        if (k < 0) noteErrno();
+        return false;
+      }
+      p += k; n -= (size_t)k;
+    }
+    return true;
+  }
+
+  // Makes sure at least 'need' bytes are buffered
+  bool fill(size_t need) {
+    char tmp[4096];
+    while (buf_.size() < need) {
+      ssize_t k = recv(fd_, tmp, sizeof(tmp), 0);
+      if (k <= 0) {
+        if (k < 0) noteErrno();
+        return false;
+      }
+      buf_.append(tmp, (size_t)k);
+      gotBytes_ = true;
+    }
+    return true;
+  }
+
+  // Reads up to and including "\r\n", returns the line without it
+  bool readLine(std::string& line) {
+    size_t pos;
+    while ((pos = buf_.find("\r\n")) == std::string::npos) {
+      if (!fill(buf_.size() + 1)) return false;
+    }
+    line.assign(buf_, 0, pos);
+    buf_.erase(0, pos + 2);
+    return true;
+  }
+
+  // n body bytes from the front of the buffer
+  void take(size_t n) {
+    if (reply_) reply_->body.append(buf_, 0, n);
+    buf_.erase(0, n);
+  }
+
+  int readResponse() {
+    std::string line;
+    if (!readLine(line) || line.compare(0, 5, "HTTP/") != 0) return -1;
+    int status = atoi(line.c_str() + 9);
+    bool http11 = line.compare(0, 8, "HTTP/1.1") == 0;
+
+    long length = -1;
+    bool chunked = false;
+    keepAlive_ = http11;
+    while (readLine(line) && !line.empty()) {
+      std::string h = line;
+      std::transform(h.begin(), h.end(), h.begin(), ::tolower);
+      if (h.compare(0, 15, "content-length:") == 0) length = atol(h.c_str() + 15);
+      else if (h.compare(0, 18, "transfer-encoding:") == 0 && h.find("chunked") != std::string::npos) chunked = true;
+      else if (h.compare(0, 11, "connection:") == 0) keepAlive_ = h.find("close") == std::string::npos;
+      else if (h.compare(0, 9, "location:") == 0 && reply_) {
+        size_t at = line.find_first_not_of(' ', 9);
+        reply_->location = at == std::string::npos ? "" : line.substr(at);
+      }
+    }
+    if (!line.empty()) return -1;
+
+    if (chunked) {
+      for (;;) {
+        if (!readLine(line)) return -1;
+        size_t n = strtoul(line.c_str(), NULL, 16);
+        if (!fill(n + 2)) return -1;
+        take(n);
+        buf_.erase(0, 2);
+        if (n == 0) break;
+      }
+    } else if (length >= 0) {
+      if (!fill((size_t)length)) return -1;
+      take((size_t)length);
+    } else {
+      // no length: body ends when the server closes
+      while (fill(buf_.size() + 1)) {}
+      take(buf_.size());
+      keepAlive_ = false;
+    }
+    return status;
+  }
+
+  sockaddr_in addr_;
+  int timeoutMs_;
+  int fd_ = -1;
+  bool keepAlive_ = true;
+  bool timedOut_ = false;
+  bool gotBytes_ = false;
+  Reply* reply_ = nullptr;
+  std::string buf_;
+};
+
+// ==============================================================
+//                    RESULTS
+// ==============================================================
+struct KindStats {
+  std::vector<double> latMs;
+  long errors = 0;
+  long timeouts = 0;
+  long non2xx = 0;
+
+  long requests() const { return (long)latMs.size() + errors + timeouts; }
+  void add(const KindStats& o) {
+    latMs.insert(latMs.end(), o.latMs.begin(), o.latMs.end());
+    errors += o.errors;
+    timeouts += o.timeouts;
+    non2xx += o.non2xx;
+  }
+};
+typedef std::map<std::string, KindStats> StatsMap;
+
+// One timed GET into the stats of its kind
+int timedGet(HttpConn& conn, const std::string& host, const std::string& path, KindStats& k, Reply* reply = nullptr) {
+  auto t0 = Clock::now();
+  int status = conn.get(host, path, reply);
+  double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+  if (status == HTTP_TIMEOUT) k.timeouts++;
+  else if (status < 0) k.errors++;
+  else {
+    if (status < 200 || status >= 400) k.non2xx++;
+    k.latMs.push_back(ms);
+  }
+  return status;
+}
+
+double percentile(std::vector<double>& v, double p) {
+  if (v.empty()) return 0;
+  size_t k = (size_t)(p / 100.0 * (v.size() - 1) + 0.5);
+  std::nth_element(v.begin(), v.begin() + k, v.end());
+  return v[k];
+}
+
+// The numbers of one table row
+struct Row {
+  std::string kind;
+  long requests = 0;
+  double rps = 0, p50 = 0, p90 = 0, p99 = 0, max = 0;
+  long errors = 0, timeouts = 0, non2xx = 0;
+  double failPct() const { return requests ? 100.0 * (errors + timeouts) / requests : 0; }
+};
+
+Row makeRow(const std::string& kind, KindStats& k, double seconds) {
+  Row r;
+  r.kind = kind;
+  r.requests = k.requests();
+  r.rps = k.latMs.size() / seconds;
+  r.p50 = percentile(k.latMs, 50);
+  r.p90 = percentile(k.latMs, 90);
+  r.p99 = percentile(k.latMs, 99);
+  r.max = k.latMs.empty() ? 0 : *std::max_element(k.latMs.begin(), k.latMs.end());
+  r.errors = k.errors;
+  r.timeouts = k.timeouts;
+  r.non2xx = k.non2xx;
+  return r;
+}
+
+void printRowHeader() {
+  printf("%-10s %9s %8s %8s %8s %8s %8s %7s %8s %7s\n", "kind", "requests", "req/s", "p50 ms", "p90 ms", "p99 ms",
+         "max ms", "errors", "timeouts", "non2xx");
+}
+
+void printRow(const Row& r) {
+  printf("%-10s %9ld %8.1f %8.1f %8.1f %8.1f %8.1f %7ld %8ld %7ld\n", r.kind.c_str(), r.requests, r.rps, r.p50, r.p90,
+         r.p99, r.max, r.errors, r.timeouts, r.non2xx);
+}
+
+// ==============================================================
+//                    STEPS (BACK TO BACK GETS)
+// ==============================================================
+KindStats runStep(const Options& opt, const sockaddr_in& addr, int clients) {
+  std::vector<KindStats> per(clients);
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> threads;
+  for (int c = 0; c < clients; c++) {
+    threads.emplace_back([&, c]() {
+      HttpConn conn(addr, opt.timeoutMs);
+      while (!stop.load(std::memory_order_relaxed)) {
+        if (timedGet(conn, opt.host, opt.path, per[c]) < 0) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(50)); // don't spin on a dead server
+        }
+      }
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::seconds(opt.seconds));
+  stop = true;
+  for (auto& t : threads) t.join();
+
+  KindStats all;
+  for (auto& r : per) all.add(r);
+  return all;
+}
+
+void runSteps(const Options& opt, const sockaddr_in& addr) {
+  printf("target http://%s:%d%s, %d s per step\n", opt.host.c_str(), opt.port, opt.path.c_str(), opt.seconds);
+  printf("%8s %10s %9s %9s %9s %9s %8s %8s %8s\n", "clients", "requests", "req/s", "p50 ms", "p90 ms", "p99 ms",
+         "errors", "timeouts", "non2xx");
+  for (int clients : opt.clients) {
+    KindStats k = runStep(opt, addr, clients);
+    Row r = makeRow("", k, opt.seconds);
+    printf("%8d %10ld %9.1f %9.1f %9.1f %9.1f %8ld %8ld %8ld\n", clients, r.requests, r.rps, r.p50, r.p90, r.p99,
+           r.errors, r.timeouts, r.non2xx);
+    fflush(stdout);
+  }
+}
+
+// ==============================================================
+//                    SCENARIO FILE
+// ==============================================================
+struct Action {
+  std::string kind;                // poll / press / post
+  std::vector<std::string> paths;  // one picked at random per request
+  int everyMs;                     // poll: after the reply, else mean gap
+};
+
+struct OneShot {
+  double atS;
+  std::string path;
+};
+
+struct Scenario {
+  std::string name = "unnamed";
+  int clients = 10;
+  int seconds = 60;
+  unsigned seed = 1;
+  int timeoutMs = 5000;
+  int idleS = 0;
+  std::vector<Action> actions;
+  std::vector<OneShot> shots;
+};
+
+static void scenarioError(const std::string& file, int line, const char* what) {
+  fprintf(stderr, "%s:%d: %s\n", file.c_str(), line, what);
+  exit(2);
+}
+
+Scenario loadScenario(const std::string& file) {
+  FILE* f = fopen(file.c_str(), "r");
+  if (!f) {
+    fprintf(stderr, "cannot open %s\n", file.c_str());
+    exit(2);
+  }
+  Scenario sc;
+  char text[512];
+  int lineNo = 0;
+  while (fgets(text, sizeof(text), f)) {
+    lineNo++;
+    char* hash = strchr(text, '#');
+    if (hash) *hash = 0;
+    char key[32], a[400], b[32];
+    int n = sscanf(text, "%31s %399s %31s", key, a, b);
+    if (n <= 0) continue;
+    std::string k = key;
+    if (n < 2) scenarioError(file, lineNo, "value missing");
+    if (k == "name") sc.name = a;
+    else if (k == "clients") sc.clients = atoi(a);
+    else if (k == "seconds") sc.seconds = atoi(a);
+    else if (k == "seed") sc.seed = (unsigned)atoi(a);
+    else if (k == "timeout-ms") sc.timeoutMs = atoi(a);
+    else if (k == "idle") sc.idleS = atoi(a);
+    else if (k == "poll" || k == "press" || k == "post") {
+      if (n < 3 || atoi(b) <= 0) scenarioError(file, lineNo, "expected: <kind> <path>[,<path>..] <ms>");
+      Action act = { k, {}, atoi(b) };
+      for (const char* p = a; *p;) {
+        const char* comma = strchr(p, ',');
+        size_t len = comma ? (size_t)(comma - p) : strlen(p);
+        if (len) act.paths.push_back(std::string(p, len));
+        p += len + (comma ? 1 : 0);
+      }
+      if (act.paths.empty()) scenarioError(file, lineNo, "no path");
+      sc.actions.push_back(act);
+    } else if (k == "at") {
+      if (n < 3) scenarioError(file, lineNo, "expected: at <second> <path>");
+      sc.shots.push_back({ atof(a), b });
+    } else {
+      scenarioError(file, lineNo, "unknown setting");
+    }
+  }
+  fclose(f);
+  if (sc.clients < 1 || sc.seconds < 1 || sc.timeoutMs < 1 || sc.idleS < 0) {
+    scenarioError(file, lineNo, "clients, seconds and timeout-ms must be > 0");
+  }
+  if (sc.actions.empty()) scenarioError(file, lineNo, "no poll / press / post line");
+  std::sort(sc.shots.begin(), sc.shots.end(), [](const OneShot& x, const OneShot& y) { return x.atS < y.atS; });
+  return sc;
+}
+
+// ==============================================================
+//                    SIMULATED PHONES
+// ==============================================================
+void runPhone(const Scenario& sc, const Options& opt, const sockaddr_in& addr, int c, Clock::time_point start,
+              Clock::time_point end, StatsMap& stats) {
+  std::mt19937 rng(sc.seed * 1000003u + (unsigned)c);
+  HttpConn conn(addr, sc.timeoutMs);
+  auto ms = [](double v) { return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(v)); };
+  auto gap = [&](const Action& a) { return ms(std::exponential_distribution<double>(1.0 / a.everyMs)(rng)); };
+
+  // phones don't all load the page in the same millisecond
+  std::vector<Clock::time_point> next;
+  for (const Action& a : sc.actions) {
+    next.push_back(start + (a.kind == "poll" ? ms(std::uniform_real_distribution<double>(0, a.everyMs)(rng)) : gap(a)));
+  }
+  Reply reply;
+  for (;;) {
+    size_t i = std::min_element(next.begin(), next.end()) - next.begin();
+    if (next[i] >= end) return;
+    std::this_thread::sleep_until(next[i]);
+    const Action& a = sc.actions[i];
+    const std::string& path = a.paths[rng() % a.paths.size()];
+    int status = timedGet(conn, opt.host, path, stats[a.kind], &reply);
+    if (a.kind == "poll") next[i] = Clock::now() + ms(a.everyMs);
+    else next[i] += gap(a);
+    if (status == 303 && !reply.location.empty() && Clock::now() < end) {
+      std::string to = reply.location;
+      timedGet(conn, opt.host, to, stats["redirect"]);
+      // the page was loaded again: its refresh starts over
+      for (size_t j = 0; j < sc.actions.size(); j++) {
+        if (sc.actions[j].kind == "poll") next[j] = Clock::now() + ms(sc.actions[j].everyMs);
+      }
+    }
+  }
+}
+
+// ==============================================================
+//                    UNIT SIDE (/api/perf, /api/heap)
+// ==============================================================
+static const char* const UNIT_FIELDS[] = { "loopAvgUs", "loopMaxUs", "tickAvgUs", "tickMaxUs", "inputAvgUs",
+                                           "inputMaxUs", "free", "minFree" };
+#define UNIT_FIELD_COUNT (sizeof(UNIT_FIELDS) / sizeof(UNIT_FIELDS[0]))
+
+struct UnitSample {
+  bool ok = false;
+  double loopsPerS = -1;
+  double v[UNIT_FIELD_COUNT];
+};
+
+// "key":number in a flat JSON object, -1 if it is not there
+static double jsonNumber(const std::string& body, const char* key) {
+  std::string k = std::string("\"") + key + "\":";
+  size_t at = body.find(k);
+  return at == std::string::npos ? -1 : atof(body.c_str() + at + k.size());
+}
+
+// Counters since the last reset (and reset them): seconds = since then
+UnitSample readUnit(HttpConn& conn, const std::string& host, double seconds) {
+  UnitSample s;
+  for (double& x : s.v) x = -1;
+  Reply perf, heap;
+  if (conn.get(host, "/api/perf?reset=1", &perf) != 200) return s;
+  s.ok = true;
+  double loops = jsonNumber(perf.body, "loops");
+  if (loops >= 0 && seconds > 0) s.loopsPerS = loops / seconds;
+  if (conn.get(host, "/api/heap", &heap) != 200) heap.body.clear();
+  for (size_t i = 0; i < UNIT_FIELD_COUNT; i++) {
+    s.v[i] = jsonNumber(i < 6 ? perf.body : heap.body, UNIT_FIELDS[i]);
+  }
+  return s;
+}
+
+void printUnit(const UnitSample& idle, const UnitSample& load) {
+  if (!load.ok) {
+    printf("unit: no /api/perf reply\n");
+    return;
+  }
+  auto cell = [](const UnitSample& s, double v) {
+    static char out[4][16];
+    static int at = 0;
+    char* c = out[at++ % 4];
+    if (!s.ok || v < 0) strcpy(c, "-");
+    else snprintf(c, 16, "%.0f", v);
+    return (const char*)c;
+  };
+  printf("%-12s %10s %10s\n", "unit", "idle", "load");
+  printf("%-12s %10s %10s\n", "loops/s", cell(idle, idle.loopsPerS), cell(load, load.loopsPerS));
+  for (size_t i = 0; i < UNIT_FIELD_COUNT; i++) {
+    printf("%-12s %10s %10s\n", UNIT_FIELDS[i], cell(idle, idle.v[i]), cell(load, load.v[i]));
+  }
+}
+
+// ==============================================================
+//                    REPORT / BASELINE
+// ==============================================================
+// kind,requests,...   rows, an empty line, then unit,idle,load rows
+bool writeReport(const std::string& path, const Scenario& sc, const std::vector<Row>& rows, const UnitSample& idle,
+                 const UnitSample& load) {
+  FILE* f = fopen(path.c_str(), "w");
+  if (!f) return false;
+  fprintf(f, "# loadgen scenario %s, %d clients, %d s, seed %u\n", sc.name.c_str(), sc.clients, sc.seconds, sc.seed);
+  fprintf(f, "kind,requests,rps,p50_ms,p90_ms,p99_ms,max_ms,errors,timeouts,non2xx\n");
+  for (const Row& r : rows) {
+    fprintf(f, "%s,%ld,%.2f,%.2f,%.2f,%.2f,%.2f,%ld,%ld,%ld\n", r.kind.c_str(), r.requests, r.rps, r.p50, r.p90,
+            r.p99, r.max, r.errors, r.timeouts, r.non2xx);
+  }
+  fprintf(f, "\nunit,idle,load\n");
+  fprintf(f, "loopsPerS,%.1f,%.1f\n", idle.loopsPerS, load.loopsPerS);
+  for (size_t i = 0; i < UNIT_FIELD_COUNT; i++) fprintf(f, "%s,%.0f,%.0f\n", UNIT_FIELDS[i], idle.v[i], load.v[i]);
+  fclose(f);
+  return true;
+}
+
+struct Report {
+  std::vector<Row> rows;
+  std::map<std::string, double> unitLoad;
+};
+
+bool readReport(const std::string& path, Report& out) {
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) return false;
+  char line[256];
+  bool unit = false;
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#' || strncmp(line, "kind,", 5) == 0) continue;
+    if (line[0] == '\n' || strncmp(line, "unit,", 5) == 0) {
+      unit = true;
+      continue;
+    }
+    char name[32];
+    if (unit) {
+      double idle, load;
+      if (sscanf(line, "%31[^,],%lf,%lf", name, &idle, &load) == 3) out.unitLoad[name] = load;
+      continue;
+    }
+    Row r;
+    if (sscanf(line, "%31[^,],%ld,%lf,%lf,%lf,%lf,%lf,%ld,%ld,%ld", name, &r.requests, &r.rps, &r.p50, &r.p90, &r.p99,
+               &r.max, &r.errors, &r.timeouts, &r.non2xx) == 10) {
+      r.kind = name;
+      out.rows.push_back(r);
+    }
+  }
+  fclose(f);
+  return !out.rows.empty();
+}
+
+// Small absolute changes are noise (one slow Wi-Fi frame), not a regression
+#define REGRESS_MIN_MS 5.0
+#define REGRESS_MIN_US 100.0
+#define REGRESS_FAIL_PCT 1.0   // error + timeout rate, percentage points
+
+long compareBaseline(const Options& opt, const std::vector<Row>& rows, const UnitSample& load) {
+  Report old;
+  if (!readReport(opt.baseline, old)) {
+    printf("FAIL cannot read baseline %s\n", opt.baseline.c_str());
+    return 1;
+  }
+  long failures = 0;
+  double allow = 1 + opt.maxRegressPct / 100;
+  printf("vs %s:\n", opt.baseline.c_str());
+  for (const Row& r : rows) {
+    auto it = std::find_if(old.rows.begin(), old.rows.end(), [&](const Row& o) { return o.kind == r.kind; });
+    if (it == old.rows.end()) continue;
+    bool slower = r.p99 > it->p99 * allow && r.p99 - it->p99 > REGRESS_MIN_MS;
+    bool failing = r.failPct() > it->failPct() + REGRESS_FAIL_PCT;
+    printf("  %-10s p99 %7.1f -> %7.1f ms, req/s %7.1f -> %7.1f, failed %5.1f%% -> %5.1f%%%s\n", r.kind.c_str(),
+           it->p99, r.p99, it->rps, r.rps, it->failPct(), r.failPct(), slower || failing ? "  <- worse" : "");
+    failures += slower + failing;
+  }
+  // (the stand-in's loop numbers are host scheduling noise)
+  for (size_t i = 0; i < UNIT_FIELD_COUNT && !opt.sim; i++) {
+    std::string name = UNIT_FIELDS[i];
+    if (name != "loopAvgUs" && name != "loopMaxUs") continue;
+    auto it = old.unitLoad.find(name);
+    if (it == old.unitLoad.end() || it->second < 0 || load.v[i] < 0) continue;
+    bool worse = load.v[i] > it->second * allow && load.v[i] - it->second > REGRESS_MIN_US;
+    printf("  %-10s under load %7.0f -> %7.0f us%s\n", name.c_str(), it->second, load.v[i], worse ? "  <- worse" : "");
+    failures += worse;
+  }
+  return failures;
+}
+
+// ==============================================================
+//                    SCENARIO RUN
+// ==============================================================
+long runScenario(const Options& opt, const sockaddr_in& addr) {
+  Scenario sc = loadScenario(opt.scenario);
+  printf("scenario %s: %d phones, %d s (+%d s idle), seed %u, http://%s:%d\n", sc.name.c_str(), sc.clients,
+         sc.seconds, sc.idleS, sc.seed, opt.host.c_str(), opt.port);
+  fflush(stdout);
+
+  // unit at rest first
+  HttpConn monitor(addr, sc.timeoutMs);
+  UnitSample idle, load;
+  readUnit(monitor, opt.host, 0);
+  if (sc.idleS > 0) {
+    std::this_thread::sleep_for(std::chrono::seconds(sc.idleS));
+    idle = readUnit(monitor, opt.host, sc.idleS);
+  }
+
+  auto start = Clock::now() + std::chrono::milliseconds(100);
+  auto end = start + std::chrono::seconds(sc.seconds);
+  std::vector<StatsMap> per(sc.clients);
+  std::vector<std::thread> threads;
+  for (int c = 0; c < sc.clients; c++) {
+    threads.emplace_back([&, c]() { runPhone(sc, opt, addr, c, start, end, per[c]); });
+  }
+  StatsMap mine;
+  for (const OneShot& s : sc.shots) {
+    auto at = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(s.atS));
+    if (at >= end) break;
+    std::this_thread::sleep_until(at);
+    timedGet(monitor, opt.host, s.path, mine["at"]);
+  }
+  for (auto& t : threads) t.join();
+  load = readUnit(monitor, opt.host, std::chrono::duration<double>(Clock::now() - start).count());
+
+  StatsMap all = mine;
+  KindStats total;
+  for (StatsMap& m : per) {
+    for (auto& kv : m) all[kv.first].add(kv.second);
+  }
+  std::vector<Row> rows;
+  for (auto& kv : all) {
+    total.add(kv.second);
+    rows.push_back(makeRow(kv.first, kv.second, sc.seconds));
+  }
+  rows.push_back(makeRow("all", total, sc.seconds));
+
+  printRowHeader();
+  for (const Row& r : rows) printRow(r);
+  printUnit(idle, load);
+
+  long failures = 0;
+  if (!opt.report.empty() && !writeReport(opt.report, sc, rows, idle, load)) {
+    printf("FAIL cannot write %s\n", opt.report.c_str());
+    failures++;
+  }
+  if (!opt.baseline.empty()) failures += compareBaseline(opt, rows, load);
+  if (total.latMs.empty()) {
+    printf("FAIL no request was answered\n");
+    failures++;
+  }
+  return failures;
+}
+
+// ==============================================================
+//                    STAND-IN FIRMWARE (--sim)
+// ==============================================================
+// Shaped like HimBuddy.c's esp_http_server: one task serves every
+// socket in turn, WEB_MAX_SOCKETS of them, the least recently used one
+// is closed for a new one (lru_purge_enable), pages go out in ChunkOut
+// sized chunks. A "loop" thread stands in for /api/perf.
+#define SIM_MAX_SOCKETS 12     // WEB_MAX_SOCKETS
+#define SIM_CHUNK 512          // ChunkOut buffer
+#define SIM_LOOP_MS 10
+#define SIM_ALARM_S 30         // like the siren of the magic "alert" message
+
+class SimServer {
+public:
+  int start(const Options& opt) {
+    chunkUs_ = opt.simChunkUs;
+    pageBytes_ = opt.simPageBytes;
+    lfd_ = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(lfd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in a = {};
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(a);
+    if (lfd_ < 0 || bind(lfd_, (sockaddr*)&a, sizeof(a)) != 0 || listen(lfd_, 5) != 0 ||
+        getsockname(lfd_, (sockaddr*)&a, &len) != 0) {
+      return -1;
+    }
+    std::thread([this]() { serve(); }).detach();
+    std::thread([this]() { loop(); }).detach();
+    return ntohs(a.sin_port);
+  }
+
+private:
+  struct Sock {
+    int fd;
+    Clock::time_point used;
+    std::string in;
+  };
+
+  void loop() {
+    auto next = Clock::now();
+    for (;;) {
+      next += std::chrono::milliseconds(SIM_LOOP_MS);
+      std::this_thread::sleep_until(next);
+      // the pass starts late when the host is busy with the load
+      auto late = Clock::now() - next;
+      uint32_t us = (uint32_t)std::max<long>(0, std::chrono::duration_cast<std::chrono::microseconds>(late).count());
+      std::lock_guard<std::mutex> lock(perfMutex_);
+      loops_++;
+      loopUsSum_ += us;
+      loopUsMax_ = std::max(loopUsMax_, us);
+    }
+  }
+
+  void serve() {
+    std::vector<Sock> socks;
+    for (;;) {
+      std::vector<pollfd> p(1, pollfd{ lfd_, POLLIN, 0 });
+      for (const Sock& s : socks) p.push_back(pollfd{ s.fd, POLLIN, 0 });
+      if (poll(p.data(), p.size(), 1000) <= 0) continue;
+      for (size_t i = p.size() - 1; i >= 1; i--) {
+        if (!(p[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+        Sock& s = socks[i - 1];
+        char buf[2048];
+        ssize_t k = recv(s.fd, buf, sizeof(buf), 0);
+        if (k <= 0 || !handle(s, buf, (size_t)k)) {
+          close(s.fd);
+          socks.erase(socks.begin() + (i - 1));
+        }
+      }
+      if (p[0].revents & POLLIN) {
+        int fd = accept(lfd_, nullptr, nullptr);
+        if (fd < 0) continue;
+        if (socks.size() >= SIM_MAX_SOCKETS) {
+          auto lru = std::min_element(socks.begin(), socks.end(),
+                                      [](const Sock& x, const Sock& y) { return x.used < y.used; });
+          close(lru->fd);
+          socks.erase(lru);
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        socks.push_back({ fd, Clock::now(), "" });
+      }
+    }
+  }
+
+  // false: close the socket
+  bool handle(Sock& s, const char* data, size_t n) {
+    s.used = Clock::now();
+    s.in.append(data, n);
+    size_t end;
+    while ((end = s.in.find("\r\n\r\n")) != std::string::npos) {
+      std::string head = s.in.substr(0, end);
+      s.in.erase(0, end + 4);
+      char method[8] = "", target[256] = "";
+      sscanf(head.c_str(), "%7s %255s", method, target);
+      std::string path = target, query;
+      size_t q = path.find('?');
+      if (q != std::string::npos) {
+        query = path.substr(q + 1);
+        path.resize(q);
+      }
+      if (!route(s.fd, path, query)) return false;
+      if (head.find("Connection: close") != std::string::npos) return false;
+    }
+    return true;
+  }
+
+  bool sendAll(int fd, const std::string& out) {
+    return send(fd, out.data(), out.size(), MSG_NOSIGNAL) == (ssize_t)out.size();
+  }
+
+  bool reply(int fd, const char* status, const char* type, const std::string& body, const char* extra = "") {
+    char head[256];
+    snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n%s\r\n", status, type,
+             body.size(), extra);
+    return sendAll(fd, head + body);
+  }
+
+  bool route(int fd, const std::string& path, const std::string& query) {
+    bool alarm = Clock::now() < alarmUntil_;
+    if (path == "/") {
+      // renderRoot(): chunked, SIM_CHUNK bytes per send
+      if (!sendAll(fd, "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nTransfer-Encoding: chunked\r\n\r\n")) return false;
+      std::string page = "<html><head><noscript><meta http-equiv='refresh' content='2'></noscript></head><body>";
+      page += alarm ? "<h1>DANGER</h1>" : "<h1>HIMBUDDY CONTROL</h1>";
+      page.resize(std::max<size_t>(page.size(), (size_t)pageBytes_ - 14), ' ');
+      page += "</body></html>";
+      for (size_t at = 0; at < page.size(); at += SIM_CHUNK) {
+        std::this_thread::sleep_for(std::chrono::microseconds(chunkUs_));
+        std::string part = page.substr(at, SIM_CHUNK);
+        char size[16];
+        snprintf(size, sizeof(size), "%zx\r\n", part.size());
+        if (!sendAll(fd, size + part + "\r\n")) return false;
+      }
+      return sendAll(fd, "0\r\n\r\n");
+    }
+    if (path == "/msg" || path == "/up" || path == "/down" || path == "/select" || path == "/exit" || path == "/dev" ||
+        path == "/test_buzz") {
+      if (path == "/msg" && query.find("t=alert") != std::string::npos) {
+        alarmUntil_ = Clock::now() + std::chrono::seconds(SIM_ALARM_S);
+      }
+      return reply(fd, "303 See Other", "text/html", "", "Location: /\r\n");
+    }
+    if (path == "/api/perf") {
+      std::lock_guard<std::mutex> lock(perfMutex_);
+      char out[160];
+      snprintf(out, sizeof(out), "{\"loops\":%lu,\"loopAvgUs\":%lu,\"loopMaxUs\":%lu}", (unsigned long)loops_,
+               (unsigned long)(loops_ ? loopUsSum_ / loops_ : 0), (unsigned long)loopUsMax_);
+      if (query.find("reset=1") != std::string::npos) loops_ = loopUsSum_ = loopUsMax_ = 0;
+      return reply(fd, "200 OK", "application/json", out);
+    }
+    return reply(fd, "404 Not Found", "text/plain", "not found");
+  }
+
+  int lfd_ = -1;
+  int chunkUs_ = 0, pageBytes_ = 0;
+  Clock::time_point alarmUntil_;
+  std::mutex perfMutex_;
+  uint64_t loops_ = 0, loopUsSum_ = 0;
+  uint32_t loopUsMax_ = 0;
+};
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+void usage() {
+  fprintf(stderr,
+          "usage: loadgen <host> [--port 80] [--clients 10,20] [--seconds 10] [--path /] [--timeout-ms 5000]\n"
+          "       loadgen <host> --scenario FILE [--port 80] [--report out.csv] [--baseline old.csv]\n"
+          "               [--max-regress 20]\n"
+          "       loadgen --sim [--sim-chunk-us 400] [--sim-page 4500] ... (same as above, no host)\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  bool hostGiven = false;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a.compare(0, 2, "--") != 0) {
+      if (hostGiven) usage();
+      opt.host = a;
+      hostGiven = true;
+      continue;
+    }
+    if (a == "--sim") {
+      opt.sim = true;
+      continue;
+    }
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--port") opt.port = atoi(v);
+    else if (a == "--seconds") opt.seconds = atoi(v);
+    else if (a == "--path") opt.path = v;
+    else if (a == "--timeout-ms") opt.timeoutMs = atoi(v);
+    else if (a == "--scenario") opt.scenario = v;
+    else if (a == "--report") opt.report = v;
+    else if (a == "--baseline") opt.baseline = v;
+    else if (a == "--max-regress") opt.maxRegressPct = atof(v);
+    else if (a == "--sim-chunk-us") opt.simChunkUs = atoi(v);
+    else if (a == "--sim-page") opt.simPageBytes = atoi(v);
+    else if (a == "--clients") {
+      opt.clients.clear();
+      for (const char* p = v; *p; ) {
+        opt.clients.push_back(atoi(p));
+        while (*p && *p != ',') p++;
+        if (*p == ',') p++;
+      }
+    } else usage();
+  }
+  if (hostGiven == opt.sim) usage();
+  if (opt.scenario.empty() && (!opt.report.empty() || !opt.baseline.empty())) usage();
+
+  if (opt.sim) {
+    static SimServer sim;
+    opt.port = sim.start(opt);
+    if (opt.port < 0) {
+      fprintf(stderr, "cannot start the stand-in server\n");
+      return 1;
+    }
+    opt.host = "127.0.0.1";
+  }
+
+  addrinfo hints = {}, *res = nullptr;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(opt.host.c_str(), nullptr, &hints, &res) != 0 || !res) {
+    fprintf(stderr, "cannot resolve %s\n", opt.host.c_str());
+    return 1;
+  }
+  sockaddr_in addr = *(sockaddr_in*)res->ai_addr;
+  addr.sin_port = htons((uint16_t)opt.port);
+  freeaddrinfo(res);
+
+  if (opt.scenario.empty()) {
+    runSteps(opt, addr);
+    return 0;
+  }
+  long failures = runScenario(opt, addr);
+  printf("%s: %ld failed checks\n", failures ? "FAIL" : "OK", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,331 @@
+/****************************************************************
+ * HIMBUDDY - ALERT MESH SIMULATOR (Linux)
+ *
+ * Runs N nodes of src/alert_mesh.h as threads. They talk through a
+ * UDP multicast transport on the loopback interface (the Linux
+ * stand-in for ESP-NOW). Nodes stand in a line down the slope; a node
+ * only hears neighbours within --range, and every link drops
+ * --loss of the frames. Node 0 raises an alert, and we time how
+ * long it takes for every other node to hear it.
+ *
+ * Before that, without sockets: recorded frames played back to a node
+ * (after 100 newer ones, and from before the origin rebooted) must be
+ * dropped, and the rebooted origin's new frames must get through.
+ *
+ * Build : g++ -O2 -std=c++17 -pthread -I. tools/mesh_sim.cpp -o mesh_sim
+ * Run   : ./mesh_sim                       (20 nodes, 200 alerts)
+ *         ./mesh_sim --nodes 20 --range 2 --loss 0.2 --alerts 500
+ ****************************************************************/
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/alert_mesh.h"
+
+using Clock = std::chrono::steady_clock;
+
+static const char* GROUP = "239.255.72.66";
+static uint16_t PORT = 47266;
+static const uint8_t KEY[16] = { 'h', 'i', 'm', 'b', 'u', 'd', 'd', 'y', '-', 's', 'i', 'm', '-', 'k', 'e', 'y' };
+
+struct SimConfig {
+  int nodes = 20;
+  int range = 2;       // hears nodes i-range .. i+range
+  double loss = 0.1;   // drop probability per frame per link
+  int alerts = 200;
+  int gapMs = 30;      // quiet time between alerts
+  int timeoutMs = 500; // give up on a node after this
+};
+
+static MeshAddr addrOf(int node) {
+  MeshAddr a = { { 0x02, 'H', 'B', 0, (uint8_t)(node >> 8), (uint8_t)node } };
+  return a;
+}
+
+static int nodeOf(const MeshAddr& a) { return (a.b[4] << 8) | a.b[5]; }
+
+// ==============================================================
+//          UDP MULTICAST TRANSPORT (ESP-NOW STAND-IN)
+// ==============================================================
+// Datagram: [src addr 6][dst addr 6, FF.. = broadcast][frame]
+class UdpMulticastTransport : public MeshTransport {
+public:
+  bool open(const MeshAddr& self) {
+    me = self;
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return false;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    sockaddr_in bindAddr = {};
+    bindAddr.sin_family = AF_INET;
+    bindAddr.sin_port = htons(PORT);
+    bindAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (sockaddr*)&bindAddr, sizeof(bindAddr)) != 0) return false;
+
+    ip_mreq mreq = {};
+    mreq.imr_multiaddr.s_addr = inet_addr(GROUP);
+    mreq.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+    if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0) return false;
+    in_addr ifAddr;
+    ifAddr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &ifAddr, sizeof(ifAddr));
+    unsigned char loop = 1;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+    group.sin_family = AF_INET;
+    group.sin_port = htons(PORT);
+    group.sin_addr.s_addr = inet_addr(GROUP);
+    return true;
+  }
+
+  ~UdpMulticastTransport() { if (fd >= 0) close(fd); }
+
+  bool broadcast(const uint8_t* data, size_t len) override {
+    MeshAddr all = { { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF } };
+    return sendTo(all, data, len);
+  }
+
+  bool unicast(const MeshAddr& to, const uint8_t* data, size_t len) override { return sendTo(to, data, len); }
+
+  // Waits up to timeoutMs for one datagram meant for us
+  bool receive(MeshAddr& from, MeshAddr& to, uint8_t* frame, size_t& len, int timeoutMs) {
+    pollfd p = { fd, POLLIN, 0 };
+    if (::poll(&p, 1, timeoutMs) <= 0) return false;
+    uint8_t buf[64];
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n < 12) return false;
+    memcpy(from.b, buf, 6);
+    memcpy(to.b, buf + 6, 6);
+    len = (size_t)n - 12;
+    memcpy(frame, buf + 12, len);
+    return true;
+  }
+
+  int fd = -1;
+
+private:
+  bool sendTo(const MeshAddr& to, const uint8_t* data, size_t len) {
+    uint8_t buf[64];
+    if (len + 12 > sizeof(buf)) return false;
+    memcpy(buf, me.b, 6);
+    memcpy(buf + 6, to.b, 6);
+    memcpy(buf + 12, data, len);
+    return sendto(fd, buf, len + 12, 0, (sockaddr*)&group, sizeof(group)) == (ssize_t)(len + 12);
+  }
+
+  MeshAddr me;
+  sockaddr_in group = {};
+};
+
+// ==============================================================
+//                    SIMULATED NODE
+// ==============================================================
+struct SimShared {
+  SimConfig cfg;
+  std::atomic<bool> stop{ false };
+  std::atomic<int> originate{ 0 };              // node 0: send alert number N
+  std::atomic<int> currentAlert{ 0 };
+  std::vector<std::atomic<int64_t>> heardAtUs;  // per node, for currentAlert
+  std::vector<std::atomic<int>> hops;
+  Clock::time_point epoch = Clock::now();
+
+  explicit SimShared(const SimConfig& c) : cfg(c), heardAtUs(c.nodes), hops(c.nodes) {}
+  int64_t nowUs() const { return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - epoch).count(); }
+  uint32_t nowMs() const { return (uint32_t)(nowUs() / 1000); }
+};
+
+struct NodeCtx {
+  SimShared* sim;
+  int id;
+};
+
+static void onAlert(const MeshFrame& f, const MeshAddr&, void* ctx) {
+  NodeCtx* n = (NodeCtx*)ctx;
+  if ((int)f.value != n->sim->currentAlert.load()) return; // late copy of an older alert
+  int64_t expect = -1;
+  if (n->sim->heardAtUs[n->id].compare_exchange_strong(expect, n->sim->nowUs())) n->sim->hops[n->id] = f.hops + 1;
+}
+
+static void runNode(SimShared* sim, int id, MeshStats* statsOut) {
+  UdpMulticastTransport radio;
+  if (!radio.open(addrOf(id))) {
+    fprintf(stderr, "node %d: multicast socket failed (%s)\n", id, strerror(errno));
+    sim->stop = true;
+    return;
+  }
+  AlertMesh mesh(radio);
+  NodeCtx ctx = { sim, id };
+  mesh.begin(0x48420000u + (uint32_t)id, KEY, 1);
+  mesh.onAlert(onAlert, &ctx);
+
+  std::mt19937 rng(1234 + id);
+  std::uniform_real_distribution<double> coin(0.0, 1.0);
+  MeshAddr self = addrOf(id);
+  int sent = 0;
+
+  while (!sim->stop) {
+    if (id == 0 && sim->originate.load() > sent) {
+      sent = sim->originate.load();
+      mesh.originate(MESH_ALERT_LANDSLIDE, 3, (int16_t)sent, sim->nowMs());
+    }
+    uint32_t wait = mesh.poll(sim->nowMs());
+    int timeout = (int)std::min<uint32_t>(wait, 2);
+
+    MeshAddr from, to;
+    uint8_t frame[64];
+    size_t len = 0;
+    if (!radio.receive(from, to, frame, len, timeout)) continue;
+    int src = nodeOf(from);
+    if (from == self) continue;
+    bool forAll = to.b[0] == 0xFF;
+    if (!forAll && !(to == self)) continue;
+    int dist = std::abs(src - id);
+    if (dist > sim->cfg.range) continue;          // out of radio range
+    if (coin(rng) < sim->cfg.loss) continue;      // lost on air
+    int8_t rssi = (int8_t)(-50 - 15 * dist);
+    mesh.onReceive(from, rssi, frame, len, sim->nowMs());
+  }
+  *statsOut = mesh.stats;
+}
+
+// ==============================================================
+//                    REPLAY CHECK
+// ==============================================================
+struct Recorder : MeshTransport {
+  std::vector<std::vector<uint8_t>> frames;
+  bool broadcast(const uint8_t* data, size_t len) override {
+    frames.emplace_back(data, data + len);
+    return true;
+  }
+  bool unicast(const MeshAddr&, const uint8_t*, size_t) override { return true; }
+};
+
+static bool checkReplay() {
+  Recorder air, sink;
+  AlertMesh origin(air), node(sink);
+  int heard = 0;
+  node.begin(2, KEY, 1);
+  node.onAlert([](const MeshFrame&, const MeshAddr&, void* ctx) { ++*(int*)ctx; }, &heard);
+  MeshAddr from = addrOf(1);
+  auto deliver = [&](const std::vector<uint8_t>& f) { node.onReceive(from, -60, f.data(), f.size(), 0); };
+
+  origin.begin(1, KEY, 7);
+  for (int i = 0; i < 101; i++) origin.originate(MESH_ALERT_SMOKE, 3, (int16_t)i, 0);
+  std::vector<std::vector<uint8_t>> boot7 = air.frames;
+  for (size_t i = 1; i < boot7.size(); i++) deliver(boot7[i]);  // first one "missed"
+  int fresh = heard;
+  deliver(boot7[1]);    // 99 frames old: far out of the window
+  deliver(boot7[90]);   // in the window, already heard
+  deliver(boot7[0]);    // never heard, but older than the window
+  int replays = heard - fresh;
+
+  air.frames.clear();
+  origin.begin(1, KEY, 8);  // reboot: seq from 0 again
+  for (int i = 0; i < 3; i++) origin.originate(MESH_ALERT_QUAKE, 3, (int16_t)i, 0);
+  for (auto& f : air.frames) deliver(f);
+  int rebooted = heard - fresh;
+  deliver(boot7[100]);  // the newest frame of the old boot
+  replays += heard - fresh - rebooted;
+
+  bool ok = fresh == 100 && replays == 0 && rebooted == 3;
+  printf("replay          : %d of 100 heard, %d replays accepted, %d of 3 after a reboot, %u dropped -> %s\n", fresh,
+         replays, rebooted, node.stats.replayed + node.stats.dup, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+static double pct(std::vector<double> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[(size_t)(p / 100.0 * (v.size() - 1) + 0.5)];
+}
+
+int main(int argc, char** argv) {
+  SimConfig cfg;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string a = argv[i];
+    const char* v = argv[i + 1];
+    if (a == "--nodes") cfg.nodes = atoi(v);
+    else if (a == "--range") cfg.range = atoi(v);
+    else if (a == "--loss") cfg.loss = atof(v);
+    else if (a == "--alerts") cfg.alerts = atoi(v);
+    else if (a == "--port") PORT = (uint16_t)atoi(v);
+    else { fprintf(stderr, "usage: mesh_sim [--nodes 20] [--range 2] [--loss 0.1] [--alerts 200] [--port %u]\n", PORT); return 2; }
+  }
+
+  if (!checkReplay()) return 1;
+
+  SimShared sim(cfg);
+  std::vector<MeshStats> stats(cfg.nodes);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < cfg.nodes; i++) {
+    sim.heardAtUs[i] = -1;
+    threads.emplace_back(runNode, &sim, i, &stats[i]);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200)); // sockets joined
+
+  // Warm-up alert so every node learns its neighbours (link stats)
+  std::vector<double> lastNode, allNodes, hopsLast;
+  long missed = 0;
+  for (int a = 0; a <= cfg.alerts && !sim.stop; a++) {
+    for (int i = 0; i < cfg.nodes; i++) { sim.heardAtUs[i] = -1; sim.hops[i] = 0; }
+    sim.currentAlert = a + 1;
+    int64_t t0 = sim.nowUs();
+    sim.originate = a + 1;
+
+    int64_t deadline = t0 + cfg.timeoutMs * 1000;
+    for (;;) {
+      bool all = true;
+      for (int i = 1; i < cfg.nodes; i++) if (sim.heardAtUs[i] < 0) { all = false; break; }
+      if (all || sim.nowUs() > deadline) break;
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    if (a == 0) continue; // warm-up not counted
+
+    for (int i = 1; i < cfg.nodes; i++) {
+      int64_t t = sim.heardAtUs[i];
+      if (t < 0) { missed++; continue; }
+      allNodes.push_back((t - t0) / 1000.0);
+    }
+    int64_t tl = sim.heardAtUs[cfg.nodes - 1];
+    if (tl >= 0) {
+      lastNode.push_back((tl - t0) / 1000.0);
+      hopsLast.push_back(sim.hops[cfg.nodes - 1]);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(cfg.gapMs));
+  }
+  sim.stop = true;
+  for (auto& t : threads) t.join();
+
+  MeshStats total = {};
+  for (auto& s : stats) {
+    total.rx += s.rx; total.dup += s.dup; total.rejected += s.rejected; total.replayed += s.replayed;
+    total.delivered += s.delivered; total.relayed += s.relayed; total.retries += s.retries;
+  }
+  long expected = (long)cfg.alerts * (cfg.nodes - 1);
+  double avgHops = 0;
+  for (double h : hopsLast) avgHops += h;
+  if (!hopsLast.empty()) avgHops /= hopsLast.size();
+
+  printf("mesh: %d nodes in a line, range %d, loss %.0f%%, %d alerts\n", cfg.nodes, cfg.range, cfg.loss * 100, cfg.alerts);
+  printf("delivery        : %.2f%% (%ld of %ld node-alerts missed)\n",
+         expected ? 100.0 * (expected - missed) / expected : 0.0, missed, expected);
+  printf("any node   (ms) : p50 %.2f  p99 %.2f  max %.2f\n", pct(allNodes, 50), pct(allNodes, 99), pct(allNodes, 100));
+  printf("last node  (ms) : p50 %.2f  p99 %.2f  max %.2f  (avg %.1f hops)\n", pct(lastNode, 50), pct(lastNode, 99), pct(lastNode, 100), avgHops);
+  printf("frames          : rx %u  dup %u  replayed %u  rejected %u  relayed %u  retries %u\n",
+         total.rx, total.dup, total.replayed, total.rejected, total.relayed, total.retries);
+  return missed == 0 ? 0 : 1;
+}
@@ -0,0 +1,238 @@
+/****************************************************************
+ * HIMBUDDY - WEB MESSAGE QUEUE + TEXT STRIP CHECK (runs on a PC)
+ *
+ * Runs src/oled_message.h, the OLED message queue of HimBuddy.c:
+ *   queue  random pushes (priorities, expiries, a full queue) and pops
+ *          against a plain list model: same message out every time,
+ *          same expired / replaced / refused counts
+ *   strip  random texts drawn at 1x and 2x with a made-up font; every
+ *          frame of the scroll is blitted into a 128 x 64 frame buffer
+ *          and compared pixel by pixel with the text drawn directly
+ *   time   ns per render and per frame (blit) against text length: a
+ *          frame must cost the same for 1 character or 63
+ *
+ * Build : g++ -O2 -std=c++17 -I. tools/message_check.cpp -o message_check
+ * Run   : ./message_check
+ *         ./message_check --ops 1000000 --texts 20000 --seed 3
+ ****************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/oled_message.h"
+
+struct Options {
+  long ops = 200000;
+  long texts = 5000;
+  unsigned seed = 1;
+};
+
+#define FB_W 128
+#define FB_PAGES 8
+#define QN 8
+#define QLEN 64
+
+static long failures = 0;
+
+static void fail(const char* what) {
+  if (failures++ < 10) printf("FAIL %s\n", what);
+}
+
+// ==============================================================
+//                    QUEUE
+// ==============================================================
+struct ModelMsg {
+  std::string text;
+  uint8_t priority;
+  uint32_t expires;
+  uint32_t seq;
+};
+
+struct Model {
+  std::vector<ModelMsg> q;
+  uint32_t seq = 0, expired = 0, replaced = 0, refused = 0;
+
+  void dropExpired(uint32_t now) {
+    size_t before = q.size();
+    q.erase(std::remove_if(q.begin(), q.end(), [&](const ModelMsg& m) { return (int32_t)(now - m.expires) >= 0; }),
+            q.end());
+    expired += (uint32_t)(before - q.size());
+  }
+  bool push(const std::string& t, uint8_t p, uint32_t now, uint32_t ttl) {
+    dropExpired(now);
+    if (q.size() == QN) {
+      auto low = std::min_element(q.begin(), q.end(), [](const ModelMsg& a, const ModelMsg& b) {
+        return a.priority != b.priority ? a.priority < b.priority : a.seq < b.seq;
+      });
+      if (low->priority > p) {
+        refused++;
+        return false;
+      }
+      q.erase(low);
+      replaced++;
+    }
+    q.push_back({ t.substr(0, QLEN - 1), p, now + ttl, seq++ });
+    return true;
+  }
+  bool pop(uint32_t now, ModelMsg& out) {
+    dropExpired(now);
+    if (q.empty()) return false;
+    auto best = std::min_element(q.begin(), q.end(), [](const ModelMsg& a, const ModelMsg& b) {
+      return a.priority != b.priority ? a.priority > b.priority : a.seq < b.seq;
+    });
+    out = *best;
+    q.erase(best);
+    return true;
+  }
+};
+
+static void checkQueue(const Options& o, std::mt19937& rng) {
+  static MessageQueue<QN, QLEN> queue;
+  Model model;
+  uint32_t now = 0xFFFF0000u;  // wraps the 32 bit clock on the way
+  long pushes = 0, pops = 0, shown = 0;
+  char text[100];
+  for (long i = 0; i < o.ops; i++) {
+    now += rng() % 3000;
+    if (rng() % 100 < 60) {
+      size_t len = rng() % 90;
+      for (size_t k = 0; k < len; k++) text[k] = (char)('a' + rng() % 26);
+      text[len] = 0;
+      uint8_t p = (uint8_t)(rng() % 4 == 0 ? rng() % 10 : rng() % 2);
+      uint32_t ttl = 1000 + rng() % 60000;
+      bool a = queue.push(text, p, now, ttl), b = model.push(text, p, now, ttl);
+      if (a != b) fail("push accepted / refused differently");
+      pushes++;
+    } else {
+      MessageQueue<QN, QLEN>::Message m;
+      ModelMsg want;
+      bool a = queue.pop(now, m), b = model.pop(now, want);
+      if (a != b) fail("pop found a message / none differently");
+      else if (a && (want.text != m.text || want.priority != m.priority || want.seq != m.seq)) {
+        fail("pop took another message");
+      }
+      pops++;
+      shown += a;
+    }
+    if (queue.size() != model.q.size() || queue.expired() != model.expired || queue.replaced() != model.replaced ||
+        queue.refused() != model.refused) {
+      fail("size or counters differ");
+    }
+  }
+  printf("queue : %ld pushes, %ld pops (%ld shown), %lu expired, %lu replaced, %lu refused\n", pushes, pops, shown,
+         (unsigned long)queue.expired(), (unsigned long)queue.replaced(), (unsigned long)queue.refused());
+}
+
+// ==============================================================
+//                    STRIP
+// ==============================================================
+// made-up 5x7 font: any 7 bit columns, fixed per character
+static void fakeGlyph(char c, uint8_t cols[5]) {
+  uint32_t h = (uint8_t)c * 2654435761u;
+  for (int x = 0; x < 5; x++) cols[x] = (uint8_t)((h >> (x * 5)) & 0x7F);
+}
+
+// pixel (x, y) of the text drawn straight (y from the top of the strip)
+static bool textPixel(const std::string& t, int scale, int x, int y) {
+  int ch = x / (6 * scale), col = (x % (6 * scale)) / scale, row = y / scale;
+  if (ch >= (int)t.size() || col == 5 || row > 7) return false;
+  uint8_t g[5];
+  fakeGlyph(t[ch], g);
+  return (g[col] >> row) & 1;
+}
+
+static void checkStrip(const Options& o, std::mt19937& rng) {
+  static TextStrip strip;
+  static uint8_t fb[FB_PAGES * FB_W];
+  long frames = 0;
+  for (long i = 0; i < o.texts; i++) {
+    std::string t;
+    size_t len = 1 + rng() % 63;
+    for (size_t k = 0; k < len; k++) t += (char)(32 + rng() % 95);
+    int scale = 1 + (int)(rng() % 2);
+    strip.render(t.c_str(), (uint8_t)scale, fakeGlyph);
+    if (strip.width() != len * 6 * scale || strip.pages() != scale) fail("strip size");
+
+    const uint8_t page = 3;
+    uint32_t pass = strip.passMs(FB_W);
+    for (uint32_t ms = 0; ms <= pass + 500; ms += 1 + rng() % 150) {
+      uint16_t x = strip.scrollX(ms, FB_W);
+      if (strip.width() > FB_W && ms >= pass && x != strip.width() - FB_W) fail("scroll does not reach the end");
+      memset(fb, 0xA5, sizeof(fb));
+      strip.blit(fb, FB_W, page, x, FB_W);
+      frames++;
+      for (int sx = 0; sx < FB_W; sx++) {
+        for (int y = 0; y < 8 * scale; y++) {
+          bool got = (fb[(page + y / 8) * FB_W + sx] >> (y % 8)) & 1;
+          if (got != textPixel(t, scale, x + sx, y)) {
+            fail("blitted pixel differs from the text");
+            sx = FB_W;
+            break;
+          }
+        }
+      }
+      if (fb[(page - 1) * FB_W] != 0xA5 || fb[(page + scale) * FB_W] != 0xA5) fail("blit wrote outside its pages");
+    }
+  }
+  printf("strip : %ld texts, %ld frames compared pixel by pixel\n", o.texts, frames);
+}
+
+// ==============================================================
+//                    TIME
+// ==============================================================
+static void timeStrip() {
+  static TextStrip strip;
+  static uint8_t fb[FB_PAGES * FB_W];
+  printf("%6s %12s %12s\n", "chars", "render ns", "frame ns");
+  for (int len : { 1, 10, 21, 42, 63 }) {
+    std::string t(len, 'W');
+    const int N = 2000;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++) strip.render(t.c_str(), 2, fakeGlyph);
+    double renderNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / N;
+
+    const int F = 200000;
+    volatile uint8_t sink = 0;
+    uint32_t pass = strip.passMs(FB_W);
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < F; i++) {
+      strip.blit(fb, FB_W, 3, strip.scrollX((uint32_t)i * 7 % (pass + 1), FB_W), FB_W);
+      sink = sink + fb[3 * FB_W + (i & 127)];
+    }
+    double frameNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / F;
+    printf("%6d %12.0f %12.1f\n", len, renderNs, frameNs);
+  }
+}
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr, "usage: message_check [--ops 200000] [--texts 5000] [--seed 1]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--ops") o.ops = atol(v);
+    else if (a == "--texts") o.texts = atol(v);
+    else if (a == "--seed") o.seed = (unsigned)atoi(v);
+    else usage();
+  }
+  if (o.ops < 1 || o.texts < 1) usage();
+  std::mt19937 rng(o.seed);
+  checkQueue(o, rng);
+  checkStrip(o, rng);
+  timeStrip();
+  printf("%s: %ld failed checks\n", failures ? "FAIL" : "OK", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,276 @@
+/****************************************************************
+ * HIMBUDDY - HOT PATH MICROBENCHMARKS (runs on a PC)
+ *
+ * Times the routines the units run every tick / sample / alert, built
+ * from the same headers as the firmware, with src/bench.h (batches,
+ * median + MAD over 31 samples):
+ *   safety_rules      checkSafetyPriority() decision: HimBuddy.c rules
+ *   rules_100         100 rules, to see what a big rules file costs
+ *   quake_sample      one MPU6050 FIFO sample into the FFT classifier
+ *   landslide_update  one esp32fullcode.c landslide sample
+ *   history_record    one second into the 3-tier history
+ *   iso_time          isoNow() text (src/log_format.h)
+ *   alert_json        sendBluetoothAlert() line
+ *   snapshot_csv      logSensorSnapshot() row
+ * handleRoot() and the TinyGPSPlus feed need the Arduino / IDF
+ * libraries: they are in the on-device suite (BENCH_ON_BOOT in
+ * HimBuddy.c), which prints the same JSON in CPU cycles over serial.
+ *
+ * --json FILE writes the results (one JSON array); --compare FILE
+ * reads an earlier one and flags every routine whose median got more
+ * than --limit % slower (exit code 1), e.g. in CI before flashing.
+ *
+ * Build : g++ -O2 -std=c++17 -I. tools/microbench.cpp -o microbench
+ * Run   : ./microbench --json before.json
+ *         ./microbench --compare before.json --limit 10
+ ****************************************************************/
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/bench.h"
+#include "src/history.h"
+#include "src/landslide.h"
+#include "src/log_format.h"
+#include "src/quake_fft.h"
+#include "src/rules.h"
+
+// Same as DEFAULT_RULES in HimBuddy.c (limits expanded)
+static const char HIMBUDDY_RULES[] =
+  "soil < 1500 and soil > 10 -> FLOOD priority 1\n"
+  "gas > 2500 -> FIRE priority 2\n"
+  "seismic == 1 and pga >= 30 -> EARTHQUAKE priority 3\n";
+static const char* const HIMBUDDY_SIGNALS[] = { "soil", "gas", "temp", "hum", "seismic", "pga" };
+
+struct Options {
+  std::string json, compare, filter;
+  double limitPct = 10;
+  int samples = 31;
+};
+
+static uint64_t nowNs() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ==============================================================
+//                    SUITE
+// ==============================================================
+static std::vector<BenchResult> runSuite(const Options& o) {
+  BenchClock clock = { nowNs, "ns", 2000000 };  // >= 2 ms per batch
+  Bench bench(clock, (uint16_t)o.samples);
+  std::vector<BenchResult> results;
+  auto want = [&](const char* name) { return o.filter.empty() || strstr(name, o.filter.c_str()); };
+  std::mt19937 rng(1);
+  std::normal_distribution<float> noise(0, 1);
+
+  // inputs: precomputed, so the generator is not timed
+  const int N = 4096;
+  std::vector<float> soil(N), gas(N);
+  std::vector<int16_t> ax(N), ay(N), az(N);
+  for (int i = 0; i < N; i++) {
+    soil[i] = 1800 + 200 * noise(rng);
+    gas[i] = 900 + 300 * noise(rng);
+    ax[i] = (int16_t)(20 * noise(rng));
+    ay[i] = (int16_t)(20 * noise(rng));
+    az[i] = (int16_t)(1000 + 20 * noise(rng));
+  }
+  char err[64];
+
+  if (want("safety_rules")) {
+    static RuleEngine engine;
+    if (!engine.compile(HIMBUDDY_RULES, HIMBUDDY_SIGNALS, 6, err, sizeof(err))) { fprintf(stderr, "%s\n", err); exit(1); }
+    uint32_t now = 0, i = 0;
+    results.push_back(bench.run("safety_rules", [&]() {
+      float v[6] = { soil[i % N], gas[i % N], 24.5f, 60, (float)((i >> 6) & 1), 40 };
+      uint8_t fired[8];
+      uint8_t n = engine.evaluate(now += 100, v, fired, sizeof(fired));
+      int16_t top = engine.topHeld();
+      benchKeep(n);
+      benchKeep(top);
+      i++;
+    }));
+  }
+
+  if (want("rules_100")) {
+    static RuleEngine engine;
+    std::string text;
+    char line[128];
+    for (int r = 0; r < 100; r++) {
+      switch (r % 4) {
+        case 0: snprintf(line, sizeof(line), "soil < %d and soil > 10 -> R%d\n", 1000 + r * 10, r); break;
+        case 1: snprintf(line, sizeof(line), "gas > %d for 3s -> R%d priority 2 cooldown 30s\n", 1500 + r * 10, r); break;
+        case 2: snprintf(line, sizeof(line), "temp > 40 or gas_rate > %d/min -> R%d\n", r, r); break;
+        default: snprintf(line, sizeof(line), "not (seismic == 0) and pga >= %d -> R%d priority 1\n", r, r); break;
+      }
+      text += line;
+    }
+    if (!engine.compile(text.c_str(), HIMBUDDY_SIGNALS, 6, err, sizeof(err))) { fprintf(stderr, "%s\n", err); exit(1); }
+    uint32_t now = 0, i = 0;
+    results.push_back(bench.run("rules_100", [&]() {
+      float v[6] = { soil[i % N], gas[i % N], 24.5f, 60, (float)((i >> 6) & 1), 40 };
+      uint8_t fired[RULES_MAX];
+      uint8_t n = engine.evaluate(now += 100, v, fired, sizeof(fired));
+      benchKeep(n);
+      i++;
+    }));
+  }
+
+  if (want("quake_sample")) {
+    static QuakeDetector quake;
+    quake.begin();
+    uint32_t i = 0;
+    results.push_back(bench.run("quake_sample", [&]() {
+      bool done = quake.push(ax[i % N], ay[i % N], az[i % N]);
+      benchKeep(done);
+      i++;
+    }));
+  }
+
+  if (want("landslide_update")) {
+    LandslideDetector slide;
+    slide.begin(LANDSLIDE_CONFIG_DEFAULT, 0);
+    uint32_t now = 0, i = 0;
+    results.push_back(bench.run("landslide_update", [&]() {
+      bool rose = slide.update(now += 5000, soil[i % N] / 40, ax[i % N], ay[i % N], az[i % N], 0);
+      benchKeep(rose);
+      i++;
+    }));
+  }
+
+  if (want("history_record")) {
+    static SensorHistory<4> history;
+    uint32_t sec = 0;
+    results.push_back(bench.run("history_record", [&]() {
+      HistoryPoint<4> p = { { (int16_t)soil[sec % N], (int16_t)gas[sec % N], 245, 600 } };
+      history.record(sec++, p);
+      benchKeep(history);
+    }));
+  }
+
+  char ts[ISO_TIME_LEN];
+  if (want("iso_time")) {
+    int s = 0;
+    results.push_back(bench.run("iso_time", [&]() {
+      formatIsoTime(ts, 2025, 7, 14, 13, (s / 60) % 60, s % 60);
+      benchKeep(ts);
+      s++;
+    }));
+  }
+
+  char out[512];
+  formatIsoTime(ts, 2025, 7, 14, 13, 5, 0);
+  if (want("alert_json")) {
+    int i = 0;
+    results.push_back(bench.run("alert_json", [&]() {
+      int n = formatAlertJson(out, sizeof(out), "MQ2", "Smoke/Gas detected", ts, "t:24.5,h:61.0,mq:412,soil:1830",
+                              24.5f, 61.0f, 24.1f, 58.2f, 812.4f, (int)gas[i % N], (int)soil[i % N], 30.316494,
+                              78.032188);
+      benchKeep(n);
+      i++;
+    }));
+  }
+
+  if (want("snapshot_csv")) {
+    int i = 0;
+    results.push_back(bench.run("snapshot_csv", [&]() {
+      int n = formatSnapshotCsv(out, sizeof(out), ts, 24.5f, 61.0f, 24.1f, 58.2f, 812.4f, (int)gas[i % N],
+                                (int)soil[i % N], 30.316494, 78.032188);
+      benchKeep(n);
+      i++;
+    }));
+  }
+  return results;
+}
+
+// ==============================================================
+//                    COMPARE
+// ==============================================================
+// median of "name" in an earlier --json file (NAN = not there)
+static double oldMedian(const std::string& text, const char* name) {
+  std::string key = std::string("\"name\":\"") + name + "\"";
+  size_t at = text.find(key);
+  if (at == std::string::npos) return NAN;
+  size_t m = text.find("\"median\":", at);
+  size_t end = text.find('}', at);
+  if (m == std::string::npos || m > end) return NAN;
+  return atof(text.c_str() + m + 9);
+}
+
+static std::string readFile(const std::string& path) {
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) { perror(path.c_str()); exit(1); }
+  std::string text;
+  char buf[512];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, n);
+  fclose(f);
+  return text;
+}
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr, "usage: microbench [--json FILE] [--compare FILE] [--limit 10] [--filter NAME] [--samples 31]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--json") o.json = v;
+    else if (a == "--compare") o.compare = v;
+    else if (a == "--filter") o.filter = v;
+    else if (a == "--limit") o.limitPct = atof(v);
+    else if (a == "--samples") o.samples = atoi(v);
+    else usage();
+  }
+
+  std::string before = o.compare.empty() ? "" : readFile(o.compare);
+  std::vector<BenchResult> results = runSuite(o);
+
+  int slower = 0;
+  printf("%-18s %10s %10s %10s %8s %10s", "routine", "median", "p90", "min", "mad", "calls");
+  if (!before.empty()) printf(" %9s", "vs before");
+  printf("\n");
+  for (const BenchResult& r : results) {
+    printf("%-18s %8.1f%-2s %8.1f%-2s %8.1f%-2s %8.1f %10lu", r.name, r.median, r.unit, r.p90, r.unit, r.min, r.unit,
+           r.mad, (unsigned long)r.batch * r.samples);
+    if (!before.empty()) {
+      double old = oldMedian(before, r.name);
+      if (std::isnan(old) || old <= 0) printf(" %9s", "new");
+      else {
+        double pct = 100 * (r.median - old) / old;
+        // a change inside the noise (3 MAD) is not a regression
+        bool worse = pct > o.limitPct && r.median - old > 3 * r.mad;
+        printf(" %+8.1f%%%s", pct, worse ? "  SLOWER" : "");
+        slower += worse;
+      }
+    }
+    printf("\n");
+  }
+
+  if (!o.json.empty()) {
+    FILE* f = o.json == "-" ? stdout : fopen(o.json.c_str(), "w");
+    if (!f) { perror(o.json.c_str()); return 1; }
+    fprintf(f, "[\n");
+    char line[256];
+    for (size_t i = 0; i < results.size(); i++) {
+      Bench::json(results[i], line, sizeof(line));
+      fprintf(f, "  %s%s\n", line, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "]\n");
+    if (f != stdout) fclose(f);
+  }
+  if (slower) fprintf(stderr, "%d routine(s) more than %.0f%% slower\n", slower, o.limitPct);
+  return slower ? 1 : 0;
+}
@@ -0,0 +1,254 @@
+/****************************************************************
+ * HIMBUDDY - POWER SIMULATION (runs on a PC)
+ *
+ * Runs the power manager from src/power.h (the same code the
+ * esp32fullcode.c sketch uses) over a day of events and prints the
+ * estimated charge per rail, battery life and alert latency, next to
+ * the always-on numbers of the old firmware.
+ *
+ * Trace file: one event per line, "<seconds> <event>", '#' = comment
+ *   motion   MPU6050 motion interrupt (wakes the unit)
+ *   tilt     tilt switch closes (wakes the unit; counted as a landslide
+ *            alert, the worst case: most closures only feed the detector)
+ *   gas      MQ-2 / soil / DHT over threshold -> seen at the next sample
+ *   mesh     alert frame from another unit (heard only while awake)
+ *   bt_on / bt_off   phone app connects / disconnects
+ * Without --trace a random day is generated (see options).
+ *
+ * Build : g++ -O2 -std=c++17 -I. tools/power_sim.cpp -o power_sim
+ * Run   : ./power_sim --days 7 --battery-mah 3000
+ *         ./power_sim --trace field_day.txt
+ ****************************************************************/
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/power.h"
+
+// Same values as the esp32fullcode.c config
+const PowerConfig SIM_CONFIG = { 5000, 10000, 60000, 120000, 300000, 20000, 20 };
+
+struct Event {
+  uint64_t ms;
+  std::string kind;
+};
+
+struct Options {
+  std::string trace;
+  int days = 1;
+  double motionPerHour = 2;
+  double tiltPerDay = 1;
+  double gasPerDay = 2;
+  double meshPerDay = 2;
+  double btPerDay = 3;
+  int btMinutes = 5;
+  uint32_t sampleWorkMs = 60; // sensor reads, SD write, display (DHT22 alone is ~25 ms)
+  uint32_t wakeCostMs = 15;   // light sleep exit + Wi-Fi restart
+  double batteryMah = 3000;
+  unsigned seed = 1;
+};
+
+// ==============================================================
+//                    EVENTS
+// ==============================================================
+static std::vector<Event> loadTrace(const std::string& path) {
+  std::vector<Event> ev;
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) { perror(path.c_str()); exit(1); }
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#') continue;
+    double sec;
+    char kind[32];
+    if (sscanf(line, "%lf %31s", &sec, kind) == 2) ev.push_back({ (uint64_t)(sec * 1000), kind });
+  }
+  fclose(f);
+  std::sort(ev.begin(), ev.end(), [](const Event& a, const Event& b) { return a.ms < b.ms; });
+  return ev;
+}
+
+static std::vector<Event> randomTrace(const Options& o) {
+  std::mt19937 rng(o.seed);
+  uint64_t span = (uint64_t)o.days * 86400000ULL;
+  std::uniform_int_distribution<uint64_t> at(0, span - 1);
+  std::vector<Event> ev;
+  auto scatter = [&](double perDay, const char* kind) {
+    std::poisson_distribution<int> n(perDay * o.days);
+    for (int i = n(rng); i > 0; i--) ev.push_back({ at(rng), kind });
+  };
+  scatter(o.motionPerHour * 24, "motion");
+  scatter(o.tiltPerDay, "tilt");
+  scatter(o.gasPerDay, "gas");
+  scatter(o.meshPerDay, "mesh");
+  std::poisson_distribution<int> nbt(o.btPerDay * o.days);
+  for (int i = nbt(rng); i > 0; i--) {
+    uint64_t t = at(rng);
+    ev.push_back({ t, "bt_on" });
+    ev.push_back({ t + (uint64_t)o.btMinutes * 60000, "bt_off" });
+  }
+  std::sort(ev.begin(), ev.end(), [](const Event& a, const Event& b) { return a.ms < b.ms; });
+  return ev;
+}
+
+static bool wakes(const std::string& k) { return k == "motion" || k == "tilt"; }
+
+// ==============================================================
+//                    SIMULATION
+// ==============================================================
+struct Latency {
+  std::vector<double> ms;
+  void add(double v) { ms.push_back(v); }
+  void print(const char* name) {
+    if (ms.empty()) { printf("  %-6s -\n", name); return; }
+    std::sort(ms.begin(), ms.end());
+    double sum = 0;
+    for (double v : ms) sum += v;
+    printf("  %-6s n=%-4zu mean %7.1f ms   max %7.1f ms\n", name, ms.size(), sum / ms.size(), ms.back());
+  }
+};
+
+struct SimResult {
+  EnergyMeter meter;
+  uint64_t stateMs[4] = {};
+  Latency tilt, gas, mesh;
+  int meshMissed = 0;
+};
+
+static SimResult simulate(const Options& o, const std::vector<Event>& ev, uint64_t spanMs) {
+  SimResult r;
+  r.meter.reset();
+  PowerPolicy p;
+  p.begin(SIM_CONFIG, 0);
+  uint64_t t = 0;
+  size_t next = 0;
+  std::vector<uint64_t> gasPending;
+  uint64_t deafFrom = 0, deafTo = 0; // last sleep + radio restart: mesh frames are lost
+
+  // time 't' passes awake with the rails of the current state
+  auto awake = [&](uint32_t dt) {
+    PowerState s = p.state((uint32_t)t);
+    bool on = (s == POWER_LINK || s == POWER_ALERT);
+    r.meter.add(dt, true, true, on, on);
+    r.stateMs[s] += dt;
+    t += dt;
+  };
+
+  while (t < spanMs) {
+    // events that happened while we were busy / asleep
+    while (next < ev.size() && ev[next].ms <= t) {
+      const Event& e = ev[next++];
+      uint32_t now = (uint32_t)t;
+      if (e.kind == "motion") p.onMotion(now);
+      else if (e.kind == "tilt") { p.onMotion(now); p.onAlert(now); r.tilt.add((double)(t - e.ms)); }
+      else if (e.kind == "gas") gasPending.push_back(e.ms);
+      else if (e.kind == "mesh") {
+        if (e.ms >= deafFrom && e.ms < deafTo) r.meshMissed++;
+        else { p.onAlert(now); r.mesh.add((double)(t - e.ms)); }
+      }
+      else if (e.kind == "bt_on") p.setBtClient(true);
+      else if (e.kind == "bt_off") p.setBtClient(false);
+    }
+
+    if (p.sampleDue((uint32_t)t)) {
+      awake(o.sampleWorkMs);
+      for (uint64_t g : gasPending) { p.onAlert((uint32_t)t); r.gas.add((double)(t - g)); }
+      gasPending.clear();
+      continue;
+    }
+
+    uint32_t sleep = p.sleepMs((uint32_t)t);
+    if (sleep == 0) {
+      awake(10); // loop() + delay(10)
+      continue;
+    }
+    uint64_t wake = t + sleep;
+    // the first waking event cuts the sleep short
+    for (size_t i = next; i < ev.size() && ev[i].ms < wake; i++) {
+      if (wakes(ev[i].kind)) { wake = ev[i].ms; break; }
+    }
+    if (wake > spanMs) wake = spanMs;
+    r.meter.add((uint32_t)(wake - t), false, false, false, false);
+    r.stateMs[POWER_DUTY] += wake - t;
+    r.meter.addWakeup();
+    deafFrom = t;
+    deafTo = wake + o.wakeCostMs;
+    t = wake;
+    awake(o.wakeCostMs);
+  }
+  return r;
+}
+
+// Old firmware: loop with delay(10), everything on all the time
+static EnergyMeter alwaysOn(uint64_t spanMs) {
+  EnergyMeter m;
+  m.reset();
+  m.add((uint32_t)std::min<uint64_t>(spanMs, 0xFFFFFFFFULL), true, true, true, true);
+  return m;
+}
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr,
+          "usage: power_sim [--trace FILE] [--days 1] [--motion-per-hour 2] [--tilt-per-day 1]\n"
+          "                 [--gas-per-day 2] [--mesh-per-day 2] [--bt-per-day 3] [--bt-minutes 5]\n"
+          "                 [--sample-work-ms 60] [--wake-cost-ms 15] [--battery-mah 3000] [--seed 1]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--trace") o.trace = v;
+    else if (a == "--days") o.days = atoi(v);
+    else if (a == "--motion-per-hour") o.motionPerHour = atof(v);
+    else if (a == "--tilt-per-day") o.tiltPerDay = atof(v);
+    else if (a == "--gas-per-day") o.gasPerDay = atof(v);
+    else if (a == "--mesh-per-day") o.meshPerDay = atof(v);
+    else if (a == "--bt-per-day") o.btPerDay = atof(v);
+    else if (a == "--bt-minutes") o.btMinutes = atoi(v);
+    else if (a == "--sample-work-ms") o.sampleWorkMs = (uint32_t)atoi(v);
+    else if (a == "--wake-cost-ms") o.wakeCostMs = (uint32_t)atoi(v);
+    else if (a == "--battery-mah") o.batteryMah = atof(v);
+    else if (a == "--seed") o.seed = (unsigned)atoi(v);
+    else usage();
+  }
+  if (o.days < 1 || o.days > 45) { fprintf(stderr, "--days 1..45 (millis() wraps at 49 days)\n"); return 2; }
+
+  std::vector<Event> ev = o.trace.empty() ? randomTrace(o) : loadTrace(o.trace);
+  uint64_t span = (uint64_t)o.days * 86400000ULL;
+  if (!o.trace.empty() && !ev.empty()) span = std::max(span, ev.back().ms + 1000);
+
+  SimResult r = simulate(o, ev, span);
+  EnergyMeter base = alwaysOn(span);
+  const PowerModel& m = POWER_MODEL_DEFAULT;
+
+  printf("simulated %.1f h, %zu events, %u wake-ups\n\n", span / 3600000.0, ev.size(), r.meter.wakeups);
+  printf("time per state:");
+  for (int s = 0; s < 4; s++) printf("  %s %.1f%%", powerStateName((uint8_t)s), 100.0 * r.stateMs[s] / span);
+  printf("\n\n%-8s %12s %12s\n", "rail", "always-on", "power-save");
+  printf("%-8s %12s %12s\n", "", "mAh/day", "mAh/day");
+  for (uint8_t rail = 0; rail < RAIL_COUNT; rail++) {
+    printf("%-8s %12.1f %12.1f\n", powerRailName(rail), base.mAhPerDay(m, rail), r.meter.mAhPerDay(m, rail));
+  }
+  printf("%-8s %12.1f %12.1f\n", "fixed", m.always * 24, m.always * 24);
+  double b = base.mAhPerDay(m), s = r.meter.mAhPerDay(m);
+  printf("%-8s %12.1f %12.1f\n", "total", b, s);
+  printf("\nbattery %.0f mAh: %.1f days always-on, %.1f days power-save\n", o.batteryMah, o.batteryMah / b, o.batteryMah / s);
+  printf("(the MQ-2 heater, ~150 mA at 5 V, is on its own supply and not counted)\n");
+
+  printf("\nalert latency (event -> alert raised):\n");
+  r.tilt.print("tilt");
+  r.gas.print("gas");
+  r.mesh.print("mesh");
+  if (r.meshMissed) printf("  mesh   %d frame(s) arrived while asleep (missed)\n", r.meshMissed);
+  return 0;
+}
@@ -0,0 +1,215 @@
+/****************************************************************
+ * HIMBUDDY - FLASH / RAM / BOOT TIME PER BOARD PROFILE (runs on a PC)
+ *
+ * Reads the .elf of each build (one per profile of src/board_config.h)
+ * and adds up its sections:
+ *   code    .flash.text            (flash)
+ *   rodata  .flash.rodata, ...     (flash)
+ *   iram    .iram0.*               (flash image + IRAM)
+ *   data    .dram0.data, ...       (flash image + DRAM, copied at boot)
+ *   bss     .dram0.bss, .noinit    (DRAM)
+ *   rtc     .rtc.*                 (RTC memory)
+ * flash = code + rodata + iram + data, static RAM = data + bss: what
+ * is left of the 320 KB DRAM is the heap. Any ELF32 / ELF64 file
+ * works, so the tool can be tried on PC binaries as well.
+ *
+ * --boot name=serial.log adds what the unit printed at boot
+ * (bootReportJson: bootMs, freeHeap) to that profile's row.
+ * --max-flash / --max-ram fail the run when a profile is bigger.
+ *
+ * Build the profiles the way the sketch is built, once per profile,
+ * e.g. with arduino-cli:
+ *   --build-property "compiler.cpp.extra_flags=-DHIMBUDDY_PROFILE=PROFILE_BT_SD"
+ *
+ * Build : g++ -O2 -std=c++17 -I. tools/profile_size.cpp -o profile_size
+ * Run   : ./profile_size web=build/web/HimBuddy.ino.elf bt_call=build/call/esp32.ino.elf
+ *         ./profile_size bt_sd=sd.elf bt_sd_lite=lite.elf --boot bt_sd=boot.log --max-ram 120000
+ ****************************************************************/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct Options {
+  std::vector<std::pair<std::string, std::string>> elfs;   // name, path
+  std::vector<std::pair<std::string, std::string>> boots;  // name, log
+  long maxFlash = 0;  // 0 = no limit
+  long maxRam = 0;
+};
+
+struct Sizes {
+  std::string name;
+  uint64_t code = 0, rodata = 0, iram = 0, data = 0, bss = 0, rtc = 0;
+  long bootMs = -1, freeHeap = -1;
+  uint64_t flash() const { return code + rodata + iram + data; }
+  uint64_t ram() const { return data + bss; }
+};
+
+// ==============================================================
+//                    ELF
+// ==============================================================
+#define SHT_NOBITS 8
+#define SHF_WRITE 1
+#define SHF_ALLOC 2
+#define SHF_EXECINSTR 4
+
+static uint64_t rd(const std::vector<uint8_t>& b, size_t at, int bytes) {
+  uint64_t v = 0;
+  if (at + bytes > b.size()) return 0;
+  for (int i = bytes - 1; i >= 0; i--) v = (v << 8) | b[at + i];  // little endian (ESP32, x86, arm)
+  return v;
+}
+
+static bool startsWith(const char* s, const char* prefix) { return strncmp(s, prefix, strlen(prefix)) == 0; }
+
+static bool readElf(const std::string& path, Sizes& out) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) return false;
+  std::vector<uint8_t> b;
+  uint8_t chunk[65536];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) b.insert(b.end(), chunk, chunk + n);
+  fclose(f);
+  if (b.size() < 52 || memcmp(b.data(), "\x7f" "ELF", 4) != 0 || b[5] != 1) return false;
+  bool is64 = b[4] == 2;
+  int w = is64 ? 8 : 4;  // address / offset size
+  uint64_t shoff = rd(b, is64 ? 0x28 : 0x20, w);
+  size_t shentsize = rd(b, is64 ? 0x3A : 0x2E, 2);
+  size_t shnum = rd(b, is64 ? 0x3C : 0x30, 2);
+  size_t shstrndx = rd(b, is64 ? 0x3E : 0x32, 2);
+  if (shoff == 0 || shnum == 0 || shstrndx >= shnum || shoff + shnum * shentsize > b.size()) return false;
+
+  auto sec = [&](size_t i, int field) -> uint64_t {
+    size_t at = shoff + i * shentsize;
+    switch (field) {
+      case 0: return rd(b, at, 4);                             // name
+      case 1: return rd(b, at + 4, 4);                         // type
+      case 2: return rd(b, at + 8, w);                         // flags
+      case 3: return rd(b, at + (is64 ? 0x18 : 0x10), w);      // offset
+      default: return rd(b, at + (is64 ? 0x20 : 0x14), w);     // size
+    }
+  };
+  uint64_t strtab = sec(shstrndx, 3);
+  for (size_t i = 1; i < shnum; i++) {
+    uint64_t flags = sec(i, 2), size = sec(i, 4);
+    if (!(flags & SHF_ALLOC) || size == 0) continue;
+    uint64_t nameAt = strtab + sec(i, 0);
+    const char* name = nameAt < b.size() ? (const char*)&b[nameAt] : "";
+    bool nobits = sec(i, 1) == SHT_NOBITS;
+    if (startsWith(name, ".rtc")) out.rtc += size;
+    else if (startsWith(name, ".iram")) out.iram += size;
+    else if (flags & SHF_WRITE) (nobits ? out.bss : out.data) += size;
+    else if (flags & SHF_EXECINSTR) out.code += size;
+    else if (!nobits) out.rodata += size;
+  }
+  return true;
+}
+
+// ==============================================================
+//                    BOOT LOG
+// ==============================================================
+// Last line of the log with "bootMs": that boot's report
+static bool readBoot(const std::string& path, Sizes& out) {
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) return false;
+  char line[512];
+  bool found = false;
+  while (fgets(line, sizeof(line), f)) {
+    const char* bootMs = strstr(line, "\"bootMs\":");
+    const char* heap = strstr(line, "\"freeHeap\":");
+    if (!bootMs || !heap) continue;
+    out.bootMs = atol(bootMs + 9);
+    out.freeHeap = atol(heap + 11);
+    found = true;
+  }
+  fclose(f);
+  return found;
+}
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr,
+          "usage: profile_size name=file.elf [name=file.elf ...] [--boot name=serial.log] [--max-flash bytes]\n"
+          "                    [--max-ram bytes]\n");
+  exit(2);
+}
+
+static bool splitPair(const std::string& a, std::pair<std::string, std::string>& out) {
+  size_t eq = a.find('=');
+  if (eq == std::string::npos || eq == 0 || eq + 1 == a.size()) return false;
+  out = { a.substr(0, eq), a.substr(eq + 1) };
+  return true;
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    std::pair<std::string, std::string> kv;
+    if (a.compare(0, 2, "--") != 0) {
+      if (!splitPair(a, kv)) usage();
+      o.elfs.push_back(kv);
+      continue;
+    }
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--boot") {
+      if (!splitPair(v, kv)) usage();
+      o.boots.push_back(kv);
+    } else if (a == "--max-flash") o.maxFlash = atol(v);
+    else if (a == "--max-ram") o.maxRam = atol(v);
+    else usage();
+  }
+  if (o.elfs.empty()) usage();
+
+  std::vector<Sizes> rows;
+  long failures = 0;
+  for (const auto& e : o.elfs) {
+    Sizes s;
+    s.name = e.first;
+    if (!readElf(e.second, s)) {
+      printf("FAIL %s: %s is not a readable ELF file\n", e.first.c_str(), e.second.c_str());
+      failures++;
+      continue;
+    }
+    for (const auto& b : o.boots) {
+      if (b.first == e.first && !readBoot(b.second, s)) {
+        printf("FAIL %s: no boot report in %s\n", e.first.c_str(), b.second.c_str());
+        failures++;
+      }
+    }
+    rows.push_back(s);
+  }
+
+  printf("%-12s %9s %9s %8s %7s %8s %6s %10s %10s %8s %9s\n", "profile", "code", "rodata", "iram", "data", "bss", "rtc",
+         "flash", "static RAM", "boot ms", "free heap");
+  for (const Sizes& s : rows) {
+    char boot[24] = "-", heap[24] = "-";
+    if (s.bootMs >= 0) snprintf(boot, sizeof(boot), "%ld", s.bootMs);
+    if (s.freeHeap >= 0) snprintf(heap, sizeof(heap), "%ld", s.freeHeap);
+    printf("%-12s %9llu %9llu %8llu %7llu %8llu %6llu %10llu %10llu %8s %9s\n", s.name.c_str(),
+           (unsigned long long)s.code, (unsigned long long)s.rodata, (unsigned long long)s.iram,
+           (unsigned long long)s.data, (unsigned long long)s.bss, (unsigned long long)s.rtc,
+           (unsigned long long)s.flash(), (unsigned long long)s.ram(), boot, heap);
+  }
+  // against the first profile (e.g. the full build vs one with features off)
+  for (size_t i = 1; i < rows.size(); i++) {
+    printf("%s vs %s: flash %+lld bytes, static RAM %+lld bytes\n", rows[i].name.c_str(), rows[0].name.c_str(),
+           (long long)rows[i].flash() - (long long)rows[0].flash(), (long long)rows[i].ram() - (long long)rows[0].ram());
+  }
+  for (const Sizes& s : rows) {
+    if (o.maxFlash && (long)s.flash() > o.maxFlash) {
+      printf("FAIL %s: flash %llu > %ld\n", s.name.c_str(), (unsigned long long)s.flash(), o.maxFlash);
+      failures++;
+    }
+    if (o.maxRam && (long)s.ram() > o.maxRam) {
+      printf("FAIL %s: static RAM %llu > %ld\n", s.name.c_str(), (unsigned long long)s.ram(), o.maxRam);
+      failures++;
+    }
+  }
+  printf("%s: %zu profiles, %ld failed checks\n", failures ? "FAIL" : "OK", rows.size(), failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,336 @@
+/****************************************************************
+ * HIMBUDDY - QUAKE CLASSIFIER BENCH (runs on a PC)
+ *
+ * Runs the vibration classifier from src/quake_fft.h (the same code
+ * HimBuddy.c runs on the MPU6050 FIFO data) over labelled traces and
+ * prints:
+ *   - confusion matrix per window, and per trace alarm rates
+ *     (alarm = a SEISMIC window with PGA >= --pga-mg), next to the
+ *     old rule (x/y jump > 3.5 m/s^2 between 100 ms reads)
+ *   - time per window on this PC
+ *
+ * Without --csv a labelled set is generated: band-limited ground
+ * motion (seismic), footsteps, door slams, pumps / motors, passing
+ * traffic and a quiet bench, each with sensor noise and gravity.
+ *
+ * CSV trace (100 Hz): "ax,ay,az" in mg per line, '#' = comment.
+ * The label is given with --label seismic|impulsive|machinery|quiet.
+ *
+ * Build : g++ -O2 -std=c++17 -I. tools/quake_bench.cpp -o quake_bench
+ * Run   : ./quake_bench --traces 200
+ *         ./quake_bench --csv shake_table.csv --label seismic
+ ****************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/quake_fft.h"
+
+struct Sample {
+  int16_t x, y, z;
+};
+
+struct Trace {
+  const char* kind;  // generator name
+  uint8_t label;     // expected class
+  std::vector<Sample> s;
+};
+
+struct Options {
+  std::string csv;
+  std::string label = "seismic";
+  int traces = 100;   // per kind
+  int seconds = 30;
+  int pgaMg = 30;     // alarm limit for SEISMIC windows
+  unsigned seed = 1;
+};
+
+// ==============================================================
+//                    SYNTHETIC TRACES (mg, 100 Hz)
+// ==============================================================
+class Gen {
+public:
+  explicit Gen(unsigned seed) : rng(seed) {}
+
+  double uni(double lo, double hi) { return std::uniform_real_distribution<double>(lo, hi)(rng); }
+  double gauss(double sd) { return std::normal_distribution<double>(0, sd)(rng); }
+
+  // Sum of random sines between f0 and f1: band-limited noise
+  struct Band {
+    std::vector<double> f, ph, a;
+    double at(double t) const {
+      double v = 0;
+      for (size_t i = 0; i < f.size(); i++) v += a[i] * sin(2 * M_PI * f[i] * t + ph[i]);
+      return v;
+    }
+  };
+  Band band(double f0, double f1, int n = 40) {
+    Band b;
+    double norm = sqrt(2.0 / n);
+    for (int i = 0; i < n; i++) {
+      b.f.push_back(uni(f0, f1));
+      b.ph.push_back(uni(0, 2 * M_PI));
+      b.a.push_back(norm * uni(0.5, 1.5));
+    }
+    return b;
+  }
+
+  std::mt19937 rng;
+};
+
+static int16_t mg(double v) { return (int16_t)std::max(-32768.0, std::min(32767.0, std::round(v))); }
+
+// Sensor at rest: random tilt of gravity, ~2 mg noise per axis, int mg
+static Trace finish(Gen& g, const char* kind, uint8_t label, int n, const std::vector<double>& x,
+                    const std::vector<double>& y, const std::vector<double>& z) {
+  Trace t{ kind, label, {} };
+  double tx = g.uni(-0.05, 0.05), ty = g.uni(-0.05, 0.05);
+  for (int i = 0; i < n; i++) {
+    t.s.push_back({ mg(1000 * tx + x[i] + g.gauss(2)), mg(1000 * ty + y[i] + g.gauss(2)),
+                    mg(1000 + z[i] + g.gauss(2)) });
+  }
+  return t;
+}
+
+// Ground motion: 0.5-8 Hz, rises in 1-3 s, shakes 10-40 s
+static Trace genSeismic(Gen& g, int n) {
+  std::vector<double> x(n), y(n), z(n);
+  Gen::Band bx = g.band(0.5, g.uni(4, 8)), by = g.band(0.5, g.uni(4, 8)), bz = g.band(0.8, 8);
+  double pga = g.uni(20, 300), rise = g.uni(1, 3), len = g.uni(10, 40);
+  for (int i = 0; i < n; i++) {
+    double t = (double)i / QUAKE_FS;
+    double env = t < rise ? t / rise : (t < len ? 1.0 : exp(-(t - len) / 5));
+    double a = env * pga / 2.5;
+    x[i] = a * bx.at(t);
+    y[i] = a * by.at(t);
+    z[i] = 0.5 * a * bz.at(t);
+  }
+  return finish(g, "seismic", QUAKE_SEISMIC, n, x, y, z);
+}
+
+// Damped ringing of the floor / wall after a hit
+static void addHit(std::vector<double>& v, int at, double amp, double hz, double tau) {
+  for (int i = at; i < (int)v.size() && i < at + (int)(6 * tau * QUAKE_FS); i++) {
+    double t = (double)(i - at) / QUAKE_FS;
+    v[i] += amp * exp(-t / tau) * sin(2 * M_PI * hz * t);
+  }
+}
+
+// Walking past / around the unit: a step every 0.45-0.65 s
+static Trace genFootsteps(Gen& g, int n) {
+  std::vector<double> x(n), y(n), z(n);
+  double period = g.uni(0.45, 0.65), amp = g.uni(10, 120), hz = g.uni(10, 30);
+  for (double t = g.uni(0, 1); t * QUAKE_FS < n; t += period * g.uni(0.9, 1.1)) {
+    int at = (int)(t * QUAKE_FS);
+    double a = amp * g.uni(0.6, 1.2);
+    addHit(z, at, a, hz, g.uni(0.02, 0.05));
+    addHit(x, at, 0.3 * a, hz * 1.2, 0.03);
+    addHit(y, at, 0.3 * a, hz * 0.9, 0.03);
+  }
+  return finish(g, "footsteps", QUAKE_IMPULSIVE, n, x, y, z);
+}
+
+// A slam every few seconds (door, drawer, box dropped on the table)
+static Trace genSlams(Gen& g, int n) {
+  std::vector<double> x(n), y(n), z(n);
+  for (double t = g.uni(0.5, 2); t * QUAKE_FS < n; t += g.uni(1.5, 4)) {
+    int at = (int)(t * QUAKE_FS);
+    double a = g.uni(100, 800), hz = g.uni(6, 40), tau = g.uni(0.04, 0.15);
+    addHit(x, at, a * g.uni(0.3, 1), hz, tau);
+    addHit(y, at, a * g.uni(0.3, 1), hz * 1.1, tau);
+    addHit(z, at, a * g.uni(0.2, 0.6), hz * 0.8, tau);
+  }
+  return finish(g, "slams", QUAKE_IMPULSIVE, n, x, y, z);
+}
+
+// Pump / motor / generator: a line (+ harmonics) with slow drift
+static Trace genMachine(Gen& g, int n) {
+  std::vector<double> x(n), y(n), z(n);
+  double f = g.uni(4, 45), amp = g.uni(10, 150), drift = g.uni(0, 0.03), h2 = g.uni(0, 0.4);
+  double px = g.uni(0, 6.3), py = g.uni(0, 6.3), ph = 0;
+  for (int i = 0; i < n; i++) {
+    double t = (double)i / QUAKE_FS;
+    ph += 2 * M_PI * f * (1 + drift * sin(2 * M_PI * 0.1 * t)) / QUAKE_FS;
+    double v = sin(ph) + h2 * sin(2 * ph + 1);
+    x[i] = amp * sin(ph + px);
+    y[i] = 0.7 * amp * sin(ph + py);
+    z[i] = 0.5 * amp * v;
+  }
+  return finish(g, "machine", QUAKE_MACHINERY, n, x, y, z);
+}
+
+// Trucks on a nearby road: 10-30 Hz rumble, a vehicle every few seconds
+static Trace genTraffic(Gen& g, int n) {
+  std::vector<double> x(n), y(n), z(n);
+  Gen::Band bx = g.band(10, 30), by = g.band(10, 30), bz = g.band(10, 30);
+  double amp = g.uni(10, 100);
+  std::vector<double> env(n, 0.2);
+  for (double t = 0; t * QUAKE_FS < n; t += g.uni(3, 10)) {
+    double w = g.uni(3, 8);
+    for (int i = 0; i < n; i++) {
+      double d = ((double)i / QUAKE_FS - t) / w;
+      env[i] += exp(-d * d * 4);
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    double t = (double)i / QUAKE_FS;
+    x[i] = amp * env[i] * bx.at(t);
+    y[i] = amp * env[i] * by.at(t);
+    z[i] = 1.5 * amp * env[i] * bz.at(t);
+  }
+  return finish(g, "traffic", QUAKE_MACHINERY, n, x, y, z);
+}
+
+static Trace genQuiet(Gen& g, int n) {
+  std::vector<double> x(n), y(n), z(n);
+  return finish(g, "quiet", QUAKE_QUIET, n, x, y, z);
+}
+
+static std::vector<Trace> generate(const Options& o) {
+  Gen g(o.seed);
+  int n = o.seconds * QUAKE_FS;
+  Trace (*const gens[])(Gen&, int) = { genSeismic, genFootsteps, genSlams, genMachine, genTraffic, genQuiet };
+  std::vector<Trace> set;
+  for (auto gen : gens) {
+    for (int i = 0; i < o.traces; i++) set.push_back(gen(g, n));
+  }
+  return set;
+}
+
+static uint8_t parseLabel(const std::string& s) {
+  for (uint8_t c = 0; c < QUAKE_CLASSES; c++) {
+    std::string name = quakeClassName(c);
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    if (name == s) return c;
+  }
+  fprintf(stderr, "unknown label '%s'\n", s.c_str());
+  exit(2);
+}
+
+static Trace loadCsv(const Options& o) {
+  Trace t{ "csv", parseLabel(o.label), {} };
+  FILE* f = fopen(o.csv.c_str(), "r");
+  if (!f) { perror(o.csv.c_str()); exit(1); }
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#') continue;
+    double x, y, z;
+    if (sscanf(line, "%lf,%lf,%lf", &x, &y, &z) == 3) t.s.push_back({ mg(x), mg(y), mg(z) });
+  }
+  fclose(f);
+  return t;
+}
+
+// ==============================================================
+//                    EVALUATION
+// ==============================================================
+// Old HimBuddy rule: every 100 ms, x or y changed by > 3.5 m/s^2
+static bool legacyAlarm(const Trace& t) {
+  const double limitMg = 3.5 / 9.80665 * 1000;
+  for (size_t i = 10; i < t.s.size(); i += 10) {
+    if (abs(t.s[i].x - t.s[i - 10].x) > limitMg || abs(t.s[i].y - t.s[i - 10].y) > limitMg) return true;
+  }
+  return false;
+}
+
+struct KindStats {
+  const char* kind;
+  uint8_t label;
+  int traces = 0, alarms = 0, legacy = 0;
+};
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr,
+          "usage: quake_bench [--traces 100] [--seconds 30] [--pga-mg 30] [--seed 1]\n"
+          "                   [--csv FILE --label seismic|impulsive|machinery|quiet]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--csv") o.csv = v;
+    else if (a == "--label") o.label = v;
+    else if (a == "--traces") o.traces = atoi(v);
+    else if (a == "--seconds") o.seconds = atoi(v);
+    else if (a == "--pga-mg") o.pgaMg = atoi(v);
+    else if (a == "--seed") o.seed = (unsigned)atoi(v);
+    else usage();
+  }
+  if (o.traces < 1 || o.seconds < 6) usage();
+
+  std::vector<Trace> set;
+  if (o.csv.empty()) set = generate(o);
+  else set.push_back(loadCsv(o));
+
+  static QuakeDetector det; // ~5 KB, same as on the ESP32
+  det.begin();
+  long confusion[QUAKE_CLASSES][QUAKE_CLASSES] = {};
+  std::vector<KindStats> kinds;
+  std::vector<double> analyseNs;
+  long windows = 0;
+
+  for (const Trace& t : set) {
+    det.reset();
+    bool alarm = false;
+    for (const Sample& s : t.s) {
+      auto t0 = std::chrono::steady_clock::now();
+      bool done = det.push(s.x, s.y, s.z);
+      if (!done) continue;
+      double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+      analyseNs.push_back(ns);
+      windows++;
+      const QuakeFeatures& f = det.last();
+      confusion[t.label][f.cls]++;
+      if (f.cls == QUAKE_SEISMIC && f.pgaMg >= o.pgaMg) alarm = true;
+    }
+    if (kinds.empty() || strcmp(kinds.back().kind, t.kind) != 0) kinds.push_back({ t.kind, t.label });
+    KindStats& k = kinds.back();
+    k.traces++;
+    k.alarms += alarm;
+    k.legacy += legacyAlarm(t);
+  }
+
+  printf("%zu traces, %ld windows of %d samples (%.2f s, hop %.2f s)\n\n", set.size(), windows, QUAKE_N,
+         (double)QUAKE_N / QUAKE_FS, (double)QUAKE_HOP / QUAKE_FS);
+  printf("windows: expected (rows) vs classified (columns)\n%-10s", "");
+  for (int c = 0; c < QUAKE_CLASSES; c++) printf(" %10s", quakeClassName(c));
+  printf(" %8s\n", "correct");
+  for (int r = 0; r < QUAKE_CLASSES; r++) {
+    long sum = 0;
+    for (int c = 0; c < QUAKE_CLASSES; c++) sum += confusion[r][c];
+    if (!sum) continue;
+    printf("%-10s", quakeClassName(r));
+    for (int c = 0; c < QUAKE_CLASSES; c++) printf(" %10ld", confusion[r][c]);
+    printf(" %7.1f%%\n", 100.0 * confusion[r][r] / sum);
+  }
+
+  printf("\ntraces that raise EARTHQUAKE (PGA >= %d mg):\n", o.pgaMg);
+  printf("%-10s %-10s %7s %10s %10s\n", "trace", "label", "count", "fft", "old rule");
+  for (const KindStats& k : kinds) {
+    printf("%-10s %-10s %7d %9.1f%% %9.1f%%\n", k.kind, quakeClassName(k.label), k.traces, 100.0 * k.alarms / k.traces,
+           100.0 * k.legacy / k.traces);
+  }
+
+  if (!analyseNs.empty()) {
+    std::sort(analyseNs.begin(), analyseNs.end());
+    double sum = 0;
+    for (double v : analyseNs) sum += v;
+    printf("\nanalyse: mean %.1f us, p99 %.1f us per window on this PC\n", sum / analyseNs.size() / 1000,
+           analyseNs[analyseNs.size() * 99 / 100] / 1000);
+  }
+  printf("(the ESP32 reports its own cycles per window on /api/quake)\n");
+  return 0;
+}
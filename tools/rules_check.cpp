@@ -0,0 +1,172 @@
+/****************************************************************
+ * HIMBUDDY - ALERT RULES CHECKER (runs on a PC)
+ *
+ * Compiles a rules file with src/rules.h, the same engine the
+ * sketches run, so a typo is found here and not on the mountain.
+ * Prints every rule as the device will see it and the bytecode size.
+ *
+ * --bench times evaluate() on N made-up rules (every snapshot moves
+ * the signals a little, so conditions flip and timers run) to show
+ * what a snapshot costs.
+ *
+ * Signals per sketch (use the one the file is for):
+ *   HimBuddy.c       soil,gas,temp,hum,seismic,pga
+ *   esp32.c          temp,hum,soil,gas,vibration,slide,tilt
+ *   esp32fullcode.c  dhtT,dhtH,mq,soil,slide
+ *
+ * Build : g++ -O2 -std=c++17 -I. tools/rules_check.cpp -o rules_check
+ * Run   : ./rules_check --rules rules.txt --signals temp,hum,soil,gas,vibration,slide,tilt
+ *         ./rules_check --bench 100
+ ****************************************************************/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/rules.h"
+
+struct Options {
+  std::string rules;
+  std::string signals = "soil,gas,temp,hum,seismic,pga";
+  int bench = 0;
+};
+
+static std::vector<std::string> split(const std::string& s) {
+  std::vector<std::string> out;
+  size_t at = 0;
+  while (at <= s.size()) {
+    size_t comma = s.find(',', at);
+    if (comma == std::string::npos) comma = s.size();
+    if (comma > at) out.push_back(s.substr(at, comma - at));
+    at = comma + 1;
+  }
+  return out;
+}
+
+static std::string readFile(const std::string& path) {
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) { perror(path.c_str()); exit(1); }
+  std::string text;
+  char buf[512];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, n);
+  fclose(f);
+  return text;
+}
+
+// ==============================================================
+//                    BENCH
+// ==============================================================
+static std::string madeUpRules(int n, int signals, std::mt19937& rng) {
+  static const char* const OPS[] = { ">", ">=", "<", "<=" };
+  std::uniform_int_distribution<int> sig(0, signals - 1), op(0, 3), pct(10, 90), kind(0, 3);
+  std::string text;
+  char line[160];
+  for (int i = 0; i < n; i++) {
+    int a = sig(rng), b = sig(rng);
+    switch (kind(rng)) {
+      case 0: snprintf(line, sizeof(line), "s%d %s %d -> R%d\n", a, OPS[op(rng)], pct(rng), i); break;
+      case 1:
+        snprintf(line, sizeof(line), "s%d > %d for 3s and s%d < %d -> R%d priority %d cooldown 10s\n", a, pct(rng), b,
+                 pct(rng), i, 1 + i % 5);
+        break;
+      case 2:
+        snprintf(line, sizeof(line), "(s%d > %d or s%d_rate > 2/min) and not s%d == 0 -> R%d priority 2\n", a, pct(rng),
+                 b, a, i);
+        break;
+      default: snprintf(line, sizeof(line), "s%d_rate < -1/s for 500ms -> R%d cooldown 1min\n", a, i); break;
+    }
+    text += line;
+  }
+  return text;
+}
+
+static int bench(int rules) {
+  const int signals = 8;
+  std::vector<std::string> names;
+  std::vector<const char*> ptrs;
+  for (int i = 0; i < signals; i++) names.push_back("s" + std::to_string(i));
+  for (const std::string& s : names) ptrs.push_back(s.c_str());
+
+  std::mt19937 rng(1);
+  std::string text = madeUpRules(rules, signals, rng);
+  static RuleEngine engine;
+  char err[64];
+  if (!engine.compile(text.c_str(), ptrs.data(), signals, err, sizeof(err))) {
+    fprintf(stderr, "bench rules did not compile: %s\n", err);
+    return 1;
+  }
+
+  const int snapshots = 200000;
+  std::normal_distribution<float> step(0, 3);
+  std::vector<float> values(signals, 50);
+  std::vector<float> trace((size_t)snapshots * signals);
+  for (int t = 0; t < snapshots; t++) {
+    for (int s = 0; s < signals; s++) {
+      values[s] = std::max(0.0f, std::min(100.0f, values[s] + step(rng)));
+      trace[(size_t)t * signals + s] = values[s];
+    }
+  }
+
+  uint8_t fired[RULES_MAX];
+  unsigned long total = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < snapshots; t++) {
+    total += engine.evaluate((uint32_t)t * 250, &trace[(size_t)t * signals], fired, RULES_MAX);
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  printf("%u rules, %u bytes of bytecode, %d snapshots, %lu fires\n", engine.count(), engine.codeBytes(), snapshots,
+         total);
+  printf("evaluate(): %.0f ns per snapshot on this PC (%.1f ns per rule), engine %zu bytes\n", ns / snapshots,
+         ns / snapshots / engine.count(), sizeof(engine));
+  return 0;
+}
+
+// ==============================================================
+//                    MAIN
+// ==============================================================
+static void usage() {
+  fprintf(stderr, "usage: rules_check --rules FILE [--signals a,b,c] | --bench 100\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) usage();
+    const char* v = argv[++i];
+    if (a == "--rules") o.rules = v;
+    else if (a == "--signals") o.signals = v;
+    else if (a == "--bench") o.bench = atoi(v);
+    else usage();
+  }
+  if (o.bench > 0) return bench(o.bench);
+  if (o.rules.empty()) usage();
+
+  std::vector<std::string> names = split(o.signals);
+  std::vector<const char*> ptrs;
+  for (const std::string& s : names) ptrs.push_back(s.c_str());
+  if (names.size() > RULES_SIGNALS_MAX) { fprintf(stderr, "too many signals\n"); return 1; }
+
+  std::string text = readFile(o.rules);
+  static RuleEngine engine;
+  char err[64];
+  if (!engine.compile(text.c_str(), ptrs.data(), (uint8_t)ptrs.size(), err, sizeof(err))) {
+    bool numbered = strncmp(err, "line ", 5) == 0;  // "line N: ..." -> "file:N: ..."
+    fprintf(stderr, "%s:%s\n", o.rules.c_str(), numbered ? err + 5 : err);
+    return 1;
+  }
+  printf("%5s  %-16s %8s %10s %10s\n", "line", "name", "priority", "for", "cooldown");
+  for (uint8_t i = 0; i < engine.count(); i++) {
+    const Rule& r = engine.rule(i);
+    printf("%5u  %-16s %8u %8lums %8lums\n", (unsigned)r.line, engine.name(i), (unsigned)r.priority,
+           (unsigned long)r.forMs, (unsigned long)r.cooldownMs);
+  }
+  printf("%u rules, %u bytes of bytecode\n", engine.count(), engine.codeBytes());
+  return 0;
+}